@@ -0,0 +1,109 @@
+#include "access_log.h"
+#include "clock.h"
+#include "http_enums.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+
+//==============================================================================
+// Access log formats
+//==============================================================================
+const char* access_log_format_to_string(enum EAccessLogFormat x) {
+  switch(x) {
+    case ACCESS_LOG_TEXT:   return "text";
+    case ACCESS_LOG_BINARY: return "binary";
+    default:                return "?";
+  }
+}
+
+enum EAccessLogFormat access_log_format_from_string(const char* str) {
+  if(!strcmp(str, "text"  )) return ACCESS_LOG_TEXT;
+  if(!strcmp(str, "binary")) return ACCESS_LOG_BINARY;
+  return ACCESS_LOG_UNKNOWN;
+}
+
+//==============================================================================
+// Encoding
+//==============================================================================
+void access_log_header(AccessLogHeader* header) {
+  memcpy(header->magic, ACCESS_LOG_MAGIC, sizeof(header->magic));
+  header->version = ACCESS_LOG_VERSION;
+  header->record_size = sizeof(AccessLogRecord);
+}
+
+size_t access_log_encode(char* buf, AccessLogRecord* record, const char* uri, size_t uri_len) {
+  if(uri_len > ACCESS_LOG_MAX_URI) uri_len = ACCESS_LOG_MAX_URI;
+  record->uri_len = uri_len;
+  memcpy(buf, record, sizeof(AccessLogRecord));
+  memcpy(buf + sizeof(AccessLogRecord), uri, uri_len);
+  return sizeof(AccessLogRecord) + uri_len;
+}
+
+//==============================================================================
+// Decoding
+//==============================================================================
+bool access_log_read_header(FILE* in) {
+  AccessLogHeader header;
+  if(fread(&header, sizeof(header), 1, in) != 1) return false;
+  return !memcmp(header.magic, ACCESS_LOG_MAGIC, sizeof(header.magic)) &&
+         header.version == ACCESS_LOG_VERSION &&
+         header.record_size == sizeof(AccessLogRecord);
+}
+
+int access_log_read(FILE* in, AccessLogRecord* record, char* uri) {
+  const size_t n = fread(record, 1, sizeof(AccessLogRecord), in);
+  if(n == 0) return 0;
+  if(n < sizeof(AccessLogRecord) || record->uri_len > ACCESS_LOG_MAX_URI) return -1;
+  if(fread(uri, 1, record->uri_len, in) != record->uri_len) return -1;
+  uri[record->uri_len] = 0;
+  return 1;
+}
+
+// Format a record's client IP address
+static void access_log_ip(const AccessLogRecord* record, char* buf) {
+  struct in_addr addr;
+  addr.s_addr = record->ip;
+  inet_ntop(AF_INET, &addr, buf, INET_ADDRSTRLEN);
+}
+
+void access_log_print_text(FILE* out, const AccessLogRecord* record, const char* uri) {
+  char tb[CLOCK_LOG_TIMESTAMP_LEN + 1];
+  char ip[INET_ADDRSTRLEN];
+  clock_format_log_timestamp(record->time, tb);
+  access_log_ip(record, ip);
+  fprintf(out, "%s | %s:%i | %s %s %s | %u %llu %uus", tb, ip, record->port,
+          http_method_to_string(record->method), uri, http_version_to_string(record->version),
+          record->status, (unsigned long long)record->bytes, record->latency_us);
+
+  // How well the body compressed, and what it cost
+  if(record->body_in > 0) {
+    fprintf(out, " | %s %llu->%llu %.1f%% %uus",
+            http_encoding_to_string(record->encoding), (unsigned long long)record->body_in,
+            (unsigned long long)record->body_out, 100.0 * record->body_out / record->body_in,
+            record->compress_us);
+  }
+  fputc('\n', out);
+}
+
+void access_log_print_csv_header(FILE* out) {
+  fprintf(out, "time,ip,port,method,uri,version,status,bytes,latency_us,"
+               "encoding,body_in,body_out,compress_us\n");
+}
+
+void access_log_print_csv(FILE* out, const AccessLogRecord* record, const char* uri) {
+  char ip[INET_ADDRSTRLEN];
+  access_log_ip(record, ip);
+  fprintf(out, "%lld,%s,%u,%s,\"", (long long)record->time, ip, record->port,
+          http_method_to_string(record->method));
+
+  // The URI is quoted, with any quotes in it doubled
+  for(const char* p = uri; *p; ++p) {
+    if(*p == '"') fputc('"', out);
+    fputc(*p, out);
+  }
+
+  fprintf(out, "\",%s,%u,%llu,%u,%s,%llu,%llu,%u\n", http_version_to_string(record->version),
+          record->status, (unsigned long long)record->bytes, record->latency_us,
+          http_encoding_to_string(record->encoding), (unsigned long long)record->body_in,
+          (unsigned long long)record->body_out, record->compress_us);
+}
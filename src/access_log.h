@@ -0,0 +1,97 @@
+//==============================================================================
+// Binary access log
+//
+// At peak load, formatting and writing a text line per request costs real CPU
+// and disk bandwidth. In binary mode, the webserver instead writes one
+// fixed-layout record per request to webserver-access-YYYYMMDD.bin, next to
+// the other log files. bin/logdecode turns those files back into text lines
+// or CSV.
+//
+// A file starts with an AccessLogHeader. Each record is an AccessLogRecord
+// followed by 'uri_len' bytes of request URI. Everything is in host byte
+// order: the header's version doesn't match on a machine with the other
+// byte order, so such files are rejected rather than misread.
+//
+// URIs longer than ACCESS_LOG_MAX_URI bytes are truncated, since a record has
+// to fit in one log ring slot (see log_ring.h).
+//==============================================================================
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "log_ring.h"
+
+#define ACCESS_LOG_MAGIC   "WSAL"
+#define ACCESS_LOG_VERSION 2
+
+// Access log formats
+enum EAccessLogFormat {
+  ACCESS_LOG_UNKNOWN,
+  ACCESS_LOG_TEXT,    // A line in the standard log
+  ACCESS_LOG_BINARY   // A record in the binary access log
+};
+
+// String conversion. Returns "?" or ACCESS_LOG_UNKNOWN on error.
+const char*           access_log_format_to_string  (enum EAccessLogFormat x);
+enum EAccessLogFormat access_log_format_from_string(const char* s);
+
+typedef struct AccessLogHeader {
+  char     magic[4];     // ACCESS_LOG_MAGIC, without a null terminator
+  uint16_t version;      // ACCESS_LOG_VERSION
+  uint16_t record_size;  // sizeof(AccessLogRecord)
+} AccessLogHeader;
+
+typedef struct AccessLogRecord {
+  int64_t  time;        // When the response was queued (all of it, if it was
+                        //   streamed), in seconds since the epoch
+  uint32_t ip;          // Client IPv4 address, in network byte order
+  uint16_t port;        // Client port
+  uint8_t  method;      // enum EHttpMethod
+  uint8_t  version;     // enum EHttpVersion
+  uint16_t status;      // Response status code
+  uint16_t uri_len;     // Number of URI bytes following the record
+  uint32_t latency_us;  // From starting on the request to queuing its response
+  uint64_t bytes;       // Size of the response
+  uint64_t body_in;     // Size of the body before compression, or 0 if it
+  uint64_t body_out;    //   wasn't compressed, and after
+  uint32_t compress_us; // CPU time spent compressing it for this response
+  uint8_t  encoding;    // enum EHttpEncoding of the body
+  uint8_t  reserved[3]; // Zero
+} AccessLogRecord;
+
+// Longest URI a record can carry
+#define ACCESS_LOG_MAX_URI (LOG_RECORD_TEXT_SIZE - sizeof(AccessLogRecord))
+
+// Fill in a file header
+void access_log_header(AccessLogHeader* header);
+
+// Serialize a record and its URI into 'buf', which must have room for
+// sizeof(AccessLogRecord) + ACCESS_LOG_MAX_URI bytes. Sets the record's
+// uri_len, truncating the URI if needed. Returns the number of bytes written.
+size_t access_log_encode(char* buf, AccessLogRecord* record, const char* uri, size_t uri_len);
+
+//----- Decoding ---------------------------------------------------------------
+
+// Read and check a file header. Returns false if it's missing or doesn't
+// match this build.
+bool access_log_read_header(FILE* in);
+
+// Read the next record and its URI. 'uri' must have room for
+// ACCESS_LOG_MAX_URI + 1 bytes, and is null-terminated.
+// - Returns 1 on success, 0 at the end of the file, and -1 if the file ends
+//   partway through a record.
+int access_log_read(FILE* in, AccessLogRecord* record, char* uri);
+
+// Write a record as a line in the text log format, followed by the status,
+// response size and latency:
+//   "20121008-15:32:46 UTC | 10.0.0.1:5123 | GET / HTTP/1.1 | 200 59 120us"
+void access_log_print_text(FILE* out, const AccessLogRecord* record, const char* uri);
+
+// Write a record as a CSV row, or write the CSV header row
+void access_log_print_csv(FILE* out, const AccessLogRecord* record, const char* uri);
+void access_log_print_csv_header(FILE* out);
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,161 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+// Utility functions
+//==============================================================================
+// Round up to a multiple of ARENA_ALIGNMENT
+static size_t arena_align(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// Where a chunk's memory starts, past its header
+static char* arena_chunk_data(ArenaChunk* chunk) {
+  return (char*)chunk + arena_align(sizeof(ArenaChunk));
+}
+
+// Get a pooled-size chunk: a spare one if there is one
+static ArenaChunk* arena_pool_take(ArenaPool* pool) {
+  if(pool && pool->spare) {
+    ArenaChunk* chunk = pool->spare;
+    pool->spare = chunk->next;
+    pool->num_spare -= 1;
+    return chunk;
+  }
+  ArenaChunk* chunk = malloc(ARENA_CHUNK_SIZE);
+  chunk->size = ARENA_CHUNK_SIZE;
+  return chunk;
+}
+
+// Return a chunk to the pool, or free it if it's oversized or the pool is full
+static void arena_pool_give(ArenaPool* pool, ArenaChunk* chunk) {
+  if(pool && chunk->size == ARENA_CHUNK_SIZE && pool->num_spare < pool->max_spare) {
+    chunk->next = pool->spare;
+    pool->spare = chunk;
+    pool->num_spare += 1;
+  }
+  else {
+    free(chunk);
+  }
+}
+
+// Return a list of chunks to the pool
+static void arena_release(ArenaPool* pool, ArenaChunk* chunk) {
+  while(chunk) {
+    ArenaChunk* next = chunk->next;
+    arena_pool_give(pool, chunk);
+    chunk = next;
+  }
+}
+
+//==============================================================================
+// ArenaPool
+//==============================================================================
+void arena_pool_init(ArenaPool* pool, size_t max_spare) {
+  pool->spare = NULL;
+  pool->num_spare = 0;
+  pool->max_spare = max_spare;
+}
+
+void arena_pool_free(ArenaPool* pool) {
+  ArenaChunk* chunk = pool->spare;
+  while(chunk) {
+    ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  pool->spare = NULL;
+  pool->num_spare = 0;
+}
+
+//==============================================================================
+// Arena
+//==============================================================================
+void arena_init(Arena* arena, ArenaPool* pool) {
+  arena->pool = pool;
+  arena->chunks = NULL;
+  arena->ptr = NULL;
+  arena->end = NULL;
+}
+
+void arena_free(Arena* arena) {
+  arena_release(arena->pool, arena->chunks);
+  arena_init(arena, arena->pool);
+}
+
+void arena_reset(Arena* arena) {
+  ArenaChunk* keep = arena->chunks;
+  if(!keep) return;
+
+  // The current chunk is the first one, unless the only allocations so far
+  // were oversized
+  if(keep->size != ARENA_CHUNK_SIZE) {
+    arena_free(arena);
+    return;
+  }
+  arena_release(arena->pool, keep->next);
+  keep->next = NULL;
+  arena->ptr = arena_chunk_data(keep);
+  arena->end = (char*)keep + keep->size;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+  size = arena_align(size ? size : 1);
+  if((size_t)(arena->end - arena->ptr) >= size) {
+    void* mem = arena->ptr;
+    arena->ptr += size;
+    return mem;
+  }
+
+  // Too big for any pooled chunk: give it a chunk of its own, behind the
+  // current one so that the current one's free space isn't lost
+  const size_t header = arena_align(sizeof(ArenaChunk));
+  if(size > ARENA_CHUNK_SIZE - header) {
+    ArenaChunk* chunk = malloc(header + size);
+    chunk->size = header + size;
+    if(arena->chunks) {
+      chunk->next = arena->chunks->next;
+      arena->chunks->next = chunk;
+    }
+    else {
+      chunk->next = NULL;
+      arena->chunks = chunk;
+    }
+    return arena_chunk_data(chunk);
+  }
+
+  // Start a new current chunk
+  ArenaChunk* chunk = arena_pool_take(arena->pool);
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  arena->ptr = arena_chunk_data(chunk) + size;
+  arena->end = (char*)chunk + chunk->size;
+  return arena_chunk_data(chunk);
+}
+
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+  if(!ptr) return arena_alloc(arena, new_size);
+  if(new_size <= old_size) return ptr;
+
+  // The latest allocation can grow into the free space after it
+  const size_t old_aligned = arena_align(old_size ? old_size : 1);
+  const size_t new_aligned = arena_align(new_size);
+  if((char*)ptr + old_aligned == arena->ptr &&
+     (size_t)(arena->end - (char*)ptr) >= new_aligned)
+  {
+    arena->ptr = (char*)ptr + new_aligned;
+    return ptr;
+  }
+
+  void* mem = arena_alloc(arena, new_size);
+  memcpy(mem, ptr, old_size);
+  return mem;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+  char* copy = arena_alloc(arena, len + 1);
+  memcpy(copy, str, len);
+  copy[len] = 0;
+  return copy;
+}
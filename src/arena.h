@@ -0,0 +1,74 @@
+//==============================================================================
+// Bump-pointer arena for memory that lives as long as one request
+//
+// Allocating from an arena is a pointer increment, and nothing is freed on its
+// own: arena_reset() drops everything at once when the request is done. Each
+// connection has one, so handling a request and building its response never
+// call malloc() or free().
+//
+// Arenas get their memory in fixed-size chunks from an ArenaPool. Chunks given
+// back by one connection are handed to the next, so once a worker has warmed
+// up, new connections don't call malloc() either. A pool isn't thread-safe;
+// each worker has its own.
+//
+// Allocations bigger than a chunk get a chunk of their own, which is freed
+// rather than pooled.
+//==============================================================================
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Size of a pooled chunk, including its header
+#define ARENA_CHUNK_SIZE 8192
+
+// Alignment of every allocation
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaChunk {
+  struct ArenaChunk* next;  // Next chunk in the arena or pool
+  size_t             size;  // Size of the chunk, including this header
+} ArenaChunk;
+
+typedef struct ArenaPool {
+  ArenaChunk* spare;      // Chunks waiting to be reused
+  size_t      num_spare;  // Number of spare chunks
+  size_t      max_spare;  // Chunks past this many are freed instead
+} ArenaPool;
+
+typedef struct Arena {
+  ArenaPool*  pool;    // Where chunks come from. May be NULL.
+  ArenaChunk* chunks;  // Chunks in use, the current one first
+  char*       ptr;     // Next free byte of the current chunk
+  char*       end;     // End of the current chunk
+} Arena;
+
+// Initialize a pool that keeps up to 'max_spare' chunks for reuse
+void arena_pool_init(ArenaPool* pool, size_t max_spare);
+
+// Free the pool's spare chunks. Arenas using the pool must be freed first.
+void arena_pool_free(ArenaPool* pool);
+
+// Initialize an empty arena. It takes no memory until the first allocation.
+// - If 'pool' is NULL, chunks come straight from malloc().
+void arena_init(Arena* arena, ArenaPool* pool);
+
+// Give all of the arena's memory back to its pool
+void arena_free(Arena* arena);
+
+// Free everything allocated from the arena. Keeps the current chunk, so the
+// next request starts with warm memory.
+void arena_reset(Arena* arena);
+
+// Allocate 'size' bytes, aligned to ARENA_ALIGNMENT. Never returns NULL.
+void* arena_alloc(Arena* arena, size_t size);
+
+// Resize an allocation from this arena, copying it if it can't grow in place.
+// Only the most recent allocation can grow in place.
+// - 'ptr' may be NULL, in which case this is arena_alloc().
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+
+// Copy 'len' bytes of 'str' into the arena, with a null terminator
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+
+#endif // ARENA_H
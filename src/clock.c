@@ -0,0 +1,265 @@
+#include "clock.h"
+#include <string.h>
+
+//==============================================================================
+// Data and constants
+//==============================================================================
+static const char* DAY_NAMES[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char* MONTH_NAMES[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// Each thread's formatted copy of the current second
+typedef struct ClockCache {
+  time_t second;  // Second the strings were formatted for
+  char   http_date[CLOCK_HTTP_DATE_LEN + 1];
+  char   log_timestamp[CLOCK_LOG_TIMESTAMP_LEN + 1];
+} ClockCache;
+
+static __thread ClockCache clock_cache = { -1, {0}, {0} };
+
+//==============================================================================
+// Utility functions
+//==============================================================================
+// A UTC time, broken down
+typedef struct ClockFields {
+  int year, month, day;        // Month is 1-12
+  int hour, minute, second;
+  int weekday;                 // 0 is Sunday
+} ClockFields;
+
+// Break down a time. Converts days to a date with Howard Hinnant's
+// civil_from_days algorithm, which is exact for the proleptic Gregorian
+// calendar.
+static ClockFields clock_fields(time_t t) {
+  ClockFields f;
+  int64_t days = t / 86400;
+  int64_t secs = t % 86400;
+  if(secs < 0) {
+    secs += 86400;
+    days -= 1;
+  }
+  f.hour = secs / 3600;
+  f.minute = secs / 60 % 60;
+  f.second = secs % 60;
+  f.weekday = (int)((days % 7 + 11) % 7);  // 1970-01-01 was a Thursday
+
+  days += 719468;
+  const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const int64_t doe = days - era * 146097;
+  const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const int64_t mp = (5 * doy + 2) / 153;
+  f.day = doy - (153 * mp + 2) / 5 + 1;
+  f.month = (mp < 10 ? mp + 3 : mp - 9);
+  f.year = yoe + era * 400 + (f.month <= 2);
+  return f;
+}
+
+// Days since 1970-01-01 of a date, with Howard Hinnant's days_from_civil
+// algorithm: the inverse of the above
+static int64_t clock_days(int64_t year, int month, int day) {
+  year -= (month <= 2);
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t yoe = year - era * 400;
+  const int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Read exactly 'width' digits. Returns -1 if they aren't all digits.
+static int clock_get_digits(const char* p, int width) {
+  int value = 0;
+  for(int i=0; i<width; ++i) {
+    if(p[i] < '0' || p[i] > '9') return -1;
+    value = value * 10 + (p[i] - '0');
+  }
+  return value;
+}
+
+// Month (1-12) of a three-letter name, or 0
+static int clock_get_month(const char* p) {
+  for(int i=0; i<12; ++i) {
+    if(!memcmp(p, MONTH_NAMES[i], 3)) return i + 1;
+  }
+  return 0;
+}
+
+// Is 'p' one of the day names, for 'len' bytes? Short names are three letters;
+// long ones, as in RFC 850 dates, are those plus "day", "sday", etc.
+static bool clock_is_day_name(const char* p, size_t len) {
+  static const char* LONG_NAMES[7] = {"Sunday", "Monday", "Tuesday", "Wednesday",
+                                      "Thursday", "Friday", "Saturday"};
+  for(int i=0; i<7; ++i) {
+    if(len == 3 && !memcmp(p, DAY_NAMES[i], 3)) return true;
+    if(len == strlen(LONG_NAMES[i]) && !memcmp(p, LONG_NAMES[i], len)) return true;
+  }
+  return false;
+}
+
+// Read "HH:MM:SS" into 'f'
+static bool clock_get_time(const char* p, ClockFields* f) {
+  if(p[2] != ':' || p[5] != ':') return false;
+  f->hour = clock_get_digits(p, 2);
+  f->minute = clock_get_digits(p + 3, 2);
+  f->second = clock_get_digits(p + 6, 2);
+  return f->hour >= 0 && f->hour < 24 && f->minute >= 0 && f->minute < 60 &&
+         f->second >= 0 && f->second <= 60;
+}
+
+// Turn checked fields into a time. A leap second counts as the second before.
+static bool clock_from_fields(const ClockFields* f, time_t* t) {
+  static const int MONTH_DAYS[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if(f->year < 0 || f->month < 1 || f->day < 1 || f->day > MONTH_DAYS[f->month - 1]) return false;
+  const int64_t days = clock_days(f->year, f->month, f->day);
+  if(f->month == 2 && f->day == 29 && clock_days(f->year, 3, 1) - days != 1) return false;
+  const int second = (f->second == 60 ? 59 : f->second);
+  *t = days * 86400 + f->hour * 3600 + f->minute * 60 + second;
+  return true;
+}
+
+// Write a number as exactly 'width' digits
+static char* clock_put_digits(char* p, int value, int width) {
+  for(int i=width-1; i>=0; --i) {
+    p[i] = '0' + value % 10;
+    value /= 10;
+  }
+  return p + width;
+}
+
+static char* clock_put(char* p, const char* str, size_t len) {
+  memcpy(p, str, len);
+  return p + len;
+}
+
+// Reformat the calling thread's strings if the second has changed
+static ClockCache* clock_refresh() {
+  ClockCache* cache = &clock_cache;
+  const time_t now = clock_now();
+  if(now != cache->second) {
+    clock_format_http_date(now, cache->http_date);
+    clock_format_log_timestamp(now, cache->log_timestamp);
+    cache->second = now;
+  }
+  return cache;
+}
+
+//==============================================================================
+// Clock
+//==============================================================================
+uint64_t clock_monotonic_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t clock_monotonic_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t clock_thread_cpu_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+time_t clock_now() {
+  // The coarse clock is read without a system call and is plenty accurate
+  // for whole seconds
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  return ts.tv_sec;
+}
+
+const char* clock_http_date() {
+  return clock_refresh()->http_date;
+}
+
+const char* clock_log_timestamp() {
+  return clock_refresh()->log_timestamp;
+}
+
+void clock_format_http_date(time_t t, char* buf) {
+  const ClockFields f = clock_fields(t);
+  char* p = buf;
+  p = clock_put(p, DAY_NAMES[f.weekday], 3);
+  p = clock_put(p, ", ", 2);
+  p = clock_put_digits(p, f.day, 2);
+  p = clock_put(p, " ", 1);
+  p = clock_put(p, MONTH_NAMES[f.month - 1], 3);
+  p = clock_put(p, " ", 1);
+  p = clock_put_digits(p, f.year, 4);
+  p = clock_put(p, " ", 1);
+  p = clock_put_digits(p, f.hour, 2);
+  p = clock_put(p, ":", 1);
+  p = clock_put_digits(p, f.minute, 2);
+  p = clock_put(p, ":", 1);
+  p = clock_put_digits(p, f.second, 2);
+  p = clock_put(p, " GMT", 4);
+  *p = 0;
+}
+
+bool clock_parse_http_date(const char* str, size_t len, time_t* t) {
+  ClockFields f;
+
+  // IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT"
+  if(len == CLOCK_HTTP_DATE_LEN) {
+    if(str[3] != ',' || str[4] != ' ' || str[7] != ' ' || str[11] != ' ' || str[16] != ' ' ||
+       memcmp(str + 25, " GMT", 4) || !clock_is_day_name(str, 3))
+    {
+      return false;
+    }
+    f.day = clock_get_digits(str + 5, 2);
+    f.month = clock_get_month(str + 8);
+    f.year = clock_get_digits(str + 12, 4);
+    return clock_get_time(str + 17, &f) && clock_from_fields(&f, t);
+  }
+
+  // asctime(): "Sun Nov  6 08:49:37 1994"
+  if(len == 24 && str[3] == ' ') {
+    if(str[7] != ' ' || str[10] != ' ' || str[19] != ' ' || !clock_is_day_name(str, 3)) {
+      return false;
+    }
+    f.month = clock_get_month(str + 4);
+    f.day = (str[8] == ' ' ? clock_get_digits(str + 9, 1) : clock_get_digits(str + 8, 2));
+    f.year = clock_get_digits(str + 20, 4);
+    return clock_get_time(str + 11, &f) && clock_from_fields(&f, t);
+  }
+
+  // RFC 850: "Sunday, 06-Nov-94 08:49:37 GMT". The day name has a variable
+  // length, and what follows it is 24 bytes.
+  if(len < 30 || len > 33) return false;
+  const char* p = str + len - 24;
+  if(p[0] != ',' || p[1] != ' ' || p[4] != '-' || p[8] != '-' || p[11] != ' ' ||
+     memcmp(p + 20, " GMT", 4) || !clock_is_day_name(str, p - str))
+  {
+    return false;
+  }
+  f.day = clock_get_digits(p + 2, 2);
+  f.month = clock_get_month(p + 5);
+  const int yy = clock_get_digits(p + 9, 2);
+  if(yy < 0 || !clock_get_time(p + 12, &f)) return false;
+
+  // A two-digit year more than 50 years ahead is in the past century
+  const int this_year = clock_fields(clock_now()).year;
+  f.year = this_year - this_year % 100 + yy;
+  if(f.year > this_year + 50) f.year -= 100;
+  return clock_from_fields(&f, t);
+}
+
+void clock_format_log_timestamp(time_t t, char* buf) {
+  const ClockFields f = clock_fields(t);
+  char* p = buf;
+  p = clock_put_digits(p, f.year, 4);
+  p = clock_put_digits(p, f.month, 2);
+  p = clock_put_digits(p, f.day, 2);
+  p = clock_put(p, "-", 1);
+  p = clock_put_digits(p, f.hour, 2);
+  p = clock_put(p, ":", 1);
+  p = clock_put_digits(p, f.minute, 2);
+  p = clock_put(p, ":", 1);
+  p = clock_put_digits(p, f.second, 2);
+  p = clock_put(p, " UTC", 4);
+  *p = 0;
+}
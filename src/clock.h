@@ -0,0 +1,60 @@
+//==============================================================================
+// Clock service: the current time, formatted once per second
+//
+// Every response carries a Date header and every log line a timestamp, but
+// both only change once a second. Each thread keeps the current second's
+// strings and reformats them only when the second changes, so the hot path
+// just reads the coarse system clock and returns a pointer.
+//
+// The returned strings belong to the calling thread and stay valid until its
+// next call into the clock service.
+//
+// Formatting doesn't use gmtime() or strftime(), which aren't thread-safe and
+// are far slower than the arithmetic needed here.
+//==============================================================================
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Lengths of the formatted strings, excluding the null terminator
+#define CLOCK_HTTP_DATE_LEN     29  // "Sun, 06 Nov 1994 08:49:37 GMT"
+#define CLOCK_LOG_TIMESTAMP_LEN 21  // "19941106-08:49:37 UTC"
+
+// Milliseconds from a monotonic clock, for measuring intervals and deadlines
+uint64_t clock_monotonic_ms();
+
+// Same, in microseconds, for timing short operations
+uint64_t clock_monotonic_us();
+
+// CPU time the calling thread has used, in microseconds, for measuring the
+// cost of work that may be interrupted by other threads
+uint64_t clock_thread_cpu_us();
+
+// Current wall-clock second
+time_t clock_now();
+
+// Current time as an HTTP date (RFC 7231 IMF-fixdate), for the Date header
+const char* clock_http_date();
+
+// Current time for log lines
+const char* clock_log_timestamp();
+
+// Format any time as an HTTP date. 'buf' must have room for
+// CLOCK_HTTP_DATE_LEN + 1 characters.
+void clock_format_http_date(time_t t, char* buf);
+
+// Parse an HTTP date, as sent in If-Modified-Since. Returns false if it's not
+// valid. IMF-fixdate, which every current client sends, is checked first and
+// parsed by position. The two obsolete formats are accepted too:
+// "Sunday, 06-Nov-94 08:49:37 GMT" and "Sun Nov  6 08:49:37 1994".
+bool clock_parse_http_date(const char* str, size_t len, time_t* t);
+
+// Format any time as a log timestamp. 'buf' must have room for
+// CLOCK_LOG_TIMESTAMP_LEN + 1 characters.
+void clock_format_log_timestamp(time_t t, char* buf);
+
+#endif // CLOCK_H
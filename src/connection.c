@@ -0,0 +1,395 @@
+#include "connection.h"
+#include "response_stream.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Initial size of a connection's input buffer. Grows by doubling.
+static const size_t CONNECTION_IN_BUFFER_SIZE = 1024;
+
+// Minimum size of an output segment. Responses smaller than this share one.
+static const size_t CONNECTION_OUT_SEGMENT_SIZE = 4096;
+
+// Spare output buffers larger than this are freed rather than kept for reuse
+static const size_t CONNECTION_OUT_SPARE_MAX = 64 * 1024;
+
+// Writes by reference smaller than this are copied instead
+static const size_t CONNECTION_REF_MIN_SIZE = 256;
+
+// Max number of iovecs per gathering send
+#define CONNECTION_MAX_IOV 64
+
+//==============================================================================
+// Output queue
+//==============================================================================
+// Reverse the order of out_segs[begin, end)
+static void connection_reverse_segments(Connection* conn, size_t begin, size_t end) {
+  while(begin + 1 < end) {
+    const OutputSegment tmp = conn->out_segs[begin];
+    conn->out_segs[begin] = conn->out_segs[end - 1];
+    conn->out_segs[end - 1] = tmp;
+    ++begin;
+    --end;
+  }
+}
+
+// Get an empty segment at the end of the queue, with room for 'len' bytes
+static OutputSegment* connection_push_segment(Connection* conn, size_t len) {
+  if(conn->out_count == conn->out_slots) {
+    if(conn->out_head > 0) {
+      // Rotate the sent segments to the back, where their buffers are spares
+      connection_reverse_segments(conn, 0, conn->out_head);
+      connection_reverse_segments(conn, conn->out_head, conn->out_count);
+      connection_reverse_segments(conn, 0, conn->out_count);
+      conn->out_count -= conn->out_head;
+      conn->out_head = 0;
+    }
+    else {
+      const size_t slots = (conn->out_slots ? conn->out_slots * 2 : 4);
+      conn->out_segs = realloc(conn->out_segs, slots * sizeof(OutputSegment));
+      memset(conn->out_segs + conn->out_slots, 0,
+             (slots - conn->out_slots) * sizeof(OutputSegment));
+      conn->out_slots = slots;
+    }
+  }
+
+  // Reuse the slot's spare buffer if it's big enough
+  OutputSegment* seg = &conn->out_segs[conn->out_count++];
+  if(seg->cap < len) {
+    free(seg->data);
+    seg->cap = (len > CONNECTION_OUT_SEGMENT_SIZE ? len : CONNECTION_OUT_SEGMENT_SIZE);
+    seg->data = malloc(seg->cap);
+  }
+  seg->len = 0;
+  seg->ref = NULL;
+  seg->fd = -1;
+  seg->release = NULL;
+  return seg;
+}
+
+// Release a segment's bytes, or close its file, if it needs either
+static void connection_release_segment(OutputSegment* seg) {
+  if(seg->release)      seg->release(seg->release_arg);
+  else if(seg->fd != -1) close(seg->fd);
+  seg->fd = -1;
+  seg->release = NULL;
+}
+
+// All output has been sent: empty the queue, keeping modest buffers as spares
+static void connection_reset_output(Connection* conn) {
+  for(size_t i=0; i<conn->out_count; ++i) {
+    OutputSegment* seg = &conn->out_segs[i];
+    if(seg->cap > CONNECTION_OUT_SPARE_MAX) {
+      free(seg->data);
+      seg->data = NULL;
+      seg->cap = 0;
+    }
+    seg->len = 0;
+    seg->ref = NULL;
+    seg->fd = -1;
+    seg->release = NULL;
+  }
+  conn->out_head = 0;
+  conn->out_count = 0;
+  conn->out_sent = 0;
+  conn->pipelined = 0;
+}
+
+//==============================================================================
+// Connection
+//==============================================================================
+Connection* connection_new(const ClientSocket* socket, ArenaPool* pool) {
+  Connection* conn = malloc(sizeof(Connection));
+  conn->socket = *socket;
+  conn->state = CONNECTION_STATE_READING;
+  conn->keep_alive = false;
+  conn->read_closed = false;
+  conn->requests = 0;
+  conn->response_status = 0;
+  conn->request_start_us = 0;
+  conn->response_encoding = 0;
+  conn->response_body_in = 0;
+  conn->response_body_out = 0;
+  conn->response_compress_us = 0;
+  conn->response_logged = false;
+  conn->in_buf = malloc(CONNECTION_IN_BUFFER_SIZE + 1);
+  conn->in_buf[0] = 0;
+  conn->in_len = 0;
+  conn->in_cap = CONNECTION_IN_BUFFER_SIZE;
+  http_parser_init(&conn->parser);
+  arena_init(&conn->arena, pool);
+  conn->out_segs = NULL;
+  conn->out_head = 0;
+  conn->out_count = 0;
+  conn->out_slots = 0;
+  conn->out_sent = 0;
+  conn->pipelined = 0;
+  conn->stream = NULL;
+  conn->yielded = false;
+  conn->body_handler = NULL;
+  conn->engine_data = NULL;
+  conn->bytes_in = 0;
+  conn->bytes_out = 0;
+  conn->phase = CONNECTION_PHASE_HEADERS;
+  timer_init(&conn->timer, conn);
+  conn->timer_phase = CONNECTION_PHASE_HEADERS;
+  conn->phase_start_ms = 0;
+  conn->phase_start_bytes = 0;
+  conn->progress_ms = 0;
+  conn->progress_bytes = 0;
+  conn->prev = NULL;
+  conn->next = NULL;
+  conn->ready_prev = NULL;
+  conn->ready_next = NULL;
+  return conn;
+}
+
+void connection_free(Connection* conn) {
+  if(conn->state != CONNECTION_STATE_CLOSED) connection_close(conn);
+  if(conn->in_buf) free(conn->in_buf);
+  http_parser_free(&conn->parser);
+  arena_free(&conn->arena);
+  if(conn->stream) response_stream_free(conn->stream);
+  for(size_t i=conn->out_head; i<conn->out_count; ++i) {
+    connection_release_segment(&conn->out_segs[i]);
+  }
+  for(size_t i=0; i<conn->out_slots; ++i) {
+    free(conn->out_segs[i].data);
+  }
+  free(conn->out_segs);
+  free(conn);
+}
+
+Status connection_close(Connection* conn) {
+  conn->state = CONNECTION_STATE_CLOSED;
+  return client_socket_close(&conn->socket);
+}
+
+Status connection_fill(Connection* conn, size_t max_bytes, bool* peer_closed) {
+  *peer_closed = false;
+
+  while(conn->in_len < max_bytes) {
+    // Make sure there's room to read into. Leave space for the terminator.
+    if(conn->in_len == conn->in_cap) {
+      conn->in_cap *= 2;
+      conn->in_buf = realloc(conn->in_buf, conn->in_cap + 1);
+    }
+
+    // Read as much as fits
+    size_t received = 0;
+    size_t space = conn->in_cap - conn->in_len;
+    if(space > max_bytes - conn->in_len) space = max_bytes - conn->in_len;
+    Status status = client_socket_recv_some(&conn->socket,
+                                            conn->in_buf + conn->in_len,
+                                            space, &received);
+
+    // Socket is drained: that's what we wanted
+    if(!status.ok) {
+      if(status.errnum == EWOULDBLOCK || status.errnum == EAGAIN) break;
+      return status;
+    }
+
+    // Zero bytes means the client shut down its side of the connection
+    if(received == 0) {
+      *peer_closed = true;
+      break;
+    }
+
+    conn->in_len += received;
+    conn->in_buf[conn->in_len] = 0;
+    conn->bytes_in += received;
+  }
+  return make_status(true, 0);
+}
+
+void connection_append_input(Connection* conn, const void* data, size_t len) {
+  if(conn->in_len + len > conn->in_cap) {
+    while(conn->in_len + len > conn->in_cap) conn->in_cap *= 2;
+    conn->in_buf = realloc(conn->in_buf, conn->in_cap + 1);
+  }
+  memcpy(conn->in_buf + conn->in_len, data, len);
+  conn->in_len += len;
+  conn->in_buf[conn->in_len] = 0;
+  conn->bytes_in += len;
+}
+
+void connection_consume(Connection* conn, size_t len) {
+  if(len >= conn->in_len) {
+    conn->in_len = 0;
+  }
+  else {
+    memmove(conn->in_buf, conn->in_buf + len, conn->in_len - len);
+    conn->in_len -= len;
+  }
+  conn->in_buf[conn->in_len] = 0;
+}
+
+void connection_write(Connection* conn, const void* data, size_t len) {
+  if(len == 0) return;
+
+  // Append to the last segment if it has room. Bytes already handed to the
+  // kernel don't move, so this is safe even while a send is in flight.
+  OutputSegment* seg = NULL;
+  if(conn->out_count > conn->out_head) {
+    seg = &conn->out_segs[conn->out_count - 1];
+    if(seg->ref || seg->fd != -1 || seg->cap - seg->len < len) seg = NULL;
+  }
+  if(!seg) seg = connection_push_segment(conn, len);
+
+  memcpy(seg->data + seg->len, data, len);
+  seg->len += len;
+}
+
+void connection_write_ref(Connection* conn, const void* data, size_t len) {
+  if(len < CONNECTION_REF_MIN_SIZE) {
+    connection_write(conn, data, len);
+    return;
+  }
+  OutputSegment* seg = connection_push_segment(conn, 0);
+  seg->ref = data;
+  seg->len = len;
+}
+
+void connection_write_ref_release(Connection* conn, const void* data, size_t len,
+                                  void (*release)(void*), void* arg)
+{
+  if(len < CONNECTION_REF_MIN_SIZE) {
+    connection_write(conn, data, len);
+    release(arg);
+    return;
+  }
+  OutputSegment* seg = connection_push_segment(conn, 0);
+  seg->ref = data;
+  seg->len = len;
+  seg->release = release;
+  seg->release_arg = arg;
+}
+
+void connection_write_file(Connection* conn, int fd, off_t offset, size_t len) {
+  if(len == 0) {
+    close(fd);
+    return;
+  }
+  OutputSegment* seg = connection_push_segment(conn, 0);
+  seg->fd = fd;
+  seg->offset = offset;
+  seg->len = len;
+}
+
+void connection_write_file_ref(Connection* conn, int fd, off_t offset, size_t len,
+                               void (*release)(void*), void* arg)
+{
+  if(len == 0) {
+    release(arg);
+    return;
+  }
+  OutputSegment* seg = connection_push_segment(conn, 0);
+  seg->fd = fd;
+  seg->offset = offset;
+  seg->len = len;
+  seg->release = release;
+  seg->release_arg = arg;
+}
+
+Status connection_flush(Connection* conn) {
+  while(connection_has_output(conn)) {
+    // Files go out with sendfile(), everything else with a gathering send
+    size_t sent = 0;
+    Status status;
+    int fd;
+    off_t offset;
+    size_t len;
+    if(connection_output_file(conn, &fd, &offset, &len)) {
+      status = client_socket_sendfile_some(&conn->socket, fd, offset, len, &sent);
+      // The file ended early: it must have been truncated since it was opened
+      if(status.ok && sent == 0) return make_status(false, EIO);
+    }
+    else {
+      struct iovec iov[CONNECTION_MAX_IOV];
+      const int iovcnt = connection_output_iov(conn, iov, CONNECTION_MAX_IOV);
+      const bool more = connection_output_file_follows(conn, iovcnt);
+      status = client_socket_sendv_some(&conn->socket, iov, iovcnt, more, &sent);
+    }
+    if(!status.ok) {
+      if(status.errnum == EWOULDBLOCK || status.errnum == EAGAIN) break;
+      return status;
+    }
+    connection_output_sent(conn, sent);
+  }
+  return make_status(true, 0);
+}
+
+int connection_output_iov(const Connection* conn, struct iovec* iov, int max) {
+  int count = 0;
+  size_t offset = conn->out_sent;
+  for(size_t i=conn->out_head; i<conn->out_count && count<max; ++i) {
+    const OutputSegment* seg = &conn->out_segs[i];
+    if(seg->fd != -1) break;
+    iov[count].iov_base = (char*)(seg->ref ? seg->ref : seg->data) + offset;
+    iov[count].iov_len = seg->len - offset;
+    offset = 0;
+    ++count;
+  }
+  return count;
+}
+
+bool connection_output_file_follows(const Connection* conn, int iovcnt) {
+  const size_t next = conn->out_head + iovcnt;
+  return next < conn->out_count && conn->out_segs[next].fd != -1;
+}
+
+bool connection_output_file(const Connection* conn, int* fd, off_t* offset, size_t* len) {
+  if(!connection_has_output(conn)) return false;
+  const OutputSegment* seg = &conn->out_segs[conn->out_head];
+  if(seg->fd == -1) return false;
+  *fd = seg->fd;
+  *offset = seg->offset + conn->out_sent;
+  *len = seg->len - conn->out_sent;
+  return true;
+}
+
+void connection_output_sent(Connection* conn, size_t len) {
+  conn->bytes_out += len;
+  while(len > 0 && conn->out_head < conn->out_count) {
+    const size_t left = conn->out_segs[conn->out_head].len - conn->out_sent;
+    if(len < left) {
+      conn->out_sent += len;
+      return;
+    }
+    len -= left;
+    connection_release_segment(&conn->out_segs[conn->out_head]);
+    conn->out_head += 1;
+    conn->out_sent = 0;
+  }
+  if(conn->out_head == conn->out_count) connection_reset_output(conn);
+}
+
+bool connection_has_output(const Connection* conn) {
+  return conn->out_head < conn->out_count;
+}
+
+size_t connection_output_len(const Connection* conn) {
+  size_t len = 0;
+  for(size_t i=conn->out_head; i<conn->out_count; ++i) {
+    len += conn->out_segs[i].len;
+  }
+  return len - conn->out_sent;
+}
+
+uint64_t connection_phase_bytes(const Connection* conn) {
+  return (conn->phase == CONNECTION_PHASE_WRITE ? conn->bytes_out : conn->bytes_in);
+}
+
+const char* connection_phase_to_string(enum EConnectionPhase phase) {
+  switch(phase) {
+    case CONNECTION_PHASE_HEADERS: return "reading request headers";
+    case CONNECTION_PHASE_BODY:    return "reading request body";
+    case CONNECTION_PHASE_IDLE:    return "idle";
+    case CONNECTION_PHASE_WRITE:   return "writing response";
+  }
+  return "?";
+}
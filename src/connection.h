@@ -0,0 +1,214 @@
+//==============================================================================
+// A Connection is one client socket being serviced by the webserver's event
+// loop. It owns the bytes read from the client that haven't been handled yet,
+// and the response bytes that haven't been sent yet. Its parser remembers how
+// far into the first of those requests it has got, so each byte is parsed once.
+//
+// Output is a queue of segments. Responses are appended in order, small ones
+// sharing a segment, and the whole queue goes out with one gathering send. A
+// segment may also refer to bytes it doesn't own, such as a static response
+// body, so that they're sent without being copied. Or it may be a range of an
+// open file, which is sent with sendfile() and never read into memory.
+//
+// All IO is non-blocking. connection_fill() and connection_flush() read or
+// write until the socket would block, which is what an edge-triggered event
+// loop requires.
+//
+// A request body is handed to the connection's body handler as it arrives, if
+// it has one, and dropped from the input buffer. So is a body nobody wants.
+//
+// A response may also have a body that's still being produced, a piece at a
+// time as output drains (see response_stream.h). The connection holds it
+// until it's done, and frees it if the connection is freed first.
+//
+// Memory needed only while handling a request comes from the connection's
+// arena, which the webserver resets once each response has been queued.
+//
+// Each connection also carries a timer. The webserver says which phase the
+// connection is in, and the worker arms the timer with that phase's deadline.
+//==============================================================================
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "arena.h"
+#include "http_parser.h"
+#include "sockets.h"
+#include "status.h"
+#include "timer_wheel.h"
+
+//==============================================================================
+// Connection states
+//==============================================================================
+enum EConnectionState {
+  CONNECTION_STATE_READING,  // Taking requests (responses may still be queued)
+  CONNECTION_STATE_WRITING,  // Last response queued; close once it's sent
+  CONNECTION_STATE_CLOSED    // Socket closed; safe to free
+};
+
+// What the connection is waiting on, which determines its deadline
+enum EConnectionPhase {
+  CONNECTION_PHASE_HEADERS,  // Receiving request headers
+  CONNECTION_PHASE_BODY,     // Receiving a request body
+  CONNECTION_PHASE_IDLE,     // Between requests on a persistent connection
+  CONNECTION_PHASE_WRITE     // Sending a response
+};
+
+//==============================================================================
+// Connection
+//==============================================================================
+struct Connection;
+
+// Takes the next piece of a request body, or NULL once the body is complete
+typedef void (*RequestBodyHandler)(struct Connection* conn, const char* data, size_t len);
+
+// A chunk of queued output. Once it's been sent, the buffer is kept for reuse.
+typedef struct OutputSegment {
+  char*       data;    // Bytes to send
+  size_t      len;     // Number of bytes to send
+  size_t      cap;     // Size of data
+  const char* ref;     // If set, send these bytes, not the segment's own data
+  int         fd;      // If not -1, send bytes from this file instead.
+  off_t       offset;  //   'offset' is where to start.
+  void      (*release)(void*);  // If set, call release(release_arg) once the
+  void*       release_arg;      //   bytes are sent. Otherwise the segment owns fd.
+} OutputSegment;
+
+typedef struct Connection {
+  ClientSocket          socket;    // Client socket (non-blocking)
+  enum EConnectionState state;     // Where we are in the request/response cycle
+  bool                  keep_alive;   // Read another request after this response?
+  bool                  read_closed;  // Has the client shut down its side?
+  unsigned              requests;  // Number of requests received
+  unsigned              response_status;   // Status code of the last response queued
+  uint64_t              request_start_us;  // When work on the current request began
+  unsigned              response_encoding;     // enum EHttpEncoding of the last
+  uint64_t              response_body_in;      //   response's body. Its size before
+  uint64_t              response_body_out;     //   compression (0 if it wasn't) and
+  uint32_t              response_compress_us;  //   after, and the CPU time it took.
+  bool                  response_logged;   // Has the last response's binary access
+                                           //   log record been seen to elsewhere?
+  char*                 in_buf;    // Bytes received, always null-terminated
+  size_t                in_len;    // Number of bytes received
+  size_t                in_cap;    // Size of in_buf, excluding the terminator
+  HttpParser            parser;    // Parses the request at the start of in_buf
+  Arena                 arena;     // Request-scoped memory
+  OutputSegment*        out_segs;  // Output queue. Unsent segments are
+  size_t                out_head;  //   out_segs[out_head, out_count). Slots
+  size_t                out_count; //   past that hold spare buffers.
+  size_t                out_slots; // Size of the out_segs array
+  size_t                out_sent;  // Bytes of the head segment already sent
+  unsigned              pipelined; // Responses queued since output was last empty
+  struct ResponseStream* stream;   // Response body still being produced, if any
+  bool                  yielded;   // Did the stream stop early, to let other
+                                   //   connections run? It wants to go on soon.
+  RequestBodyHandler    body_handler;  // Takes the body of the request being received
+  void*                 engine_data;  // Per-connection state of the IO engine
+  uint64_t              bytes_in;  // Total bytes received
+  uint64_t              bytes_out; // Total bytes sent
+  enum EConnectionPhase phase;     // Current phase, set by the webserver
+  Timer                 timer;     // Deadline timer, managed by the worker
+  enum EConnectionPhase timer_phase;        // Phase the timer was armed for
+  uint64_t              phase_start_ms;     // When that phase began
+  uint64_t              phase_start_bytes;  // Bytes moved before it began
+  uint64_t              progress_ms;        // When bytes last moved
+  uint64_t              progress_bytes;     // Bytes moved as of progress_ms
+  struct Connection*    prev;      // Intrusive list of open connections,
+  struct Connection*    next;      //   maintained by the worker
+  struct Connection*    ready_prev;  // Intrusive list of connections to service
+  struct Connection*    ready_next;  //   again before waiting for events
+} Connection;
+
+// Allocate a new connection for a client socket that was just accepted.
+// - Takes ownership of the socket's file descriptor.
+// - Its arena takes chunks from 'pool', which may be NULL.
+// - Caller must free it via connection_free.
+Connection* connection_new(const ClientSocket* socket, ArenaPool* pool);
+
+// Close the socket (if still open) and free the connection's resources
+void connection_free(Connection* conn);
+
+// Close the socket. Buffers are kept until connection_free().
+Status connection_close(Connection* conn);
+
+// Read everything the socket has available into in_buf.
+// - Reads until the socket would block, or until in_buf holds 'max_bytes'.
+// - 'peer_closed' is set if the client has shut down its side.
+Status connection_fill(Connection* conn, size_t max_bytes, bool* peer_closed);
+
+// Append bytes that were received some other way (e.g. by io_uring) to in_buf
+void connection_append_input(Connection* conn, const void* data, size_t len);
+
+// Remove the first 'len' bytes from in_buf, keeping whatever follows
+void connection_consume(Connection* conn, size_t len);
+
+// Queue bytes to be sent, after everything already queued. They're copied.
+void connection_write(Connection* conn, const void* data, size_t len);
+
+// Queue bytes to be sent without copying them.
+// - They must stay valid and unchanged until they've been sent or the
+//   connection is freed, e.g. static data.
+// - Small writes are copied anyway, since that's cheaper than an extra iovec.
+void connection_write_ref(Connection* conn, const void* data, size_t len);
+
+// Same, for bytes that are only kept around while someone holds a reference,
+// such as a cached response. The connection calls release(arg) once they've
+// been sent, or when the connection is freed. Small writes are copied and
+// released right away.
+void connection_write_ref_release(Connection* conn, const void* data, size_t len,
+                                  void (*release)(void*), void* arg);
+
+// Queue 'len' bytes of an open file, starting at 'offset', to be sent with
+// sendfile(). The connection takes ownership of 'fd' and closes it once the
+// bytes have been sent, or when the connection is freed.
+void connection_write_file(Connection* conn, int fd, off_t offset, size_t len);
+
+// Same, but for a file the connection doesn't own, such as one in a cache.
+// Instead of closing 'fd', the connection calls release(arg) once the bytes
+// have been sent, or when the connection is freed. If 'len' is 0, it's called
+// right away.
+void connection_write_file_ref(Connection* conn, int fd, off_t offset, size_t len,
+                               void (*release)(void*), void* arg);
+
+// Send as much queued output as the socket will take.
+// - Succeeds (with output possibly still pending) if the socket would block.
+// - Fails on any other socket error.
+Status connection_flush(Connection* conn);
+
+// Describe the unsent output as up to 'max' iovecs, oldest first. Returns the
+// number of iovecs filled in.
+// - The memory they point at stays put until it's marked sent, even if more
+//   output is queued meanwhile.
+// - Stops at a file segment, which can't be described as an iovec. Returns 0
+//   if the oldest unsent segment is one; see connection_output_file().
+int connection_output_iov(const Connection* conn, struct iovec* iov, int max);
+
+// Is a file segment next after the first 'iovcnt' unsent segments? If so,
+// those segments should be sent with MSG_MORE, so that a small response head
+// shares a packet with the file's first bytes.
+bool connection_output_file_follows(const Connection* conn, int iovcnt);
+
+// If the oldest unsent segment is a file, get the file and the range of it
+// left to send, and return true
+bool connection_output_file(const Connection* conn, int* fd, off_t* offset, size_t* len);
+
+// Mark 'len' bytes of output as sent, after an engine-submitted send completes
+void connection_output_sent(Connection* conn, size_t len);
+
+// Is there queued output that hasn't been sent yet?
+bool connection_has_output(const Connection* conn);
+
+// Number of queued bytes that haven't been sent yet
+size_t connection_output_len(const Connection* conn);
+
+// Bytes moved in the direction that matters for the current phase: sent while
+// writing a response, received otherwise
+uint64_t connection_phase_bytes(const Connection* conn);
+
+// Name of a phase, for log messages
+const char* connection_phase_to_string(enum EConnectionPhase phase);
+
+#endif // CONNECTION_H
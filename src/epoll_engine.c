@@ -0,0 +1,192 @@
+#include "epoll_engine.h"
+#include "event_loop.h"
+#include "logging.h"
+#include "webserver.h"
+#include <errno.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Max number of events handled per call to event_loop_wait()
+static const int MAX_EVENTS_PER_WAIT = 256;
+
+//==============================================================================
+// Event handlers
+//==============================================================================
+// Accept every pending connection and register each with the event loop.
+// - With a shared listening socket, other workers race us for connections, so
+//   EWOULDBLOCK on the first try is normal.
+static void epoll_engine_accept(Worker* worker, EventLoop* loop) {
+  while(worker_keep_running(worker)) {
+    ClientSocket client;
+    client_socket_init(&client);
+
+    // Accept the next connection. EWOULDBLOCK means the backlog is drained.
+    Status status = server_socket_accept(worker->server, &client);
+    if(!status.ok) {
+      if(status.errnum == EINTR || status.errnum == ECONNABORTED) continue;
+      if(status.errnum != EWOULDBLOCK && status.errnum != EAGAIN) {
+        log_err("Error accepting incoming connection (errno: %i)", status.errnum);
+      }
+      return;
+    }
+
+    status = client_socket_set_blocking(&client, false);
+    if(!status.ok) {
+      log_err("Error setting client socket non-blocking (errno: %i)", status.errnum);
+      client_socket_close(&client);
+      continue;
+    }
+
+    // Watch for both directions up front. With edge-triggering we only hear
+    // about transitions, so there's no need to toggle EPOLLOUT later.
+    Connection* conn = worker_add_connection(worker, &client);
+    status = event_loop_add(loop, conn->socket.fd,
+                            EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, conn);
+    if(!status.ok) {
+      log_err("Error registering connection with event loop (errno: %i)", status.errnum);
+      worker_close_connection(worker, conn);
+    }
+  }
+}
+
+// Read everything available and hand it to the webserver.
+// Returns false if the connection should be closed.
+// - A request body is taken from the buffer as it arrives. If that made room,
+//   read again: edge-triggering won't tell us about the rest of it.
+static bool epoll_engine_on_readable(Worker* worker, Connection* conn) {
+  const size_t max_bytes = worker->config->max_request_size;
+  bool full = true;
+  while(full) {
+    bool peer_closed = false;
+    Status status = connection_fill(conn, max_bytes, &peer_closed);
+    if(!status.ok) {
+      log_err("%s:%i | Error reading data from client (errno: %i)",
+              client_socket_get_ip(&conn->socket),
+              client_socket_get_port(&conn->socket), status.errnum);
+      return false;
+    }
+    full = (conn->in_len >= max_bytes && !peer_closed);
+    if(!webserver_on_input(conn, worker->config, peer_closed)) return false;
+    full = full && conn->in_len < max_bytes && conn->state == CONNECTION_STATE_READING;
+  }
+  return true;
+}
+
+// Send pending output. Sets 'finished' if that emptied the output queue.
+// Returns false if the connection should be closed.
+// - A stream that yielded wants to go on, whether or not it queued anything
+static bool epoll_engine_on_writable(Worker* worker, Connection* conn, bool* finished) {
+  *finished = false;
+  if(connection_has_output(conn)) {
+    Status status = connection_flush(conn);
+    if(!status.ok) return false;
+    if(connection_has_output(conn)) return true;
+  }
+  else if(!conn->yielded) {
+    return true;
+  }
+  *finished = true;
+  return webserver_on_output(conn, worker->config);
+}
+
+// Dispatch one readiness event for a connection
+static void epoll_engine_on_event(Worker* worker, Connection* conn, uint32_t events) {
+  bool keep_open = true;
+  bool readable = (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR));
+  bool finished = true;
+  while(keep_open && finished) {
+    if(readable) {
+      keep_open = epoll_engine_on_readable(worker, conn);
+    }
+    if(keep_open) {
+      keep_open = epoll_engine_on_writable(worker, conn, &finished);
+    }
+    // A response being streamed that has had its turn waits until the other
+    // connections have had theirs, even though the socket could take more
+    if(keep_open && finished && conn->yielded) {
+      worker_defer(worker, conn);
+      break;
+    }
+    // Once the queued responses are out, more requests may be waiting in the
+    // socket (we stop reading at max_request_size). Edge-triggering won't tell
+    // us about them again.
+    readable = true;
+  }
+  if(keep_open) {
+    worker_update_deadline(worker, conn);
+  }
+  else {
+    // Closing the socket also removes it from the epoll set
+    worker_close_connection(worker, conn);
+  }
+}
+
+// A deferred connection's turn has come round again: send what it queued,
+// and carry on from there
+static void epoll_engine_on_ready(Connection* conn, void* arg) {
+  epoll_engine_on_event(arg, conn, 0);
+}
+
+// A connection ran out of time: close it right away
+static void epoll_engine_on_expired(Connection* conn, void* arg) {
+  worker_close_connection(arg, conn);
+}
+
+//==============================================================================
+// Engine
+//==============================================================================
+// The listening socket is registered with its ServerSocket as the data pointer,
+// and the shutdown eventfd with a pointer to Worker::shutdown_fd. Every other fd
+// points at its Connection.
+Status epoll_engine_run(Worker* worker) {
+  EventLoop loop;
+  Status status = event_loop_init(&loop, MAX_EVENTS_PER_WAIT);
+  if(!status.ok) return status;
+  worker_start_timers(worker);
+
+  // A shared listening socket must be level-triggered and exclusive, so each
+  // incoming connection wakes exactly one worker
+  const uint32_t listen_events = (worker->shared_listener ?
+                                  EPOLLIN | EPOLLEXCLUSIVE : EPOLLIN | EPOLLET);
+  status = event_loop_add(&loop, worker->server->fd, listen_events, worker->server);
+  if(status.ok) {
+    status = event_loop_add(&loop, worker->shutdown_fd, EPOLLIN, &worker->shutdown_fd);
+  }
+  if(!status.ok) {
+    event_loop_close(&loop);
+    return status;
+  }
+
+  // Wait for events and service them, then the connections that were deferred.
+  // Wake up in time to enforce the next connection deadline, or right away if
+  // there are deferred connections still to service.
+  while(worker_keep_running(worker)) {
+    int num_events = 0;
+    const int timeout = (worker->ready ? 0 : worker_next_timeout(worker));
+    status = event_loop_wait(&loop, timeout, &num_events);
+    if(!status.ok) {
+      if(status.errnum != EINTR) {
+        log_err("Worker %i: error waiting for events (errno: %i)", worker->id, status.errnum);
+      }
+      continue;
+    }
+
+    for(int i=0; i<num_events && worker_keep_running(worker); ++i) {
+      const struct epoll_event* ev = &loop.events[i];
+      if(ev->data.ptr == worker->server) {
+        epoll_engine_accept(worker, &loop);
+      }
+      else if(ev->data.ptr != &worker->shutdown_fd) {
+        epoll_engine_on_event(worker, ev->data.ptr, ev->events);
+      }
+    }
+    worker_run_ready(worker, epoll_engine_on_ready, worker);
+    worker_expire_timers(worker, epoll_engine_on_expired, worker);
+  }
+
+  // Clean up: close all of this worker's connections
+  worker_close_all_connections(worker);
+  event_loop_close(&loop);
+  return make_status(true, 0);
+}
@@ -0,0 +1,15 @@
+//==============================================================================
+// epoll IO engine. Registers the listening socket and every connection with an
+// edge-triggered EventLoop, and reads or writes each socket until it would
+// block whenever it becomes ready.
+//==============================================================================
+#ifndef EPOLL_ENGINE_H
+#define EPOLL_ENGINE_H
+
+#include "status.h"
+#include "worker.h"
+
+// Run the worker until the server shuts down
+Status epoll_engine_run(Worker* worker);
+
+#endif // EPOLL_ENGINE_H
@@ -0,0 +1,54 @@
+#include "event_loop.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+Status event_loop_init(EventLoop* loop, int max_events) {
+  loop->events = NULL;
+  loop->max_events = 0;
+  loop->fd = epoll_create1(EPOLL_CLOEXEC);
+  if(loop->fd == -1) return get_status(false);
+
+  loop->events = malloc(sizeof(struct epoll_event) * max_events);
+  loop->max_events = max_events;
+  return get_status(true);
+}
+
+void event_loop_close(EventLoop* loop) {
+  if(loop->fd != -1) close(loop->fd);
+  if(loop->events) free(loop->events);
+  loop->fd = -1;
+  loop->events = NULL;
+  loop->max_events = 0;
+}
+
+// Helper for add/modify
+static Status event_loop_ctl(EventLoop* loop, int op, int fd, uint32_t events,
+                             void* data)
+{
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.ptr = data;
+  const int result = epoll_ctl(loop->fd, op, fd, &ev);
+  return get_status(result != -1);
+}
+
+Status event_loop_add(EventLoop* loop, int fd, uint32_t events, void* data) {
+  return event_loop_ctl(loop, EPOLL_CTL_ADD, fd, events, data);
+}
+
+Status event_loop_modify(EventLoop* loop, int fd, uint32_t events, void* data) {
+  return event_loop_ctl(loop, EPOLL_CTL_MOD, fd, events, data);
+}
+
+Status event_loop_remove(EventLoop* loop, int fd) {
+  // Older kernels require a non-null event pointer, even for EPOLL_CTL_DEL
+  struct epoll_event ev = { 0 };
+  const int result = epoll_ctl(loop->fd, EPOLL_CTL_DEL, fd, &ev);
+  return get_status(result != -1);
+}
+
+Status event_loop_wait(EventLoop* loop, int timeout_ms, int* num_events) {
+  const int result = epoll_wait(loop->fd, loop->events, loop->max_events, timeout_ms);
+  *num_events = (result == -1 ? 0 : result);
+  return get_status(result != -1);
+}
@@ -0,0 +1,41 @@
+//==============================================================================
+// Thin wrapper around epoll. The webserver registers its listening socket and
+// every client connection with an EventLoop, then repeatedly waits for
+// readiness events and dispatches them.
+//
+// - Each registered fd carries a user pointer that's returned with its events.
+// - Connections are registered edge-triggered (EPOLLET), so a handler must
+//   read or write until it gets EWOULDBLOCK before waiting again.
+//==============================================================================
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+#include "status.h"
+
+typedef struct EventLoop {
+  int                 fd;          // epoll file descriptor
+  struct epoll_event* events;      // Events returned by the last wait
+  int                 max_events;  // Size of the events array
+} EventLoop;
+
+// Create the epoll instance and allocate room for 'max_events' per wait
+Status event_loop_init(EventLoop* loop, int max_events);
+
+// Close the epoll instance and free the events array
+void event_loop_close(EventLoop* loop);
+
+// Register, modify or unregister a file descriptor.
+// - 'events' is a mask of EPOLLIN, EPOLLOUT, EPOLLET, etc.
+// - 'data' is handed back in epoll_event::data.ptr when the fd is ready.
+Status event_loop_add   (EventLoop* loop, int fd, uint32_t events, void* data);
+Status event_loop_modify(EventLoop* loop, int fd, uint32_t events, void* data);
+Status event_loop_remove(EventLoop* loop, int fd);
+
+// Wait up to 'timeout_ms' for events (-1 waits forever).
+// - On success, 'num_events' is set and loop->events holds the events.
+// - If interrupted by a signal, fails with errnum EINTR.
+Status event_loop_wait(EventLoop* loop, int timeout_ms, int* num_events);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,691 @@
+#include "file_cache.h"
+#include "arena.h"
+#include "clock.h"
+#include "gzip_stream.h"
+#include "http_response_builder.h"
+#include "logging.h"
+#include "mime_types.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Changes to a watched directory, or to a file in it, that invalidate entries
+static const uint32_t FILE_CACHE_WATCH_MASK =
+  IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+  IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// Changes to a directory in a watched directory that invalidate everything.
+// Paths below it may now name other files, or none.
+static const uint32_t FILE_CACHE_DIR_MASK = IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+//==============================================================================
+// Entries
+//==============================================================================
+// FNV-1a
+static uint64_t file_cache_hash(const char* path, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for(size_t i=0; i<len; ++i) {
+    hash ^= (unsigned char)path[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static FileCacheShard* file_cache_shard(FileCache* cache, uint64_t hash) {
+  return &cache->shards[hash & (FILE_CACHE_SHARDS - 1)];
+}
+
+static FileCacheEntry** file_cache_bucket(FileCacheShard* shard, uint64_t hash) {
+  // The low bits pick the shard, so use the high bits here
+  return &shard->buckets[(hash >> 32) & (shard->num_buckets - 1)];
+}
+
+// Find an entry in a shard. Call with the shard locked.
+static FileCacheEntry* file_cache_find(FileCacheShard* shard, const char* path, size_t len,
+                                       uint64_t hash)
+{
+  for(FileCacheEntry* e = *file_cache_bucket(shard, hash); e; e = e->next) {
+    if(e->hash == hash && e->path_len == len && !memcmp(e->path, path, len)) return e;
+  }
+  return NULL;
+}
+
+static void file_cache_lru_unlink(FileCacheShard* shard, FileCacheEntry* entry) {
+  if(entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+  else                shard->lru_head = entry->lru_next;
+  if(entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+  else                shard->lru_tail = entry->lru_prev;
+}
+
+static void file_cache_lru_push(FileCacheShard* shard, FileCacheEntry* entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = shard->lru_head;
+  if(shard->lru_head) shard->lru_head->lru_prev = entry;
+  else                shard->lru_tail = entry;
+  shard->lru_head = entry;
+}
+
+// Bytes an entry keeps in memory, charged to its shard's budget
+static size_t file_cache_entry_bytes(const FileCacheEntry* entry) {
+  return (entry->head ? entry->head_len + entry->tail_len : 0);
+}
+
+// Take an entry out of its shard. Call with the shard locked, then release the
+// cache's reference once it's unlocked.
+static void file_cache_remove(FileCacheShard* shard, FileCacheEntry* entry) {
+  FileCacheEntry** link = file_cache_bucket(shard, entry->hash);
+  while(*link != entry) link = &(*link)->next;
+  *link = entry->next;
+  file_cache_lru_unlink(shard, entry);
+  shard->count -= 1;
+  shard->bytes -= entry->bytes;
+}
+
+// Open the file at 'path' into a new entry, with one reference, along with
+// its siblings. Sets 'is_dir' if the path is a directory, and
+// it's the index file that was opened.
+static enum EHttpStatus file_cache_open_entry(const char* path, size_t len,
+                                              FileCacheEntry** entry, bool* is_dir)
+{
+  FileCacheEntry* e = malloc(sizeof(FileCacheEntry) + len + 1);
+  memcpy(e->path, path, len);
+  e->path[len] = 0;
+  e->path_len = len;
+  e->hash = file_cache_hash(path, len);
+
+  // Opening a directory changes the path to its index file. The key stays.
+  char file_path[STATIC_FILE_MAX_PATH];
+  size_t file_len = len;
+  memcpy(file_path, path, len);
+  file_path[len] = 0;
+  const enum EHttpStatus status = static_file_open_path(&e->file, file_path, &file_len);
+  if(status != HTTP_STATUS_OK) {
+    free(e);
+    return status;
+  }
+  *is_dir = (file_len != len);
+  static_file_etag(&e->file, e->etag);
+  e->encodings = 0;
+  for(int i=0; i<HTTP_ENCODING_COUNT; ++i) {
+    FileCacheVariant* variant = &e->encoded[i];
+    if(static_file_open_encoded(&variant->file, file_path, file_len, (enum EHttpEncoding)i)) {
+      static_file_etag(&variant->file, variant->etag);
+      e->encodings |= (1u << i);
+    }
+    else {
+      variant->file.fd = -1;
+    }
+  }
+  e->gzip = NULL;
+  e->incompressible = false;
+  e->head = NULL;
+  e->head_len = 0;
+  e->tail = NULL;
+  e->tail_len = 0;
+  e->refs = 1;
+  e->bytes = 0;
+  e->next = NULL;
+  e->lru_prev = NULL;
+  e->lru_next = NULL;
+  *entry = e;
+  return HTTP_STATUS_OK;
+}
+
+// Read a small file into a ready-made response, with the head and tail in one
+// allocation. Leaves the entry as it is if the response wouldn't fit in a
+// shard's budget, or if the file can't be read in full.
+static void file_cache_load(const FileCache* cache, FileCacheEntry* entry) {
+  Arena arena;
+  arena_init(&arena, NULL);
+
+  HttpResponseBuilder head;
+  http_response_builder_init(&head, &arena);
+  http_response_builder_set_status(&head, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  http_response_builder_add_header(&head, "Server", cache->server);
+
+  HttpResponseBuilder tail;
+  http_response_builder_init(&tail, &arena);
+  http_response_builder_add_header(&tail, "Content-Type", entry->file.content_type);
+  http_response_builder_add_header_uint(&tail, "Content-Length", entry->file.size);
+  http_response_builder_add_header(&tail, "ETag", entry->etag);
+  char last_modified[CLOCK_HTTP_DATE_LEN + 1];
+  clock_format_http_date(entry->file.mtime, last_modified);
+  http_response_builder_add_header(&tail, "Last-Modified", last_modified);
+  if(file_cache_varies(entry)) http_response_builder_add_header(&tail, "Vary", "Accept-Encoding");
+  http_response_builder_add_header(&tail, "Accept-Ranges", "bytes");
+
+  // The head builder hasn't been finished, so it has no blank line yet
+  struct iovec tail_iov[2];
+  http_response_builder_iov(&tail, tail_iov);
+  const size_t head_len = head.head_len;
+  const size_t tail_len = tail_iov[0].iov_len + entry->file.size;
+  if(head_len + tail_len > cache->shard_budget) {
+    arena_free(&arena);
+    return;
+  }
+  char* bytes = malloc(head_len + tail_len);
+  memcpy(bytes, head.head, head_len);
+  memcpy(bytes + head_len, tail_iov[0].iov_base, tail_iov[0].iov_len);
+  arena_free(&arena);
+
+  char* body = bytes + head_len + tail_iov[0].iov_len;
+  size_t done = 0;
+  while(done < entry->file.size) {
+    const ssize_t n = pread(entry->file.fd, body + done, entry->file.size - done, done);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) {
+      free(bytes);
+      return;
+    }
+    done += n;
+  }
+  entry->head = bytes;
+  entry->head_len = head_len;
+  entry->tail = bytes + head_len;
+  entry->tail_len = tail_len;
+}
+
+// Is the file worth gzipping on the fly? Whether gzip actually makes it
+// smaller is only known once it's been tried.
+static bool file_cache_gzippable(const FileCacheEntry* entry) {
+  return entry->encoded[HTTP_ENCODING_GZIP].file.fd == -1 &&
+         entry->file.size >= GZIP_MIN_SIZE && entry->file.size <= FILE_CACHE_MAX_COMPRESS_SIZE &&
+         mime_type_compressible(entry->file.content_type);
+}
+
+// GzipSink that appends to a FileCacheCompressed, growing it as needed
+static void file_cache_gzip_append(void* arg, const void* data, size_t len) {
+  FileCacheCompressed** gzip = arg;
+  FileCacheCompressed* z = *gzip;
+  if(z->len + len > z->cap) {
+    size_t cap = z->cap * 2;
+    while(cap < z->len + len) cap *= 2;
+    z = realloc(z, sizeof(FileCacheCompressed) + cap);
+    z->cap = cap;
+    *gzip = z;
+  }
+  memcpy(z->data + z->len, data, len);
+  z->len += len;
+}
+
+// Gzip a file, reading it a piece at a time. Returns NULL if it can't be read
+// in full, or if gzip doesn't make it smaller.
+static FileCacheCompressed* file_cache_compress(const FileCacheEntry* entry) {
+  const size_t size = entry->file.size;
+  FileCacheCompressed* gzip = malloc(sizeof(FileCacheCompressed) + size / 2);
+  gzip->len = 0;
+  gzip->cap = size / 2;
+
+  // The stream's output buffer is too big for a worker's stack
+  GzipStream* stream = malloc(sizeof(GzipStream));
+  bool ok = gzip_stream_init(stream, Z_DEFAULT_COMPRESSION, file_cache_gzip_append, &gzip).ok;
+  char buf[16 * 1024];
+  size_t done = 0;
+  while(ok && done < size) {
+    const size_t want = (size - done < sizeof(buf) ? size - done : sizeof(buf));
+    const ssize_t n = pread(entry->file.fd, buf, want, done);
+    if(n < 0 && errno == EINTR) continue;
+    ok = (n > 0 && gzip_stream_write(stream, buf, n).ok);
+    done += (n > 0 ? n : 0);
+  }
+  ok = ok && gzip_stream_finish(stream).ok && gzip->len < size;
+  gzip_stream_free(stream);
+  free(stream);
+  if(!ok) {
+    free(gzip);
+    return NULL;
+  }
+
+  // Keep just what's needed
+  gzip = realloc(gzip, sizeof(FileCacheCompressed) + gzip->len);
+  gzip->cap = gzip->len;
+  file_cache_gzip_etag(entry, gzip->etag);
+  return gzip;
+}
+
+//==============================================================================
+// Watching for changes
+//==============================================================================
+// Watch a directory, and remember which directory the watch is for. Returns
+// false if it can't be watched.
+static bool file_cache_watch_dir(FileCache* cache, const char* dir) {
+  const int wd = inotify_add_watch(cache->inotify_fd, dir, FILE_CACHE_WATCH_MASK);
+  if(wd < 0) return false;
+
+  pthread_mutex_lock(&cache->watch_lock);
+  if((size_t)wd >= cache->watch_slots) {
+    size_t slots = (cache->watch_slots ? cache->watch_slots : 64);
+    while(slots <= (size_t)wd) slots *= 2;
+    cache->watch_dirs = realloc(cache->watch_dirs, slots * sizeof(char*));
+    memset(cache->watch_dirs + cache->watch_slots, 0,
+           (slots - cache->watch_slots) * sizeof(char*));
+    cache->watch_slots = slots;
+  }
+  if(!cache->watch_dirs[wd]) cache->watch_dirs[wd] = strdup(dir);
+  pthread_mutex_unlock(&cache->watch_lock);
+  return true;
+}
+
+// Watch every directory from the root down to the one holding the last
+// segment of 'path'. Every '/' in the path past the root ends one of them.
+static bool file_cache_watch_path(FileCache* cache, const char* path, size_t len) {
+  char dir[STATIC_FILE_MAX_PATH];
+  for(size_t i=cache->root_len; i<len; ++i) {
+    if(path[i] != '/') continue;
+    memcpy(dir, path, i);
+    dir[i] = 0;
+    if(!file_cache_watch_dir(cache, i ? dir : "/")) return false;
+  }
+  return true;
+}
+
+// Drop the entries a change to 'name' in the watched directory 'dir' affects:
+// the file's own, the directory's if the file is its index, and those of the
+// file it's a precompressed sibling of, if it is one
+static void file_cache_on_change(FileCache* cache, const char* dir, const char* name) {
+  char path[STATIC_FILE_MAX_PATH];
+  const size_t dir_len = strlen(dir);
+  const size_t name_len = strlen(name);
+  if(dir_len + name_len + 2 > sizeof(path)) {
+    file_cache_clear(cache);
+    return;
+  }
+  memcpy(path, dir, dir_len);
+  size_t len = dir_len;
+  if(len == 0 || path[len - 1] != '/') path[len++] = '/';
+  memcpy(path + len, name, name_len);
+  file_cache_invalidate(cache, path, len + name_len);
+
+  if(!strcmp(name, STATIC_FILE_INDEX)) {
+    file_cache_invalidate(cache, path, dir_len);
+    file_cache_invalidate(cache, path, dir_len + 1);
+  }
+
+  for(int i=0; i<HTTP_ENCODING_COUNT; ++i) {
+    const char* suffix = static_file_encoding_suffix((enum EHttpEncoding)i);
+    const size_t suffix_len = (suffix ? strlen(suffix) : 0);
+    if(suffix && name_len > suffix_len && !strcmp(name + name_len - suffix_len, suffix)) {
+      char base[STATIC_FILE_MAX_PATH];
+      memcpy(base, name, name_len - suffix_len);
+      base[name_len - suffix_len] = 0;
+      file_cache_on_change(cache, dir, base);
+    }
+  }
+}
+
+static void file_cache_on_event(FileCache* cache, const struct inotify_event* ev) {
+  if(ev->mask & IN_Q_OVERFLOW) {
+    // Events were lost
+    file_cache_clear(cache);
+    return;
+  }
+
+  char dir[STATIC_FILE_MAX_PATH] = {0};
+  pthread_mutex_lock(&cache->watch_lock);
+  if(ev->wd >= 0 && (size_t)ev->wd < cache->watch_slots && cache->watch_dirs[ev->wd]) {
+    strncpy(dir, cache->watch_dirs[ev->wd], sizeof(dir) - 1);
+    if(ev->mask & IN_IGNORED) {
+      free(cache->watch_dirs[ev->wd]);
+      cache->watch_dirs[ev->wd] = NULL;
+    }
+  }
+  pthread_mutex_unlock(&cache->watch_lock);
+
+  // The directory itself, or one in it, was moved or removed
+  if((ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) ||
+     ((ev->mask & IN_ISDIR) && (ev->mask & FILE_CACHE_DIR_MASK)))
+  {
+    file_cache_clear(cache);
+  }
+  else if(ev->len > 0 && dir[0]) {
+    file_cache_on_change(cache, dir, ev->name);
+  }
+}
+
+// Watcher thread: handle inotify events until woken by file_cache_free()
+static void* file_cache_run_watcher(void* arg) {
+  FileCache* cache = arg;
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct pollfd fds[2] = {
+    { cache->inotify_fd, POLLIN, 0 },
+    { cache->wake_fd,    POLLIN, 0 }
+  };
+  while(true) {
+    if(poll(fds, 2, -1) == -1) {
+      if(errno == EINTR) continue;
+      log_err("Error waiting for file changes (errno: %i)", errno);
+      break;
+    }
+    if(fds[1].revents) break;
+
+    ssize_t len;
+    while((len = read(cache->inotify_fd, buf, sizeof(buf))) > 0) {
+      for(char* p = buf; p < buf + len; ) {
+        const struct inotify_event* ev = (const struct inotify_event*)p;
+        file_cache_on_event(cache, ev);
+        p += sizeof(struct inotify_event) + ev->len;
+      }
+    }
+  }
+  return NULL;
+}
+
+//==============================================================================
+// FileCache
+//==============================================================================
+Status file_cache_init(FileCache* cache, const char* root, const char* server,
+                       size_t max_entries, size_t max_bytes)
+{
+  memset(cache, 0, sizeof(*cache));
+  cache->root_len = strlen(root);
+  while(cache->root_len > 0 && root[cache->root_len - 1] == '/') --cache->root_len;
+  cache->root = strndup(root, cache->root_len);
+  cache->server = server;
+  cache->inotify_fd = -1;
+  cache->wake_fd = -1;
+  pthread_mutex_init(&cache->watch_lock, NULL);
+
+  const size_t capacity = (max_entries + FILE_CACHE_SHARDS - 1) / FILE_CACHE_SHARDS;
+  size_t num_buckets = 1;
+  while(num_buckets < capacity) num_buckets *= 2;
+  for(int i=0; i<FILE_CACHE_SHARDS; ++i) {
+    FileCacheShard* shard = &cache->shards[i];
+    pthread_mutex_init(&shard->lock, NULL);
+    shard->buckets = calloc(num_buckets, sizeof(FileCacheEntry*));
+    shard->num_buckets = num_buckets;
+  }
+  if(capacity == 0) return get_status(true);
+
+  // Nothing can be cached without a way to tell when it changes
+  cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(cache->inotify_fd != -1) cache->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(cache->wake_fd == -1) return get_status(false);
+  const int err = pthread_create(&cache->watcher, NULL, file_cache_run_watcher, cache);
+  if(err) return make_status(false, err);
+  cache->shard_capacity = capacity;
+  cache->shard_budget = max_bytes / FILE_CACHE_SHARDS;
+  return get_status(true);
+}
+
+void file_cache_free(FileCache* cache) {
+  if(cache->shard_capacity > 0) {
+    const uint64_t one = 1;
+    ssize_t ignored = write(cache->wake_fd, &one, sizeof(one));
+    (void)ignored;
+    pthread_join(cache->watcher, NULL);
+  }
+  if(cache->inotify_fd != -1) close(cache->inotify_fd);
+  if(cache->wake_fd != -1) close(cache->wake_fd);
+
+  file_cache_clear(cache);
+  for(int i=0; i<FILE_CACHE_SHARDS; ++i) {
+    pthread_mutex_destroy(&cache->shards[i].lock);
+    free(cache->shards[i].buckets);
+  }
+  for(size_t i=0; i<cache->watch_slots; ++i) {
+    free(cache->watch_dirs[i]);
+  }
+  free(cache->watch_dirs);
+  pthread_mutex_destroy(&cache->watch_lock);
+  free(cache->root);
+  memset(cache, 0, sizeof(*cache));
+}
+
+enum EHttpStatus file_cache_open_file(const char* root, const char* uri, size_t uri_len,
+                                      FileCacheEntry** entry)
+{
+  char path[STATIC_FILE_MAX_PATH];
+  const size_t len = static_file_path(root, uri, uri_len, path);
+  if(len == 0) return HTTP_STATUS_BAD_REQUEST;
+  bool is_dir = false;
+  return file_cache_open_entry(path, len, entry, &is_dir);
+}
+
+enum EHttpStatus file_cache_open(FileCache* cache, const char* uri, size_t uri_len,
+                                 FileCacheEntry** entry)
+{
+  if(cache->shard_capacity == 0) {
+    return file_cache_open_file(cache->root, uri, uri_len, entry);
+  }
+  char path[STATIC_FILE_MAX_PATH];
+  const size_t len = static_file_path(cache->root, uri, uri_len, path);
+  if(len == 0) return HTTP_STATUS_BAD_REQUEST;
+
+  // Hit: take a reference while the shard is locked
+  const uint64_t hash = file_cache_hash(path, len);
+  FileCacheShard* shard = file_cache_shard(cache, hash);
+  pthread_mutex_lock(&shard->lock);
+  FileCacheEntry* e = file_cache_find(shard, path, len, hash);
+  if(e) {
+    __atomic_add_fetch(&e->refs, 1, __ATOMIC_RELAXED);
+    file_cache_lru_unlink(shard, e);
+    file_cache_lru_push(shard, e);
+    shard->hits += 1;
+    pthread_mutex_unlock(&shard->lock);
+    *entry = e;
+    return HTTP_STATUS_OK;
+  }
+  shard->misses += 1;
+  pthread_mutex_unlock(&shard->lock);
+
+  // Miss: watch the file's directories before opening it, so no change after
+  // the open goes unnoticed. A directory's own changes matter too, since its
+  // index is what's served; watch it and open it again.
+  bool watched = file_cache_watch_path(cache, path, len);
+  uint64_t generation = __atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE);
+  bool is_dir = false;
+  enum EHttpStatus status =
+    file_cache_open_entry(path, len, &e, &is_dir);
+  if(status == HTTP_STATUS_OK && is_dir && watched && path[len - 1] != '/') {
+    path[len] = '/';
+    watched = file_cache_watch_path(cache, path, len + 1);
+    generation = __atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE);
+    file_cache_release(e);
+    status = file_cache_open_entry(path, len, &e, &is_dir);
+  }
+  if(status != HTTP_STATUS_OK) return status;
+  *entry = e;
+  if(!watched) return HTTP_STATUS_OK;
+  if(cache->shard_budget > 0 && e->file.size <= FILE_CACHE_MAX_CONTENT_SIZE) {
+    file_cache_load(cache, e);
+  }
+  const size_t bytes = file_cache_entry_bytes(e);
+
+  // Add the entry, unless another thread got there first or something changed
+  // since the open, in which case it may be stale. Evicted entries are
+  // released once the shard is unlocked.
+  FileCacheEntry* existing = NULL;
+  FileCacheEntry* victims = NULL;
+  pthread_mutex_lock(&shard->lock);
+  existing = file_cache_find(shard, path, len, hash);
+  if(existing) {
+    __atomic_add_fetch(&existing->refs, 1, __ATOMIC_RELAXED);
+    *entry = existing;
+  }
+  else if(generation == __atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE)) {
+    while(shard->lru_tail && (shard->count >= cache->shard_capacity ||
+                              shard->bytes + bytes > cache->shard_budget))
+    {
+      FileCacheEntry* victim = shard->lru_tail;
+      file_cache_remove(shard, victim);
+      shard->evictions += 1;
+      victim->next = victims;
+      victims = victim;
+    }
+    e->refs = 2;
+    e->bytes = bytes;
+    FileCacheEntry** bucket = file_cache_bucket(shard, hash);
+    e->next = *bucket;
+    *bucket = e;
+    file_cache_lru_push(shard, e);
+    shard->count += 1;
+    shard->bytes += bytes;
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  if(existing) file_cache_release(e);
+  while(victims) {
+    FileCacheEntry* next = victims->next;
+    file_cache_release(victims);
+    victims = next;
+  }
+  return HTTP_STATUS_OK;
+}
+
+bool file_cache_varies(const FileCacheEntry* entry) {
+  return entry->encodings != 0 || file_cache_gzippable(entry) || file_cache_gzip_streams(entry);
+}
+
+bool file_cache_gzip_streams(const FileCacheEntry* entry) {
+  return entry->encoded[HTTP_ENCODING_GZIP].file.fd == -1 &&
+         entry->file.size > FILE_CACHE_MAX_COMPRESS_SIZE &&
+         mime_type_compressible(entry->file.content_type);
+}
+
+void file_cache_gzip_etag(const FileCacheEntry* entry, char* etag) {
+  // The file's ETag, with a suffix inside the quotes
+  const size_t etag_len = strlen(entry->etag);
+  memcpy(etag, entry->etag, etag_len - 1);
+  memcpy(etag + etag_len - 1, "-gz\"", 5);
+}
+
+const FileCacheCompressed* file_cache_gzip(FileCache* cache, FileCacheEntry* entry,
+                                           uint64_t* cpu_us)
+{
+  *cpu_us = 0;
+  FileCacheCompressed* gzip = __atomic_load_n(&entry->gzip, __ATOMIC_ACQUIRE);
+  if(gzip) return gzip;
+  if(__atomic_load_n(&entry->incompressible, __ATOMIC_RELAXED) || !file_cache_gzippable(entry)) {
+    return NULL;
+  }
+
+  const uint64_t start = clock_thread_cpu_us();
+  gzip = file_cache_compress(entry);
+  *cpu_us = clock_thread_cpu_us() - start;
+  if(!gzip) {
+    __atomic_store_n(&entry->incompressible, true, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  // An entry nobody else can see just keeps it
+  if(!cache || cache->shard_capacity == 0) {
+    entry->gzip = gzip;
+    return gzip;
+  }
+
+  // Attach it, unless another thread beat us to it. If the entry is still in
+  // the cache, charge its shard, evicting older entries to stay in budget.
+  // One that doesn't fit at all is kept uncharged: the entry is then only
+  // bounded by the number of entries.
+  FileCacheEntry* victims = NULL;
+  FileCacheShard* shard = file_cache_shard(cache, entry->hash);
+  pthread_mutex_lock(&shard->lock);
+  if(entry->gzip) {
+    free(gzip);
+    gzip = entry->gzip;
+  }
+  else {
+    const size_t bytes = sizeof(FileCacheCompressed) + gzip->cap;
+    if(file_cache_find(shard, entry->path, entry->path_len, entry->hash) == entry &&
+       bytes <= cache->shard_budget)
+    {
+      while(shard->lru_tail != entry && shard->bytes + bytes > cache->shard_budget) {
+        FileCacheEntry* victim = shard->lru_tail;
+        file_cache_remove(shard, victim);
+        shard->evictions += 1;
+        victim->next = victims;
+        victims = victim;
+      }
+      entry->bytes += bytes;
+      shard->bytes += bytes;
+    }
+    __atomic_store_n(&entry->gzip, gzip, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  while(victims) {
+    FileCacheEntry* next = victims->next;
+    file_cache_release(victims);
+    victims = next;
+  }
+  return gzip;
+}
+
+void file_cache_retain(FileCacheEntry* entry) {
+  __atomic_add_fetch(&entry->refs, 1, __ATOMIC_RELAXED);
+}
+
+void file_cache_release(void* arg) {
+  FileCacheEntry* entry = arg;
+  if(__atomic_sub_fetch(&entry->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    close(entry->file.fd);
+    for(int i=0; i<HTTP_ENCODING_COUNT; ++i) {
+      if(entry->encoded[i].file.fd != -1) close(entry->encoded[i].file.fd);
+    }
+    free(entry->head);
+    free(entry->gzip);
+    free(entry);
+  }
+}
+
+void file_cache_invalidate(FileCache* cache, const char* path, size_t len) {
+  // Bump the generation first, so a thread that opened the old file can't add
+  // it once the entry is gone
+  __atomic_add_fetch(&cache->generation, 1, __ATOMIC_ACQ_REL);
+  const uint64_t hash = file_cache_hash(path, len);
+  FileCacheShard* shard = file_cache_shard(cache, hash);
+  pthread_mutex_lock(&shard->lock);
+  FileCacheEntry* entry = file_cache_find(shard, path, len, hash);
+  if(entry) {
+    file_cache_remove(shard, entry);
+    shard->invalidations += 1;
+  }
+  pthread_mutex_unlock(&shard->lock);
+  if(entry) file_cache_release(entry);
+}
+
+void file_cache_clear(FileCache* cache) {
+  __atomic_add_fetch(&cache->generation, 1, __ATOMIC_ACQ_REL);
+  for(int i=0; i<FILE_CACHE_SHARDS; ++i) {
+    FileCacheShard* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    FileCacheEntry* entry = shard->lru_head;
+    shard->invalidations += shard->count;
+    shard->lru_head = NULL;
+    shard->lru_tail = NULL;
+    shard->count = 0;
+    shard->bytes = 0;
+    memset(shard->buckets, 0, shard->num_buckets * sizeof(FileCacheEntry*));
+    pthread_mutex_unlock(&shard->lock);
+
+    while(entry) {
+      FileCacheEntry* next = entry->lru_next;
+      file_cache_release(entry);
+      entry = next;
+    }
+  }
+}
+
+FileCacheStats file_cache_stats(FileCache* cache) {
+  FileCacheStats stats;
+  memset(&stats, 0, sizeof(stats));
+  for(int i=0; i<FILE_CACHE_SHARDS; ++i) {
+    FileCacheShard* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    stats.entries += shard->count;
+    stats.bytes += shard->bytes;
+    stats.hits += shard->hits;
+    stats.misses += shard->misses;
+    stats.evictions += shard->evictions;
+    stats.invalidations += shard->invalidations;
+    pthread_mutex_unlock(&shard->lock);
+  }
+  return stats;
+}
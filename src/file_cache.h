@@ -0,0 +1,200 @@
+//==============================================================================
+// FileCache: open files under the document root, shared by every worker
+//
+// Serving a file from disk costs an open(), an fstat() and a close() before a
+// single byte is sent. The cache keeps popular files open, along with what's
+// needed to respond: size, modification time, inode, Content-Type and ETag.
+// A hit is a hash lookup, and the file goes straight to sendfile().
+//
+// Entries are keyed by the path a request maps to (see static_file_path()),
+// so "/", "/index.html" and "/./index.html" may be separate entries for the
+// same file. The cache is split into shards by hash, each with its own lock,
+// which is held only long enough to find an entry and take a reference. Each
+// shard evicts its least recently used entry when it's full.
+//
+// A watcher thread uses inotify to keep the cache honest. Every directory
+// from the root down to a cached file is watched, and any change to a file,
+// or any directory being moved or removed, drops the affected entries.
+//
+// Small files are also read into memory, as a ready-made response laid out
+// like a CachedResponse's (see response_cache.h): the head, then the headers
+// that vary per request, then the tail, which holds the rest of the headers and
+// the file's bytes. A hit on one is sent with one gathering send, with no
+// sendfile() at all. Each shard has a budget for these bytes, and evicts its
+// least recently used entries to stay within it.
+//
+// Each entry also holds the file's precompressed siblings open, if it has
+// any: "style.css.gz" and "style.css.br" for "style.css". Changing a sibling
+// drops the file's entry too.
+//
+// A text file without a .gz sibling is gzipped the first time a client asks
+// for it that way, and the result is kept with the entry. Since the entry
+// goes whenever the file changes, it's effectively keyed by the file's ETag,
+// and repeated hits never compress it again. It counts against the shard's
+// memory budget like an in-memory response. A text file too big for that is
+// left for the webserver to gzip as it's sent instead.
+//
+// Entries are reference-counted: one that's dropped while a response still
+// uses it stays open until that response has been sent.
+//==============================================================================
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "http_enums.h"
+#include "static_file.h"
+#include "status.h"
+
+// Number of shards. A power of two.
+#define FILE_CACHE_SHARDS 16
+
+// Files up to this size are kept in memory, budget permitting
+#define FILE_CACHE_MAX_CONTENT_SIZE (64 * 1024)
+
+// Files up to this size are gzipped on the fly. Bigger ones take too long to
+// compress while a worker's other connections wait.
+#define FILE_CACHE_MAX_COMPRESS_SIZE (1024 * 1024)
+
+// A precompressed sibling of a cached file
+typedef struct FileCacheVariant {
+  StaticFile file;                         // fd is -1 if there's no sibling
+  char       etag[STATIC_FILE_ETAG_SIZE];  // Quoted ETag
+} FileCacheVariant;
+
+// A file gzipped on the fly
+typedef struct FileCacheCompressed {
+  char   etag[STATIC_FILE_ETAG_SIZE + 3];  // The file's ETag, marked "-gz"
+  size_t len;                               // Size of the compressed bytes
+  size_t cap;                               // Size of data
+  char   data[];
+} FileCacheCompressed;
+
+typedef struct FileCacheEntry {
+  StaticFile             file;        // The open file. Don't close it.
+  char                   etag[STATIC_FILE_ETAG_SIZE];  // Quoted ETag
+  unsigned               encodings;   // Bitmask of (1 << EHttpEncoding), for
+  FileCacheVariant       encoded[HTTP_ENCODING_COUNT];  //   each sibling there is
+  FileCacheCompressed*   gzip;        // The file gzipped on the fly, once wanted
+  bool                   incompressible;  // Set if gzip didn't make it smaller
+  char*                  head;        // If the file is kept in memory: status
+  size_t                 head_len;    //   line and Server header, then the
+  const char*            tail;        //   other headers and the file's bytes.
+  size_t                 tail_len;    //   Otherwise head is NULL.
+  int                    refs;        // The cache's reference, plus users'
+  size_t                 bytes;       // Bytes charged to the shard's budget
+  uint64_t               hash;        // Hash of the path
+  size_t                 path_len;    // Length of the path
+  struct FileCacheEntry* next;        // Next entry in the hash chain
+  struct FileCacheEntry* lru_prev;    // Neighbours in the shard's LRU list,
+  struct FileCacheEntry* lru_next;    //   most recently used first
+  char                   path[];      // Key: path the request maps to
+} FileCacheEntry;
+
+typedef struct FileCacheShard {
+  pthread_mutex_t  lock;
+  FileCacheEntry** buckets;      // Hash chains
+  size_t           num_buckets;  // A power of two
+  size_t           count;        // Number of entries
+  size_t           bytes;        // Bytes of responses kept in memory
+  FileCacheEntry*  lru_head;     // Most recently used entry
+  FileCacheEntry*  lru_tail;     // Least recently used entry
+  uint64_t         hits;         // Counters, for monitoring
+  uint64_t         misses;
+  uint64_t         evictions;
+  uint64_t         invalidations;
+} FileCacheShard;
+
+typedef struct FileCache {
+  char*           root;            // Document root, without trailing slashes
+  size_t          root_len;        // Length of root
+  const char*     server;          // Value of the Server header
+  size_t          shard_capacity;  // Max entries per shard (0 = caching is off)
+  size_t          shard_budget;    // Max bytes kept in memory per shard
+  FileCacheShard  shards[FILE_CACHE_SHARDS];
+  uint64_t        generation;      // Bumped whenever entries are invalidated
+  int             inotify_fd;      // Watches the directories of cached files
+  int             wake_fd;         // eventfd that tells the watcher to stop
+  pthread_t       watcher;         // Thread reading inotify events
+  pthread_mutex_t watch_lock;      // Guards watch_dirs
+  char**          watch_dirs;      // Watched directory, by watch descriptor
+  size_t          watch_slots;     // Size of watch_dirs
+} FileCache;
+
+// Counters summed over every shard
+typedef struct FileCacheStats {
+  size_t   entries;
+  size_t   bytes;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t invalidations;
+} FileCacheStats;
+
+// Set up a cache of up to 'max_entries' open files under 'root', and start the
+// watcher thread.
+// - Up to 'max_bytes' of small files are kept in memory, as responses naming
+//   'server' (a static string) in their Server header. 0 turns this off.
+// - With max_entries of 0, or if inotify can't be set up, nothing is cached:
+//   every lookup opens the file afresh. Only the latter is an error.
+Status file_cache_init(FileCache* cache, const char* root, const char* server,
+                       size_t max_entries, size_t max_bytes);
+
+// Stop the watcher and drop every entry. Entries still in use are closed once
+// they're released. No other thread may be using the cache.
+void file_cache_free(FileCache* cache);
+
+// Get the open file a request URI maps to, from the cache or from disk.
+// - Returns HTTP_STATUS_OK and sets 'entry', holding a reference to it. Call
+//   file_cache_release() once done with it.
+// - Otherwise returns the status to respond with. See static_file_open().
+enum EHttpStatus file_cache_open(FileCache* cache, const char* uri, size_t uri_len,
+                                 FileCacheEntry** entry);
+
+// Same, without a cache: open the file under 'root' into a new entry
+enum EHttpStatus file_cache_open_file(const char* root, const char* uri, size_t uri_len,
+                                      FileCacheEntry** entry);
+
+// Get an entry's file gzipped, compressing it now if it hasn't been yet.
+// - Returns NULL if it isn't worth compressing: it's not text (see
+//   mime_type_compressible()), it's too small or too big, it has a .gz sibling
+//   to send instead, or gzip doesn't make it smaller.
+// - The result lives as long as the entry. 'cpu_us' is set to the CPU time
+//   spent compressing, which is 0 if it already had been.
+// - 'cache' is NULL for an entry from file_cache_open_file().
+const FileCacheCompressed* file_cache_gzip(FileCache* cache, FileCacheEntry* entry,
+                                           uint64_t* cpu_us);
+
+// Does the response for an entry depend on Accept-Encoding? It does if the
+// file has a precompressed sibling, or could be gzipped on the fly.
+bool file_cache_varies(const FileCacheEntry* entry);
+
+// Is an entry's file too big for file_cache_gzip(), but worth gzipping a piece
+// at a time as it's sent? It is if it's text without a .gz sibling.
+bool file_cache_gzip_streams(const FileCacheEntry* entry);
+
+// Get the ETag of an entry's file gzipped: the file's, marked "-gz". 'etag'
+// needs room for STATIC_FILE_ETAG_SIZE + 3 bytes.
+void file_cache_gzip_etag(const FileCacheEntry* entry, char* etag);
+
+// Take another reference to an entry, e.g. for each part of a response that
+// will release it separately
+void file_cache_retain(FileCacheEntry* entry);
+
+// Drop a reference to an entry. Takes a void* so it can be passed to
+// connection_write_file_ref().
+void file_cache_release(void* entry);
+
+// Drop the entry for a path, if there is one. The watcher does this when a
+// file changes.
+void file_cache_invalidate(FileCache* cache, const char* path, size_t len);
+
+// Drop every entry
+void file_cache_clear(FileCache* cache);
+
+// Get the cache's counters
+FileCacheStats file_cache_stats(FileCache* cache);
+
+#endif // FILE_CACHE_H
@@ -0,0 +1,76 @@
+#include "gzip_stream.h"
+#include <string.h>
+
+//==============================================================================
+// Utility functions
+//==============================================================================
+// Hand over whatever output has built up
+static void gzip_stream_drain(GzipStream* stream) {
+  const size_t len = sizeof(stream->out) - stream->z.avail_out;
+  if(len > 0) {
+    stream->sink(stream->sink_arg, stream->out, len);
+    stream->bytes_out += len;
+  }
+  stream->z.next_out = (Bytef*)stream->out;
+  stream->z.avail_out = sizeof(stream->out);
+}
+
+// Run deflate() over the pending input, draining output each time the chunk
+// fills. deflate() only stops short of filling it once it has taken all the
+// input. With Z_FINISH, runs until the trailer has been written.
+static Status gzip_stream_deflate(GzipStream* stream, int flush) {
+  while(true) {
+    const int err = deflate(&stream->z, flush);
+    if(err == Z_STREAM_END) {
+      gzip_stream_drain(stream);
+      return make_status(true, 0);
+    }
+    if(err != Z_OK && err != Z_BUF_ERROR) return make_status(false, err);
+    if(stream->z.avail_out > 0 && flush == Z_NO_FLUSH) return make_status(true, 0);
+    if(stream->z.avail_out == 0) gzip_stream_drain(stream);
+  }
+}
+
+//==============================================================================
+// GzipStream
+//==============================================================================
+Status gzip_stream_init(GzipStream* stream, int level, GzipSink sink, void* arg) {
+  memset(&stream->z, 0, sizeof(stream->z));
+  stream->sink = sink;
+  stream->sink_arg = arg;
+  stream->bytes_in = 0;
+  stream->bytes_out = 0;
+  stream->z.next_out = (Bytef*)stream->out;
+  stream->z.avail_out = sizeof(stream->out);
+
+  // 16 added to the window bits asks for a gzip header and trailer, rather
+  // than zlib's
+  const int err = deflateInit2(&stream->z, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+  return make_status(err == Z_OK, err);
+}
+
+Status gzip_stream_write(GzipStream* stream, const void* data, size_t len) {
+  // avail_in is an unsigned int, so feed huge inputs in pieces
+  const char* p = data;
+  while(len > 0) {
+    const size_t n = (len > (1u << 30) ? (1u << 30) : len);
+    stream->z.next_in = (Bytef*)p;
+    stream->z.avail_in = n;
+    const Status status = gzip_stream_deflate(stream, Z_NO_FLUSH);
+    if(!status.ok) return status;
+    stream->bytes_in += n;
+    p += n;
+    len -= n;
+  }
+  return make_status(true, 0);
+}
+
+Status gzip_stream_finish(GzipStream* stream) {
+  stream->z.next_in = NULL;
+  stream->z.avail_in = 0;
+  return gzip_stream_deflate(stream, Z_FINISH);
+}
+
+void gzip_stream_free(GzipStream* stream) {
+  deflateEnd(&stream->z);
+}
@@ -0,0 +1,52 @@
+//==============================================================================
+// GzipStream: gzip compression, a piece at a time
+//
+// Compressing a response body doesn't need the whole body at once. Bytes are
+// fed in as they're produced, e.g. as a file is read, and zlib hands back
+// compressed output in chunks, which go to a callback as they fill up. Only
+// the compressor's window and one chunk of output are held at a time.
+//==============================================================================
+#ifndef GZIP_STREAM_H
+#define GZIP_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "status.h"
+
+// Size of the chunks output is handed over in
+#define GZIP_STREAM_CHUNK_SIZE (16 * 1024)
+
+// Bodies smaller than this aren't worth compressing: the gzip header and
+// trailer alone are 18 bytes, and a response head is a few hundred
+#define GZIP_MIN_SIZE 256
+
+// Called with each chunk of compressed output. The bytes are only valid
+// during the call.
+typedef void (*GzipSink)(void* arg, const void* data, size_t len);
+
+typedef struct GzipStream {
+  z_stream z;          // zlib's state
+  GzipSink sink;       // Where output goes
+  void*    sink_arg;
+  uint64_t bytes_in;   // Bytes fed in so far
+  uint64_t bytes_out;  // Bytes of output so far
+  char     out[GZIP_STREAM_CHUNK_SIZE];  // Output not yet handed over
+} GzipStream;
+
+// Start a stream, compressing at 'level' (1-9, or Z_DEFAULT_COMPRESSION).
+// On error, the Status holds zlib's error code.
+Status gzip_stream_init(GzipStream* stream, int level, GzipSink sink, void* arg);
+
+// Compress 'len' more bytes. Output goes to the sink whenever a chunk fills.
+Status gzip_stream_write(GzipStream* stream, const void* data, size_t len);
+
+// Compress whatever is buffered and write the gzip trailer. Every byte of
+// output has reached the sink once this returns.
+Status gzip_stream_finish(GzipStream* stream);
+
+// Free zlib's state. Call this whether or not the stream was finished.
+void gzip_stream_free(GzipStream* stream);
+
+#endif // GZIP_STREAM_H
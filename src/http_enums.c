@@ -1,6 +1,22 @@
 #include "http_enums.h"
 #include <string.h>
 
+//==============================================================================
+// Private utility functions
+//==============================================================================
+static inline char http_enums_lower(char c) {
+  return (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+}
+
+// Does 'str' match 'lower', ignoring case? 'lower' is lowercase and exactly as
+// long as 'str', which the lookups below have already checked.
+static inline int http_enums_match(const char* str, const char* lower) {
+  for(; *lower; ++str, ++lower) {
+    if(http_enums_lower(*str) != *lower) return 0;
+  }
+  return 1;
+}
+
 //==============================================================================
 // HTTP Versions
 //==============================================================================
@@ -13,9 +29,16 @@ const char* http_version_to_string(enum EHttpVersion x) {
 }
 
 enum EHttpVersion http_version_from_string(const char* str) {
-  if(!strcmp(str, "HTTP/1.0")) return HTTP_VERSION_1_0;
-  if(!strcmp(str, "HTTP/1.1")) return HTTP_VERSION_1_1;
-  return HTTP_VERSION_UNKNOWN;
+  return http_version_lookup(str, strlen(str));
+}
+
+enum EHttpVersion http_version_lookup(const char* str, size_t len) {
+  if(len != 8 || memcmp(str, "HTTP/1.", 7)) return HTTP_VERSION_UNKNOWN;
+  switch(str[7]) {
+    case '0': return HTTP_VERSION_1_0;
+    case '1': return HTTP_VERSION_1_1;
+    default:  return HTTP_VERSION_UNKNOWN;
+  }
 }
 
 //==============================================================================
@@ -23,41 +46,461 @@ enum EHttpVersion http_version_from_string(const char* str) {
 //==============================================================================
 const char* http_method_to_string(enum EHttpMethod x) {
   switch(x) {
-    case HTTP_METHOD_GET:    return "GET";
-    case HTTP_METHOD_HEAD:   return "HEAD";
-    case HTTP_METHOD_POST:   return "POST";
-    case HTTP_METHOD_PUT:    return "PUT";
-    case HTTP_METHOD_DELETE: return "DELETE";
-    default:                 return "?";
+    case HTTP_METHOD_GET:     return "GET";
+    case HTTP_METHOD_HEAD:    return "HEAD";
+    case HTTP_METHOD_POST:    return "POST";
+    case HTTP_METHOD_PUT:     return "PUT";
+    case HTTP_METHOD_DELETE:  return "DELETE";
+    case HTTP_METHOD_OPTIONS: return "OPTIONS";
+    case HTTP_METHOD_PATCH:   return "PATCH";
+    case HTTP_METHOD_TRACE:   return "TRACE";
+    case HTTP_METHOD_CONNECT: return "CONNECT";
+    default:                  return "?";
   }
 }
 
 enum EHttpMethod http_method_from_string(const char* str) {
-  if(!strcmp(str, "GET"   )) return HTTP_METHOD_GET;
-  if(!strcmp(str, "HEAD"  )) return HTTP_METHOD_HEAD;
-  if(!strcmp(str, "POST"  )) return HTTP_METHOD_POST;
-  if(!strcmp(str, "PUT"   )) return HTTP_METHOD_PUT;
-  if(!strcmp(str, "DELETE")) return HTTP_METHOD_DELETE;
+  return http_method_lookup(str, strlen(str));
+}
+
+enum EHttpMethod http_method_lookup(const char* str, size_t len) {
+  switch(len) {
+    case 3:
+      if(!memcmp(str, "GET", 3)) return HTTP_METHOD_GET;
+      if(!memcmp(str, "PUT", 3)) return HTTP_METHOD_PUT;
+      break;
+    case 4:
+      if(!memcmp(str, "HEAD", 4)) return HTTP_METHOD_HEAD;
+      if(!memcmp(str, "POST", 4)) return HTTP_METHOD_POST;
+      break;
+    case 5:
+      if(!memcmp(str, "PATCH", 5)) return HTTP_METHOD_PATCH;
+      if(!memcmp(str, "TRACE", 5)) return HTTP_METHOD_TRACE;
+      break;
+    case 6:
+      if(!memcmp(str, "DELETE", 6)) return HTTP_METHOD_DELETE;
+      break;
+    case 7:
+      if(!memcmp(str, "OPTIONS", 7)) return HTTP_METHOD_OPTIONS;
+      if(!memcmp(str, "CONNECT", 7)) return HTTP_METHOD_CONNECT;
+      break;
+  }
   return HTTP_METHOD_UNKNOWN;
 }
 
 //==============================================================================
-// HTTP Status Codes
+// Well-known HTTP headers
 //==============================================================================
-const char* http_status_to_string(enum EHttpStatus x) {
+const char* http_header_to_string(enum EHttpHeader x) {
   switch(x) {
-    case HTTP_STATUS_OK:              return "OK";
-    case HTTP_STATUS_BAD_REQUEST:     return "Bad Request";
-    case HTTP_STATUS_NOT_FOUND:       return "Not Found";
-    case HTTP_STATUS_NOT_IMPLEMENTED: return "Not Implemented";
-    default:                          return "?";
+    case HTTP_HEADER_ACCEPT:                         return "Accept";
+    case HTTP_HEADER_ACCEPT_CHARSET:                 return "Accept-Charset";
+    case HTTP_HEADER_ACCEPT_ENCODING:                return "Accept-Encoding";
+    case HTTP_HEADER_ACCEPT_LANGUAGE:                return "Accept-Language";
+    case HTTP_HEADER_ACCEPT_RANGES:                  return "Accept-Ranges";
+    case HTTP_HEADER_ACCESS_CONTROL_REQUEST_HEADERS: return "Access-Control-Request-Headers";
+    case HTTP_HEADER_ACCESS_CONTROL_REQUEST_METHOD:  return "Access-Control-Request-Method";
+    case HTTP_HEADER_AGE:                            return "Age";
+    case HTTP_HEADER_ALLOW:                          return "Allow";
+    case HTTP_HEADER_AUTHORIZATION:                  return "Authorization";
+    case HTTP_HEADER_CACHE_CONTROL:                  return "Cache-Control";
+    case HTTP_HEADER_CONNECTION:                     return "Connection";
+    case HTTP_HEADER_CONTENT_DISPOSITION:            return "Content-Disposition";
+    case HTTP_HEADER_CONTENT_ENCODING:               return "Content-Encoding";
+    case HTTP_HEADER_CONTENT_LANGUAGE:               return "Content-Language";
+    case HTTP_HEADER_CONTENT_LENGTH:                 return "Content-Length";
+    case HTTP_HEADER_CONTENT_LOCATION:               return "Content-Location";
+    case HTTP_HEADER_CONTENT_RANGE:                  return "Content-Range";
+    case HTTP_HEADER_CONTENT_TYPE:                   return "Content-Type";
+    case HTTP_HEADER_COOKIE:                         return "Cookie";
+    case HTTP_HEADER_DATE:                           return "Date";
+    case HTTP_HEADER_DNT:                            return "DNT";
+    case HTTP_HEADER_ETAG:                           return "ETag";
+    case HTTP_HEADER_EXPECT:                         return "Expect";
+    case HTTP_HEADER_EXPIRES:                        return "Expires";
+    case HTTP_HEADER_FORWARDED:                      return "Forwarded";
+    case HTTP_HEADER_FROM:                           return "From";
+    case HTTP_HEADER_HOST:                           return "Host";
+    case HTTP_HEADER_IF_MATCH:                       return "If-Match";
+    case HTTP_HEADER_IF_MODIFIED_SINCE:              return "If-Modified-Since";
+    case HTTP_HEADER_IF_NONE_MATCH:                  return "If-None-Match";
+    case HTTP_HEADER_IF_RANGE:                       return "If-Range";
+    case HTTP_HEADER_IF_UNMODIFIED_SINCE:            return "If-Unmodified-Since";
+    case HTTP_HEADER_KEEP_ALIVE:                     return "Keep-Alive";
+    case HTTP_HEADER_LAST_MODIFIED:                  return "Last-Modified";
+    case HTTP_HEADER_LINK:                           return "Link";
+    case HTTP_HEADER_LOCATION:                       return "Location";
+    case HTTP_HEADER_MAX_FORWARDS:                   return "Max-Forwards";
+    case HTTP_HEADER_ORIGIN:                         return "Origin";
+    case HTTP_HEADER_PRAGMA:                         return "Pragma";
+    case HTTP_HEADER_PROXY_AUTHORIZATION:            return "Proxy-Authorization";
+    case HTTP_HEADER_RANGE:                          return "Range";
+    case HTTP_HEADER_REFERER:                        return "Referer";
+    case HTTP_HEADER_RETRY_AFTER:                    return "Retry-After";
+    case HTTP_HEADER_SEC_FETCH_DEST:                 return "Sec-Fetch-Dest";
+    case HTTP_HEADER_SEC_FETCH_MODE:                 return "Sec-Fetch-Mode";
+    case HTTP_HEADER_SEC_FETCH_SITE:                 return "Sec-Fetch-Site";
+    case HTTP_HEADER_SEC_FETCH_USER:                 return "Sec-Fetch-User";
+    case HTTP_HEADER_SERVER:                         return "Server";
+    case HTTP_HEADER_SET_COOKIE:                     return "Set-Cookie";
+    case HTTP_HEADER_TE:                             return "TE";
+    case HTTP_HEADER_TRAILER:                        return "Trailer";
+    case HTTP_HEADER_TRANSFER_ENCODING:              return "Transfer-Encoding";
+    case HTTP_HEADER_UPGRADE:                        return "Upgrade";
+    case HTTP_HEADER_UPGRADE_INSECURE_REQUESTS:      return "Upgrade-Insecure-Requests";
+    case HTTP_HEADER_USER_AGENT:                     return "User-Agent";
+    case HTTP_HEADER_VARY:                           return "Vary";
+    case HTTP_HEADER_VIA:                            return "Via";
+    case HTTP_HEADER_WWW_AUTHENTICATE:               return "WWW-Authenticate";
+    case HTTP_HEADER_X_FORWARDED_FOR:                return "X-Forwarded-For";
+    case HTTP_HEADER_X_FORWARDED_HOST:               return "X-Forwarded-Host";
+    case HTTP_HEADER_X_FORWARDED_PROTO:              return "X-Forwarded-Proto";
+    case HTTP_HEADER_X_REAL_IP:                      return "X-Real-IP";
+    case HTTP_HEADER_X_REQUESTED_WITH:               return "X-Requested-With";
+    default:                                       return "?";
+  }
+}
+
+enum EHttpHeader http_header_from_string(const char* str) {
+  return http_header_lookup(str, strlen(str));
+}
+
+// Grouped by length, then by first letter
+enum EHttpHeader http_header_lookup(const char* str, size_t len) {
+  switch(len) {
+    case 2:
+      if(http_enums_match(str, "te")) return HTTP_HEADER_TE;
+      break;
+    case 3:
+      switch(http_enums_lower(str[0])) {
+        case 'a':
+          if(http_enums_match(str, "age")) return HTTP_HEADER_AGE;
+          break;
+        case 'd':
+          if(http_enums_match(str, "dnt")) return HTTP_HEADER_DNT;
+          break;
+        case 'v':
+          if(http_enums_match(str, "via")) return HTTP_HEADER_VIA;
+          break;
+      }
+      break;
+    case 4:
+      switch(http_enums_lower(str[0])) {
+        case 'd':
+          if(http_enums_match(str, "date")) return HTTP_HEADER_DATE;
+          break;
+        case 'e':
+          if(http_enums_match(str, "etag")) return HTTP_HEADER_ETAG;
+          break;
+        case 'f':
+          if(http_enums_match(str, "from")) return HTTP_HEADER_FROM;
+          break;
+        case 'h':
+          if(http_enums_match(str, "host")) return HTTP_HEADER_HOST;
+          break;
+        case 'l':
+          if(http_enums_match(str, "link")) return HTTP_HEADER_LINK;
+          break;
+        case 'v':
+          if(http_enums_match(str, "vary")) return HTTP_HEADER_VARY;
+          break;
+      }
+      break;
+    case 5:
+      switch(http_enums_lower(str[0])) {
+        case 'a':
+          if(http_enums_match(str, "allow")) return HTTP_HEADER_ALLOW;
+          break;
+        case 'r':
+          if(http_enums_match(str, "range")) return HTTP_HEADER_RANGE;
+          break;
+      }
+      break;
+    case 6:
+      switch(http_enums_lower(str[0])) {
+        case 'a':
+          if(http_enums_match(str, "accept")) return HTTP_HEADER_ACCEPT;
+          break;
+        case 'c':
+          if(http_enums_match(str, "cookie")) return HTTP_HEADER_COOKIE;
+          break;
+        case 'e':
+          if(http_enums_match(str, "expect")) return HTTP_HEADER_EXPECT;
+          break;
+        case 'o':
+          if(http_enums_match(str, "origin")) return HTTP_HEADER_ORIGIN;
+          break;
+        case 'p':
+          if(http_enums_match(str, "pragma")) return HTTP_HEADER_PRAGMA;
+          break;
+        case 's':
+          if(http_enums_match(str, "server")) return HTTP_HEADER_SERVER;
+          break;
+      }
+      break;
+    case 7:
+      switch(http_enums_lower(str[0])) {
+        case 'e':
+          if(http_enums_match(str, "expires")) return HTTP_HEADER_EXPIRES;
+          break;
+        case 'r':
+          if(http_enums_match(str, "referer")) return HTTP_HEADER_REFERER;
+          break;
+        case 't':
+          if(http_enums_match(str, "trailer")) return HTTP_HEADER_TRAILER;
+          break;
+        case 'u':
+          if(http_enums_match(str, "upgrade")) return HTTP_HEADER_UPGRADE;
+          break;
+      }
+      break;
+    case 8:
+      switch(http_enums_lower(str[0])) {
+        case 'i':
+          if(http_enums_match(str, "if-match")) return HTTP_HEADER_IF_MATCH;
+          if(http_enums_match(str, "if-range")) return HTTP_HEADER_IF_RANGE;
+          break;
+        case 'l':
+          if(http_enums_match(str, "location")) return HTTP_HEADER_LOCATION;
+          break;
+      }
+      break;
+    case 9:
+      switch(http_enums_lower(str[0])) {
+        case 'f':
+          if(http_enums_match(str, "forwarded")) return HTTP_HEADER_FORWARDED;
+          break;
+        case 'x':
+          if(http_enums_match(str, "x-real-ip")) return HTTP_HEADER_X_REAL_IP;
+          break;
+      }
+      break;
+    case 10:
+      switch(http_enums_lower(str[0])) {
+        case 'c':
+          if(http_enums_match(str, "connection")) return HTTP_HEADER_CONNECTION;
+          break;
+        case 'k':
+          if(http_enums_match(str, "keep-alive")) return HTTP_HEADER_KEEP_ALIVE;
+          break;
+        case 's':
+          if(http_enums_match(str, "set-cookie")) return HTTP_HEADER_SET_COOKIE;
+          break;
+        case 'u':
+          if(http_enums_match(str, "user-agent")) return HTTP_HEADER_USER_AGENT;
+          break;
+      }
+      break;
+    case 11:
+      if(http_enums_match(str, "retry-after")) return HTTP_HEADER_RETRY_AFTER;
+      break;
+    case 12:
+      switch(http_enums_lower(str[0])) {
+        case 'c':
+          if(http_enums_match(str, "content-type")) return HTTP_HEADER_CONTENT_TYPE;
+          break;
+        case 'm':
+          if(http_enums_match(str, "max-forwards")) return HTTP_HEADER_MAX_FORWARDS;
+          break;
+      }
+      break;
+    case 13:
+      switch(http_enums_lower(str[0])) {
+        case 'a':
+          if(http_enums_match(str, "accept-ranges")) return HTTP_HEADER_ACCEPT_RANGES;
+          if(http_enums_match(str, "authorization")) return HTTP_HEADER_AUTHORIZATION;
+          break;
+        case 'c':
+          if(http_enums_match(str, "cache-control")) return HTTP_HEADER_CACHE_CONTROL;
+          if(http_enums_match(str, "content-range")) return HTTP_HEADER_CONTENT_RANGE;
+          break;
+        case 'i':
+          if(http_enums_match(str, "if-none-match")) return HTTP_HEADER_IF_NONE_MATCH;
+          break;
+        case 'l':
+          if(http_enums_match(str, "last-modified")) return HTTP_HEADER_LAST_MODIFIED;
+          break;
+      }
+      break;
+    case 14:
+      switch(http_enums_lower(str[0])) {
+        case 'a':
+          if(http_enums_match(str, "accept-charset")) return HTTP_HEADER_ACCEPT_CHARSET;
+          break;
+        case 'c':
+          if(http_enums_match(str, "content-length")) return HTTP_HEADER_CONTENT_LENGTH;
+          break;
+        case 's':
+          if(http_enums_match(str, "sec-fetch-dest")) return HTTP_HEADER_SEC_FETCH_DEST;
+          if(http_enums_match(str, "sec-fetch-mode")) return HTTP_HEADER_SEC_FETCH_MODE;
+          if(http_enums_match(str, "sec-fetch-site")) return HTTP_HEADER_SEC_FETCH_SITE;
+          if(http_enums_match(str, "sec-fetch-user")) return HTTP_HEADER_SEC_FETCH_USER;
+          break;
+      }
+      break;
+    case 15:
+      switch(http_enums_lower(str[0])) {
+        case 'a':
+          if(http_enums_match(str, "accept-encoding")) return HTTP_HEADER_ACCEPT_ENCODING;
+          if(http_enums_match(str, "accept-language")) return HTTP_HEADER_ACCEPT_LANGUAGE;
+          break;
+        case 'x':
+          if(http_enums_match(str, "x-forwarded-for")) return HTTP_HEADER_X_FORWARDED_FOR;
+          break;
+      }
+      break;
+    case 16:
+      switch(http_enums_lower(str[0])) {
+        case 'c':
+          if(http_enums_match(str, "content-encoding")) return HTTP_HEADER_CONTENT_ENCODING;
+          if(http_enums_match(str, "content-language")) return HTTP_HEADER_CONTENT_LANGUAGE;
+          if(http_enums_match(str, "content-location")) return HTTP_HEADER_CONTENT_LOCATION;
+          break;
+        case 'w':
+          if(http_enums_match(str, "www-authenticate")) return HTTP_HEADER_WWW_AUTHENTICATE;
+          break;
+        case 'x':
+          if(http_enums_match(str, "x-forwarded-host")) return HTTP_HEADER_X_FORWARDED_HOST;
+          if(http_enums_match(str, "x-requested-with")) return HTTP_HEADER_X_REQUESTED_WITH;
+          break;
+      }
+      break;
+    case 17:
+      switch(http_enums_lower(str[0])) {
+        case 'i':
+          if(http_enums_match(str, "if-modified-since")) return HTTP_HEADER_IF_MODIFIED_SINCE;
+          break;
+        case 't':
+          if(http_enums_match(str, "transfer-encoding")) return HTTP_HEADER_TRANSFER_ENCODING;
+          break;
+        case 'x':
+          if(http_enums_match(str, "x-forwarded-proto")) return HTTP_HEADER_X_FORWARDED_PROTO;
+          break;
+      }
+      break;
+    case 19:
+      switch(http_enums_lower(str[0])) {
+        case 'c':
+          if(http_enums_match(str, "content-disposition")) return HTTP_HEADER_CONTENT_DISPOSITION;
+          break;
+        case 'i':
+          if(http_enums_match(str, "if-unmodified-since")) return HTTP_HEADER_IF_UNMODIFIED_SINCE;
+          break;
+        case 'p':
+          if(http_enums_match(str, "proxy-authorization")) return HTTP_HEADER_PROXY_AUTHORIZATION;
+          break;
+      }
+      break;
+    case 25:
+      if(http_enums_match(str, "upgrade-insecure-requests")) {
+        return HTTP_HEADER_UPGRADE_INSECURE_REQUESTS;
+      }
+      break;
+    case 29:
+      if(http_enums_match(str, "access-control-request-method")) {
+        return HTTP_HEADER_ACCESS_CONTROL_REQUEST_METHOD;
+      }
+      break;
+    case 30:
+      if(http_enums_match(str, "access-control-request-headers")) {
+        return HTTP_HEADER_ACCESS_CONTROL_REQUEST_HEADERS;
+      }
+      break;
   }
+  return HTTP_HEADER_UNKNOWN;
+}
+
+//==============================================================================
+// Content codings
+//==============================================================================
+const char* http_encoding_to_string(enum EHttpEncoding x) {
+  switch(x) {
+    case HTTP_ENCODING_IDENTITY: return "identity";
+    case HTTP_ENCODING_GZIP:     return "gzip";
+    case HTTP_ENCODING_BR:       return "br";
+    default:                     return "?";
+  }
+}
+
+enum EHttpEncoding http_encoding_from_string(const char* str) {
+  return http_encoding_lookup(str, strlen(str));
+}
+
+enum EHttpEncoding http_encoding_lookup(const char* str, size_t len) {
+  switch(len) {
+    case 2: if(http_enums_match(str, "br"))       return HTTP_ENCODING_BR;       break;
+    case 4: if(http_enums_match(str, "gzip"))     return HTTP_ENCODING_GZIP;     break;
+    case 6: if(http_enums_match(str, "x-gzip"))   return HTTP_ENCODING_GZIP;     break;
+    case 8: if(http_enums_match(str, "identity")) return HTTP_ENCODING_IDENTITY; break;
+  }
+  return HTTP_ENCODING_UNKNOWN;
+}
+
+//==============================================================================
+// HTTP Status Codes
+//==============================================================================
+// Reason phrases, indexed by status code. Every response's status line is
+// built from one, so this is a lookup rather than a switch.
+static const char* HTTP_STATUS_REASONS[HTTP_STATUS_MAX] = {
+  [HTTP_STATUS_CONTINUE]                        = "Continue",
+  [HTTP_STATUS_SWITCHING_PROTOCOLS]             = "Switching Protocols",
+  [HTTP_STATUS_OK]                              = "OK",
+  [HTTP_STATUS_CREATED]                         = "Created",
+  [HTTP_STATUS_ACCEPTED]                        = "Accepted",
+  [HTTP_STATUS_NON_AUTHORITATIVE_INFORMATION]   = "Non-Authoritative Information",
+  [HTTP_STATUS_NO_CONTENT]                      = "No Content",
+  [HTTP_STATUS_RESET_CONTENT]                   = "Reset Content",
+  [HTTP_STATUS_PARTIAL_CONTENT]                 = "Partial Content",
+  [HTTP_STATUS_MULTIPLE_CHOICES]                = "Multiple Choices",
+  [HTTP_STATUS_MOVED_PERMANENTLY]               = "Moved Permanently",
+  [HTTP_STATUS_FOUND]                           = "Found",
+  [HTTP_STATUS_SEE_OTHER]                       = "See Other",
+  [HTTP_STATUS_NOT_MODIFIED]                    = "Not Modified",
+  [HTTP_STATUS_USE_PROXY]                       = "Use Proxy",
+  [HTTP_STATUS_TEMPORARY_REDIRECT]              = "Temporary Redirect",
+  [HTTP_STATUS_PERMANENT_REDIRECT]              = "Permanent Redirect",
+  [HTTP_STATUS_BAD_REQUEST]                     = "Bad Request",
+  [HTTP_STATUS_UNAUTHORIZED]                    = "Unauthorized",
+  [HTTP_STATUS_PAYMENT_REQUIRED]                = "Payment Required",
+  [HTTP_STATUS_FORBIDDEN]                       = "Forbidden",
+  [HTTP_STATUS_NOT_FOUND]                       = "Not Found",
+  [HTTP_STATUS_METHOD_NOT_ALLOWED]              = "Method Not Allowed",
+  [HTTP_STATUS_NOT_ACCEPTABLE]                  = "Not Acceptable",
+  [HTTP_STATUS_PROXY_AUTHENTICATION_REQUIRED]   = "Proxy Authentication Required",
+  [HTTP_STATUS_REQUEST_TIMEOUT]                 = "Request Timeout",
+  [HTTP_STATUS_CONFLICT]                        = "Conflict",
+  [HTTP_STATUS_GONE]                            = "Gone",
+  [HTTP_STATUS_LENGTH_REQUIRED]                 = "Length Required",
+  [HTTP_STATUS_PRECONDITION_FAILED]             = "Precondition Failed",
+  [HTTP_STATUS_CONTENT_TOO_LARGE]               = "Content Too Large",
+  [HTTP_STATUS_URI_TOO_LONG]                    = "URI Too Long",
+  [HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE]          = "Unsupported Media Type",
+  [HTTP_STATUS_RANGE_NOT_SATISFIABLE]           = "Range Not Satisfiable",
+  [HTTP_STATUS_EXPECTATION_FAILED]              = "Expectation Failed",
+  [HTTP_STATUS_MISDIRECTED_REQUEST]             = "Misdirected Request",
+  [HTTP_STATUS_UNPROCESSABLE_CONTENT]           = "Unprocessable Content",
+  [HTTP_STATUS_UPGRADE_REQUIRED]                = "Upgrade Required",
+  [HTTP_STATUS_PRECONDITION_REQUIRED]           = "Precondition Required",
+  [HTTP_STATUS_TOO_MANY_REQUESTS]               = "Too Many Requests",
+  [HTTP_STATUS_REQUEST_HEADER_FIELDS_TOO_LARGE] = "Request Header Fields Too Large",
+  [HTTP_STATUS_UNAVAILABLE_FOR_LEGAL_REASONS]   = "Unavailable For Legal Reasons",
+  [HTTP_STATUS_INTERNAL_SERVER_ERROR]           = "Internal Server Error",
+  [HTTP_STATUS_NOT_IMPLEMENTED]                 = "Not Implemented",
+  [HTTP_STATUS_BAD_GATEWAY]                     = "Bad Gateway",
+  [HTTP_STATUS_SERVICE_UNAVAILABLE]             = "Service Unavailable",
+  [HTTP_STATUS_GATEWAY_TIMEOUT]                 = "Gateway Timeout",
+  [HTTP_STATUS_HTTP_VERSION_NOT_SUPPORTED]      = "HTTP Version Not Supported",
+  [HTTP_STATUS_NETWORK_AUTHENTICATION_REQUIRED] = "Network Authentication Required",
+};
+
+const char* http_status_to_string(enum EHttpStatus x) {
+  if((unsigned)x >= HTTP_STATUS_MAX || !HTTP_STATUS_REASONS[x]) return "?";
+  return HTTP_STATUS_REASONS[x];
 }
 
 enum EHttpStatus http_status_from_string(const char* str) {
-  if(!strcmp(str, "OK"))              return HTTP_STATUS_OK;
-  if(!strcmp(str, "Bad Request"))     return HTTP_STATUS_BAD_REQUEST;
-  if(!strcmp(str, "Not Found"))       return HTTP_STATUS_NOT_FOUND;
-  if(!strcmp(str, "Not Implemented")) return HTTP_STATUS_NOT_IMPLEMENTED;
+  for(int i=0; i<HTTP_STATUS_MAX; ++i) {
+    if(HTTP_STATUS_REASONS[i] && !strcmp(str, HTTP_STATUS_REASONS[i])) return (enum EHttpStatus)i;
+  }
   return HTTP_STATUS_UNKNOWN;
 }
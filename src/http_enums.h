@@ -4,12 +4,18 @@
 // NOTE:
 //   - xxx_to_string() will return "?" on error
 //   - xxx_from_string() will return the proper UNKNOWN enum value on error
+//   - xxx_lookup() is the same as xxx_from_string(), for strings that aren't
+//     null-terminated. It's what the request parser uses: a switch on length,
+//     then on the first character, then one comparison, so it takes about the
+//     same time however many values there are.
 //
 // Evan Kuhn 2012-09-25
 //==============================================================================
 #ifndef HTTP_ENUMS_H
 #define HTTP_ENUMS_H
 
+#include <stddef.h>
+
 //==============================================================================
 // HTTP Versions
 //==============================================================================
@@ -22,6 +28,7 @@ enum EHttpVersion {
 // String conversion
 const char*       http_version_to_string  (enum EHttpVersion x);
 enum EHttpVersion http_version_from_string(const char* s);
+enum EHttpVersion http_version_lookup     (const char* s, size_t len);
 
 //==============================================================================
 // HTTP Request Methods
@@ -32,26 +39,178 @@ enum EHttpMethod {
   HTTP_METHOD_HEAD,
   HTTP_METHOD_POST,
   HTTP_METHOD_PUT,
-  HTTP_METHOD_DELETE
+  HTTP_METHOD_DELETE,
+  HTTP_METHOD_OPTIONS,
+  HTTP_METHOD_PATCH,
+  HTTP_METHOD_TRACE,
+  HTTP_METHOD_CONNECT
 };
 
-// String conversion
+// String conversion. Methods are case-sensitive.
 const char*      http_method_to_string  (enum EHttpMethod x);
 enum EHttpMethod http_method_from_string(const char* s);
+enum EHttpMethod http_method_lookup     (const char* s, size_t len);
+
+//==============================================================================
+// Well-known HTTP headers
+//==============================================================================
+enum EHttpHeader {
+  HTTP_HEADER_UNKNOWN,
+  HTTP_HEADER_ACCEPT,
+  HTTP_HEADER_ACCEPT_CHARSET,
+  HTTP_HEADER_ACCEPT_ENCODING,
+  HTTP_HEADER_ACCEPT_LANGUAGE,
+  HTTP_HEADER_ACCEPT_RANGES,
+  HTTP_HEADER_ACCESS_CONTROL_REQUEST_HEADERS,
+  HTTP_HEADER_ACCESS_CONTROL_REQUEST_METHOD,
+  HTTP_HEADER_AGE,
+  HTTP_HEADER_ALLOW,
+  HTTP_HEADER_AUTHORIZATION,
+  HTTP_HEADER_CACHE_CONTROL,
+  HTTP_HEADER_CONNECTION,
+  HTTP_HEADER_CONTENT_DISPOSITION,
+  HTTP_HEADER_CONTENT_ENCODING,
+  HTTP_HEADER_CONTENT_LANGUAGE,
+  HTTP_HEADER_CONTENT_LENGTH,
+  HTTP_HEADER_CONTENT_LOCATION,
+  HTTP_HEADER_CONTENT_RANGE,
+  HTTP_HEADER_CONTENT_TYPE,
+  HTTP_HEADER_COOKIE,
+  HTTP_HEADER_DATE,
+  HTTP_HEADER_DNT,
+  HTTP_HEADER_ETAG,
+  HTTP_HEADER_EXPECT,
+  HTTP_HEADER_EXPIRES,
+  HTTP_HEADER_FORWARDED,
+  HTTP_HEADER_FROM,
+  HTTP_HEADER_HOST,
+  HTTP_HEADER_IF_MATCH,
+  HTTP_HEADER_IF_MODIFIED_SINCE,
+  HTTP_HEADER_IF_NONE_MATCH,
+  HTTP_HEADER_IF_RANGE,
+  HTTP_HEADER_IF_UNMODIFIED_SINCE,
+  HTTP_HEADER_KEEP_ALIVE,
+  HTTP_HEADER_LAST_MODIFIED,
+  HTTP_HEADER_LINK,
+  HTTP_HEADER_LOCATION,
+  HTTP_HEADER_MAX_FORWARDS,
+  HTTP_HEADER_ORIGIN,
+  HTTP_HEADER_PRAGMA,
+  HTTP_HEADER_PROXY_AUTHORIZATION,
+  HTTP_HEADER_RANGE,
+  HTTP_HEADER_REFERER,
+  HTTP_HEADER_RETRY_AFTER,
+  HTTP_HEADER_SEC_FETCH_DEST,
+  HTTP_HEADER_SEC_FETCH_MODE,
+  HTTP_HEADER_SEC_FETCH_SITE,
+  HTTP_HEADER_SEC_FETCH_USER,
+  HTTP_HEADER_SERVER,
+  HTTP_HEADER_SET_COOKIE,
+  HTTP_HEADER_TE,
+  HTTP_HEADER_TRAILER,
+  HTTP_HEADER_TRANSFER_ENCODING,
+  HTTP_HEADER_UPGRADE,
+  HTTP_HEADER_UPGRADE_INSECURE_REQUESTS,
+  HTTP_HEADER_USER_AGENT,
+  HTTP_HEADER_VARY,
+  HTTP_HEADER_VIA,
+  HTTP_HEADER_WWW_AUTHENTICATE,
+  HTTP_HEADER_X_FORWARDED_FOR,
+  HTTP_HEADER_X_FORWARDED_HOST,
+  HTTP_HEADER_X_FORWARDED_PROTO,
+  HTTP_HEADER_X_REAL_IP,
+  HTTP_HEADER_X_REQUESTED_WITH,
+  HTTP_HEADER_COUNT  // Number of values above, including UNKNOWN
+};
+
+// String conversion. Header names are case-insensitive; to_string() gives the
+// usual spelling.
+const char*      http_header_to_string  (enum EHttpHeader x);
+enum EHttpHeader http_header_from_string(const char* s);
+enum EHttpHeader http_header_lookup     (const char* s, size_t len);
+
+//==============================================================================
+// Content codings, as in Accept-Encoding and Content-Encoding
+//==============================================================================
+enum EHttpEncoding {
+  HTTP_ENCODING_UNKNOWN,
+  HTTP_ENCODING_IDENTITY,
+  HTTP_ENCODING_GZIP,
+  HTTP_ENCODING_BR,
+  HTTP_ENCODING_COUNT  // Number of values above, including UNKNOWN
+};
+
+// String conversion. Codings are case-insensitive, and "x-gzip" is gzip.
+const char*        http_encoding_to_string  (enum EHttpEncoding x);
+enum EHttpEncoding http_encoding_from_string(const char* s);
+enum EHttpEncoding http_encoding_lookup     (const char* s, size_t len);
 
 //==============================================================================
 // HTTP Status Codes
 //==============================================================================
+// Every status code registered by RFC 9110, plus 428, 429, 431 and 451
 enum EHttpStatus {
-  HTTP_STATUS_OK = 200,
-  HTTP_STATUS_BAD_REQUEST = 400,
-  HTTP_STATUS_NOT_FOUND = 404,
-  HTTP_STATUS_NOT_IMPLEMENTED = 501,
-  //TODO - etc
-  HTTP_STATUS_UNKNOWN
+  HTTP_STATUS_UNKNOWN = 0,
+
+  HTTP_STATUS_CONTINUE                        = 100,
+  HTTP_STATUS_SWITCHING_PROTOCOLS             = 101,
+
+  HTTP_STATUS_OK                              = 200,
+  HTTP_STATUS_CREATED                         = 201,
+  HTTP_STATUS_ACCEPTED                        = 202,
+  HTTP_STATUS_NON_AUTHORITATIVE_INFORMATION   = 203,
+  HTTP_STATUS_NO_CONTENT                      = 204,
+  HTTP_STATUS_RESET_CONTENT                   = 205,
+  HTTP_STATUS_PARTIAL_CONTENT                 = 206,
+
+  HTTP_STATUS_MULTIPLE_CHOICES                = 300,
+  HTTP_STATUS_MOVED_PERMANENTLY               = 301,
+  HTTP_STATUS_FOUND                           = 302,
+  HTTP_STATUS_SEE_OTHER                       = 303,
+  HTTP_STATUS_NOT_MODIFIED                    = 304,
+  HTTP_STATUS_USE_PROXY                       = 305,
+  HTTP_STATUS_TEMPORARY_REDIRECT              = 307,
+  HTTP_STATUS_PERMANENT_REDIRECT              = 308,
+
+  HTTP_STATUS_BAD_REQUEST                     = 400,
+  HTTP_STATUS_UNAUTHORIZED                    = 401,
+  HTTP_STATUS_PAYMENT_REQUIRED                = 402,
+  HTTP_STATUS_FORBIDDEN                       = 403,
+  HTTP_STATUS_NOT_FOUND                       = 404,
+  HTTP_STATUS_METHOD_NOT_ALLOWED              = 405,
+  HTTP_STATUS_NOT_ACCEPTABLE                  = 406,
+  HTTP_STATUS_PROXY_AUTHENTICATION_REQUIRED   = 407,
+  HTTP_STATUS_REQUEST_TIMEOUT                 = 408,
+  HTTP_STATUS_CONFLICT                        = 409,
+  HTTP_STATUS_GONE                            = 410,
+  HTTP_STATUS_LENGTH_REQUIRED                 = 411,
+  HTTP_STATUS_PRECONDITION_FAILED             = 412,
+  HTTP_STATUS_CONTENT_TOO_LARGE               = 413,
+  HTTP_STATUS_URI_TOO_LONG                    = 414,
+  HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE          = 415,
+  HTTP_STATUS_RANGE_NOT_SATISFIABLE           = 416,
+  HTTP_STATUS_EXPECTATION_FAILED              = 417,
+  HTTP_STATUS_MISDIRECTED_REQUEST             = 421,
+  HTTP_STATUS_UNPROCESSABLE_CONTENT           = 422,
+  HTTP_STATUS_UPGRADE_REQUIRED                = 426,
+  HTTP_STATUS_PRECONDITION_REQUIRED           = 428,
+  HTTP_STATUS_TOO_MANY_REQUESTS               = 429,
+  HTTP_STATUS_REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
+  HTTP_STATUS_UNAVAILABLE_FOR_LEGAL_REASONS   = 451,
+
+  HTTP_STATUS_INTERNAL_SERVER_ERROR           = 500,
+  HTTP_STATUS_NOT_IMPLEMENTED                 = 501,
+  HTTP_STATUS_BAD_GATEWAY                     = 502,
+  HTTP_STATUS_SERVICE_UNAVAILABLE             = 503,
+  HTTP_STATUS_GATEWAY_TIMEOUT                 = 504,
+  HTTP_STATUS_HTTP_VERSION_NOT_SUPPORTED      = 505,
+  HTTP_STATUS_NETWORK_AUTHENTICATION_REQUIRED = 511,
 };
 
-// String conversion
+// One more than the largest status code
+#define HTTP_STATUS_MAX 600
+
+// String conversion, to and from reason phrases, e.g. "Not Found"
 const char*      http_status_to_string  (enum EHttpStatus x);
 enum EHttpStatus http_status_from_string(const char* s);
 
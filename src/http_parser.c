@@ -0,0 +1,531 @@
+#include "http_parser.h"
+#include "http_scan.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+//==============================================================================
+// Private utility functions
+//==============================================================================
+static enum EHttpParseResult http_parser_fail(HttpParser* parser, const char* error) {
+  parser->state = HTTP_PARSER_ERROR;
+  parser->error = error;
+  return HTTP_PARSE_ERROR;
+}
+
+static bool span_equals_nocase(const char* buf, HttpSpan span, const char* str) {
+  return span.len == strlen(str) && !strncasecmp(buf + span.off, str, span.len);
+}
+
+// Parse a Content-Length value. Fails on anything but a plain decimal number
+// that fits in a size_t.
+static bool http_parser_parse_length(const char* buf, HttpSpan span, size_t* length) {
+  if(span.len == 0) return false;
+  size_t value = 0;
+  for(size_t i=0; i<span.len; ++i) {
+    const char c = buf[span.off + i];
+    if(c < '0' || c > '9') return false;
+    const size_t digit = c - '0';
+    if(value > ((size_t)-1 - digit) / 10) return false;
+    value = value * 10 + digit;
+  }
+  *length = value;
+  return true;
+}
+
+// Value of a hex digit, or -1 if it isn't one
+static int http_parser_hex_value(unsigned char c) {
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Go through the codings in a Transfer-Encoding value, in the order they were
+// applied. Chunked must be the last, and only once (RFC 9112 section 6.1).
+// Returns false, with the parser in the error state, if there's one after it.
+static bool http_parser_add_codings(HttpParser* parser, const char* buf, HttpSpan value) {
+  const size_t end = value.off + value.len;
+  size_t i = value.off;
+  while(i < end) {
+    // Each list element is a coding name, maybe with parameters
+    size_t start = i;
+    while(i < end && buf[i] != ',') ++i;
+    size_t name_end = start;
+    while(name_end < i && buf[name_end] != ';') ++name_end;
+    while(start < name_end && (buf[start] == ' ' || buf[start] == '\t')) ++start;
+    while(name_end > start && (buf[name_end-1] == ' ' || buf[name_end-1] == '\t')) --name_end;
+    i += 1;
+    if(name_end == start) continue;  // Empty list element
+
+    if(parser->chunked) {
+      http_parser_fail(parser, "Transfer-Encoding has a coding after chunked");
+      return false;
+    }
+    const HttpSpan name = {start, name_end - start};
+    parser->chunked = span_equals_nocase(buf, name, "chunked");
+    parser->other_coding = parser->other_coding || !parser->chunked;
+  }
+  return true;
+}
+
+// Record a header once its line is complete. Returns false, with the parser
+// in the error state, if the header is unacceptable.
+static bool http_parser_add_header(HttpParser* parser, const char* buf,
+                                   HttpSpan name, HttpSpan value)
+{
+  if(parser->num_headers == HTTP_PARSER_MAX_HEADERS) {
+    http_parser_fail(parser, "Too many headers");
+    return false;
+  }
+
+  // Grow the array if needed: start at 16, then double
+  if(parser->num_headers == parser->header_cap) {
+    const size_t newcap = (parser->header_cap ? parser->header_cap * 2 : 16);
+    parser->headers = realloc(parser->headers, sizeof(HttpParserHeader) * newcap);
+    parser->header_cap = newcap;
+  }
+  HttpParserHeader* header = &parser->headers[parser->num_headers++];
+  header->name = name;
+  header->value = value;
+  header->id = http_header_lookup(buf + name.off, name.len);
+  if(header->id == HTTP_HEADER_UNKNOWN) return true;
+  if(!parser->header_index[header->id]) {
+    parser->header_index[header->id] = parser->num_headers;
+  }
+
+  // Pick out the headers that say how the body is framed
+  if(header->id == HTTP_HEADER_CONTENT_LENGTH) {
+    size_t length = 0;
+    if(!http_parser_parse_length(buf, value, &length)) {
+      http_parser_fail(parser, "Invalid Content-Length");
+      return false;
+    }
+    if(parser->has_content_length && parser->content_length != length) {
+      http_parser_fail(parser, "Conflicting Content-Length headers");
+      return false;
+    }
+    parser->has_content_length = true;
+    parser->content_length = length;
+  }
+  else if(header->id == HTTP_HEADER_TRANSFER_ENCODING) {
+    parser->has_transfer_encoding = true;
+    return http_parser_add_codings(parser, buf, value);
+  }
+  return true;
+}
+
+// The blank line after the headers has been consumed. Decide what follows.
+static enum EHttpParseResult http_parser_end_headers(HttpParser* parser) {
+  parser->header_len = parser->pos;
+  parser->body.off = parser->pos;
+  parser->body.len = 0;
+
+  // Transfer-Encoding overrides Content-Length, but a request with both may be
+  // framed differently by a proxy in front of us. Without chunked last, the
+  // body's length can't be determined. (RFC 9112 section 6.3)
+  if(parser->has_transfer_encoding && parser->has_content_length) {
+    return http_parser_fail(parser, "Both Transfer-Encoding and Content-Length");
+  }
+  if(parser->has_transfer_encoding && !parser->chunked) {
+    return http_parser_fail(parser, "Transfer-Encoding doesn't end with chunked");
+  }
+  if(parser->other_coding) {
+    parser->not_implemented = true;
+    return http_parser_fail(parser, "Unsupported transfer coding");
+  }
+  if(parser->chunked) {
+    parser->state = HTTP_PARSER_CHUNK_START;
+    return HTTP_PARSE_HEADERS_COMPLETE;
+  }
+  if(parser->content_length > 0) {
+    parser->state = HTTP_PARSER_BODY;
+    return HTTP_PARSE_HEADERS_COMPLETE;
+  }
+  parser->state = HTTP_PARSER_DONE;
+  return HTTP_PARSE_COMPLETE;
+}
+
+// Hand over the next 'n' bytes of the body, at parser->pos
+static enum EHttpParseResult http_parser_take_body(HttpParser* parser, size_t n) {
+  parser->body.off = parser->pos;
+  parser->body.len = n;
+  parser->body_received += n;
+  parser->pos += n;
+  return HTTP_PARSE_BODY;
+}
+
+// A chunk-size line has been consumed. The last chunk is empty, and followed
+// by any trailers.
+static void http_parser_end_chunk_size(HttpParser* parser) {
+  parser->skipped = 0;
+  parser->state = (parser->chunk_left ? HTTP_PARSER_CHUNK_DATA : HTTP_PARSER_TRAILER_START);
+}
+
+// The last chunk's trailers have been consumed, up to their final line ending
+static enum EHttpParseResult http_parser_end_chunks(HttpParser* parser) {
+  parser->pos += 1;
+  parser->body.off = parser->pos;
+  parser->body.len = 0;
+  parser->state = HTTP_PARSER_DONE;
+  return HTTP_PARSE_COMPLETE;
+}
+
+//==============================================================================
+// HttpParser
+//==============================================================================
+void http_parser_init(HttpParser* parser) {
+  parser->headers = NULL;
+  parser->header_cap = 0;
+  http_parser_reset(parser);
+}
+
+void http_parser_free(HttpParser* parser) {
+  free(parser->headers);
+  http_parser_init(parser);
+}
+
+void http_parser_reset(HttpParser* parser) {
+  const HttpSpan empty = {0, 0};
+  parser->state = HTTP_PARSER_REQUEST_START;
+  parser->pos = 0;
+  parser->mark = 0;
+  parser->header_name = empty;
+  parser->method = HTTP_METHOD_UNKNOWN;
+  parser->version = HTTP_VERSION_UNKNOWN;
+  parser->method_span = empty;
+  parser->uri = empty;
+  parser->version_span = empty;
+  parser->num_headers = 0;
+  memset(parser->header_index, 0, sizeof(parser->header_index));
+  parser->header_len = 0;
+  parser->has_content_length = false;
+  parser->content_length = 0;
+  parser->has_transfer_encoding = false;
+  parser->chunked = false;
+  parser->other_coding = false;
+  parser->chunk_left = 0;
+  parser->skipped = 0;
+  parser->body_received = 0;
+  parser->body = empty;
+  parser->error = NULL;
+  parser->not_implemented = false;
+}
+
+void http_parser_consume(HttpParser* parser, size_t len) {
+  const HttpSpan empty = {0, 0};
+  parser->pos -= len;
+  parser->mark = 0;
+  parser->header_name = empty;
+  parser->method_span = empty;
+  parser->uri = empty;
+  parser->version_span = empty;
+  parser->num_headers = 0;
+  memset(parser->header_index, 0, sizeof(parser->header_index));
+  parser->header_len = 0;
+  parser->body.off = parser->pos;
+  parser->body.len = 0;
+}
+
+bool http_parser_in_body(const HttpParser* parser) {
+  return parser->state >= HTTP_PARSER_BODY && parser->state < HTTP_PARSER_DONE;
+}
+
+enum EHttpParseResult http_parser_execute(HttpParser* parser, const char* buf, size_t len) {
+  // A piece of the body is only good until the next call
+  if(http_parser_in_body(parser)) {
+    parser->body.off = parser->pos;
+    parser->body.len = 0;
+  }
+
+  while(parser->pos < len) {
+    const unsigned char c = buf[parser->pos];
+    switch(parser->state) {
+      case HTTP_PARSER_REQUEST_START:
+        // Tolerate blank lines before the request line (RFC 7230 section 3.5)
+        if(c == '\r' || c == '\n') break;
+        if(!http_is_token_char(c)) return http_parser_fail(parser, "Invalid character in method");
+        parser->mark = parser->pos;
+        parser->state = HTTP_PARSER_METHOD;
+        break;
+
+      case HTTP_PARSER_METHOD: {
+        const size_t end = parser->pos + http_scan_token(buf + parser->pos, len - parser->pos);
+        parser->pos = end;
+        if(end == len) return HTTP_PARSE_INCOMPLETE;
+        if(buf[end] != ' ') return http_parser_fail(parser, "Invalid character in method");
+        parser->method_span.off = parser->mark;
+        parser->method_span.len = end - parser->mark;
+        parser->method = http_method_lookup(buf + parser->mark, parser->method_span.len);
+        if(parser->method == HTTP_METHOD_UNKNOWN) {
+          return http_parser_fail(parser, "Unknown method");
+        }
+        parser->state = HTTP_PARSER_URI_START;
+        break;
+      }
+
+      case HTTP_PARSER_URI_START:
+        if(c == ' ') break;
+        if(!http_is_visible_char(c)) return http_parser_fail(parser, "Missing request URI");
+        parser->mark = parser->pos;
+        parser->state = HTTP_PARSER_URI;
+        break;
+
+      case HTTP_PARSER_URI: {
+        // Take the rest of the URI in one go
+        const size_t end = parser->pos + http_scan_visible(buf + parser->pos, len - parser->pos);
+        parser->pos = end;
+        if(end == len) return HTTP_PARSE_INCOMPLETE;
+        if(buf[end] != ' ') {
+          const bool eol = (buf[end] == '\r' || buf[end] == '\n');
+          return http_parser_fail(parser, eol ? "Missing HTTP version"
+                                              : "Invalid character in request URI");
+        }
+        parser->uri.off = parser->mark;
+        parser->uri.len = end - parser->mark;
+        parser->state = HTTP_PARSER_VERSION_START;
+        break;
+      }
+
+      case HTTP_PARSER_VERSION_START:
+        if(c == ' ') break;
+        if(!http_is_visible_char(c)) return http_parser_fail(parser, "Missing HTTP version");
+        parser->mark = parser->pos;
+        parser->state = HTTP_PARSER_VERSION;
+        break;
+
+      case HTTP_PARSER_VERSION:
+        if(http_is_visible_char(c)) break;
+        parser->version_span.off = parser->mark;
+        parser->version_span.len = parser->pos - parser->mark;
+        parser->version = http_version_lookup(buf + parser->mark, parser->version_span.len);
+        if(parser->version == HTTP_VERSION_UNKNOWN) {
+          return http_parser_fail(parser, "Unrecognized HTTP version");
+        }
+        parser->state = HTTP_PARSER_REQUEST_LINE_END;
+        continue;  // Look at this character again
+
+      case HTTP_PARSER_REQUEST_LINE_END:
+        if(c == ' ') break;
+        if(c == '\r') parser->state = HTTP_PARSER_REQUEST_LINE_LF;
+        else if(c == '\n') parser->state = HTTP_PARSER_HEADER_START;
+        else return http_parser_fail(parser, "Invalid request line");
+        break;
+
+      case HTTP_PARSER_REQUEST_LINE_LF:
+      case HTTP_PARSER_HEADER_LINE_LF:
+        if(c != '\n') return http_parser_fail(parser, "Expected LF after CR");
+        parser->state = HTTP_PARSER_HEADER_START;
+        break;
+
+      case HTTP_PARSER_HEADER_START:
+        if(c == '\r') {
+          parser->state = HTTP_PARSER_HEADERS_END_LF;
+        }
+        else if(c == '\n') {
+          parser->pos += 1;
+          return http_parser_end_headers(parser);
+        }
+        else if(c == ' ' || c == '\t') {
+          return http_parser_fail(parser, "Folded header lines aren't supported");
+        }
+        else if(http_is_token_char(c)) {
+          parser->mark = parser->pos;
+          parser->state = HTTP_PARSER_HEADER_NAME;
+        }
+        else {
+          return http_parser_fail(parser, "Invalid character in header name");
+        }
+        break;
+
+      case HTTP_PARSER_HEADER_NAME: {
+        const size_t end = parser->pos + http_scan_token(buf + parser->pos, len - parser->pos);
+        parser->pos = end;
+        if(end == len) return HTTP_PARSE_INCOMPLETE;
+        if(buf[end] != ':') return http_parser_fail(parser, "Invalid character in header name");
+        parser->header_name.off = parser->mark;
+        parser->header_name.len = end - parser->mark;
+        parser->state = HTTP_PARSER_HEADER_VALUE_START;
+
+        // Usually the value starts after a single space
+        if(end + 2 < len && buf[end+1] == ' ' && buf[end+2] != ' ' && buf[end+2] != '\t') {
+          parser->pos = parser->mark = end + 2;
+          parser->state = HTTP_PARSER_HEADER_VALUE;
+          continue;
+        }
+        break;
+      }
+
+      case HTTP_PARSER_HEADER_VALUE_START:
+        if(c == ' ' || c == '\t') break;
+        parser->mark = parser->pos;
+        parser->state = HTTP_PARSER_HEADER_VALUE;
+        continue;  // Look at this character again
+
+      case HTTP_PARSER_HEADER_VALUE: {
+        // Take the rest of the line in one go, then trim trailing whitespace
+        const size_t end = parser->pos + http_scan_value(buf + parser->pos, len - parser->pos);
+        parser->pos = end;
+        if(end == len) return HTTP_PARSE_INCOMPLETE;
+        if(buf[end] != '\r' && buf[end] != '\n') {
+          return http_parser_fail(parser, "Invalid character in header value");
+        }
+
+        size_t value_end = end;
+        while(value_end > parser->mark && (buf[value_end-1] == ' ' || buf[value_end-1] == '\t')) {
+          --value_end;
+        }
+        const HttpSpan value = {parser->mark, value_end - parser->mark};
+        if(!http_parser_add_header(parser, buf, parser->header_name, value)) {
+          return HTTP_PARSE_ERROR;
+        }
+        // Usually the line ends with CRLF, and both are here
+        if(buf[end] == '\r' && end + 1 < len && buf[end+1] == '\n') {
+          parser->pos = end + 2;
+          parser->state = HTTP_PARSER_HEADER_START;
+          continue;
+        }
+        parser->state = (buf[end] == '\r' ? HTTP_PARSER_HEADER_LINE_LF
+                                          : HTTP_PARSER_HEADER_START);
+        break;
+      }
+
+      case HTTP_PARSER_HEADERS_END_LF:
+        if(c != '\n') return http_parser_fail(parser, "Expected LF after CR");
+        parser->pos += 1;
+        return http_parser_end_headers(parser);
+
+      case HTTP_PARSER_BODY: {
+        const uint64_t wanted = parser->content_length - parser->body_received;
+        const size_t available = len - parser->pos;
+        http_parser_take_body(parser, (available < wanted ? available : wanted));
+        if(parser->body_received < parser->content_length) return HTTP_PARSE_BODY;
+        parser->state = HTTP_PARSER_DONE;
+        return HTTP_PARSE_COMPLETE;
+      }
+
+      case HTTP_PARSER_CHUNK_START: {
+        const int digit = http_parser_hex_value(c);
+        if(digit < 0) return http_parser_fail(parser, "Invalid chunk size");
+        parser->chunk_left = digit;
+        parser->skipped = 0;
+        parser->state = HTTP_PARSER_CHUNK_SIZE;
+        break;
+      }
+
+      case HTTP_PARSER_CHUNK_SIZE: {
+        const int digit = http_parser_hex_value(c);
+        if(digit >= 0) {
+          if(parser->chunk_left > (UINT64_MAX >> 4)) {
+            return http_parser_fail(parser, "Chunk too large");
+          }
+          parser->chunk_left = (parser->chunk_left << 4) | digit;
+          break;
+        }
+        if(c != ';' && c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+          return http_parser_fail(parser, "Invalid chunk size");
+        }
+        parser->state = HTTP_PARSER_CHUNK_EXT;
+        continue;  // Look at this character again
+      }
+
+      case HTTP_PARSER_CHUNK_EXT:
+        if(c == '\r') parser->state = HTTP_PARSER_CHUNK_SIZE_LF;
+        else if(c == '\n') http_parser_end_chunk_size(parser);
+        else if(c < ' ' && c != '\t') {
+          return http_parser_fail(parser, "Invalid character in chunk extension");
+        }
+        else if(++parser->skipped > HTTP_PARSER_MAX_CHUNK_EXT) {
+          return http_parser_fail(parser, "Chunk extension too long");
+        }
+        break;
+
+      case HTTP_PARSER_CHUNK_SIZE_LF:
+        if(c != '\n') return http_parser_fail(parser, "Expected LF after CR");
+        http_parser_end_chunk_size(parser);
+        break;
+
+      case HTTP_PARSER_CHUNK_DATA: {
+        const size_t available = len - parser->pos;
+        const size_t n = (available < parser->chunk_left ? available : parser->chunk_left);
+        parser->chunk_left -= n;
+        if(parser->chunk_left == 0) parser->state = HTTP_PARSER_CHUNK_DATA_END;
+        return http_parser_take_body(parser, n);
+      }
+
+      case HTTP_PARSER_CHUNK_DATA_END:
+        if(c == '\r') parser->state = HTTP_PARSER_CHUNK_DATA_LF;
+        else if(c == '\n') parser->state = HTTP_PARSER_CHUNK_START;
+        else return http_parser_fail(parser, "Expected line ending after chunk data");
+        break;
+
+      case HTTP_PARSER_CHUNK_DATA_LF:
+        if(c != '\n') return http_parser_fail(parser, "Expected LF after CR");
+        parser->state = HTTP_PARSER_CHUNK_START;
+        break;
+
+      case HTTP_PARSER_TRAILER_START:
+        if(c == '\n') return http_parser_end_chunks(parser);
+        if(c == '\r') {
+          parser->state = HTTP_PARSER_TRAILERS_END_LF;
+          break;
+        }
+        parser->state = HTTP_PARSER_TRAILER;
+        continue;  // Look at this character again
+
+      case HTTP_PARSER_TRAILER:
+        if(c == '\r') parser->state = HTTP_PARSER_TRAILER_LF;
+        else if(c == '\n') parser->state = HTTP_PARSER_TRAILER_START;
+        else if(c < ' ' && c != '\t') {
+          return http_parser_fail(parser, "Invalid character in trailer");
+        }
+        else if(++parser->skipped > HTTP_PARSER_MAX_TRAILERS) {
+          return http_parser_fail(parser, "Trailers too large");
+        }
+        break;
+
+      case HTTP_PARSER_TRAILER_LF:
+        if(c != '\n') return http_parser_fail(parser, "Expected LF after CR");
+        parser->state = HTTP_PARSER_TRAILER_START;
+        break;
+
+      case HTTP_PARSER_TRAILERS_END_LF:
+        if(c != '\n') return http_parser_fail(parser, "Expected LF after CR");
+        return http_parser_end_chunks(parser);
+
+      case HTTP_PARSER_DONE:
+        return HTTP_PARSE_COMPLETE;
+
+      case HTTP_PARSER_ERROR:
+        return HTTP_PARSE_ERROR;
+    }
+    parser->pos += 1;
+  }
+
+  switch(parser->state) {
+    case HTTP_PARSER_DONE:  return HTTP_PARSE_COMPLETE;
+    case HTTP_PARSER_ERROR: return HTTP_PARSE_ERROR;
+    default:                return HTTP_PARSE_INCOMPLETE;
+  }
+}
+
+const HttpParserHeader* http_parser_find_header(const HttpParser* parser,
+                                                const char* buf, const char* name)
+{
+  const size_t name_len = strlen(name);
+  const enum EHttpHeader id = http_header_lookup(name, name_len);
+  if(id != HTTP_HEADER_UNKNOWN) return http_parser_known_header(parser, id);
+  for(size_t i=0; i<parser->num_headers; ++i) {
+    if(span_equals_nocase(buf, parser->headers[i].name, name)) {
+      return &parser->headers[i];
+    }
+  }
+  return NULL;
+}
+
+const HttpParserHeader* http_parser_known_header(const HttpParser* parser,
+                                                 enum EHttpHeader id)
+{
+  const uint8_t slot = parser->header_index[id];
+  return (slot ? &parser->headers[slot - 1] : NULL);
+}
@@ -0,0 +1,165 @@
+//==============================================================================
+// Incremental HTTP request parser
+//
+// HttpParser is a byte-oriented state machine. It's pointed at a buffer that
+// holds the request received so far (starting at buf[0]), and picks up where
+// it stopped last time, so bytes that have already been looked at are never
+// scanned again. Feed it again each time more bytes are appended, however the
+// request happens to be split up on the wire.
+//
+// Everything the parser records is an offset into that buffer rather than a
+// pointer, so the buffer is free to move (e.g. be realloc'd) between calls.
+//
+// A body is framed by Content-Length, or sent in chunks. Either way it's handed
+// over a piece at a time, as it arrives: the caller takes each piece and may
+// then drop everything parsed so far from its buffer, so a body of any size
+// goes through a buffer of fixed size. Chunked bodies are decoded, so the
+// pieces are just the data. Chunk extensions and trailer fields are skipped.
+//
+// A request with a Transfer-Encoding must have chunked as its last coding, or
+// there's no telling where its body ends, and it's rejected. One with other
+// codings before that is rejected too, with 'not_implemented' set: we don't
+// decode them. One with both Transfer-Encoding and Content-Length is rejected,
+// since that's how requests are smuggled past a proxy.
+//==============================================================================
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "http_enums.h"
+
+// Requests with more headers than this are rejected. Must fit in header_index.
+#define HTTP_PARSER_MAX_HEADERS 100
+
+// Chunk extensions and trailers are skipped, but not forever: requests with a
+// longer extension on any one chunk-size line, or more bytes of trailers than
+// this, are rejected
+#define HTTP_PARSER_MAX_CHUNK_EXT (8 * 1024)
+#define HTTP_PARSER_MAX_TRAILERS  (8 * 1024)
+
+//==============================================================================
+// Parser states and results
+//==============================================================================
+enum EHttpParserState {
+  HTTP_PARSER_REQUEST_START,      // Before the request line (skipping blank lines)
+  HTTP_PARSER_METHOD,             // In the method
+  HTTP_PARSER_URI_START,          // Before the URI
+  HTTP_PARSER_URI,                // In the URI
+  HTTP_PARSER_VERSION_START,      // Before the HTTP version
+  HTTP_PARSER_VERSION,            // In the HTTP version
+  HTTP_PARSER_REQUEST_LINE_END,   // After the version, before the line ending
+  HTTP_PARSER_REQUEST_LINE_LF,    // Got CR at the end of the request line
+  HTTP_PARSER_HEADER_START,       // At the start of a header line
+  HTTP_PARSER_HEADER_NAME,        // In a header name
+  HTTP_PARSER_HEADER_VALUE_START, // After the colon, before the value
+  HTTP_PARSER_HEADER_VALUE,       // In a header value
+  HTTP_PARSER_HEADER_LINE_LF,     // Got CR at the end of a header line
+  HTTP_PARSER_HEADERS_END_LF,     // Got CR on the blank line ending the headers
+  HTTP_PARSER_BODY,               // In a body framed by Content-Length
+  HTTP_PARSER_CHUNK_START,        // At the start of a chunk-size line
+  HTTP_PARSER_CHUNK_SIZE,         // In a chunk size
+  HTTP_PARSER_CHUNK_EXT,          // In chunk extensions, which are skipped
+  HTTP_PARSER_CHUNK_SIZE_LF,      // Got CR at the end of a chunk-size line
+  HTTP_PARSER_CHUNK_DATA,         // In a chunk's data
+  HTTP_PARSER_CHUNK_DATA_END,     // After a chunk's data, before its line ending
+  HTTP_PARSER_CHUNK_DATA_LF,      // Got CR after a chunk's data
+  HTTP_PARSER_TRAILER_START,      // At the start of a trailer line, after the last chunk
+  HTTP_PARSER_TRAILER,            // In a trailer field, which is skipped
+  HTTP_PARSER_TRAILER_LF,         // Got CR at the end of a trailer line
+  HTTP_PARSER_TRAILERS_END_LF,    // Got CR on the blank line ending the trailers
+  HTTP_PARSER_DONE,               // Request complete
+  HTTP_PARSER_ERROR               // Malformed request; see HttpParser::error
+};
+
+enum EHttpParseResult {
+  HTTP_PARSE_INCOMPLETE,        // Need more data
+  HTTP_PARSE_HEADERS_COMPLETE,  // Headers parsed, body still to come
+  HTTP_PARSE_BODY,              // Found a piece of the body, with more to come
+  HTTP_PARSE_COMPLETE,          // Whole request parsed
+  HTTP_PARSE_ERROR              // Malformed request
+};
+
+//==============================================================================
+// HttpParser
+//==============================================================================
+// A run of bytes in the request buffer
+typedef struct HttpSpan {
+  size_t off;  // Offset from the start of the request
+  size_t len;  // Number of bytes
+} HttpSpan;
+
+typedef struct HttpParserHeader {
+  HttpSpan         name;   // Header name, as sent
+  HttpSpan         value;  // Value, without surrounding whitespace
+  enum EHttpHeader id;     // Which well-known header it is, if any
+} HttpParserHeader;
+
+typedef struct HttpParser {
+  enum EHttpParserState state;   // Where the parser stopped
+  size_t            pos;         // Bytes of the request consumed so far
+  size_t            mark;        // Start of the token being parsed
+  HttpSpan          header_name; // Name of the header being parsed
+  enum EHttpMethod  method;      // Request method
+  enum EHttpVersion version;     // HTTP version
+  HttpSpan          method_span; // Method, as sent
+  HttpSpan          uri;         // Request URI
+  HttpSpan          version_span;  // HTTP version, as sent
+  HttpParserHeader* headers;     // Headers, in the order they were sent
+  size_t            num_headers; // Number of headers
+  size_t            header_cap;  // Capacity of the headers array
+  uint8_t           header_index[HTTP_HEADER_COUNT];  // For each well-known
+                                 //   header, 1 + the index of its first
+                                 //   occurrence in 'headers', or 0 if absent
+  size_t            header_len;  // Length of the request line and headers
+  bool              has_content_length;  // Was there a Content-Length header?
+  size_t            content_length;      // Its value
+  bool              has_transfer_encoding;  // Was there a Transfer-Encoding header?
+  bool              chunked;     // Is chunked the last coding so far?
+  bool              other_coding;  // Was any other coding applied?
+  uint64_t          chunk_left;  // Data still to come in the current chunk
+  size_t            skipped;     // Bytes skipped of the current chunk extension,
+                                 //   or of the trailers
+  uint64_t          body_received;  // Body bytes found so far, after decoding
+  HttpSpan          body;        // Piece of the body found by the last call
+  const char*       error;       // Why the request was rejected
+  bool              not_implemented;  // Was it well-formed, but asked for something
+                                 //   we don't support?
+} HttpParser;
+
+// Initialize or free a parser
+void http_parser_init(HttpParser* parser);
+void http_parser_free(HttpParser* parser);
+
+// Get ready for the next request. Keeps the headers array for reuse.
+void http_parser_reset(HttpParser* parser);
+
+// Parse the request in buf[0, len), resuming at parser->pos.
+// - Returns HTTP_PARSE_HEADERS_COMPLETE once, when the headers are done and a
+//   body follows. Call again to parse the body.
+// - In the body, each call stops after the next piece of it, which is in
+//   parser->body. HTTP_PARSE_BODY means there's more to come. With
+//   HTTP_PARSE_COMPLETE, the piece (which may be empty) is the last of it.
+// - Once complete, parser->pos is the length of the request. Anything after it
+//   belongs to the next request.
+enum EHttpParseResult http_parser_execute(HttpParser* parser, const char* buf, size_t len);
+
+// The caller has dropped the first 'len' bytes of the buffer, which the parser
+// has already been through (len <= parser->pos). Only allowed in the body, once
+// the headers and the last piece found are done with: their spans are cleared.
+void http_parser_consume(HttpParser* parser, size_t len);
+
+// Has the parser finished the headers and started on the body?
+bool http_parser_in_body(const HttpParser* parser);
+
+// Find the first header with the given name (case-insensitive). NULL if none.
+const HttpParserHeader* http_parser_find_header(const HttpParser* parser,
+                                                const char* buf, const char* name);
+
+// Find the first occurrence of a well-known header, in constant time. NULL if
+// there isn't one.
+const HttpParserHeader* http_parser_known_header(const HttpParser* parser,
+                                                 enum EHttpHeader id);
+
+#endif // HTTP_PARSER_H
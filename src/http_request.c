@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdarg.h>
 #include "utils.h"
 
@@ -38,15 +39,232 @@ void http_header_set_value(HttpHeader* header, const char* value) {
   strcpy(header->value, value);
 }
 
+bool http_header_value_has_token(const char* value, size_t len, const char* token) {
+  // Compare each comma-separated element, ignoring surrounding whitespace
+  const char* value_end = value + len;
+  const size_t token_len = strlen(token);
+  while(value < value_end) {
+    while(value < value_end && (*value == ' ' || *value == '\t' || *value == ',')) ++value;
+    const char* end = value;
+    while(end < value_end && *end != ',') ++end;
+    const char* last = end;
+    while(last > value && (last[-1] == ' ' || last[-1] == '\t')) --last;
+    if((size_t)(last - value) == token_len && !strncasecmp(value, token, token_len)) {
+      return true;
+    }
+    value = end;
+  }
+  return false;
+}
+
+//==============================================================================
+// HttpAcceptEncoding
+//==============================================================================
+// Parse a q-value: "0" or "1", optionally followed by '.' and up to three
+// digits. Returns it in thousandths, or -1 if it's malformed.
+static int http_qvalue_parse(const char* str, size_t len) {
+  if(len == 0 || (str[0] != '0' && str[0] != '1')) return -1;
+  int q = (str[0] - '0') * 1000;
+  if(len == 1) return q;
+  if(str[1] != '.' || len > 5) return -1;
+  int scale = 100;
+  for(size_t i=2; i<len; ++i) {
+    if(str[i] < '0' || str[i] > '9') return -1;
+    q += (str[i] - '0') * scale;
+    scale /= 10;
+  }
+  return (q > 1000 ? -1 : q);
+}
+
+static bool http_is_space(char c) {
+  return c == ' ' || c == '\t';
+}
+
+void http_accept_encoding_parse(HttpAcceptEncoding* accept, const char* value, size_t len) {
+  // Q-values of the codings that are listed, or -1
+  int listed[HTTP_ENCODING_COUNT];
+  for(int i=0; i<HTTP_ENCODING_COUNT; ++i) listed[i] = -1;
+  int star = -1;
+
+  // Each element is a coding, then parameters after semicolons
+  const char* end = value + len;
+  while(value && value < end) {
+    while(value < end && (http_is_space(*value) || *value == ',')) ++value;
+    const char* elem_end = value;
+    while(elem_end < end && *elem_end != ',') ++elem_end;
+    const char* name_end = value;
+    while(name_end < elem_end && *name_end != ';' && !http_is_space(*name_end)) ++name_end;
+
+    int q = 1000;
+    for(const char* p = name_end; p < elem_end; ) {
+      while(p < elem_end && *p != ';') ++p;
+      if(p == elem_end) break;
+      ++p;
+      while(p < elem_end && http_is_space(*p)) ++p;
+      const char* param_end = p;
+      while(param_end < elem_end && *param_end != ';') ++param_end;
+      const char* last = param_end;
+      while(last > p && http_is_space(last[-1])) --last;
+      if(last - p >= 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+        q = http_qvalue_parse(p + 2, last - p - 2);
+      }
+      p = param_end;
+    }
+
+    if(q >= 0 && name_end > value) {
+      if(name_end - value == 1 && *value == '*') {
+        star = q;
+      }
+      else {
+        listed[http_encoding_lookup(value, name_end - value)] = q;
+      }
+    }
+    value = elem_end;
+  }
+
+  accept->q[HTTP_ENCODING_UNKNOWN] = 0;
+  for(int i=HTTP_ENCODING_UNKNOWN+1; i<HTTP_ENCODING_COUNT; ++i) {
+    accept->q[i] = (listed[i] >= 0 ? listed[i] : (star >= 0 ? star : 0));
+  }
+  if(listed[HTTP_ENCODING_IDENTITY] < 0 && star < 0) accept->q[HTTP_ENCODING_IDENTITY] = 1;
+}
+
+enum EHttpEncoding http_accept_encoding_choose(const HttpAcceptEncoding* accept,
+                                               unsigned available)
+{
+  static const enum EHttpEncoding PREFERENCE[] = {
+    HTTP_ENCODING_BR, HTTP_ENCODING_GZIP, HTTP_ENCODING_IDENTITY
+  };
+  available |= (1u << HTTP_ENCODING_IDENTITY);
+  enum EHttpEncoding best = HTTP_ENCODING_UNKNOWN;
+  unsigned best_q = 0;
+  for(size_t i=0; i<sizeof(PREFERENCE)/sizeof(PREFERENCE[0]); ++i) {
+    const enum EHttpEncoding encoding = PREFERENCE[i];
+    if((available & (1u << encoding)) && accept->q[encoding] > best_q) {
+      best = encoding;
+      best_q = accept->q[encoding];
+    }
+  }
+  return best;
+}
+
+//==============================================================================
+// Entity tags
+//==============================================================================
+bool http_etag_list_match(const char* value, size_t len, const char* etag) {
+  if(etag[0] == 'W' && etag[1] == '/') etag += 2;
+  const size_t etag_len = strlen(etag);
+  const char* end = value + len;
+  while(value < end) {
+    while(value < end && (http_is_space(*value) || *value == ',')) ++value;
+    if(value == end) break;
+    if(*value == '*') return true;
+
+    // An entity tag is an opaque string in quotes, optionally weak
+    if(end - value >= 2 && value[0] == 'W' && value[1] == '/') value += 2;
+    if(value == end || *value != '"') return false;
+    const char* close = memchr(value + 1, '"', end - value - 1);
+    if(!close) return false;
+    const size_t tag_len = close + 1 - value;
+    if(tag_len == etag_len && !memcmp(value, etag, etag_len)) return true;
+    value = close + 1;
+  }
+  return false;
+}
+
+//==============================================================================
+// Byte ranges
+//==============================================================================
+// Parse the decimal number at *p, before 'end', and advance past it. Returns
+// false if there are no digits. Numbers too big for 64 bits are capped, since
+// they're past the end of any file anyway.
+static bool http_range_number(const char** p, const char* end, uint64_t* n) {
+  const char* start = *p;
+  *n = 0;
+  for(; *p < end && **p >= '0' && **p <= '9'; ++*p) {
+    const uint64_t digit = **p - '0';
+    *n = (*n > (UINT64_MAX - digit) / 10 ? UINT64_MAX : *n * 10 + digit);
+  }
+  return *p > start;
+}
+
+int http_range_parse(const char* value, size_t len, uint64_t size, HttpRange* ranges, int max) {
+  const char* end = value + len;
+  while(value < end && http_is_space(*value)) ++value;
+  if(end - value < 6 || strncasecmp(value, "bytes=", 6)) return -1;
+  value += 6;
+
+  // Each element is "first-last", "first-" or "-suffix_length"
+  int count = 0;
+  int listed = 0;
+  while(value < end) {
+    while(value < end && (http_is_space(*value) || *value == ',')) ++value;
+    if(value == end) break;
+    uint64_t first, last, suffix;
+    const bool has_first = http_range_number(&value, end, &first);
+    if(value == end || *value != '-') return -1;
+    ++value;
+    const bool has_last = http_range_number(&value, end, &last);
+    while(value < end && http_is_space(*value)) ++value;
+    if(value < end && *value != ',') return -1;
+    if(!has_first && !has_last) return -1;
+    if(has_first && has_last && last < first) return -1;
+    if(++listed > max) return -1;
+
+    if(!has_first) {
+      suffix = last;
+      if(suffix == 0 || size == 0) continue;
+      first = (suffix < size ? size - suffix : 0);
+      last = size - 1;
+    }
+    else {
+      if(first >= size) continue;
+      if(!has_last || last >= size) last = size - 1;
+    }
+    ranges[count].first = first;
+    ranges[count].last = last;
+    ++count;
+  }
+  if(listed == 0) return -1;
+
+  // Sort by first byte (there are only a few), then merge neighbours
+  for(int i=1; i<count; ++i) {
+    const HttpRange range = ranges[i];
+    int j = i;
+    for(; j > 0 && ranges[j - 1].first > range.first; --j) ranges[j] = ranges[j - 1];
+    ranges[j] = range;
+  }
+  int merged = 0;
+  for(int i=0; i<count; ++i) {
+    if(merged > 0 && ranges[i].first <= ranges[merged - 1].last + 1) {
+      if(ranges[i].last > ranges[merged - 1].last) ranges[merged - 1].last = ranges[i].last;
+    }
+    else {
+      ranges[merged++] = ranges[i];
+    }
+  }
+  return merged;
+}
+
 //==============================================================================
 // HttpRequest: private utility functions
 //==============================================================================
 // Size of HttpRequest::error string buffer
 #define HTTP_REQUEST_ERROR_BUFLEN 256
 
+// Allocate memory for one of the request's fields, from its arena if it has one
+static void* http_request_alloc(HttpRequest* request, size_t size) {
+  return (request->arena ? arena_alloc(request->arena, size) : malloc(size));
+}
+
+// Free memory from http_request_alloc(). Arena memory is left for the arena.
+static void http_request_release(HttpRequest* request, void* ptr) {
+  if(!request->arena) free(ptr);
+}
+
 // Set the error message
 void set_error_message(HttpRequest* request, const char* format, ...) {
-  if(!request->error) request->error = malloc(HTTP_REQUEST_ERROR_BUFLEN);
+  if(!request->error) request->error = http_request_alloc(request, HTTP_REQUEST_ERROR_BUFLEN);
   va_list args;
   va_start(args, format);
   vsnprintf(request->error, HTTP_REQUEST_ERROR_BUFLEN, format, args);
@@ -65,6 +283,10 @@ void clear_error_message(HttpRequest* request) {
 // HttpRequest
 //==============================================================================
 void http_request_init(HttpRequest* request) {
+  http_request_init_arena(request, NULL);
+}
+
+void http_request_init_arena(HttpRequest* request, Arena* arena) {
   request->version = HTTP_VERSION_UNKNOWN;
   request->method = HTTP_METHOD_UNKNOWN;
   request->uri = 0;
@@ -73,9 +295,14 @@ void http_request_init(HttpRequest* request) {
   request->headers = 0;
   request->body = 0;
   request->error = 0;
+  request->arena = arena;
 }
 
 void http_request_free(HttpRequest* request) {
+  if(request->arena) {
+    http_request_init_arena(request, request->arena);
+    return;
+  }
   if(request->headers) {
     for(size_t i=0; i<request->num_headers; ++i) {
       http_header_free(&request->headers[i]);
@@ -95,7 +322,12 @@ HttpHeader* http_request_add_header(HttpRequest* request) {
     const size_t newsize = (request->num_headers ? request->num_headers * 2 : 4);
 
     // Allocate or reallocate memory
-    if(request->headers) {
+    if(request->arena) {
+      request->headers = arena_realloc(request->arena, request->headers,
+                                       sizeof(HttpHeader) * request->header_cap,
+                                       sizeof(HttpHeader) * newsize);
+    }
+    else if(request->headers) {
       request->headers = realloc(request->headers, sizeof(HttpHeader) * newsize);
     }
     else {
@@ -116,11 +348,43 @@ HttpHeader* http_request_add_header(HttpRequest* request) {
 
 void http_request_pop_header(HttpRequest* request) {
   if(request->num_headers > 0) {
-    http_header_free(&request->headers[request->num_headers-1]);
+    HttpHeader* header = &request->headers[request->num_headers-1];
+    if(request->arena) http_header_init(header);
+    else               http_header_free(header);
     request->num_headers -= 1;
   }
 }
 
+char* http_request_strndup(HttpRequest* request, const char* str, size_t len) {
+  char* copy = http_request_alloc(request, len + 1);
+  memcpy(copy, str, len);
+  copy[len] = 0;
+  return copy;
+}
+
+const char* http_request_get_header(const HttpRequest* request, const char* key) {
+  for(size_t i=0; i<request->num_headers; ++i) {
+    if(request->headers[i].key && !strcasecmp(request->headers[i].key, key)) {
+      return request->headers[i].value;
+    }
+  }
+  return NULL;
+}
+
+bool http_request_header_has_token(const HttpRequest* request, const char* key,
+                                   const char* token)
+{
+  const char* value = http_request_get_header(request, key);
+  return value && http_header_value_has_token(value, strlen(value), token);
+}
+
+bool http_request_keep_alive(const HttpRequest* request) {
+  if(request->version == HTTP_VERSION_1_1) {
+    return !http_request_header_has_token(request, "Connection", "close");
+  }
+  return http_request_header_has_token(request, "Connection", "keep-alive");
+}
+
 // Parse the HTTP request line
 // Format:  Method SP Request-URI SP HTTP-Version CRLF
 // Example: GET / HTTP/1.1
@@ -145,7 +409,7 @@ bool http_request_parse_request_line(HttpRequest* request, char* line) {
     set_error_message(request, "Error parsing HTTP header line: didn't find request URI (token 2)");
     return false;
   }
-  request->uri = strdup(token);
+  request->uri = http_request_strndup(request, token, strlen(token));
 
   // Token 3: HTTP version
   token = trim(strsep(&line, " "));
@@ -154,7 +418,7 @@ bool http_request_parse_request_line(HttpRequest* request, char* line) {
     return false;
   }
   request->version = http_version_from_string(token);
-  if(request->method == HTTP_VERSION_UNKNOWN) {
+  if(request->version == HTTP_VERSION_UNKNOWN) {
     set_error_message(request, "Unrecognized HTTP version \"%s\"\n", token);
     return false;
   }
@@ -177,8 +441,8 @@ bool http_request_parse_header_line(HttpRequest* request, char* line) {
   const char* value = trim(line);
 
   // Store key and value
-  http_header_set_key(header, key);
-  http_header_set_value(header, value);
+  header->key = http_request_strndup(request, key, strlen(key));
+  header->value = http_request_strndup(request, value, strlen(value));
   return true;
 }
 
@@ -190,7 +454,7 @@ bool http_request_parse(HttpRequest* request, const char* text) {
   http_request_free(request);
 
   // Copy the text
-  char* textcopy = strdup(text);
+  char* textcopy = http_request_strndup(request, text, strlen(text));
   char* textcopy_start = textcopy;
 
   // Parse the HTTP request line (the first line): HTTP method, URI, version
@@ -219,14 +483,11 @@ bool http_request_parse(HttpRequest* request, const char* text) {
 
   // Store the remaining text as the body
   if(textcopy && textcopy[0]) {
-    const size_t textlen = strlen(textcopy);
-    request->body = malloc(textlen + 1);
-    memcpy(request->body, textcopy, textlen + 1);
-    request->body[textlen] = 0;
+    request->body = http_request_strndup(request, textcopy, strlen(textcopy));
   }
 
   // Clean up our copy of the text
-  free(textcopy_start);
+  http_request_release(request, textcopy_start);
 
   // Return success if there was no error
   return !request->error;
@@ -8,7 +8,9 @@
 #define HTTP_REQUEST_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include "arena.h"
 #include "http_enums.h"
 
 //==============================================================================
@@ -27,6 +29,63 @@ void http_header_free(HttpHeader* header);
 void http_header_set_key  (HttpHeader* header, const char* key);
 void http_header_set_value(HttpHeader* header, const char* value);
 
+// Does a header value, 'len' bytes long, contain 'token' in its comma-separated
+// list of elements (case-insensitive)?
+bool http_header_value_has_token(const char* value, size_t len, const char* token);
+
+//==============================================================================
+// Content codings a client accepts, from its Accept-Encoding header
+//==============================================================================
+typedef struct HttpAcceptEncoding {
+  unsigned short q[HTTP_ENCODING_COUNT];  // Each coding's q-value, in thousandths
+} HttpAcceptEncoding;
+
+// Parse an Accept-Encoding header value, 'len' bytes long. Pass NULL for a
+// request without one, which gets identity.
+// - A coding that isn't listed gets the q-value of "*", if that's listed.
+//   Otherwise it's not acceptable, except for identity, which is acceptable
+//   unless excluded, but less so than anything listed.
+// - Unknown codings and elements with a malformed q-value are ignored.
+void http_accept_encoding_parse(HttpAcceptEncoding* accept, const char* value, size_t len);
+
+// Pick the coding to respond with, out of identity and those in 'available', a
+// bitmask of (1 << EHttpEncoding) values. The highest q-value wins, and ties
+// go to the smallest encoding: br, then gzip, then identity. Returns
+// HTTP_ENCODING_UNKNOWN if none of them is acceptable.
+enum EHttpEncoding http_accept_encoding_choose(const HttpAcceptEncoding* accept,
+                                               unsigned available);
+
+//==============================================================================
+// Entity tags, as in If-None-Match
+//==============================================================================
+// Does an If-None-Match or If-Match value, 'len' bytes long, list 'etag', or
+// is it "*"? 'etag' is quoted, as sent in an ETag header. The comparison is
+// weak: a W/ prefix on either side is ignored. Parsing stops at anything
+// malformed, matching nothing after it.
+bool http_etag_list_match(const char* value, size_t len, const char* etag);
+
+//==============================================================================
+// Byte ranges, as in a Range header
+//==============================================================================
+// Most ranges served in one response. A request for more is answered with the
+// whole representation instead, so that it can't make us send many tiny parts.
+#define HTTP_RANGES_MAX 16
+
+typedef struct HttpRange {
+  uint64_t first;  // Offset of the first byte
+  uint64_t last;   // Offset of the last byte, inclusive
+} HttpRange;
+
+// Parse a Range header value, 'len' bytes long, against a representation of
+// 'size' bytes, filling in up to 'max' ranges.
+// - Each range is clipped to the representation, and ones that start past its
+//   end are dropped. What's left is sorted, and ranges that overlap or touch
+//   are merged.
+// - Returns the number of ranges, or 0 if none of them is satisfiable.
+// - Returns -1 if the header should be ignored: it's malformed, its unit
+//   isn't "bytes", or it lists more than 'max' ranges.
+int http_range_parse(const char* value, size_t len, uint64_t size, HttpRange* ranges, int max);
+
 //==============================================================================
 // Struct containing all info from an HTTP request
 //==============================================================================
@@ -39,6 +98,7 @@ typedef struct HttpRequest {
   HttpHeader*       headers;      // Array of headers
   char*             body;         // Request body
   char*             error;        // Error message set by some functions
+  Arena*            arena;        // Where the above come from (NULL: malloc)
 } HttpRequest;
 
 // Initialize or free the struct's fields
@@ -46,17 +106,39 @@ typedef struct HttpRequest {
 void http_request_init(HttpRequest* request);
 void http_request_free(HttpRequest* request);
 
+// Initialize the struct to allocate everything from 'arena'. Freeing it then
+// just forgets its fields; the memory is reclaimed when the arena is reset.
+void http_request_init_arena(HttpRequest* request, Arena* arena);
+
 // Parse the request and populated the struct's fields
 // - Will modify the input string
 // - Returns true on success and false on failure
 // - On failure, it will set the HttpRequest::error buffer
 bool http_request_parse(HttpRequest* request, const char* text);
 
+// Get the value of the first header with the given key (case-insensitive).
+// - Returns NULL if there's no such header.
+const char* http_request_get_header(const HttpRequest* request, const char* key);
+
+// Does the header with the given key contain 'token' in its comma-separated
+// list of values (case-insensitive)? E.g. "Connection: keep-alive, Upgrade".
+bool http_request_header_has_token(const HttpRequest* request, const char* key,
+                                   const char* token);
+
+// Does the client want the connection kept open after the response?
+// - HTTP/1.1 connections persist unless the client sends "Connection: close".
+// - HTTP/1.0 connections close unless the client sends "Connection: keep-alive".
+bool http_request_keep_alive(const HttpRequest* request);
+
 // Add or remove a header. Acts on the end of the headers array.
 // - You probably won't need to use these. They're mainly for internal use.
 HttpHeader* http_request_add_header(HttpRequest* request);
 void        http_request_pop_header(HttpRequest* request);
 
+// Copy 'len' bytes of 'str' into a new null-terminated string, allocated the
+// same way as the request's own fields
+char* http_request_strndup(HttpRequest* request, const char* str, size_t len);
+
 // Print an HttpRequest to stdout. For debugging.
 void http_request_print(HttpRequest* request);
 
@@ -0,0 +1,89 @@
+#include "http_request_view.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+//==============================================================================
+// Private utility functions
+//==============================================================================
+// Copy a span into a new null-terminated string belonging to 'request'
+static char* http_request_view_strdup(const HttpRequestView* view, HttpRequest* request,
+                                      HttpSpan span)
+{
+  return http_request_strndup(request, view->buf + span.off, span.len);
+}
+
+//==============================================================================
+// HttpRequestView
+//==============================================================================
+void http_request_view_init(HttpRequestView* view, const HttpParser* parser,
+                            const char* buf)
+{
+  view->buf = buf;
+  view->method = parser->method;
+  view->version = parser->version;
+  view->uri = parser->uri;
+  view->headers = parser->headers;
+  view->num_headers = parser->num_headers;
+  view->header_index = parser->header_index;
+  view->body = parser->body;
+}
+
+const char* http_request_view_ptr(const HttpRequestView* view, HttpSpan span) {
+  return view->buf + span.off;
+}
+
+bool http_request_view_get_header(const HttpRequestView* view, const char* name,
+                                  HttpSpan* value)
+{
+  const size_t name_len = strlen(name);
+  const enum EHttpHeader id = http_header_lookup(name, name_len);
+  if(id != HTTP_HEADER_UNKNOWN) return http_request_view_find_header(view, id, value);
+  for(size_t i=0; i<view->num_headers; ++i) {
+    const HttpSpan key = view->headers[i].name;
+    if(key.len == name_len && !strncasecmp(view->buf + key.off, name, name_len)) {
+      *value = view->headers[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool http_request_view_find_header(const HttpRequestView* view, enum EHttpHeader id,
+                                   HttpSpan* value)
+{
+  const uint8_t slot = view->header_index[id];
+  if(!slot) return false;
+  *value = view->headers[slot - 1].value;
+  return true;
+}
+
+bool http_request_view_header_has_token(const HttpRequestView* view, enum EHttpHeader id,
+                                        const char* token)
+{
+  HttpSpan value;
+  return http_request_view_find_header(view, id, &value) &&
+         http_header_value_has_token(view->buf + value.off, value.len, token);
+}
+
+bool http_request_view_keep_alive(const HttpRequestView* view) {
+  if(view->version == HTTP_VERSION_1_1) {
+    return !http_request_view_header_has_token(view, HTTP_HEADER_CONNECTION, "close");
+  }
+  return http_request_view_header_has_token(view, HTTP_HEADER_CONNECTION, "keep-alive");
+}
+
+void http_request_view_copy(const HttpRequestView* view, HttpRequest* request) {
+  http_request_free(request);
+  request->method = view->method;
+  request->version = view->version;
+  request->uri = http_request_view_strdup(view, request, view->uri);
+  for(size_t i=0; i<view->num_headers; ++i) {
+    HttpHeader* header = http_request_add_header(request);
+    header->key = http_request_view_strdup(view, request, view->headers[i].name);
+    header->value = http_request_view_strdup(view, request, view->headers[i].value);
+  }
+  if(view->body.len > 0) {
+    request->body = http_request_view_strdup(view, request, view->body);
+  }
+}
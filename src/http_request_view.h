@@ -0,0 +1,64 @@
+//==============================================================================
+// HttpRequestView: a parsed request that points into the receive buffer
+//
+// HttpRequest copies every field into its own allocation. A view instead
+// describes the method, URI, version, headers and body as (offset, length)
+// spans into the buffer the request was parsed from, so handling a request
+// costs no allocations at all. The spans aren't null-terminated; use their
+// lengths.
+//
+// A view borrows from both the buffer and the parser that filled it in. It's
+// valid until either of them changes, e.g. until the request is consumed from
+// the connection's input buffer or the parser is reset.
+//==============================================================================
+#ifndef HTTP_REQUEST_VIEW_H
+#define HTTP_REQUEST_VIEW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "http_enums.h"
+#include "http_parser.h"
+#include "http_request.h"
+
+typedef struct HttpRequestView {
+  const char*             buf;          // Start of the request
+  enum EHttpMethod        method;       // HTTP method
+  enum EHttpVersion       version;      // HTTP version
+  HttpSpan                uri;          // URI of resource
+  const HttpParserHeader* headers;      // Headers, owned by the parser
+  size_t                  num_headers;  // Number of headers
+  const uint8_t*          header_index; // Slot per well-known header: 1 + its
+                                        //   index in 'headers', or 0 if absent
+  HttpSpan                body;         // Body the parser last handed over (may be empty)
+} HttpRequestView;
+
+// Describe the request the parser found in 'buf'
+void http_request_view_init(HttpRequestView* view, const HttpParser* parser,
+                            const char* buf);
+
+// Get a pointer to the bytes of a span
+const char* http_request_view_ptr(const HttpRequestView* view, HttpSpan span);
+
+// Find the value of the first header with the given name (case-insensitive).
+// - Returns false if there's no such header.
+bool http_request_view_get_header(const HttpRequestView* view, const char* name,
+                                  HttpSpan* value);
+
+// Same, for a well-known header. Takes constant time.
+bool http_request_view_find_header(const HttpRequestView* view, enum EHttpHeader id,
+                                   HttpSpan* value);
+
+// Does the well-known header contain 'token' in its comma-separated list of
+// values (case-insensitive)?
+bool http_request_view_header_has_token(const HttpRequestView* view, enum EHttpHeader id,
+                                        const char* token);
+
+// Does the client want the connection kept open after the response? Same rules
+// as http_request_keep_alive().
+bool http_request_view_keep_alive(const HttpRequestView* view);
+
+// Copy the request into an HttpRequest, which owns its own strings
+void http_request_view_copy(const HttpRequestView* view, HttpRequest* request);
+
+#endif // HTTP_REQUEST_VIEW_H
@@ -7,13 +7,24 @@ struct HttpResponse {
   char*  buf;     // Character buffer
   size_t buflen;  // Size of character buffer
   size_t txtlen;  // Length of string stored withing character buffer
+  Arena* arena;   // Where the struct and buffer come from (NULL: malloc)
 };
 
 // This helper function ensures that there is room for at least 'len' characters
 // within the character buffer (excluding the null terminator). If not, it will
 // reallocate space.
 void http_response_ensure_space_for(HttpResponse* res, size_t len) {
-  if(res->buf == NULL) {
+  if(res->arena) {
+    const size_t available = (res->buf ? res->buflen - res->txtlen - 1 : 0);
+    if(!res->buf || available < len) {
+      size_t new_buflen = res->buflen * 2;
+      if(new_buflen < res->txtlen + len + 1) new_buflen = res->txtlen + len + 1;
+      res->buf = arena_realloc(res->arena, res->buf, res->buflen, new_buflen);
+      bzero(res->buf + res->txtlen, new_buflen - res->txtlen);
+      res->buflen = new_buflen;
+    }
+  }
+  else if(res->buf == NULL) {
     res->buf = malloc(len + 1);
     res->buflen = len + 1;
     bzero(res->buf, len + 1);
@@ -35,17 +46,28 @@ HttpResponse* http_response_new() {
   res->buf = 0;
   res->buflen = 0;
   res->txtlen = 0;
+  res->arena = 0;
+  return res;
+}
+
+HttpResponse* http_response_new_arena(Arena* arena) {
+  HttpResponse* res = arena_alloc(arena, sizeof(HttpResponse));
+  res->buf = 0;
+  res->buflen = 0;
+  res->txtlen = 0;
+  res->arena = arena;
   return res;
 }
 
 void http_response_free(HttpResponse* res) {
+  if(res->arena) return;
   if(res->buf) free(res->buf);
   free(res);
 }
 
 void http_response_clear(HttpResponse* res) {
   if(res->buf) {
-    free(res->buf);
+    if(!res->arena) free(res->buf);
     res->buf = NULL;
     res->buflen = 0;
     res->txtlen = 0;
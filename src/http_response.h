@@ -10,11 +10,14 @@
 // If you set a body, make sure you set the Content-Length header! This struct
 // is fairly simple and won't set it for you.
 //
+// The server itself uses HttpResponseBuilder, which doesn't copy the body.
+//
 // Evan Kuhn 2012-09-26
 //==============================================================================
 #ifndef HTTP_RESPONSE_H
 #define HTTP_RESPONSE_H
 
+#include "arena.h"
 #include "http_enums.h"
 #include <string.h>
 
@@ -24,6 +27,10 @@ typedef struct HttpResponse HttpResponse;
 // - Caller must free it via http_response_free
 HttpResponse* http_response_new();
 
+// Same, but take all memory from 'arena'. Freeing the response is then a
+// no-op; the memory is reclaimed when the arena is reset.
+HttpResponse* http_response_new_arena(Arena* arena);
+
 // Free an HttpResponse object and its internal resources
 void http_response_free(HttpResponse* res);
 
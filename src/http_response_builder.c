@@ -0,0 +1,105 @@
+#include "http_response_builder.h"
+#include "utils.h"
+#include <string.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Initial size of the head. Enough for the server's usual headers.
+static const size_t HTTP_RESPONSE_HEAD_SIZE = 256;
+
+//==============================================================================
+// Private utility functions
+//==============================================================================
+// Make room for 'len' more bytes in the head
+static void http_response_builder_reserve(HttpResponseBuilder* builder, size_t len) {
+  if(builder->head_cap - builder->head_len >= len) return;
+  size_t cap = (builder->head_cap ? builder->head_cap * 2 : HTTP_RESPONSE_HEAD_SIZE);
+  while(cap - builder->head_len < len) cap *= 2;
+  builder->head = arena_realloc(builder->arena, builder->head, builder->head_cap, cap);
+  builder->head_cap = cap;
+}
+
+// Append bytes to the head. The caller must have reserved room for them.
+static void http_response_builder_put(HttpResponseBuilder* builder, const char* data,
+                                      size_t len)
+{
+  memcpy(builder->head + builder->head_len, data, len);
+  builder->head_len += len;
+}
+
+//==============================================================================
+// HttpResponseBuilder
+//==============================================================================
+void http_response_builder_init(HttpResponseBuilder* builder, Arena* arena) {
+  builder->arena = arena;
+  builder->head = NULL;
+  builder->head_len = 0;
+  builder->head_cap = 0;
+  builder->finished = false;
+  builder->body = NULL;
+  builder->body_len = 0;
+}
+
+void http_response_builder_set_status(HttpResponseBuilder* builder, enum EHttpVersion version,
+                                      enum EHttpStatus status)
+{
+  const char* ver = http_version_to_string(version);
+  const char* reason = http_status_to_string(status);
+  const size_t ver_len = strlen(ver);
+  const size_t reason_len = strlen(reason);
+
+  // "HTTP/1.1 200 OK\r\n"
+  http_response_builder_reserve(builder, ver_len + 1 + 20 + 1 + reason_len + 2);
+  http_response_builder_put(builder, ver, ver_len);
+  http_response_builder_put(builder, " ", 1);
+  builder->head_len += format_uint(builder->head + builder->head_len, status);
+  http_response_builder_put(builder, " ", 1);
+  http_response_builder_put(builder, reason, reason_len);
+  http_response_builder_put(builder, "\r\n", 2);
+}
+
+void http_response_builder_add_header(HttpResponseBuilder* builder, const char* key,
+                                      const char* value)
+{
+  const size_t key_len = strlen(key);
+  const size_t value_len = strlen(value);
+  http_response_builder_reserve(builder, key_len + 2 + value_len + 2);
+  http_response_builder_put(builder, key, key_len);
+  http_response_builder_put(builder, ": ", 2);
+  http_response_builder_put(builder, value, value_len);
+  http_response_builder_put(builder, "\r\n", 2);
+}
+
+void http_response_builder_add_header_uint(HttpResponseBuilder* builder, const char* key,
+                                           uint64_t value)
+{
+  const size_t key_len = strlen(key);
+  http_response_builder_reserve(builder, key_len + 2 + 20 + 2);
+  http_response_builder_put(builder, key, key_len);
+  http_response_builder_put(builder, ": ", 2);
+  builder->head_len += format_uint(builder->head + builder->head_len, value);
+  http_response_builder_put(builder, "\r\n", 2);
+}
+
+void http_response_builder_set_body(HttpResponseBuilder* builder, const char* body,
+                                    size_t len)
+{
+  builder->body = body;
+  builder->body_len = len;
+  http_response_builder_add_header_uint(builder, "Content-Length", len);
+}
+
+int http_response_builder_iov(HttpResponseBuilder* builder, struct iovec iov[2]) {
+  if(!builder->finished) {
+    http_response_builder_reserve(builder, 2);
+    http_response_builder_put(builder, "\r\n", 2);
+    builder->finished = true;
+  }
+  iov[0].iov_base = builder->head;
+  iov[0].iov_len = builder->head_len;
+  if(!builder->body_len) return 1;
+  iov[1].iov_base = (void*)builder->body;
+  iov[1].iov_len = builder->body_len;
+  return 2;
+}
@@ -0,0 +1,67 @@
+//==============================================================================
+// HttpResponseBuilder: builds a response as separate pieces for a gathering
+// send
+//
+// HttpResponse formats the whole response into one string, body included. A
+// builder instead keeps two pieces:
+//
+//   1) The head: status line and headers, formatted into arena memory
+//   2) The body: a pointer to the caller's bytes, which are never copied
+//
+// http_response_builder_iov() describes them as iovecs, ready to be queued on
+// a connection and sent with one writev()/sendmsg(). Numbers are formatted by
+// hand rather than with printf().
+//
+// Call the functions in this order:
+//
+//   1) http_response_builder_init()
+//   2) http_response_builder_set_status()
+//   3) http_response_builder_add_header(), _add_header_uint(), _set_body()
+//   4) http_response_builder_iov()
+//==============================================================================
+#ifndef HTTP_RESPONSE_BUILDER_H
+#define HTTP_RESPONSE_BUILDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "arena.h"
+#include "http_enums.h"
+
+typedef struct HttpResponseBuilder {
+  Arena*      arena;     // Where the head is formatted
+  char*       head;      // Status line and headers
+  size_t      head_len;  // Number of bytes in head
+  size_t      head_cap;  // Size of head
+  bool        finished;  // Has the blank line after the headers been added?
+  const char* body;      // Body, owned by the caller. May be NULL.
+  size_t      body_len;  // Number of bytes in body
+} HttpResponseBuilder;
+
+// Start an empty response. The head is allocated from 'arena'.
+void http_response_builder_init(HttpResponseBuilder* builder, Arena* arena);
+
+// Set the status line, which contains an HTTP version and status
+void http_response_builder_set_status(HttpResponseBuilder* builder, enum EHttpVersion version,
+                                      enum EHttpStatus status);
+
+// Add a header
+void http_response_builder_add_header(HttpResponseBuilder* builder, const char* key,
+                                      const char* value);
+
+// Add a header with a numeric value, e.g. Content-Length
+void http_response_builder_add_header_uint(HttpResponseBuilder* builder, const char* key,
+                                           uint64_t value);
+
+// Set the body, and add its Content-Length header.
+// - The body isn't copied. It must stay put until the response has been
+//   queued (or sent, if it's queued by reference).
+void http_response_builder_set_body(HttpResponseBuilder* builder, const char* body,
+                                    size_t len);
+
+// Finish the head and describe the response as up to two iovecs: the head,
+// then the body if there is one. Returns the number of iovecs filled in.
+int http_response_builder_iov(HttpResponseBuilder* builder, struct iovec iov[2]);
+
+#endif // HTTP_RESPONSE_BUILDER_H
@@ -0,0 +1,241 @@
+#include "http_scan.h"
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define HTTP_SCAN_X86 1
+#endif
+
+//==============================================================================
+// Character classes
+//==============================================================================
+const uint8_t http_char_class[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0,  // 0x00
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x10
+  4, 7, 6, 7, 7, 7, 7, 7, 6, 6, 7, 7, 6, 7, 7, 6,  // 0x20
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6,  // 0x30
+  6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,  // 0x40
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 7, 7,  // 0x50
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,  // 0x60
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 7, 6, 7, 0,  // 0x70
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0x80
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0x90
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0xa0
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0xb0
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0xc0
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0xd0
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0xe0
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  // 0xf0
+};
+
+//==============================================================================
+// Scalar kernels. The SIMD kernels use these for runs too short for a chunk.
+//==============================================================================
+static size_t scan_class_scalar(const char* buf, size_t len, uint8_t cls) {
+  size_t i = 0;
+  while(i < len && (http_char_class[(unsigned char)buf[i]] & cls)) ++i;
+  return i;
+}
+
+static size_t scan_token_scalar(const char* buf, size_t len) {
+  return scan_class_scalar(buf, len, HTTP_CHAR_TOKEN);
+}
+
+static size_t scan_visible_scalar(const char* buf, size_t len) {
+  return scan_class_scalar(buf, len, HTTP_CHAR_VISIBLE);
+}
+
+static size_t scan_value_scalar(const char* buf, size_t len) {
+  return scan_class_scalar(buf, len, HTTP_CHAR_VALUE);
+}
+
+#ifdef HTTP_SCAN_X86
+//==============================================================================
+// SSE2 kernels
+//
+// Each one builds a mask of the bytes in a chunk that belong to the class. The
+// first clear bit, if any, is the answer. Unsigned byte comparisons are done
+// with min/max, since SSE2 only has signed ones.
+//==============================================================================
+// Bytes of 'v' in [lo, hi]
+static inline __m128i sse2_in_range(__m128i v, unsigned char lo, unsigned char hi) {
+  const __m128i t = _mm_sub_epi8(v, _mm_set1_epi8((char)lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8((char)(hi - lo))), t);
+}
+
+static inline __m128i sse2_eq(__m128i v, unsigned char c) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8((char)c));
+}
+
+// Visible: 0x21 and up, except DEL
+static inline __m128i sse2_visible(__m128i v) {
+  const __m128i above_space = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x21)), v);
+  return _mm_andnot_si128(sse2_eq(v, 0x7f), above_space);
+}
+
+// Value: visible, space or tab
+static inline __m128i sse2_value(__m128i v) {
+  return _mm_or_si128(sse2_visible(v), _mm_or_si128(sse2_eq(v, ' '), sse2_eq(v, '\t')));
+}
+
+// Token: printable ASCII, except the delimiters "(),/:;<=>?@[\]{}
+static inline __m128i sse2_token(__m128i v) {
+  __m128i delim = sse2_eq(v, '"');
+  delim = _mm_or_si128(delim, sse2_in_range(v, '(', ')'));
+  delim = _mm_or_si128(delim, sse2_eq(v, ','));
+  delim = _mm_or_si128(delim, sse2_eq(v, '/'));
+  delim = _mm_or_si128(delim, sse2_in_range(v, ':', '@'));
+  delim = _mm_or_si128(delim, sse2_in_range(v, '[', ']'));
+  delim = _mm_or_si128(delim, sse2_eq(v, '{'));
+  delim = _mm_or_si128(delim, sse2_eq(v, '}'));
+  return _mm_andnot_si128(delim, sse2_in_range(v, 0x21, 0x7e));
+}
+
+// Runs of 16 bytes or more finish with one last load that overlaps the chunk
+// before it, ignoring the bytes already checked, so only short runs fall back
+// to the scalar kernel.
+#define SSE2_SCAN(name, classify, scalar)                                   \
+static size_t name(const char* buf, size_t len) {                           \
+  if(len < 16) return scalar(buf, len);                                     \
+  size_t i = 0;                                                             \
+  for(; i + 16 <= len; i += 16) {                                           \
+    const __m128i v = _mm_loadu_si128((const __m128i*)(buf + i));           \
+    const unsigned bad = (unsigned)_mm_movemask_epi8(classify(v)) ^ 0xffff; \
+    if(bad) return i + __builtin_ctz(bad);                                  \
+  }                                                                         \
+  if(i == len) return len;                                                  \
+  const __m128i v = _mm_loadu_si128((const __m128i*)(buf + len - 16));      \
+  const unsigned bad = ((unsigned)_mm_movemask_epi8(classify(v)) ^ 0xffff)  \
+                       >> (i + 16 - len);                                   \
+  return (bad ? i + __builtin_ctz(bad) : len);                              \
+}
+
+SSE2_SCAN(scan_token_sse2,   sse2_token,   scan_token_scalar)
+SSE2_SCAN(scan_visible_sse2, sse2_visible, scan_visible_scalar)
+SSE2_SCAN(scan_value_sse2,   sse2_value,   scan_value_scalar)
+
+//==============================================================================
+// AVX2 kernels: the same, 32 bytes at a time. These are compiled for AVX2
+// regardless of the build flags, and only called if the CPU has it.
+//==============================================================================
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i avx2_in_range(__m256i v, unsigned char lo, unsigned char hi) {
+  const __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8((char)lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8((char)(hi - lo))), t);
+}
+
+AVX2 static inline __m256i avx2_eq(__m256i v, unsigned char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)c));
+}
+
+AVX2 static inline __m256i avx2_visible(__m256i v) {
+  const __m256i above_space = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x21)), v);
+  return _mm256_andnot_si256(avx2_eq(v, 0x7f), above_space);
+}
+
+AVX2 static inline __m256i avx2_value(__m256i v) {
+  return _mm256_or_si256(avx2_visible(v), _mm256_or_si256(avx2_eq(v, ' '), avx2_eq(v, '\t')));
+}
+
+AVX2 static inline __m256i avx2_token(__m256i v) {
+  __m256i delim = avx2_eq(v, '"');
+  delim = _mm256_or_si256(delim, avx2_in_range(v, '(', ')'));
+  delim = _mm256_or_si256(delim, avx2_eq(v, ','));
+  delim = _mm256_or_si256(delim, avx2_eq(v, '/'));
+  delim = _mm256_or_si256(delim, avx2_in_range(v, ':', '@'));
+  delim = _mm256_or_si256(delim, avx2_in_range(v, '[', ']'));
+  delim = _mm256_or_si256(delim, avx2_eq(v, '{'));
+  delim = _mm256_or_si256(delim, avx2_eq(v, '}'));
+  return _mm256_andnot_si256(delim, avx2_in_range(v, 0x21, 0x7e));
+}
+
+// Same as the SSE2 kernels, with runs shorter than 32 bytes handed to those
+#define AVX2_SCAN(name, classify, shorter)                                  \
+AVX2 static size_t name(const char* buf, size_t len) {                      \
+  if(len < 32) return shorter(buf, len);                                    \
+  size_t i = 0;                                                             \
+  for(; i + 32 <= len; i += 32) {                                           \
+    const __m256i v = _mm256_loadu_si256((const __m256i*)(buf + i));        \
+    const unsigned bad = ~(unsigned)_mm256_movemask_epi8(classify(v));      \
+    if(bad) return i + __builtin_ctz(bad);                                  \
+  }                                                                         \
+  if(i == len) return len;                                                  \
+  const __m256i v = _mm256_loadu_si256((const __m256i*)(buf + len - 32));   \
+  const unsigned bad = ~(unsigned)_mm256_movemask_epi8(classify(v))         \
+                       >> (i + 32 - len);                                   \
+  return (bad ? i + __builtin_ctz(bad) : len);                              \
+}
+
+AVX2_SCAN(scan_token_avx2,   avx2_token,   scan_token_sse2)
+AVX2_SCAN(scan_visible_avx2, avx2_visible, scan_visible_sse2)
+AVX2_SCAN(scan_value_avx2,   avx2_value,   scan_value_sse2)
+#endif // HTTP_SCAN_X86
+
+//==============================================================================
+// Dispatch
+//==============================================================================
+typedef size_t (*HttpScanFn)(const char* buf, size_t len);
+
+static enum EHttpScanImpl scan_impl = HTTP_SCAN_SCALAR;
+static HttpScanFn scan_token   = scan_token_scalar;
+static HttpScanFn scan_visible = scan_visible_scalar;
+static HttpScanFn scan_value   = scan_value_scalar;
+
+bool http_scan_use(enum EHttpScanImpl impl) {
+  switch(impl) {
+    case HTTP_SCAN_SCALAR:
+      scan_token = scan_token_scalar;
+      scan_visible = scan_visible_scalar;
+      scan_value = scan_value_scalar;
+      break;
+#ifdef HTTP_SCAN_X86
+    case HTTP_SCAN_SSE2:
+      scan_token = scan_token_sse2;
+      scan_visible = scan_visible_sse2;
+      scan_value = scan_value_sse2;
+      break;
+    case HTTP_SCAN_AVX2:
+      __builtin_cpu_init();
+      if(!__builtin_cpu_supports("avx2")) return false;
+      scan_token = scan_token_avx2;
+      scan_visible = scan_visible_avx2;
+      scan_value = scan_value_avx2;
+      break;
+#endif
+    default:
+      return false;
+  }
+  scan_impl = impl;
+  return true;
+}
+
+// Pick the best kernels before main() runs, so no thread ever sees them change
+__attribute__((constructor)) static void http_scan_init() {
+  if(!http_scan_use(HTTP_SCAN_AVX2)) http_scan_use(HTTP_SCAN_SSE2);
+}
+
+enum EHttpScanImpl http_scan_impl() {
+  return scan_impl;
+}
+
+const char* http_scan_impl_to_string(enum EHttpScanImpl impl) {
+  switch(impl) {
+    case HTTP_SCAN_SCALAR: return "scalar";
+    case HTTP_SCAN_SSE2:   return "sse2";
+    case HTTP_SCAN_AVX2:   return "avx2";
+    default:               return "?";
+  }
+}
+
+size_t http_scan_token(const char* buf, size_t len) {
+  return scan_token(buf, len);
+}
+
+size_t http_scan_visible(const char* buf, size_t len) {
+  return scan_visible(buf, len);
+}
+
+size_t http_scan_value(const char* buf, size_t len) {
+  return scan_value(buf, len);
+}
@@ -0,0 +1,67 @@
+//==============================================================================
+// Byte-scanning kernels for the HTTP parser
+//
+// The parser spends most of its time running along a URI, header name or
+// header value looking for the byte that ends it. These functions do that a
+// chunk at a time: 32 bytes with AVX2, 16 with SSE2, or one at a time on other
+// CPUs. The fastest kernel the CPU supports is chosen at startup (via CPUID),
+// and all of them return identical results.
+//
+// Each scan returns the offset of the first byte in buf[0, len) that isn't in
+// its character class, or 'len' if every byte is.
+//==============================================================================
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//==============================================================================
+// Character classes
+//==============================================================================
+#define HTTP_CHAR_TOKEN   0x1  // Method and header name characters (RFC 7230 tchar)
+#define HTTP_CHAR_VISIBLE 0x2  // URI and version characters: anything past space
+                               //   except DEL, including non-ASCII bytes
+#define HTTP_CHAR_VALUE   0x4  // Header value characters: visible, space or tab
+
+extern const uint8_t http_char_class[256];
+
+static inline bool http_is_token_char(unsigned char c) {
+  return http_char_class[c] & HTTP_CHAR_TOKEN;
+}
+
+static inline bool http_is_visible_char(unsigned char c) {
+  return http_char_class[c] & HTTP_CHAR_VISIBLE;
+}
+
+//==============================================================================
+// Kernels
+//==============================================================================
+enum EHttpScanImpl {
+  HTTP_SCAN_SCALAR,
+  HTTP_SCAN_SSE2,
+  HTTP_SCAN_AVX2
+};
+
+// Scan a run of token characters
+size_t http_scan_token(const char* buf, size_t len);
+
+// Scan a run of visible characters
+size_t http_scan_visible(const char* buf, size_t len);
+
+// Scan a run of header value characters
+size_t http_scan_value(const char* buf, size_t len);
+
+// Which kernels are in use?
+enum EHttpScanImpl http_scan_impl();
+
+// Switch to another set of kernels, e.g. to compare them. Returns false, and
+// changes nothing, if this CPU doesn't support them. Not thread-safe: call it
+// before any other thread is parsing.
+bool http_scan_use(enum EHttpScanImpl impl);
+
+// Name of a set of kernels, for printing
+const char* http_scan_impl_to_string(enum EHttpScanImpl impl);
+
+#endif // HTTP_SCAN_H
@@ -0,0 +1,27 @@
+#include "io_engine.h"
+#include "epoll_engine.h"
+#include "uring_engine.h"
+#include <errno.h>
+#include <string.h>
+
+const char* io_engine_to_string(enum EIoEngine x) {
+  switch(x) {
+    case IO_ENGINE_EPOLL:    return "epoll";
+    case IO_ENGINE_IO_URING: return "io_uring";
+    default:                 return "?";
+  }
+}
+
+enum EIoEngine io_engine_from_string(const char* str) {
+  if(!strcmp(str, "epoll"   )) return IO_ENGINE_EPOLL;
+  if(!strcmp(str, "io_uring")) return IO_ENGINE_IO_URING;
+  return IO_ENGINE_UNKNOWN;
+}
+
+Status io_engine_run(enum EIoEngine engine, struct Worker* worker) {
+  switch(engine) {
+    case IO_ENGINE_EPOLL:    return epoll_engine_run(worker);
+    case IO_ENGINE_IO_URING: return uring_engine_run(worker);
+    default:                 return make_status(false, EINVAL);
+  }
+}
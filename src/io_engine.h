@@ -0,0 +1,33 @@
+//==============================================================================
+// IO engines. An engine runs a Worker: it accepts connections, moves bytes
+// between sockets and Connection buffers, and calls the webserver hooks in
+// webserver.h. The engine is chosen at startup, so engines can be benchmarked
+// against each other on the same build.
+//
+// NOTE:
+//   - io_engine_to_string() will return "?" on error
+//   - io_engine_from_string() will return IO_ENGINE_UNKNOWN on error
+//==============================================================================
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include "status.h"
+
+struct Worker;
+
+enum EIoEngine {
+  IO_ENGINE_UNKNOWN,
+  IO_ENGINE_EPOLL,     // Readiness-based: epoll + non-blocking syscalls
+  IO_ENGINE_IO_URING   // Completion-based: io_uring with batched submission
+};
+
+// String conversion
+const char*    io_engine_to_string  (enum EIoEngine x);
+enum EIoEngine io_engine_from_string(const char* s);
+
+// Run the worker with the given engine until the server shuts down.
+// - Fails without running if the engine can't be set up (for example, if the
+//   kernel doesn't support io_uring).
+Status io_engine_run(enum EIoEngine engine, struct Worker* worker);
+
+#endif // IO_ENGINE_H
@@ -0,0 +1,36 @@
+#include "log_ring.h"
+
+//==============================================================================
+// LogRing
+//==============================================================================
+void log_ring_init(LogRing* ring) {
+  ring->head = 0;
+  ring->tail = 0;
+  ring->next = NULL;
+}
+
+LogRecord* log_ring_reserve(LogRing* ring) {
+  // Only this thread moves 'head'. 'tail' is acquired so the consumer is done
+  // with a slot before it's overwritten.
+  const size_t head = ring->head;
+  const size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if(head - tail >= LOG_RING_RECORDS) return NULL;
+  return &ring->records[head & (LOG_RING_RECORDS - 1)];
+}
+
+void log_ring_commit(LogRing* ring) {
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+size_t log_ring_readable(LogRing* ring) {
+  const size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  return head - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+}
+
+const LogRecord* log_ring_peek(const LogRing* ring, size_t i) {
+  return &ring->records[(ring->tail + i) & (LOG_RING_RECORDS - 1)];
+}
+
+void log_ring_consume(LogRing* ring, size_t count) {
+  __atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,67 @@
+//==============================================================================
+// LogRing: a lock-free queue of log records between one producer thread and
+// one consumer thread.
+//
+// Each thread that logs owns a ring and formats its messages straight into
+// the ring's slots; the log writer thread drains every ring and writes the
+// records out in batches. Neither side ever takes a lock or waits for the
+// other: the producer only moves 'head' and the consumer only moves 'tail',
+// and each publishes its index with a release store.
+//
+// Records have a fixed size, so a message longer than LOG_RECORD_TEXT_SIZE is
+// truncated.
+//==============================================================================
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of records in a ring. A power of two.
+#define LOG_RING_RECORDS 1024
+
+// Size of a record, and of the text it holds
+#define LOG_RECORD_SIZE      256
+#define LOG_RECORD_TEXT_SIZE (LOG_RECORD_SIZE - 2 * sizeof(uint32_t))
+
+typedef struct LogRecord {
+  uint32_t targets;                     // Where the record goes (caller-defined bits)
+  uint32_t len;                         // Number of bytes of text
+  char     text[LOG_RECORD_TEXT_SIZE];  // Text, not null-terminated
+} LogRecord;
+
+typedef struct LogRing {
+  // The two indexes sit on separate cache lines so the producer and consumer
+  // don't contend for one. They only ever increase; slot = index % size.
+  size_t          head __attribute__((aligned(64)));  // Next record to fill
+  size_t          tail __attribute__((aligned(64)));  // Next record to drain
+  struct LogRing* next __attribute__((aligned(64)));  // Next ring, for the writer's list
+  LogRecord       records[LOG_RING_RECORDS];
+} LogRing;
+
+// Initialize an empty ring
+void log_ring_init(LogRing* ring);
+
+//----- Producer ---------------------------------------------------------------
+
+// Get the next free record to fill in, or NULL if the ring is full. The record
+// isn't visible to the consumer until log_ring_commit() is called.
+LogRecord* log_ring_reserve(LogRing* ring);
+
+// Publish the record returned by the last log_ring_reserve()
+void log_ring_commit(LogRing* ring);
+
+//----- Consumer ---------------------------------------------------------------
+
+// Number of records ready to be drained. The producer may call this too, to
+// see how full its ring is.
+size_t log_ring_readable(LogRing* ring);
+
+// Get the i'th readable record, counting from the oldest
+const LogRecord* log_ring_peek(const LogRing* ring, size_t i);
+
+// Free the 'count' oldest records, once they've been written
+void log_ring_consume(LogRing* ring, size_t count);
+
+#endif // LOG_RING_H
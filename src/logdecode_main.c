@@ -0,0 +1,83 @@
+//==============================================================================
+// Entry point for the logdecode program. Converts binary access logs (see
+// access_log.h) to text lines or CSV.
+//
+// Usage: bin/logdecode [-c] [file ...]
+//
+// Reads each file in turn, or stdin if none are given, and writes to stdout.
+//==============================================================================
+#include "access_log.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char* USAGE =
+  "\n"
+  "USAGE: logdecode [-c] [file ...]\n"
+  "\n"
+  "Print binary access logs as text, or as CSV with -c. Reads stdin if no\n"
+  "files are given.\n"
+  "\n"
+  "OPTIONS:\n"
+  "  -c  Print CSV, with a header row\n"
+  "  -h  Show this help message\n"
+  "\n";
+
+// Decode one file. Returns false if it isn't a valid access log.
+static bool logdecode_file(FILE* in, const char* name, bool csv) {
+  if(!access_log_read_header(in)) {
+    fprintf(stderr, "ERROR: %s is not a binary access log from this build\n", name);
+    return false;
+  }
+
+  AccessLogRecord record;
+  char uri[ACCESS_LOG_MAX_URI + 1];
+  int result;
+  while((result = access_log_read(in, &record, uri)) > 0) {
+    if(csv) access_log_print_csv(stdout, &record, uri);
+    else    access_log_print_text(stdout, &record, uri);
+  }
+  if(result < 0) {
+    fprintf(stderr, "ERROR: %s ends partway through a record\n", name);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  // Get options
+  bool csv = false;
+  int c;
+  while((c = getopt(argc, argv, "ch")) != -1) {
+    switch(c) {
+    case 'c':
+      csv = true;
+      break;
+    case 'h':
+      printf("%s", USAGE);
+      exit(0);
+    default:
+      fprintf(stderr, "%s", USAGE);
+      exit(1);
+    }
+  }
+
+  // Decode each file, or stdin
+  if(csv) access_log_print_csv_header(stdout);
+  bool ok = true;
+  if(optind == argc) {
+    ok = logdecode_file(stdin, "stdin", csv);
+  }
+  for(int i=optind; i<argc; ++i) {
+    FILE* in = fopen(argv[i], "rb");
+    if(!in) {
+      fprintf(stderr, "ERROR: Unable to open %s\n", argv[i]);
+      ok = false;
+      continue;
+    }
+    ok = logdecode_file(in, argv[i], csv) && ok;
+    fclose(in);
+  }
+  return (ok ? 0 : 1);
+}
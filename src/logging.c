@@ -1,9 +1,17 @@
 #include "logging.h"
-#include "utils.h"
+#include "access_log.h"
+#include "clock.h"
+#include "log_ring.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdarg.h>
-#include <time.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
 
 //==============================================================================
 // Data and constants
@@ -11,111 +19,406 @@
 // Write log messages to console?
 static bool echo_to_console = true;
 
-// File objects for log files
-static FILE* std_log_file = NULL;
-static FILE* err_log_file = NULL;
+// File descriptors for log files
+static int std_log_fd = -1;
+static int err_log_fd = -1;
+static int access_log_fd = -1;
+
+// Keep a binary access log?
+static bool binary_access_log = false;
+
+// Date of last open, as YYYYMMDD. Used to rotate files.
+static char log_file_date[9] = {0};
 
-// Day of last open. Used to rotate files.
-static int log_file_day = 0;
+// Serializes writes and rotation, between the writer thread and synchronous
+// logging
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // Default log dir
 static const char* DEFAULT_LOG_DIR = "/etc/webserver/logs";
 
-// Logging targets. Can be binary-OR'd together.
+// Logging targets. Can be binary-OR'd together. Bit 'i' selects the i'th file
+// descriptor in write_log_records().
 enum ELogTarget {
-  LOG_TARGET_STD = 0x1 << 0,  // Standard log file
-  LOG_TARGET_ERR = 0x1 << 1  // Error log file
+  LOG_TARGET_STD    = 0x1 << 0,  // Standard log file
+  LOG_TARGET_ERR    = 0x1 << 1,  // Error log file
+  LOG_TARGET_STDOUT = 0x1 << 2,  // Console
+  LOG_TARGET_STDERR = 0x1 << 3,  // Console, errors
+  LOG_TARGET_ACCESS = 0x1 << 4,  // Binary access log file
+  LOG_TARGET_COUNT  = 5
 };
 
+// Max records written per writev() call
+#define LOG_WRITE_BATCH 64
+
+// How long the writer sleeps when there's nothing to write, and how long a
+// blocked thread waits before checking its ring again
+#define LOG_WRITER_IDLE_MS 10
+#define LOG_BLOCKED_WAIT_US 100
+
+// A thread whose ring reaches this many records wakes the writer early
+#define LOG_WAKE_THRESHOLD (LOG_RING_RECORDS / 2)
+
+// Background writer state
+static bool              log_writer_running = false;   // Is logging asynchronous?
+static bool              log_writer_stopping = false;  // Has the writer been told to stop?
+static pthread_t         log_writer_thread;
+static enum ELogOverflow log_overflow = LOG_OVERFLOW_DROP;
+static size_t            dropped_log_count = 0;
+static size_t            reported_drop_count = 0;      // Only touched by the writer
+
+// Lets a filling ring cut the writer's sleep short. Only used on that rare
+// transition, never on an ordinary log call.
+static pthread_mutex_t log_wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  log_wake_cond = PTHREAD_COND_INITIALIZER;
+
+// Every thread's ring, for the writer to drain. Rings are added with a
+// compare-and-swap and freed when the writer stops, at which point the
+// generation changes so threads know to make new ones.
+static LogRing* log_rings = NULL;
+static unsigned log_ring_generation = 0;
+
+// The calling thread's ring, and the generation it belongs to
+static __thread LogRing* thread_log_ring = NULL;
+static __thread unsigned thread_log_ring_generation = 0;
+
 //==============================================================================
 // Utility functions
 //==============================================================================
-// Make sure the log files are open and have the correct filename (by date)
-Status rotate_log_files() {
-  // Get the current day
-  time_t rawtime;
-  time(&rawtime);
-  struct tm* timeinfo = gmtime(&rawtime);
+// Sleep for the given number of microseconds
+static void log_sleep_us(long us) {
+  struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+  nanosleep(&ts, NULL);
+}
+
+// Wake the writer if it's sleeping
+static void wake_log_writer() {
+  pthread_mutex_lock(&log_wake_mutex);
+  pthread_cond_signal(&log_wake_cond);
+  pthread_mutex_unlock(&log_wake_mutex);
+}
+
+// Writer: sleep until woken, or for 'ms' milliseconds
+static void wait_for_logs(long ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += ms * 1000000;
+  deadline.tv_sec += deadline.tv_nsec / 1000000000;
+  deadline.tv_nsec %= 1000000000;
+  pthread_mutex_lock(&log_wake_mutex);
+  pthread_cond_timedwait(&log_wake_cond, &log_wake_mutex, &deadline);
+  pthread_mutex_unlock(&log_wake_mutex);
+}
+
+// Close the log files. Caller holds log_mutex.
+static void close_log_fds() {
+  if(std_log_fd != -1) { close(std_log_fd); std_log_fd = -1; }
+  if(err_log_fd != -1) { close(err_log_fd); err_log_fd = -1; }
+  if(access_log_fd != -1) { close(access_log_fd); access_log_fd = -1; }
+}
+
+// Open a log file for appending
+static int open_log_fd(const char* path) {
+  const int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+  if(fd == -1) fprintf(stderr, "Unable to open log file %s (errno: %i)\n", path, errno);
+  return fd;
+}
+
+// Is a binary access log empty, or does it start with this build's header?
+static bool access_log_fd_matches(int fd) {
+  AccessLogHeader header, ours;
+  const ssize_t n = pread(fd, &header, sizeof(header), 0);
+  if(n == 0) return true;
+  access_log_header(&ours);
+  return n == sizeof(header) && !memcmp(&header, &ours, sizeof(header));
+}
+
+// Make sure the log files are open and have the correct filename (by date).
+// Caller holds log_mutex.
+static Status rotate_log_files() {
+  // Get the current day: the log timestamp starts with it
+  char date[9];
+  memcpy(date, clock_log_timestamp(), 8);
+  date[8] = 0;
 
   // If the current day is different than the log file day, rotate
-  if(timeinfo->tm_mday != log_file_day) {
+  if(strcmp(date, log_file_date)) {
     // Close existing files
-    close_log_files();
+    close_log_fds();
 
     // Get the log file names
-    char date[10];
-    strftime(date, 10, "%Y%m%d", timeinfo);
     char std_log_file_path[1024];
     char err_log_file_path[1024];
     sprintf(std_log_file_path, "%s/webserver-std-%s.log", DEFAULT_LOG_DIR, date);
     sprintf(err_log_file_path, "%s/webserver-err-%s.log", DEFAULT_LOG_DIR, date);
+    char access_log_file_path[1024];
+    sprintf(access_log_file_path, "%s/webserver-access-%s.bin", DEFAULT_LOG_DIR, date);
 
     // Open the log files
-    std_log_file = fopen(std_log_file_path, "a");
-    if(!std_log_file) {
-      fprintf(stderr, "Unable to open log file %s (errno: %i)\n", std_log_file_path, errno);
-      return get_status(false);
-    }
-    err_log_file = fopen(err_log_file_path, "a");
-    if(!err_log_file) {
-      fprintf(stderr, "Unable to open log file %s (errno: %i)\n", err_log_file_path, errno);
-      return get_status(false);
+    std_log_fd = open_log_fd(std_log_file_path);
+    if(std_log_fd == -1) return get_status(false);
+    err_log_fd = open_log_fd(err_log_file_path);
+    if(err_log_fd == -1) return get_status(false);
+    if(binary_access_log) {
+      access_log_fd = open_log_fd(access_log_file_path);
+      if(access_log_fd == -1) return get_status(false);
+
+      // Records can't be added to a file from a build with another layout.
+      // Move it aside and start a new one.
+      if(!access_log_fd_matches(access_log_fd)) {
+        char old_path[1040];
+        sprintf(old_path, "%s.old", access_log_file_path);
+        close(access_log_fd);
+        rename(access_log_file_path, old_path);
+        access_log_fd = open_log_fd(access_log_file_path);
+        if(access_log_fd == -1) return get_status(false);
+      }
+
+      // A new file starts with a header
+      if(lseek(access_log_fd, 0, SEEK_END) == 0) {
+        AccessLogHeader header;
+        access_log_header(&header);
+        if(write(access_log_fd, &header, sizeof(header)) != sizeof(header)) {
+          return get_status(false);
+        }
+      }
     }
 
     // Update the log file date
-    log_file_day = timeinfo->tm_mday;
+    memcpy(log_file_date, date, sizeof(date));
   }
 
   return get_status(true);
 }
 
-void write_log_line(FILE* file, timebuf_t tb, const char* format, va_list args) {
-  fprintf(file, "%s | ", tb);    // Print timestamp
-  vfprintf(file, format, args);  // Print formatted message
-  fprintf(file, "\n");           // Print newline
-  fflush(file);                  // Flush stream
+// Format a log line into a record: "<timestamp> | <message>\n". Messages that
+// don't fit are truncated, but keep their newline.
+static void format_log_record(LogRecord* record, unsigned targets, const char* format,
+                              va_list args)
+{
+  char* text = record->text;
+  memcpy(text, clock_log_timestamp(), CLOCK_LOG_TIMESTAMP_LEN);
+  memcpy(text + CLOCK_LOG_TIMESTAMP_LEN, " | ", 3);
+  size_t len = CLOCK_LOG_TIMESTAMP_LEN + 3;
+
+  // Leave room for vsnprintf's null terminator, which the newline replaces
+  const size_t room = LOG_RECORD_TEXT_SIZE - len;
+  const int n = vsnprintf(text + len, room, format, args);
+  if(n > 0) len += ((size_t)n < room ? (size_t)n : room - 1);
+  text[len++] = '\n';
+
+  record->targets = targets;
+  record->len = len;
 }
 
-// Helper function used by logging functions
-// - Takes a log type, rather than a FILE*, because the log's FILE* value may
-//   change after calling rotate_log_files().
-void log_helper(enum ELogTarget target, FILE* ostream, const char* format, va_list orig_args)
-{
-  // Get a timestamp for the current time
-  timebuf_t tb;
-  timestamp(tb);
-
-  // Figure out where we're logging
-  const bool log_std = (target & LOG_TARGET_STD);
-  const bool log_err = (target & LOG_TARGET_ERR);
-
-  // Rotate log files if logging to disk
-  if(log_std || log_err) {
-    if(rotate_log_files().ok) {
-      if(log_std) {
-        va_list args;
-        va_copy(args, orig_args);
-        write_log_line(std_log_file, tb, format, args);
-      }
-      if(log_err) {
-        va_list args;
-        va_copy(args, orig_args);
-        write_log_line(err_log_file, tb, format, args);
+// Same, with variable arguments
+static void make_log_record(LogRecord* record, unsigned targets, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  format_log_record(record, targets, format, args);
+  va_end(args);
+}
+
+// Write all of 'iov' to 'fd', continuing after short writes. Errors are
+// ignored: there's nowhere left to report them.
+static void write_log_iov(int fd, struct iovec* iov, int count) {
+  while(count > 0) {
+    ssize_t n = writev(fd, iov, count);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      return;
+    }
+    while(count > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if(count > 0) {
+      iov->iov_base = (char*)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+}
+
+// Write up to LOG_WRITE_BATCH records, with one writev() per target. Caller
+// holds log_mutex.
+static void write_log_records(const LogRecord** records, size_t count) {
+  // Rotate log files. If that fails, still write to the console.
+  rotate_log_files();
+  const int fds[LOG_TARGET_COUNT] = { std_log_fd, err_log_fd, STDOUT_FILENO, STDERR_FILENO,
+                                      access_log_fd };
+
+  for(int t=0; t<LOG_TARGET_COUNT; ++t) {
+    if(fds[t] == -1) continue;
+    struct iovec iov[LOG_WRITE_BATCH];
+    int num_iov = 0;
+    for(size_t i=0; i<count; ++i) {
+      if(records[i]->targets & (0x1 << t)) {
+        iov[num_iov].iov_base = (void*)records[i]->text;
+        iov[num_iov].iov_len = records[i]->len;
+        ++num_iov;
       }
     }
+    if(!num_iov) continue;
+
+    // Don't jump ahead of anything printed to the console with stdio
+    if(fds[t] == STDOUT_FILENO) fflush(stdout);
+    if(fds[t] == STDERR_FILENO) fflush(stderr);
+    write_log_iov(fds[t], iov, num_iov);
+  }
+}
+
+// Get the calling thread's ring, making one if needed. Returns NULL if out of
+// memory.
+static LogRing* get_thread_log_ring() {
+  const unsigned generation = __atomic_load_n(&log_ring_generation, __ATOMIC_ACQUIRE);
+  if(thread_log_ring && thread_log_ring_generation == generation) {
+    return thread_log_ring;
+  }
+
+  LogRing* ring = NULL;
+  if(posix_memalign((void**)&ring, 64, sizeof(LogRing))) return NULL;
+  log_ring_init(ring);
+  ring->next = __atomic_load_n(&log_rings, __ATOMIC_RELAXED);
+  while(!__atomic_compare_exchange_n(&log_rings, &ring->next, ring, false, __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED))
+  {
+    // ring->next now holds the current list head: try again
+  }
+
+  thread_log_ring = ring;
+  thread_log_ring_generation = generation;
+  return ring;
+}
+
+// Get a record to fill in on the calling thread's ring, applying the overflow
+// policy if it's full. Returns NULL if the message is dropped, or if 'sync' is
+// set, meaning it must be written synchronously instead.
+static LogRecord* reserve_log_record(bool* sync) {
+  *sync = false;
+  LogRing* ring = NULL;
+  if(__atomic_load_n(&log_writer_running, __ATOMIC_ACQUIRE)) ring = get_thread_log_ring();
+  if(!ring) {
+    *sync = true;
+    return NULL;
+  }
+
+  LogRecord* record = log_ring_reserve(ring);
+  while(!record && log_overflow == LOG_OVERFLOW_BLOCK) {
+    wake_log_writer();
+    log_sleep_us(LOG_BLOCKED_WAIT_US);
+    record = log_ring_reserve(ring);
+  }
+  if(!record) __atomic_fetch_add(&dropped_log_count, 1, __ATOMIC_RELAXED);
+  return record;
+}
+
+// Publish the record from reserve_log_record()
+static void commit_log_record() {
+  LogRing* ring = thread_log_ring;
+  log_ring_commit(ring);
+  if(log_ring_readable(ring) == LOG_WAKE_THRESHOLD) wake_log_writer();
+}
+
+// Write a record right away, from the calling thread
+static void write_log_record_now(const LogRecord* record) {
+  const LogRecord* records[1] = { record };
+  pthread_mutex_lock(&log_mutex);
+  write_log_records(records, 1);
+  pthread_mutex_unlock(&log_mutex);
+}
+
+// Helper function used by logging functions
+static void log_helper(unsigned targets, const char* format, va_list args) {
+  bool sync;
+  LogRecord* record = reserve_log_record(&sync);
+  if(record) {
+    format_log_record(record, targets, format, args);
+    commit_log_record();
   }
+  else if(sync) {
+    LogRecord local;
+    format_log_record(&local, targets, format, args);
+    write_log_record_now(&local);
+  }
+}
+
+//==============================================================================
+// Background writer
+//==============================================================================
+// Write out what's in every ring, a batch per ring at a time so a busy thread
+// can't starve the others. Returns the number of records written.
+static size_t drain_log_rings() {
+  size_t total = 0;
+  size_t written = 0;
+  do {
+    written = 0;
+    LogRing* ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE);
+    for(; ring; ring = ring->next) {
+      size_t count = log_ring_readable(ring);
+      if(!count) continue;
+      if(count > LOG_WRITE_BATCH) count = LOG_WRITE_BATCH;
+
+      const LogRecord* records[LOG_WRITE_BATCH];
+      for(size_t i=0; i<count; ++i) {
+        records[i] = log_ring_peek(ring, i);
+      }
+      pthread_mutex_lock(&log_mutex);
+      write_log_records(records, count);
+      pthread_mutex_unlock(&log_mutex);
+      log_ring_consume(ring, count);
+      written += count;
+    }
+    total += written;
+  } while(written);
+  return total;
+}
+
+// Log how many messages were dropped since the last report, if any
+static void report_dropped_logs() {
+  const size_t dropped = __atomic_load_n(&dropped_log_count, __ATOMIC_RELAXED);
+  if(dropped == reported_drop_count) return;
+
+  LogRecord record;
+  make_log_record(&record, LOG_TARGET_ERR | (echo_to_console ? LOG_TARGET_STDERR : 0),
+                  "Dropped %zu log message(s): log buffer full", dropped - reported_drop_count);
+  write_log_record_now(&record);
+  reported_drop_count = dropped;
+}
 
-  // Log to console
-  if(ostream) {
-    va_list args;
-    va_copy(args, orig_args);
-    write_log_line(ostream, tb, format, args);
+// Writer thread: drain the rings until told to stop, then once more
+static void* run_log_writer(void* arg) {
+  (void)arg;
+  while(true) {
+    // Check before draining, so a stop request always gets a final pass
+    const bool stopping = __atomic_load_n(&log_writer_stopping, __ATOMIC_ACQUIRE);
+    const size_t written = drain_log_rings();
+    report_dropped_logs();
+    if(!written) {
+      if(stopping) break;
+      wait_for_logs(LOG_WRITER_IDLE_MS);
+    }
   }
+  return NULL;
 }
 
 //==============================================================================
 // Logging functions
 //==============================================================================
+const char* log_overflow_to_string(enum ELogOverflow x) {
+  switch(x) {
+    case LOG_OVERFLOW_DROP:  return "drop";
+    case LOG_OVERFLOW_BLOCK: return "block";
+    default:                 return "?";
+  }
+}
+
+enum ELogOverflow log_overflow_from_string(const char* str) {
+  if(!strcmp(str, "drop" )) return LOG_OVERFLOW_DROP;
+  if(!strcmp(str, "block")) return LOG_OVERFLOW_BLOCK;
+  return LOG_OVERFLOW_UNKNOWN;
+}
+
 void echo_log_to_console(bool echo) {
   if(echo != echo_to_console) {
     echo_to_console = echo;
@@ -123,34 +426,103 @@ void echo_log_to_console(bool echo) {
   }
 }
 
+void use_binary_access_log(bool binary) {
+  pthread_mutex_lock(&log_mutex);
+  if(binary != binary_access_log) {
+    binary_access_log = binary;
+    close_log_fds();
+    log_file_date[0] = 0;
+  }
+  pthread_mutex_unlock(&log_mutex);
+}
+
 Status open_log_files() {
-  return rotate_log_files();
+  pthread_mutex_lock(&log_mutex);
+  const Status status = rotate_log_files();
+  pthread_mutex_unlock(&log_mutex);
+  return status;
 }
 
 void close_log_files() {
-  if(std_log_file) { fclose(std_log_file); std_log_file = NULL; }
-  if(err_log_file) { fclose(err_log_file); err_log_file = NULL; }
+  pthread_mutex_lock(&log_mutex);
+  close_log_fds();
+  log_file_date[0] = 0;
+  pthread_mutex_unlock(&log_mutex);
+}
+
+Status start_log_writer(enum ELogOverflow overflow) {
+  if(log_writer_running) return get_status(true);
+
+  log_overflow = (overflow == LOG_OVERFLOW_BLOCK ? LOG_OVERFLOW_BLOCK : LOG_OVERFLOW_DROP);
+  log_writer_stopping = false;
+  const int err = pthread_create(&log_writer_thread, NULL, run_log_writer, NULL);
+  if(err) {
+    fprintf(stderr, "Unable to start log writer (errno: %i)\n", err);
+    return make_status(false, err);
+  }
+  __atomic_store_n(&log_writer_running, true, __ATOMIC_RELEASE);
+  return get_status(true);
+}
+
+void stop_log_writer() {
+  if(!log_writer_running) return;
+
+  // New messages are written synchronously. The writer drains what's queued.
+  __atomic_store_n(&log_writer_running, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&log_writer_stopping, true, __ATOMIC_RELEASE);
+  pthread_join(log_writer_thread, NULL);
+
+  // Free the rings. Threads will make new ones if the writer restarts.
+  LogRing* ring = log_rings;
+  while(ring) {
+    LogRing* next = ring->next;
+    free(ring);
+    ring = next;
+  }
+  log_rings = NULL;
+  __atomic_fetch_add(&log_ring_generation, 1, __ATOMIC_RELEASE);
+}
+
+size_t get_dropped_log_count() {
+  return __atomic_load_n(&dropped_log_count, __ATOMIC_RELAXED);
 }
 
 void log_std(const char* format, ...) {
-  FILE* stream = (echo_to_console ? stdout : NULL);
+  const unsigned targets = LOG_TARGET_STD | (echo_to_console ? LOG_TARGET_STDOUT : 0);
   va_list args;
   va_start(args, format);
-  log_helper(LOG_TARGET_STD, stream, format, args);
+  log_helper(targets, format, args);
   va_end(args);
 }
 
 void log_err(const char* format, ...) {
-  FILE* stream = (echo_to_console ? stderr : NULL);
+  const unsigned targets = LOG_TARGET_ERR | (echo_to_console ? LOG_TARGET_STDERR : 0);
   va_list args;
   va_start(args, format);
-  log_helper(LOG_TARGET_ERR, stream, format, args);
+  log_helper(targets, format, args);
   va_end(args);
 }
 
 void log_all(const char* format, ...) {
   va_list args;
   va_start(args, format);
-  log_helper(LOG_TARGET_STD | LOG_TARGET_ERR, stdout, format, args);
+  log_helper(LOG_TARGET_STD | LOG_TARGET_ERR | LOG_TARGET_STDOUT, format, args);
   va_end(args);
 }
+
+void log_access(const char* data, size_t len) {
+  if(!binary_access_log) return;
+  if(len > LOG_RECORD_TEXT_SIZE) len = LOG_RECORD_TEXT_SIZE;
+
+  bool sync;
+  LogRecord* record = reserve_log_record(&sync);
+  LogRecord local;
+  if(!record && !sync) return;
+  if(!record) record = &local;
+
+  record->targets = LOG_TARGET_ACCESS;
+  record->len = len;
+  memcpy(record->text, data, len);
+  if(sync) write_log_record_now(record);
+  else     commit_log_record();
+}
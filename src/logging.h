@@ -6,14 +6,34 @@
 // - All error messages are written to the error log.
 // - Webserver start and stop messages are written to both logs.
 //
+// Logging is synchronous until start_log_writer() is called. From then on, a
+// log call just formats its message into the calling thread's ring buffer (see
+// log_ring.h) and returns; a background writer thread drains the rings and
+// writes their records with writev(), batched per file. Each thread's
+// messages stay in order, but lines from different threads may interleave
+// out of timestamp order. If a thread's ring fills up, the overflow policy
+// decides whether the message is dropped (and counted) or the thread waits.
+//
 // Evan Kuhn, 2012-10-08
 //==============================================================================
 #ifndef LOGGING_H
 #define LOGGING_H
 
 #include "status.h"
+#include <stddef.h>
 #include <stdio.h>
 
+// What to do when a thread logs faster than the writer can keep up
+enum ELogOverflow {
+  LOG_OVERFLOW_UNKNOWN,
+  LOG_OVERFLOW_DROP,   // Drop the message and count it. Never delays the caller.
+  LOG_OVERFLOW_BLOCK   // Wait for room. Never loses a message.
+};
+
+// String conversion. Returns "?" or LOG_OVERFLOW_UNKNOWN on error.
+const char*       log_overflow_to_string  (enum ELogOverflow x);
+enum ELogOverflow log_overflow_from_string(const char* s);
+
 // Tell the logging system to echo log messages to the console.
 // - Messages will still be written to the log files.
 // - Can be called at any time.
@@ -29,10 +49,31 @@ Status open_log_files();
 // Close log files. Ignores errors.
 void close_log_files();
 
+// Also keep a binary access log (see access_log.h), opened and rotated along
+// with the other log files. Off by default.
+void use_binary_access_log(bool binary);
+
+// Start the background writer, making logging asynchronous.
+// - Prints an error message and returns a status if the thread can't start,
+//   in which case logging stays synchronous.
+Status start_log_writer(enum ELogOverflow overflow);
+
+// Write out everything logged so far and stop the background writer. Logging
+// is synchronous again afterwards.
+// - Call once no other thread is logging, e.g. after joining the workers.
+void stop_log_writer();
+
+// Number of messages dropped because a ring buffer was full
+size_t get_dropped_log_count();
+
 // Logging functions
 // - If echo-to-console is enabled, these will also log to stdout or stderr
 void log_std(const char* format, ...);  // Log to stdout and 'standard' file
 void log_err(const char* format, ...);  // Log to stderr and 'error' file
 void log_all(const char* format, ...);  // Log to stdout and both files
 
+// Write an encoded record to the binary access log, if it's in use. Records
+// longer than a log ring slot are truncated.
+void log_access(const char* data, size_t len);
+
 #endif // LOGGING_H
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "mime_types.h"
+#include <string.h>
+#include <strings.h>
+
+//==============================================================================
+// Data
+//==============================================================================
+typedef struct MimeType {
+  const char* extension;
+  const char* type;
+} MimeType;
+
+static const MimeType MIME_TYPES[] = {
+  { "html",  "text/html"              },
+  { "htm",   "text/html"              },
+  { "css",   "text/css"               },
+  { "js",    "text/javascript"        },
+  { "mjs",   "text/javascript"        },
+  { "json",  "application/json"       },
+  { "txt",   "text/plain"             },
+  { "csv",   "text/csv"               },
+  { "xml",   "application/xml"        },
+  { "svg",   "image/svg+xml"          },
+  { "png",   "image/png"              },
+  { "jpg",   "image/jpeg"             },
+  { "jpeg",  "image/jpeg"             },
+  { "gif",   "image/gif"              },
+  { "webp",  "image/webp"             },
+  { "ico",   "image/x-icon"           },
+  { "pdf",   "application/pdf"        },
+  { "wasm",  "application/wasm"       },
+  { "woff",  "font/woff"              },
+  { "woff2", "font/woff2"             },
+  { "ttf",   "font/ttf"               },
+  { "mp3",   "audio/mpeg"             },
+  { "mp4",   "video/mp4"              },
+  { "webm",  "video/webm"             },
+  { "zip",   "application/zip"        },
+  { "gz",    "application/gzip"       },
+};
+
+static const size_t NUM_MIME_TYPES = sizeof(MIME_TYPES) / sizeof(MIME_TYPES[0]);
+
+// Types outside text/* that compress well
+static const char* COMPRESSIBLE_TYPES[] = {
+  "application/json",
+  "application/xml",
+  "application/javascript",
+  "application/wasm",
+  "image/svg+xml",
+  "image/x-icon",
+  "font/ttf",
+};
+
+static const size_t NUM_COMPRESSIBLE_TYPES =
+  sizeof(COMPRESSIBLE_TYPES) / sizeof(COMPRESSIBLE_TYPES[0]);
+
+//==============================================================================
+// MIME types
+//==============================================================================
+const char* mime_type_from_path(const char* path, size_t len) {
+  // Find the extension: whatever follows the last dot in the last segment
+  size_t dot = len;
+  for(size_t i=len; i>0; --i) {
+    if(path[i - 1] == '/') break;
+    if(path[i - 1] == '.') {
+      dot = i - 1;
+      break;
+    }
+  }
+  if(dot == len) return MIME_TYPE_DEFAULT;
+
+  const char* ext = path + dot + 1;
+  const size_t ext_len = len - dot - 1;
+  for(size_t i=0; i<NUM_MIME_TYPES; ++i) {
+    const MimeType* m = &MIME_TYPES[i];
+    if(!strncasecmp(m->extension, ext, ext_len) && m->extension[ext_len] == 0) return m->type;
+  }
+  return MIME_TYPE_DEFAULT;
+}
+
+bool mime_type_compressible(const char* type) {
+  // Parameters, as in "text/html; charset=utf-8", don't matter
+  size_t len = strcspn(type, "; ");
+  if(len >= 5 && !strncasecmp(type, "text/", 5)) return true;
+  for(size_t i=0; i<NUM_COMPRESSIBLE_TYPES; ++i) {
+    const char* t = COMPRESSIBLE_TYPES[i];
+    if(!strncasecmp(t, type, len) && t[len] == 0) return true;
+  }
+  return false;
+}
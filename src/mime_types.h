@@ -0,0 +1,25 @@
+//==============================================================================
+// MIME types: the Content-Type of a file, from its extension
+//
+// The table covers what a static site is usually made of. Anything else is
+// served as application/octet-stream, which browsers download rather than
+// try to render.
+//==============================================================================
+#ifndef MIME_TYPES_H
+#define MIME_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Type of files whose extension isn't in the table
+#define MIME_TYPE_DEFAULT "application/octet-stream"
+
+// Get the MIME type of the file at 'path', by its extension. Extensions are
+// case-insensitive. Returns a static string.
+const char* mime_type_from_path(const char* path, size_t len);
+
+// Is content of this type worth compressing? Text is, but images, audio,
+// video, fonts and archives mostly come compressed already.
+bool mime_type_compressible(const char* type);
+
+#endif // MIME_TYPES_H
@@ -1,5 +1,7 @@
 #include "program_options.h"
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -13,6 +15,19 @@ const char* program_options_usage() {
   "  -p <port>    Set the port to listen on\n"
   "  -v           Enable verbose output\n"
   "  -e           Echo the request, for debugging\n"
+  "  -w <workers> Set the number of worker threads (default: 1)\n"
+  "  -i <engine>  Set the IO engine: epoll or io_uring (default: epoll)\n"
+  "  -k <seconds> Set the keep-alive idle timeout, 0 to disable (default: 5)\n"
+  "  -n <count>   Set the max requests per connection (default: 100)\n"
+  "  -l <policy>  Set what to do when the log buffer is full: drop or block\n"
+  "               (default: drop)\n"
+  "  -a <format>  Set the access log format: text or binary (default: text).\n"
+  "               Binary logs can be read with bin/logdecode.\n"
+  "  -r <dir>     Set the directory of files to serve\n"
+  "               (default: /etc/webserver/sites)\n"
+  "  -c <count>   Set the max open files to cache, 0 to disable (default: 1024)\n"
+  "  -m <MiB>     Set the memory for caching small files' contents, 0 to disable\n"
+  "               (default: 64)\n"
   "  -h           Show this help message\n"
   "\n"
   ;
@@ -23,14 +38,28 @@ void program_options_print(ProgramOptions* options) {
   printf(" - port:    %i\n", options->config.port);
   printf(" - verbose: %s\n", options->config.verbose ? "yes" : "no");
   printf(" - echo:    %s\n", options->config.echo ? "yes" : "no");
+  printf(" - workers: %i\n", options->config.workers);
+  printf(" - engine:  %s\n", io_engine_to_string(options->config.io_engine));
+  printf(" - keep-alive timeout: %is\n", options->config.keepalive_timeout_ms / 1000);
+  printf(" - max requests/conn:  %i\n", options->config.max_keepalive_requests);
+  printf(" - log overflow:       %s\n", log_overflow_to_string(options->config.log_overflow));
+  printf(" - access log:         %s\n", access_log_format_to_string(options->config.access_log));
+  printf(" - document root:      %s\n", options->config.doc_root);
+  printf(" - file cache entries: %i\n", options->config.file_cache_entries);
+  printf(" - file cache memory:  %zu MiB\n", options->config.file_cache_memory / (1024 * 1024));
 }
 
 bool program_options_parse(ProgramOptions* options, int argc, char** argv) {
   // Tell getopt() not to print error messages
   opterr = 0;
 
-  // Reset the option-parsing index (so tests can use getopt more than once)
+  // Reset the option-parsing index (so tests can use getopt more than once).
+  // glibc only fully resets its internal state when optind is set to 0.
+#ifdef __GLIBC__
+  optind = 0;
+#else
   optind = 1;
+#endif
 
   // Set defaults
   options->help = false;
@@ -38,7 +67,7 @@ bool program_options_parse(ProgramOptions* options, int argc, char** argv) {
 
   // Parse command-line inputs
   char c = 0;
-  while((c = getopt(argc, argv, "p:veh")) != -1) {
+  while((c = getopt(argc, argv, "p:vew:i:k:n:l:a:r:c:m:h")) != -1) {
     switch(c) {
     case 'p':
       options->config.port = atoi(optarg);
@@ -49,13 +78,99 @@ bool program_options_parse(ProgramOptions* options, int argc, char** argv) {
     case 'e':
       options->config.echo = true;
       break;
+    case 'w':
+      options->config.workers = atoi(optarg);
+      if(options->config.workers < 1) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Option -w requires a positive number\n");
+        }
+        return false;
+      }
+      break;
+    case 'i':
+      options->config.io_engine = io_engine_from_string(optarg);
+      if(options->config.io_engine == IO_ENGINE_UNKNOWN) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Unknown IO engine '%s'\n", optarg);
+        }
+        return false;
+      }
+      break;
+    case 'k': {
+      // Check the range before converting to milliseconds, which could overflow
+      char* end = NULL;
+      errno = 0;
+      const long seconds = strtol(optarg, &end, 10);
+      if(end == optarg || *end || errno || seconds < 0 || seconds > INT_MAX / 1000) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Option -k requires a number of seconds from 0 to %i\n",
+                  INT_MAX / 1000);
+        }
+        return false;
+      }
+      options->config.keepalive_timeout_ms = (int)seconds * 1000;
+      break;
+    }
+    case 'n':
+      options->config.max_keepalive_requests = atoi(optarg);
+      if(options->config.max_keepalive_requests < 1) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Option -n requires a positive number\n");
+        }
+        return false;
+      }
+      break;
+    case 'l':
+      options->config.log_overflow = log_overflow_from_string(optarg);
+      if(options->config.log_overflow == LOG_OVERFLOW_UNKNOWN) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Unknown log overflow policy '%s'\n", optarg);
+        }
+        return false;
+      }
+      break;
+    case 'a':
+      options->config.access_log = access_log_format_from_string(optarg);
+      if(options->config.access_log == ACCESS_LOG_UNKNOWN) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Unknown access log format '%s'\n", optarg);
+        }
+        return false;
+      }
+      break;
+    case 'r':
+      options->config.doc_root = optarg;
+      break;
+    case 'c':
+      options->config.file_cache_entries = atoi(optarg);
+      if(options->config.file_cache_entries < 0) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Option -c requires a non-negative number\n");
+        }
+        return false;
+      }
+      break;
+    case 'm': {
+      const int mib = atoi(optarg);
+      if(mib < 0) {
+        if(!silence_program_options_parse) {
+          fprintf(stderr, "ERROR: Option -m requires a non-negative number\n");
+        }
+        return false;
+      }
+      options->config.file_cache_memory = (size_t)mib * 1024 * 1024;
+      break;
+    }
     case 'h':
       options->help = true;
       break;
     case '?':
       if(!silence_program_options_parse) {
-        if(optopt == 'p') {
-          fprintf(stderr, "ERROR: Option -p requires an argument\n");
+        if(optopt == 'p' || optopt == 'w' || optopt == 'i' ||
+           optopt == 'k' || optopt == 'n' || optopt == 'l' || optopt == 'a' ||
+           optopt == 'r' || optopt == 'c' ||
+           optopt == 'm') {
+          fprintf(stderr, "ERROR: Option -%c requires an argument\n", optopt);
         }
         else if(isprint(optopt)) {
           fprintf(stderr, "ERROR: Unknown option '-%c'\n", optopt);
@@ -0,0 +1,145 @@
+#include "response_cache.h"
+#include "arena.h"
+#include "http_response_builder.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+// Private utility functions
+//==============================================================================
+// Which bucket a response belongs in
+static size_t response_cache_bucket(enum EHttpStatus status, const char* body,
+                                    size_t body_len)
+{
+  uint64_t hash = (uintptr_t)body ^ ((uint64_t)status << 32) ^ body_len;
+  hash *= 0x9e3779b97f4a7c15ull;
+  return (size_t)(hash >> 32) & (RESPONSE_CACHE_BUCKETS - 1);
+}
+
+// Does an entry have this key?
+static bool response_cache_matches(const CachedResponse* entry, enum EHttpStatus status,
+                                   const char* body, size_t body_len,
+                                   const char* content_type)
+{
+  if(entry->status != status || entry->body != body || entry->body_len != body_len) {
+    return false;
+  }
+  if(!body) return true;
+  return entry->content_type == content_type || !strcmp(entry->content_type, content_type);
+}
+
+// Look for an entry in a bucket
+static CachedResponse* response_cache_find(CachedResponse* entry, enum EHttpStatus status,
+                                           const char* body, size_t body_len,
+                                           const char* content_type)
+{
+  for(; entry; entry = entry->next) {
+    if(response_cache_matches(entry, status, body, body_len, content_type)) return entry;
+  }
+  return NULL;
+}
+
+// Serialize a response into a new entry. The entry, its head and its tail are
+// one allocation.
+static CachedResponse* response_cache_serialize(const ResponseCache* cache,
+                                                enum EHttpStatus status,
+                                                const char* body, size_t body_len,
+                                                const char* content_type)
+{
+  Arena arena;
+  arena_init(&arena, NULL);
+
+  HttpResponseBuilder head;
+  http_response_builder_init(&head, &arena);
+  http_response_builder_set_status(&head, HTTP_VERSION_1_1, status);
+  http_response_builder_add_header(&head, "Server", cache->server);
+
+  HttpResponseBuilder tail;
+  http_response_builder_init(&tail, &arena);
+  if(body) {
+    http_response_builder_add_header(&tail, "Content-Type", content_type);
+    http_response_builder_set_body(&tail, body, body_len);
+  }
+  else {
+    http_response_builder_add_header_uint(&tail, "Content-Length", 0);
+  }
+
+  // The head builder hasn't been finished, so it has no blank line yet
+  struct iovec tail_iov[2];
+  const int tail_count = http_response_builder_iov(&tail, tail_iov);
+  const size_t head_len = head.head_len;
+  const size_t tail_len = tail_iov[0].iov_len + (tail_count > 1 ? body_len : 0);
+
+  CachedResponse* entry = malloc(sizeof(CachedResponse) + head_len + tail_len);
+  char* bytes = (char*)(entry + 1);
+  memcpy(bytes, head.head, head_len);
+  memcpy(bytes + head_len, tail_iov[0].iov_base, tail_iov[0].iov_len);
+  if(tail_count > 1) memcpy(bytes + head_len + tail_iov[0].iov_len, body, body_len);
+  arena_free(&arena);
+
+  entry->status = status;
+  entry->content_type = (body ? content_type : NULL);
+  entry->body = body;
+  entry->body_len = body_len;
+  entry->head = bytes;
+  entry->head_len = head_len;
+  entry->tail = bytes + head_len;
+  entry->tail_len = tail_len;
+  entry->next = NULL;
+  return entry;
+}
+
+//==============================================================================
+// ResponseCache
+//==============================================================================
+void response_cache_init(ResponseCache* cache, const char* server) {
+  cache->server = server;
+  memset(cache->buckets, 0, sizeof(cache->buckets));
+  cache->count = 0;
+}
+
+void response_cache_free(ResponseCache* cache) {
+  for(size_t i=0; i<RESPONSE_CACHE_BUCKETS; ++i) {
+    CachedResponse* entry = cache->buckets[i];
+    while(entry) {
+      CachedResponse* next = entry->next;
+      free(entry);
+      entry = next;
+    }
+    cache->buckets[i] = NULL;
+  }
+  cache->count = 0;
+}
+
+const CachedResponse* response_cache_get(ResponseCache* cache, enum EHttpStatus status,
+                                         const char* body, size_t body_len,
+                                         const char* content_type)
+{
+  CachedResponse** bucket = &cache->buckets[response_cache_bucket(status, body, body_len)];
+  CachedResponse* head = __atomic_load_n(bucket, __ATOMIC_ACQUIRE);
+  CachedResponse* found = response_cache_find(head, status, body, body_len, content_type);
+  if(found) return found;
+
+  // First time: make room, serialize, and publish. If another thread got
+  // there first, use its entry instead.
+  if(__atomic_fetch_add(&cache->count, 1, __ATOMIC_RELAXED) >= RESPONSE_CACHE_MAX_ENTRIES) {
+    __atomic_fetch_sub(&cache->count, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  CachedResponse* entry = response_cache_serialize(cache, status, body, body_len, content_type);
+  while(true) {
+    entry->next = head;
+    if(__atomic_compare_exchange_n(bucket, &head, entry, false, __ATOMIC_RELEASE,
+                                   __ATOMIC_ACQUIRE))
+    {
+      return entry;
+    }
+    found = response_cache_find(head, status, body, body_len, content_type);
+    if(found) {
+      free(entry);
+      __atomic_fetch_sub(&cache->count, 1, __ATOMIC_RELAXED);
+      return found;
+    }
+  }
+}
@@ -0,0 +1,68 @@
+//==============================================================================
+// ResponseCache: fixed responses, serialized once
+//
+// Most of the server's responses never change: the same status, content type
+// and body every time. The cache formats each one the first time it's needed
+// and keeps the bytes, split around the headers that do vary per request:
+//
+//   head:  "HTTP/1.1 404 Not Found\r\nServer: webserver\r\n"
+//          (per-request headers, e.g. Date and Connection, go here)
+//   tail:  "Content-Length: 0\r\n\r\n" and then the body, if any
+//
+// A response is keyed by its status, content type and body *identity*: the
+// body's address and length. Bodies must therefore be static data, such as
+// string literals, which is also what lets the tail be sent by reference.
+//
+// Lookups take no locks, so one cache can be shared by every worker. Entries
+// are added with a compare-and-swap and are never removed until the cache is
+// freed.
+//==============================================================================
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include "http_enums.h"
+
+// Number of hash buckets. A power of two.
+#define RESPONSE_CACHE_BUCKETS 64
+
+// Max number of responses. Past this, lookups of new responses fail.
+#define RESPONSE_CACHE_MAX_ENTRIES 1024
+
+typedef struct CachedResponse {
+  enum EHttpStatus       status;        // Key: status
+  const char*            content_type;  // Key: content type (NULL if no body)
+  const char*            body;          // Key: body address (NULL if no body)
+  size_t                 body_len;      // Key: body length
+  const char*            head;          // Status line and fixed headers
+  size_t                 head_len;      // Number of bytes in head
+  const char*            tail;          // Remaining headers, blank line and body
+  size_t                 tail_len;      // Number of bytes in tail
+  struct CachedResponse* next;          // Next entry in the bucket
+} CachedResponse;
+
+typedef struct ResponseCache {
+  const char*     server;                           // Value of the Server header
+  CachedResponse* buckets[RESPONSE_CACHE_BUCKETS];  // Hash chains
+  size_t          count;                            // Number of entries
+} ResponseCache;
+
+// Initialize an empty cache whose responses name 'server' (a static string)
+// in their Server header
+void response_cache_init(ResponseCache* cache, const char* server);
+
+// Same, for a cache with static storage
+#define RESPONSE_CACHE_INITIALIZER(server) { (server), {0}, 0 }
+
+// Free every entry. No other thread may be using the cache.
+void response_cache_free(ResponseCache* cache);
+
+// Get the serialized response, formatting it if this is the first request.
+// - 'body' may be NULL, for a response without one. Otherwise it must be
+//   static, and 'content_type' must be set.
+// - Returns NULL if the cache is full.
+const CachedResponse* response_cache_get(ResponseCache* cache, enum EHttpStatus status,
+                                         const char* body, size_t body_len,
+                                         const char* content_type);
+
+#endif // RESPONSE_CACHE_H
@@ -0,0 +1,133 @@
+#include "response_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+// Utility functions
+//==============================================================================
+// Queue the gathered bytes, followed by 'len' bytes of 'data', as one chunk
+static void response_stream_flush(ResponseStream* stream, const void* data, size_t len) {
+  Connection* conn = stream->conn;
+  const size_t total = stream->buf_len + len;
+
+  // A chunk of size zero would end the body
+  if(total == 0) return;
+  if(stream->chunked) {
+    char size_line[24];
+    const int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", total);
+    connection_write(conn, size_line, n);
+    stream->queued += n + 2;
+  }
+  connection_write(conn, stream->buf, stream->buf_len);
+  connection_write(conn, data, len);
+  if(stream->chunked) connection_write(conn, "\r\n", 2);
+  stream->queued += total;
+  stream->buf_len = 0;
+}
+
+// Queue the head, and put a new stream in conn->stream
+static ResponseStream* response_stream_new(Connection* conn, HttpResponseBuilder* head,
+                                           bool chunked, ResponseStreamProducer producer,
+                                           void* arg, void (*release)(void*))
+{
+  if(chunked) http_response_builder_add_header(head, "Transfer-Encoding", "chunked");
+  struct iovec iov[2];
+  http_response_builder_iov(head, iov);
+  connection_write(conn, iov[0].iov_base, iov[0].iov_len);
+
+  ResponseStream* stream = malloc(sizeof(ResponseStream));
+  stream->conn = conn;
+  stream->chunked = chunked;
+  stream->producer = producer;
+  stream->arg = arg;
+  stream->release = release;
+  stream->bytes = 0;
+  stream->queued = iov[0].iov_len;
+  stream->buf_len = 0;
+  conn->stream = stream;
+  return stream;
+}
+
+// The body is done, or can't go on. Queue the end of it, and free the stream.
+static void response_stream_finish(Connection* conn, enum EResponseStreamResult result) {
+  ResponseStream* stream = conn->stream;
+  response_stream_flush(stream, NULL, 0);
+
+  // The last chunk is empty. Without it, a client knows the body was cut short.
+  if(result == RESPONSE_STREAM_DONE && stream->chunked) {
+    connection_write(conn, "0\r\n\r\n", 5);
+    stream->queued += 5;
+  }
+  if(result == RESPONSE_STREAM_ERROR || !stream->chunked) {
+    conn->keep_alive = false;
+    conn->state = CONNECTION_STATE_WRITING;
+  }
+  conn->stream = NULL;
+  response_stream_free(stream);
+}
+
+//==============================================================================
+// ResponseStream
+//==============================================================================
+void response_stream_start(Connection* conn, HttpResponseBuilder* head, bool chunked,
+                           ResponseStreamProducer producer, void* arg, void (*release)(void*))
+{
+  if(!producer) {
+    if(chunked) http_response_builder_add_header(head, "Transfer-Encoding", "chunked");
+    struct iovec iov[2];
+    http_response_builder_iov(head, iov);
+    connection_write(conn, iov[0].iov_base, iov[0].iov_len);
+    if(release) release(arg);
+    return;
+  }
+  response_stream_new(conn, head, chunked, producer, arg, release);
+  response_stream_pump(conn);
+}
+
+ResponseStream* response_stream_open(Connection* conn, HttpResponseBuilder* head, bool chunked) {
+  return response_stream_new(conn, head, chunked, NULL, NULL, NULL);
+}
+
+void response_stream_write(ResponseStream* stream, const void* data, size_t len) {
+  stream->bytes += len;
+
+  // Gather small writes. Once there's a chunk's worth, send it all.
+  if(stream->buf_len + len < RESPONSE_STREAM_CHUNK_SIZE) {
+    memcpy(stream->buf + stream->buf_len, data, len);
+    stream->buf_len += len;
+    return;
+  }
+  response_stream_flush(stream, data, len);
+}
+
+void response_stream_pump(Connection* conn) {
+  ResponseStream* stream = conn->stream;
+  conn->yielded = false;
+  if(!stream || !stream->producer) return;
+
+  // Stop at the high-water mark, or after enough calls. A producer that
+  // compresses well may not have produced anything by then, so the engine is
+  // told to come back even if there's nothing to send.
+  enum EResponseStreamResult result = RESPONSE_STREAM_MORE;
+  for(int calls=0; result == RESPONSE_STREAM_MORE; ++calls) {
+    const size_t queued = connection_output_len(conn) + stream->buf_len;
+    if(queued >= RESPONSE_STREAM_HIGH_WATER) break;
+    if(calls >= RESPONSE_STREAM_MAX_CALLS) {
+      conn->yielded = true;
+      break;
+    }
+    result = stream->producer(stream, stream->arg);
+  }
+  response_stream_flush(stream, NULL, 0);
+  if(result != RESPONSE_STREAM_MORE) response_stream_finish(conn, result);
+}
+
+void response_stream_end(Connection* conn) {
+  response_stream_finish(conn, RESPONSE_STREAM_DONE);
+}
+
+void response_stream_free(ResponseStream* stream) {
+  if(stream->release) stream->release(stream->arg);
+  free(stream);
+}
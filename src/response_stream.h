@@ -0,0 +1,107 @@
+//==============================================================================
+// ResponseStream: a response whose body is produced a piece at a time
+//
+// A response queued in one go needs its whole body up front, if only to say
+// how long it is. A stream sends the head with "Transfer-Encoding: chunked"
+// instead, then the body as it's produced, so a handler with a large or
+// unbounded body only ever holds a little of it. An HTTP/1.0 client doesn't
+// understand chunks: it gets the body as it is, and the connection closes
+// after it to mark the end.
+//
+// The handler supplies a producer, which the stream calls whenever the
+// connection wants more output. Each call writes some of the body with
+// response_stream_write() and says whether there's more to come. Once the
+// queued output passes a high-water mark, the producer isn't called again
+// until the client has taken all of it. That's the backpressure that keeps
+// a response's memory the same however long its body is.
+//
+// A handler that gets its body from somewhere else, such as the body of the
+// request as it arrives, can instead open a stream and write to it directly,
+// then end it. It's up to the handler to hold off while the output is high.
+//
+// Small writes are gathered into one chunk, so that a producer writing a few
+// bytes at a time doesn't send a chunk, and a packet, for each of them.
+//==============================================================================
+#ifndef RESPONSE_STREAM_H
+#define RESPONSE_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "connection.h"
+#include "http_response_builder.h"
+
+// Writes are gathered into chunks of up to this size
+#define RESPONSE_STREAM_CHUNK_SIZE (16 * 1024)
+
+// The producer isn't called while this much output is queued
+#define RESPONSE_STREAM_HIGH_WATER (64 * 1024)
+
+// Most producer calls each time the connection wants more output, so that a
+// producer that compresses well can't hold up the worker's other connections
+#define RESPONSE_STREAM_MAX_CALLS 16
+
+// What a producer call did
+enum EResponseStreamResult {
+  RESPONSE_STREAM_MORE,   // Wrote some of the body, and there's more to come
+  RESPONSE_STREAM_DONE,   // Wrote the end of the body
+  RESPONSE_STREAM_ERROR   // Can't go on. The client sees the body cut short.
+};
+
+struct ResponseStream;
+typedef enum EResponseStreamResult (*ResponseStreamProducer)(struct ResponseStream* stream,
+                                                             void* arg);
+
+typedef struct ResponseStream {
+  Connection*            conn;      // Where the response goes
+  bool                   chunked;   // Chunked? Otherwise the connection closes after it.
+  ResponseStreamProducer producer;  // Writes the body. NULL if it's written directly.
+  void*                  arg;       // Producer's state. release(arg) is called
+  void                 (*release)(void*);  //   once the stream is done with it.
+  uint64_t               bytes;     // Body bytes written so far, before framing
+  uint64_t               queued;    // Bytes queued so far, head and framing included
+  size_t                 buf_len;   // Bytes gathered for the next chunk
+  char                   buf[RESPONSE_STREAM_CHUNK_SIZE];
+} ResponseStream;
+
+// Queue a response head and start streaming its body on the connection.
+// - 'head' has the status and headers, but no body or Content-Length. The
+//   stream adds "Transfer-Encoding: chunked" if 'chunked' is set. Otherwise
+//   the caller must have set conn->keep_alive to false before adding the
+//   Connection header, since closing is what ends the body.
+// - A NULL producer means no body, e.g. for HEAD: just the head is queued.
+// - Otherwise the producer is called right away for the first of the body,
+//   and 'release', if set, is called with 'arg' once the stream is done. It
+//   stays in conn->stream until then.
+void response_stream_start(Connection* conn, HttpResponseBuilder* head, bool chunked,
+                           ResponseStreamProducer producer, void* arg, void (*release)(void*));
+
+// Queue a response head, and open a stream whose body the caller writes
+// directly, then ends with response_stream_end(). 'head' is as for
+// response_stream_start(). The stream is in conn->stream until it's ended.
+ResponseStream* response_stream_open(Connection* conn, HttpResponseBuilder* head, bool chunked);
+
+// Write more of the body, from the producer or the caller that opened the
+// stream. The bytes are copied.
+void response_stream_write(ResponseStream* stream, const void* data, size_t len);
+
+// Call the producer for more of the connection's stream: until the queued
+// output reaches the high-water mark, the body ends, or it's been called
+// RESPONSE_STREAM_MAX_CALLS times. Gathered bytes are then queued. Once the
+// body is done, the stream is freed, and conn->stream is NULL again. If the
+// producer fails, the connection is set to close once what's queued has been
+// sent. Does nothing for a stream opened with response_stream_open().
+// - Stopping at the call limit sets conn->yielded. The engine should send
+//   what's queued, if anything, then let its other connections have a turn
+//   before calling webserver_on_output() again, even if the socket could take
+//   more. Nothing else will, if nothing was queued.
+void response_stream_pump(Connection* conn);
+
+// End the body of the connection's stream, which was opened with
+// response_stream_open(). The stream is freed.
+void response_stream_end(Connection* conn);
+
+// Free a stream that may not have finished, e.g. when its connection closes
+void response_stream_free(ResponseStream* stream);
+
+#endif // RESPONSE_STREAM_H
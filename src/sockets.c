@@ -2,6 +2,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <string.h>
@@ -14,6 +15,21 @@
 //==============================================================================
 const int CLIENT_SOCKET_RECV_BUFFER_SIZE = 1024;
 
+//==============================================================================
+// Utility functions
+//==============================================================================
+// Set or clear O_NONBLOCK on a file descriptor
+static Status set_fd_blocking(int fd, bool blocking) {
+  // Get current flags
+  int flags = fcntl(fd, F_GETFL, 0);
+  if(flags == -1) return get_status(false);
+
+  // Set flags to blocking or non-blocking
+  flags = (blocking ? flags & (~O_NONBLOCK) : flags | O_NONBLOCK);
+  const int result = fcntl(fd, F_SETFL, flags);
+  return get_status(result != -1);
+}
+
 //==============================================================================
 // ClientSocket
 //==============================================================================
@@ -24,6 +40,14 @@ void client_socket_init(ClientSocket* s) {
   s->data_len = 0;
 }
 
+Status client_socket_attach(ClientSocket* s, int fd) {
+  client_socket_init(s);
+  s->fd = fd;
+  socklen_t addr_len = sizeof(s->addr);
+  const int result = getpeername(fd, (struct sockaddr*)&s->addr, &addr_len);
+  return get_status(result != -1);
+}
+
 Status client_socket_connect(ClientSocket* s, const char* ip, int port) {
   // Make sure the socket isn't already open
   if(s->fd != -1) return make_status(false, 0);
@@ -60,12 +84,62 @@ Status client_socket_connect(ClientSocket* s, const char* ip, int port) {
   return status;
 }
 
+Status client_socket_set_blocking(ClientSocket* s, bool blocking) {
+  return set_fd_blocking(s->fd, blocking);
+}
+
 // Send data over the client socket
 Status client_socket_send(ClientSocket* s, const void* buf, size_t bufsize) {
   const int result = send(s->fd, buf, bufsize, 0);
   return get_status(result != -1);
 }
 
+Status client_socket_send_some(ClientSocket* s, const void* buf, size_t bufsize,
+                               size_t* sent)
+{
+  // MSG_NOSIGNAL: a peer that hung up should give us EPIPE, not kill us
+  ssize_t result = 0;
+  do {
+    result = send(s->fd, buf, bufsize, MSG_NOSIGNAL);
+  }
+  while(result == -1 && errno == EINTR);
+
+  *sent = (result == -1 ? 0 : result);
+  return get_status(result != -1);
+}
+
+Status client_socket_sendv_some(ClientSocket* s, const struct iovec* iov, int iovcnt,
+                                bool more, size_t* sent)
+{
+  // sendmsg() rather than writev(), for MSG_NOSIGNAL
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec*)iov;
+  msg.msg_iovlen = iovcnt;
+
+  ssize_t result = 0;
+  do {
+    result = sendmsg(s->fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+  }
+  while(result == -1 && errno == EINTR);
+
+  *sent = (result == -1 ? 0 : result);
+  return get_status(result != -1);
+}
+
+Status client_socket_sendfile_some(ClientSocket* s, int fd, off_t offset, size_t len,
+                                   size_t* sent)
+{
+  ssize_t result = 0;
+  do {
+    result = sendfile(s->fd, fd, &offset, len);
+  }
+  while(result == -1 && errno == EINTR);
+
+  *sent = (result == -1 ? 0 : result);
+  return get_status(result != -1);
+}
+
 // Receive data from the socket.
 // - Data will be placed in ClientSocket::data.
 // - Data array size will be written to ClientSocket::data_len.
@@ -97,9 +171,23 @@ Status client_socket_recv(ClientSocket* s) {
     s->data = realloc(s->data, s->data_len);
     write_to_addr = s->data + bytes_received;
     buffer_space = s->data_len - bytes_received;
+    memset(write_to_addr, 0, buffer_space);
   }
 }
 
+Status client_socket_recv_some(ClientSocket* s, void* buf, size_t bufsize,
+                               size_t* received)
+{
+  ssize_t result = 0;
+  do {
+    result = recv(s->fd, buf, bufsize, 0);
+  }
+  while(result == -1 && errno == EINTR);
+
+  *received = (result == -1 ? 0 : result);
+  return get_status(result != -1);
+}
+
 const char* client_socket_get_ip(ClientSocket* s) {
   return inet_ntoa(s->addr.sin_addr);
 }
@@ -144,14 +232,17 @@ Status server_socket_init(ServerSocket* s) {
 }
 
 Status server_socket_set_blocking(ServerSocket* s, bool blocking) {
-  // Get current flags
-  int flags = fcntl(s->fd, F_GETFL, 0);
-  if(flags == -1) return get_status(false);
+  return set_fd_blocking(s->fd, blocking);
+}
 
-  // Set flags to non-blocking
-  flags = (blocking ? flags & (~O_NONBLOCK) : flags | O_NONBLOCK);
-  const int result = fcntl(s->fd, F_SETFL, flags);
+Status server_socket_set_reuseport(ServerSocket* s, bool reuseport) {
+#ifdef SO_REUSEPORT
+  const int value = (reuseport ? 1 : 0);
+  const int result = setsockopt(s->fd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
   return get_status(result != -1);
+#else
+  return make_status(false, ENOPROTOOPT);
+#endif
 }
 
 Status server_socket_bind(ServerSocket* s, int port) {
@@ -173,33 +264,6 @@ Status server_socket_accept(ServerSocket* s, ClientSocket* c) {
   return get_status(c->fd != -1);
 }
 
-Status server_socket_accept_poll(ServerSocket* server,
-                                 ClientSocket* client,
-                                 int wait_time_ms,
-                                 int timeout_ms)
-{
-  int waited = 0;
-
-  while(1) {
-    // Try to accept an incoming connection
-    const Status status = server_socket_accept(server, client);
-
-    // If successful, or if we failed with any error but EWOULDBLOCK, return
-    if(status.ok || status.errnum != EWOULDBLOCK) {
-      return status;
-    }
-
-    // Check if we timed out
-    if(waited > timeout_ms) {
-      return make_status(false, EWOULDBLOCK);
-    }
-
-    // Sleep and try again
-    usleep(wait_time_ms * 1000);
-    waited += wait_time_ms;
-  }
-}
-
 Status server_socket_close(ServerSocket* s) {
   const int result = close(s->fd);
   const Status status = get_status(result != -1);
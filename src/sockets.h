@@ -7,6 +7,8 @@
 #define SOCKETS_H
 
 #include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <stdbool.h>
 #include <string.h>
@@ -25,18 +27,55 @@ typedef struct ClientSocket {
 // Initialize the socket's fields
 void client_socket_init(ClientSocket* s);
 
+// Take ownership of a file descriptor that's already connected (e.g. one that
+// was accepted by io_uring), and look up the peer's address.
+Status client_socket_attach(ClientSocket* s, int fd);
+
 // Connect to a server listening on the given IP address and port
 Status client_socket_connect(ClientSocket* s, const char* ip, int port);
 
+// Enable or disable blocking IO for the socket.
+// - Blocking IO enabled by default.
+Status client_socket_set_blocking(ClientSocket* s, bool blocking);
+
 // Send data over the client socket
 Status client_socket_send(ClientSocket* s, const void* buf, size_t bufsize);
 
+// Send as much of the buffer as the socket will currently accept.
+// - The number of bytes written is stored in 'sent'.
+// - If the socket is non-blocking and its send buffer is full, this fails with
+//   errnum EWOULDBLOCK. That's not an error; try again when writable.
+Status client_socket_send_some(ClientSocket* s, const void* buf, size_t bufsize,
+                               size_t* sent);
+
+// Like client_socket_send_some(), but gathers the data from several buffers
+// in a single call.
+// - Set 'more' if more data will follow right away, e.g. a file after its
+//   headers. The kernel then holds back a partly-filled packet (MSG_MORE)
+//   rather than sending it on its own.
+Status client_socket_sendv_some(ClientSocket* s, const struct iovec* iov, int iovcnt,
+                                bool more, size_t* sent);
+
+// Like client_socket_send_some(), but sends 'len' bytes of an open file,
+// starting at 'offset', with sendfile(). The bytes never pass through user
+// space.
+Status client_socket_sendfile_some(ClientSocket* s, int fd, off_t offset, size_t len,
+                                   size_t* sent);
+
 // Receive data from the socket.
 // - Data will be placed in ClientSocket::data.
 // - Data array size will be written to ClientSocket::data_len.
 // - Any existing data array will be deleted.
 Status client_socket_recv(ClientSocket* s);
 
+// Receive up to 'bufsize' bytes into a caller-owned buffer.
+// - The number of bytes read is stored in 'received'. Zero means the peer has
+//   closed the connection.
+// - If the socket is non-blocking and there's no data pending, this fails with
+//   errnum EWOULDBLOCK. That's not an error; try again when readable.
+Status client_socket_recv_some(ClientSocket* s, void* buf, size_t bufsize,
+                               size_t* received);
+
 // Get the IP address that the socket is connected to
 const char* client_socket_get_ip(ClientSocket* s);
 
@@ -64,6 +103,11 @@ Status server_socket_init(ServerSocket* s);
 // - Blocking IO enabled by default.
 Status server_socket_set_blocking(ServerSocket* s, bool blocking);
 
+// Enable or disable SO_REUSEPORT, which lets several sockets bind the same
+// port. The kernel then load-balances incoming connections across them.
+// - Must be called before binding.
+Status server_socket_set_reuseport(ServerSocket* s, bool reuseport);
+
 // Bind the socket to a port
 Status server_socket_bind(ServerSocket* s, int port);
 
@@ -76,14 +120,6 @@ Status server_socket_listen(ServerSocket* s, int max_pending);
 //   no pending connections.
 Status server_socket_accept(ServerSocket* s, ClientSocket* c);
 
-// Accept a connection on a server socket by polling. The ServerSocket must be
-// set to non-blocking for this to work properly. Returns true on success and
-// false on error or timeout.
-Status server_socket_accept_poll(ServerSocket* server,
-                                 ClientSocket* client,
-                                 int wait_time_ms,
-                                 int timeout_ms);
-
 // Close a server socket
 // - If successful, sets file descriptor to -1
 Status server_socket_close(ServerSocket* s);
@@ -0,0 +1,183 @@
+#include "static_file.h"
+#include "mime_types.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//==============================================================================
+// Utility functions
+//==============================================================================
+// Value of a hex digit, or -1
+static int static_file_hex(char c) {
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Open 'path' and stat it. Returns an errno value, or 0.
+// - O_NONBLOCK keeps a FIFO from blocking the worker; it has no effect on
+//   regular files.
+static int static_file_open_fd(StaticFile* file, const char* path, struct stat* st) {
+  file->fd = open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if(file->fd == -1) return errno;
+  if(fstat(file->fd, st) == -1) {
+    const int err = errno;
+    close(file->fd);
+    file->fd = -1;
+    return err;
+  }
+  return 0;
+}
+
+//==============================================================================
+// Static files
+//==============================================================================
+size_t static_file_resolve(const char* uri, size_t uri_len, char* path, size_t size) {
+  if(uri_len == 0 || uri[0] != '/' || size < 2) return 0;
+
+  // Segments are written as they're decoded. 'seg' is where the current one
+  // starts, just after its slash. The end of the URI ends the last segment,
+  // without adding a slash.
+  size_t len = 1;
+  size_t seg = 1;
+  path[0] = '/';
+  for(size_t i=1; i<=uri_len; ++i) {
+    char c = (i < uri_len ? uri[i] : '/');
+    if(c == '?' || c == '#') {
+      c = '/';
+      uri_len = i;
+    }
+    if(c == '%') {
+      if(i + 2 >= uri_len) return 0;
+      const int hi = static_file_hex(uri[i + 1]);
+      const int lo = static_file_hex(uri[i + 2]);
+      if(hi < 0 || lo < 0 || (hi == 0 && lo == 0)) return 0;
+      c = hi * 16 + lo;
+      i += 2;
+    }
+    if(c == '/') {
+      // End of a segment: drop it if it's empty or ".", and drop it and the
+      // one before it if it's "..". An escaped slash counts too, since the
+      // file system will treat it as one.
+      const size_t seg_len = len - seg;
+      if(seg_len == 0 || (seg_len == 1 && path[seg] == '.')) {
+        len = seg;
+      }
+      else if(seg_len == 2 && path[seg] == '.' && path[seg + 1] == '.') {
+        len = seg - 1;
+        while(len > 0 && path[len - 1] != '/') --len;
+        if(len == 0) len = 1;
+      }
+      else if(i < uri_len) {
+        if(len + 1 >= size) return 0;
+        path[len++] = '/';
+      }
+      seg = len;
+      continue;
+    }
+    if(len + 1 >= size) return 0;
+    path[len++] = c;
+  }
+  path[len] = 0;
+  return len;
+}
+
+size_t static_file_path(const char* root, const char* uri, size_t uri_len, char* path) {
+  // Leave room for the index file's name, and a precompressed sibling's suffix
+  const size_t root_len = strlen(root);
+  const size_t reserve = sizeof(STATIC_FILE_INDEX) + STATIC_FILE_MAX_SUFFIX;
+  if(root_len + reserve >= STATIC_FILE_MAX_PATH) return 0;
+  memcpy(path, root, root_len);
+  const size_t len = static_file_resolve(uri, uri_len, path + root_len,
+                                         STATIC_FILE_MAX_PATH - root_len - reserve);
+  return (len ? root_len + len : 0);
+}
+
+enum EHttpStatus static_file_open_path(StaticFile* file, char* path, size_t* len) {
+  struct stat st;
+  int err = static_file_open_fd(file, path, &st);
+  if(!err && S_ISDIR(st.st_mode)) {
+    close(file->fd);
+    if(path[*len - 1] != '/') path[(*len)++] = '/';
+    memcpy(path + *len, STATIC_FILE_INDEX, sizeof(STATIC_FILE_INDEX));
+    *len += sizeof(STATIC_FILE_INDEX) - 1;
+    err = static_file_open_fd(file, path, &st);
+  }
+  if(err == EACCES) return HTTP_STATUS_FORBIDDEN;
+  if(err) return HTTP_STATUS_NOT_FOUND;
+  if(!S_ISREG(st.st_mode)) {
+    close(file->fd);
+    file->fd = -1;
+    return HTTP_STATUS_NOT_FOUND;
+  }
+
+  file->size = st.st_size;
+  file->mtime = st.st_mtim.tv_sec;
+  file->mtime_nsec = st.st_mtim.tv_nsec;
+  file->inode = st.st_ino;
+  file->content_type = mime_type_from_path(path, *len);
+  return HTTP_STATUS_OK;
+}
+
+const char* static_file_encoding_suffix(enum EHttpEncoding encoding) {
+  switch(encoding) {
+    case HTTP_ENCODING_GZIP: return ".gz";
+    case HTTP_ENCODING_BR:   return ".br";
+    default:                 return NULL;
+  }
+}
+
+bool static_file_open_encoded(StaticFile* file, char* path, size_t len,
+                              enum EHttpEncoding encoding)
+{
+  file->fd = -1;
+  const char* suffix = static_file_encoding_suffix(encoding);
+  if(!suffix) return false;
+
+  // Add the suffix just for the open
+  struct stat st;
+  memcpy(path + len, suffix, strlen(suffix) + 1);
+  const int err = static_file_open_fd(file, path, &st);
+  path[len] = 0;
+  if(err) return false;
+  if(!S_ISREG(st.st_mode)) {
+    close(file->fd);
+    file->fd = -1;
+    return false;
+  }
+
+  file->size = st.st_size;
+  file->mtime = st.st_mtim.tv_sec;
+  file->mtime_nsec = st.st_mtim.tv_nsec;
+  file->inode = st.st_ino;
+  file->content_type = mime_type_from_path(path, len);
+  return true;
+}
+
+enum EHttpStatus static_file_open(StaticFile* file, const char* root,
+                                  const char* uri, size_t uri_len)
+{
+  char path[STATIC_FILE_MAX_PATH];
+  size_t len = static_file_path(root, uri, uri_len, path);
+  if(len == 0) return HTTP_STATUS_BAD_REQUEST;
+  return static_file_open_path(file, path, &len);
+}
+
+void static_file_etag(const StaticFile* file, char* buf) {
+  // Hex digits of each field, most significant first
+  const uint64_t fields[4] = { file->inode, file->size, (uint64_t)file->mtime,
+                               (uint64_t)file->mtime_nsec };
+  char* p = buf;
+  *p++ = '"';
+  for(int i=0; i<4; ++i) {
+    if(i > 0) *p++ = '-';
+    int shift = 60;
+    while(shift > 0 && !(fields[i] >> shift)) shift -= 4;
+    for(; shift >= 0; shift -= 4) *p++ = "0123456789abcdef"[(fields[i] >> shift) & 0xf];
+  }
+  *p++ = '"';
+  *p = 0;
+}
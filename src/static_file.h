@@ -0,0 +1,82 @@
+//==============================================================================
+// Static files: mapping request URIs to files under the document root
+//
+// A request URI becomes a path in three steps: the query and fragment are
+// dropped, %XX escapes are decoded, and "." and ".." segments are resolved.
+// Decoding comes first, so an escaped ".." can't be used to climb out of the
+// document root; ".." at the root just stays there.
+//
+// A directory is served by its index.html. Only regular files are served, and
+// they're opened without following the request any further, so the caller
+// can fstat() and sendfile() the same file it checked.
+//==============================================================================
+#ifndef STATIC_FILE_H
+#define STATIC_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "http_enums.h"
+
+// Max length of a resolved path, document root included
+#define STATIC_FILE_MAX_PATH 4096
+
+// Max length of an ETag, quotes and terminator included
+#define STATIC_FILE_ETAG_SIZE 62
+
+// File served for a directory
+#define STATIC_FILE_INDEX "index.html"
+
+// Longest suffix of a precompressed sibling, e.g. ".gz"
+#define STATIC_FILE_MAX_SUFFIX 3
+
+// An open file, ready to be sent
+typedef struct StaticFile {
+  int         fd;            // Open for reading. The caller must close it.
+  uint64_t    size;          // Size in bytes
+  time_t      mtime;         // Last modification time
+  long        mtime_nsec;    //   and its nanoseconds
+  uint64_t    inode;         // Inode number
+  const char* content_type;  // MIME type, from the extension
+} StaticFile;
+
+// Turn a request URI into a normalized path starting with '/', and write it to
+// 'path', which has room for 'size' bytes including the terminator. Returns
+// the path's length, or 0 if the URI is malformed (or the path too long).
+size_t static_file_resolve(const char* uri, size_t uri_len, char* path, size_t size);
+
+// Build the path a request URI maps to under the directory 'root'. 'path'
+// must have room for STATIC_FILE_MAX_PATH bytes. Returns the path's length, or
+// 0 if the URI is malformed or the path too long.
+size_t static_file_path(const char* root, const char* uri, size_t uri_len, char* path);
+
+// Open the file at a path built by static_file_path(), whose length is 'len'.
+// - Returns HTTP_STATUS_OK and fills in 'file' on success. If the path is a
+//   directory, 'path' and 'len' are updated to name its index file.
+// - Otherwise returns the status to respond with: 403 if the file can't be
+//   read, or 404.
+enum EHttpStatus static_file_open_path(StaticFile* file, char* path, size_t* len);
+
+// Suffix of a file's sibling precompressed with 'encoding': ".gz" for gzip,
+// ".br" for br. NULL for any other encoding.
+const char* static_file_encoding_suffix(enum EHttpEncoding encoding);
+
+// Open the sibling of a file that was precompressed with 'encoding', given the
+// path and length the file was opened with. Its Content-Type is the file's.
+// Returns false, leaving fd at -1, if there's no such regular file.
+bool static_file_open_encoded(StaticFile* file, char* path, size_t len,
+                              enum EHttpEncoding encoding);
+
+// Open the file a request URI maps to, under the directory 'root'. Same as the
+// two calls above, but a malformed URI gives 400 / Bad Request.
+enum EHttpStatus static_file_open(StaticFile* file, const char* root,
+                                  const char* uri, size_t uri_len);
+
+// Format the file's strong ETag, which changes whenever the file is replaced
+// or modified: its inode, size, and modification time in seconds and
+// nanoseconds, in hex, in quotes. 'buf' must have room for
+// STATIC_FILE_ETAG_SIZE bytes.
+void static_file_etag(const StaticFile* file, char* buf);
+
+#endif // STATIC_FILE_H
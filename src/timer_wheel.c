@@ -0,0 +1,166 @@
+#include "timer_wheel.h"
+
+//==============================================================================
+// Utility functions
+//==============================================================================
+static const uint64_t SLOT_MASK = TIMER_WHEEL_SLOTS - 1;
+
+// Slot list heads are circular: an empty slot points at itself
+static bool slot_empty(const Timer* head) {
+  return head->next == head;
+}
+
+static void slot_push(Timer* head, Timer* timer) {
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+static void slot_unlink(Timer* timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+}
+
+// Put a timer in the slot matching how far away its expiry is
+static void timer_wheel_place(TimerWheel* wheel, Timer* timer) {
+  uint64_t expires = timer->expires;
+  if(expires < wheel->tick) expires = wheel->tick;
+  const uint64_t delta = expires - wheel->tick;
+
+  for(int level=0; level<TIMER_WHEEL_LEVELS; ++level) {
+    const unsigned shift = level * TIMER_WHEEL_SLOT_BITS;
+    if(delta < ((uint64_t)TIMER_WHEEL_SLOTS << shift) || level == TIMER_WHEEL_LEVELS - 1) {
+      // Beyond the top level's range, park in the furthest slot and let it
+      // cascade back down
+      if(level == TIMER_WHEEL_LEVELS - 1 && delta >= ((uint64_t)TIMER_WHEEL_SLOTS << shift)) {
+        expires = wheel->tick + (((uint64_t)TIMER_WHEEL_SLOTS - 1) << shift);
+      }
+      slot_push(&wheel->slots[level][(expires >> shift) & SLOT_MASK], timer);
+      return;
+    }
+  }
+}
+
+// Re-place every timer in a slot. Called when the wheel reaches the slot, so
+// the timers land in finer levels.
+static void timer_wheel_cascade(TimerWheel* wheel, int level, unsigned index) {
+  Timer* head = &wheel->slots[level][index];
+  Timer pending;
+  pending.next = pending.prev = &pending;
+
+  // Move the list aside first, since re-placing may put timers back here
+  if(!slot_empty(head)) {
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head->next = head->prev = head;
+  }
+  while(!slot_empty(&pending)) {
+    Timer* timer = pending.next;
+    slot_unlink(timer);
+    timer_wheel_place(wheel, timer);
+  }
+}
+
+//==============================================================================
+// Public functions
+//==============================================================================
+void timer_init(Timer* timer, void* data) {
+  timer->prev = NULL;
+  timer->next = NULL;
+  timer->expires = 0;
+  timer->data = data;
+}
+
+bool timer_pending(const Timer* timer) {
+  return timer->next != NULL;
+}
+
+void timer_wheel_init(TimerWheel* wheel, uint64_t now_ms, unsigned tick_ms) {
+  wheel->tick_ms = (tick_ms ? tick_ms : 1);
+  wheel->tick = now_ms / wheel->tick_ms;
+  wheel->count = 0;
+  for(int level=0; level<TIMER_WHEEL_LEVELS; ++level) {
+    for(int i=0; i<TIMER_WHEEL_SLOTS; ++i) {
+      Timer* head = &wheel->slots[level][i];
+      head->next = head->prev = head;
+    }
+  }
+}
+
+void timer_wheel_add(TimerWheel* wheel, Timer* timer, uint64_t expires_ms) {
+  if(timer_pending(timer)) {
+    slot_unlink(timer);
+    wheel->count -= 1;
+  }
+  // Round up, so a timer never fires early. The current tick has already been
+  // processed, so the earliest a new timer can fire is the next one.
+  timer->expires = (expires_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+  if(timer->expires <= wheel->tick) timer->expires = wheel->tick + 1;
+  timer_wheel_place(wheel, timer);
+  wheel->count += 1;
+}
+
+void timer_wheel_remove(TimerWheel* wheel, Timer* timer) {
+  if(timer_pending(timer)) {
+    slot_unlink(timer);
+    wheel->count -= 1;
+  }
+}
+
+void timer_wheel_advance(TimerWheel* wheel, uint64_t now_ms,
+                         TimerCallback callback, void* arg)
+{
+  const uint64_t target = now_ms / wheel->tick_ms;
+
+  // Nothing scheduled: just jump ahead
+  if(wheel->count == 0) {
+    if(target > wheel->tick) wheel->tick = target;
+    return;
+  }
+
+  while(wheel->tick < target) {
+    wheel->tick += 1;
+
+    // When a level wraps, pull the next coarser slot down a level
+    for(int level=1; level<TIMER_WHEEL_LEVELS; ++level) {
+      const unsigned shift = level * TIMER_WHEEL_SLOT_BITS;
+      if(wheel->tick & ((1ULL << shift) - 1)) break;
+      timer_wheel_cascade(wheel, level, (wheel->tick >> shift) & SLOT_MASK);
+    }
+
+    // Fire everything in this tick's slot
+    Timer* head = &wheel->slots[0][wheel->tick & SLOT_MASK];
+    while(!slot_empty(head)) {
+      Timer* timer = head->next;
+      slot_unlink(timer);
+      wheel->count -= 1;
+      callback(timer, arg);
+    }
+
+    if(wheel->count == 0) {
+      wheel->tick = target;
+      return;
+    }
+  }
+}
+
+int timer_wheel_next_timeout(const TimerWheel* wheel, uint64_t now_ms) {
+  if(wheel->count == 0) return -1;
+
+  // Find the next non-empty level-0 slot, or else the next level-0 wrap, when
+  // coarser timers cascade
+  uint64_t ticks = 1;
+  for(; ticks<TIMER_WHEEL_SLOTS; ++ticks) {
+    const uint64_t tick = wheel->tick + ticks;
+    if(!slot_empty(&wheel->slots[0][tick & SLOT_MASK])) break;
+    if((tick & SLOT_MASK) == 0) break;
+  }
+
+  const uint64_t when_ms = (wheel->tick + ticks) * wheel->tick_ms;
+  return (when_ms > now_ms ? (int)(when_ms - now_ms) : 0);
+}
@@ -0,0 +1,69 @@
+//==============================================================================
+// Hierarchical timer wheel. Tracks any number of timers with O(1) add, remove
+// and per-tick cost, which is what we need for a deadline on every connection.
+//
+// Time is split into ticks of 'tick_ms' milliseconds. Level 0 has one slot per
+// tick for the next 64 ticks; each higher level has slots 64 times as wide.
+// Timers far in the future sit in a coarse slot and are moved ("cascaded") to
+// finer levels as their time approaches.
+//
+// Timers are intrusive: embed a Timer in the struct it belongs to, and use
+// container-of style arithmetic or Timer::data to get back to it.
+//==============================================================================
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Wheel geometry: 4 levels of 64 slots covers 2^24 ticks
+#define TIMER_WHEEL_LEVELS     4
+#define TIMER_WHEEL_SLOT_BITS  6
+#define TIMER_WHEEL_SLOTS      (1 << TIMER_WHEEL_SLOT_BITS)
+
+typedef struct Timer {
+  struct Timer* prev;     // Slot list links. NULL when not scheduled.
+  struct Timer* next;
+  uint64_t      expires;  // Tick at which the timer fires
+  void*         data;     // Caller's data
+} Timer;
+
+typedef struct TimerWheel {
+  uint64_t tick;     // Current tick. Timers expiring at or before it have fired.
+  unsigned tick_ms;  // Milliseconds per tick
+  size_t   count;    // Number of scheduled timers
+  Timer    slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // List heads
+} TimerWheel;
+
+// Called for each expired timer. The timer is no longer scheduled, so the
+// callback may re-add it.
+typedef void (*TimerCallback)(Timer* timer, void* arg);
+
+// Initialize a timer, unscheduled
+void timer_init(Timer* timer, void* data);
+
+// Is the timer scheduled?
+bool timer_pending(const Timer* timer);
+
+// Initialize the wheel, starting at time 'now_ms'
+void timer_wheel_init(TimerWheel* wheel, uint64_t now_ms, unsigned tick_ms);
+
+// Schedule a timer to fire at 'expires_ms'. If it's already scheduled, it's
+// moved. Times in the past fire on the next advance.
+void timer_wheel_add(TimerWheel* wheel, Timer* timer, uint64_t expires_ms);
+
+// Unschedule a timer. Does nothing if it isn't scheduled.
+void timer_wheel_remove(TimerWheel* wheel, Timer* timer);
+
+// Advance the wheel to 'now_ms', calling 'callback' for each expired timer
+void timer_wheel_advance(TimerWheel* wheel, uint64_t now_ms,
+                         TimerCallback callback, void* arg);
+
+// How long until the wheel next needs advancing, in milliseconds.
+// - Returns -1 if no timers are scheduled.
+// - May return less than the time to the next expiry, when timers need
+//   cascading first.
+int timer_wheel_next_timeout(const TimerWheel* wheel, uint64_t now_ms);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,722 @@
+#include "uring_engine.h"
+#include "logging.h"
+#include "webserver.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Number of submission queue entries. The completion queue gets four times as
+// many, since multishot operations post several completions per submission.
+static const unsigned URING_QUEUE_DEPTH = 256;
+
+// Provided receive buffers: count (must be a power of 2) and size of each
+static const unsigned URING_NUM_BUFFERS = 256;
+static const unsigned URING_BUFFER_SIZE = 4096;
+
+// Buffer group ID of the provided buffer ring
+static const uint16_t URING_BUFFER_GROUP = 0;
+
+// Max number of iovecs per send
+#define URING_MAX_SEND_IOV 8
+
+// Max number of file bytes to splice into a connection's pipe at once. This
+// is the default pipe capacity.
+static const unsigned URING_SPLICE_SIZE = 64 * 1024;
+
+// Operation tags, stored in the low bits of each SQE's user_data. The rest of
+// user_data is a pointer to the UringConn involved, if any.
+enum EUringOp {
+  URING_OP_ACCEPT   = 1,
+  URING_OP_RECV     = 2,
+  URING_OP_SEND     = 3,
+  URING_OP_SHUTDOWN = 4,
+  URING_OP_CANCEL   = 5,
+  URING_OP_TIMEOUT  = 6,
+  URING_OP_FILL     = 7   // Splice from a file into a connection's pipe
+};
+static const uint64_t URING_OP_MASK = 0x7;
+
+//==============================================================================
+// Ring setup and access
+//==============================================================================
+typedef struct UringRing {
+  int                  fd;            // io_uring file descriptor
+  unsigned*            sq_head;       // Submission queue ring
+  unsigned*            sq_tail;
+  unsigned             sq_mask;
+  unsigned             sq_entries;
+  unsigned             sq_pending;    // Tail including SQEs not yet published
+  struct io_uring_sqe* sqes;
+  unsigned*            cq_head;       // Completion queue ring
+  unsigned*            cq_tail;
+  unsigned             cq_mask;
+  struct io_uring_cqe* cqes;
+  void*                sq_ptr;        // Mapped regions, for unmapping
+  size_t               sq_size;
+  void*                cq_ptr;
+  size_t               cq_size;
+  size_t               sqes_size;
+  int                  inflight;      // Operations that will post a final CQE
+} UringRing;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+  return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, void* arg, size_t argsz)
+{
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_ring_close(UringRing* ring) {
+  if(ring->sqes) munmap(ring->sqes, ring->sqes_size);
+  if(ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+  if(ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_size);
+  if(ring->fd != -1) close(ring->fd);
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+static Status uring_ring_init(UringRing* ring, unsigned entries) {
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+
+  // Ask for cheap task-work handling first, then fall back to plain setup on
+  // kernels that don't know those flags
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+  p.cq_entries = entries * 4;
+  ring->fd = sys_io_uring_setup(entries, &p);
+  if(ring->fd == -1 && errno == EINVAL) {
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;
+    ring->fd = sys_io_uring_setup(entries, &p);
+  }
+  if(ring->fd == -1) return get_status(false);
+
+  // Waits are bounded by the next connection deadline, which needs a timeout
+  // argument to io_uring_enter()
+  if(!(p.features & IORING_FEAT_EXT_ARG)) {
+    close(ring->fd);
+    ring->fd = -1;
+    return make_status(false, ENOSYS);
+  }
+
+  // Map the rings. Newer kernels share one mapping for both.
+  ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    if(ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+    ring->cq_size = ring->sq_size;
+  }
+  ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if(ring->sq_ptr == MAP_FAILED) {
+    ring->sq_ptr = NULL;
+    Status status = get_status(false);
+    uring_ring_close(ring);
+    return status;
+  }
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ptr = ring->sq_ptr;
+  }
+  else {
+    ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if(ring->cq_ptr == MAP_FAILED) {
+      ring->cq_ptr = NULL;
+      Status status = get_status(false);
+      uring_ring_close(ring);
+      return status;
+    }
+  }
+  ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if(ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    Status status = get_status(false);
+    uring_ring_close(ring);
+    return status;
+  }
+
+  char* sq = ring->sq_ptr;
+  char* cq = ring->cq_ptr;
+  ring->sq_head    = (unsigned*)(sq + p.sq_off.head);
+  ring->sq_tail    = (unsigned*)(sq + p.sq_off.tail);
+  ring->sq_mask    = *(unsigned*)(sq + p.sq_off.ring_mask);
+  ring->sq_entries = p.sq_entries;
+  ring->sq_pending = *ring->sq_tail;
+  ring->cq_head    = (unsigned*)(cq + p.cq_off.head);
+  ring->cq_tail    = (unsigned*)(cq + p.cq_off.tail);
+  ring->cq_mask    = *(unsigned*)(cq + p.cq_off.ring_mask);
+  ring->cqes       = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  // SQ slots map one-to-one onto SQEs, so the index array never changes
+  unsigned* array = (unsigned*)(sq + p.sq_off.array);
+  for(unsigned i=0; i<p.sq_entries; ++i) array[i] = i;
+  return get_status(true);
+}
+
+// Publish queued SQEs and submit them, optionally waiting for completions.
+// - Waits at most 'timeout_ms' milliseconds, or forever if it's negative. A
+//   wait that times out fails with ETIME.
+static Status uring_ring_submit(UringRing* ring, unsigned wait_for, int timeout_ms) {
+  const unsigned to_submit = ring->sq_pending - *ring->sq_tail;
+  __atomic_store_n(ring->sq_tail, ring->sq_pending, __ATOMIC_RELEASE);
+  if(to_submit == 0 && wait_for == 0) return make_status(true, 0);
+
+  unsigned flags = (wait_for ? IORING_ENTER_GETEVENTS : 0);
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  if(wait_for && timeout_ms >= 0) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    flags |= IORING_ENTER_EXT_ARG;
+  }
+  const int result = sys_io_uring_enter(ring->fd, to_submit, wait_for, flags,
+                                        (flags & IORING_ENTER_EXT_ARG ? &arg : NULL),
+                                        (flags & IORING_ENTER_EXT_ARG ? sizeof(arg) : 0));
+  return get_status(result != -1);
+}
+
+// Get a cleared SQE to fill in. If the submission queue is full, submit what's
+// queued to make room.
+static struct io_uring_sqe* uring_ring_get_sqe(UringRing* ring) {
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  if(ring->sq_pending - head >= ring->sq_entries) {
+    uring_ring_submit(ring, 0, -1);
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if(ring->sq_pending - head >= ring->sq_entries) return NULL;
+  }
+  struct io_uring_sqe* sqe = &ring->sqes[ring->sq_pending & ring->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sq_pending += 1;
+  ring->inflight += 1;
+  return sqe;
+}
+
+//==============================================================================
+// Provided buffer ring
+//==============================================================================
+typedef struct UringBuffers {
+  struct io_uring_buf_ring* ring;       // Ring shared with the kernel
+  size_t                    ring_size;  // Size of the ring mapping
+  char*                     base;       // Buffer memory
+  uint16_t                  tail;       // Our copy of the ring tail
+} UringBuffers;
+
+// Hand buffer 'bid' (back) to the kernel
+static void uring_buffers_add(UringBuffers* bufs, uint16_t bid) {
+  struct io_uring_buf* buf = &bufs->ring->bufs[bufs->tail & (URING_NUM_BUFFERS - 1)];
+  buf->addr = (uint64_t)(uintptr_t)(bufs->base + (size_t)bid * URING_BUFFER_SIZE);
+  buf->len = URING_BUFFER_SIZE;
+  buf->bid = bid;
+  bufs->tail += 1;
+  __atomic_store_n(&bufs->ring->tail, bufs->tail, __ATOMIC_RELEASE);
+}
+
+static void uring_buffers_free(UringBuffers* bufs) {
+  if(bufs->ring) munmap(bufs->ring, bufs->ring_size);
+  if(bufs->base) free(bufs->base);
+  memset(bufs, 0, sizeof(*bufs));
+}
+
+static Status uring_buffers_init(UringBuffers* bufs, UringRing* ring) {
+  memset(bufs, 0, sizeof(*bufs));
+
+  // The ring must be page-aligned, which anonymous mmap guarantees
+  bufs->ring_size = URING_NUM_BUFFERS * sizeof(struct io_uring_buf);
+  bufs->ring = mmap(NULL, bufs->ring_size, PROT_READ | PROT_WRITE,
+                    MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if(bufs->ring == MAP_FAILED) {
+    bufs->ring = NULL;
+    return get_status(false);
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)bufs->ring;
+  reg.ring_entries = URING_NUM_BUFFERS;
+  reg.bgid = URING_BUFFER_GROUP;
+  if(sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+    Status status = get_status(false);
+    uring_buffers_free(bufs);
+    return status;
+  }
+
+  bufs->base = malloc((size_t)URING_NUM_BUFFERS * URING_BUFFER_SIZE);
+  for(unsigned i=0; i<URING_NUM_BUFFERS; ++i) {
+    uring_buffers_add(bufs, i);
+  }
+  return get_status(true);
+}
+
+//==============================================================================
+// Engine state
+//==============================================================================
+// Per-connection engine state, stored in Connection::engine_data
+// - io_uring has no sendfile operation. Files are sent in two splices instead,
+//   through a pipe created the first time the connection sends one: file to
+//   pipe (URING_OP_FILL), then pipe to socket (URING_OP_SEND).
+typedef struct UringConn {
+  Connection*   conn;          // The connection
+  bool          recv_armed;    // Is a multishot recv outstanding?
+  bool          recv_paused;   // Has the recv been cancelled because in_buf is full?
+  bool          send_armed;    // Is a send (or fill) outstanding?
+  bool          read_closed;   // Has the peer shut down its side?
+  bool          closing;       // Being closed; freed once nothing is outstanding
+  struct msghdr msg;           // Outstanding send, which must stay put until
+  struct iovec  iov[URING_MAX_SEND_IOV];  //   the kernel is done with it
+  int           pipe[2];       // Pipe for sending files, or -1s if none yet
+  size_t        pipe_len;      // File bytes in the pipe, not yet sent
+} UringConn;
+
+static UringConn* uring_conn_new(Connection* conn) {
+  UringConn* uc = calloc(1, sizeof(UringConn));
+  uc->conn = conn;
+  uc->pipe[0] = -1;
+  uc->pipe[1] = -1;
+  conn->engine_data = uc;
+  return uc;
+}
+
+static void uring_conn_free(UringConn* uc) {
+  if(uc->pipe[0] != -1) {
+    close(uc->pipe[0]);
+    close(uc->pipe[1]);
+  }
+  free(uc);
+}
+
+typedef struct UringEngine {
+  Worker*      worker;
+  UringRing    ring;
+  UringBuffers bufs;
+  bool         accept_armed;   // Is the multishot accept outstanding?
+} UringEngine;
+
+static uint64_t uring_user_data(void* ptr, enum EUringOp op) {
+  return (uint64_t)(uintptr_t)ptr | op;
+}
+
+//==============================================================================
+// Submitting operations
+//==============================================================================
+static void uring_engine_start_close(UringEngine* e, UringConn* uc);
+
+static void uring_engine_arm_accept(UringEngine* e) {
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = e->worker->server->fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = uring_user_data(NULL, URING_OP_ACCEPT);
+  e->accept_armed = true;
+}
+
+static void uring_engine_arm_recv(UringEngine* e, UringConn* uc) {
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = uc->conn->socket.fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BUFFER_GROUP;
+  sqe->user_data = uring_user_data(uc, URING_OP_RECV);
+  uc->recv_armed = true;
+}
+
+// Splice 'len' bytes from 'fd_in' to 'fd_out'. An offset of -1 means the fd's
+// own position, which is the only option for pipes and sockets.
+static void uring_engine_arm_splice(UringEngine* e, UringConn* uc, int fd_in, int64_t off_in,
+                                    int fd_out, size_t len, enum EUringOp op)
+{
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  sqe->opcode = IORING_OP_SPLICE;
+  sqe->splice_fd_in = fd_in;
+  sqe->splice_off_in = off_in;
+  sqe->fd = fd_out;
+  sqe->off = -1;
+  sqe->len = len;
+  sqe->user_data = uring_user_data(uc, op);
+  uc->send_armed = true;
+}
+
+static void uring_engine_arm_send(UringEngine* e, UringConn* uc) {
+  // Drain the pipe first; it holds the start of the file segment
+  if(uc->pipe_len > 0) {
+    uring_engine_arm_splice(e, uc, uc->pipe[0], -1, uc->conn->socket.fd, uc->pipe_len,
+                            URING_OP_SEND);
+    return;
+  }
+  int fd;
+  off_t offset;
+  size_t len;
+  if(connection_output_file(uc->conn, &fd, &offset, &len)) {
+    if(uc->pipe[0] == -1 && pipe2(uc->pipe, O_CLOEXEC) == -1) {
+      // The caller frees the connection once it's done with it
+      log_err("Error creating pipe (errno: %i)", errno);
+      uc->pipe[0] = -1;
+      uring_engine_start_close(e, uc);
+      return;
+    }
+    if(len > URING_SPLICE_SIZE) len = URING_SPLICE_SIZE;
+    uring_engine_arm_splice(e, uc, fd, offset, uc->pipe[1], len, URING_OP_FILL);
+    return;
+  }
+
+  const int iovcnt = connection_output_iov(uc->conn, uc->iov, URING_MAX_SEND_IOV);
+  if(iovcnt == 0) return;
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  memset(&uc->msg, 0, sizeof(uc->msg));
+  uc->msg.msg_iov = uc->iov;
+  uc->msg.msg_iovlen = iovcnt;
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = uc->conn->socket.fd;
+  sqe->addr = (uint64_t)(uintptr_t)&uc->msg;
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  if(connection_output_file_follows(uc->conn, iovcnt)) sqe->msg_flags |= MSG_MORE;
+  sqe->user_data = uring_user_data(uc, URING_OP_SEND);
+  uc->send_armed = true;
+}
+
+static void uring_engine_arm_shutdown(UringEngine* e) {
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = e->worker->shutdown_fd;
+  sqe->poll32_events = POLLIN;
+  sqe->user_data = uring_user_data(NULL, URING_OP_SHUTDOWN);
+}
+
+// Cancel a connection's multishot recv, to stop filling its input buffer
+static void uring_engine_pause_recv(UringEngine* e, UringConn* uc) {
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = uring_user_data(uc, URING_OP_RECV);
+  sqe->user_data = uring_user_data(NULL, URING_OP_CANCEL);
+  uc->recv_paused = true;
+}
+
+// Cancel every outstanding operation on the ring
+static void uring_engine_cancel_all(UringEngine* e) {
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+  sqe->user_data = uring_user_data(NULL, URING_OP_CANCEL);
+}
+
+// Post a completion after 'ms' milliseconds, to bound a wait
+static void uring_engine_arm_timeout(UringEngine* e, struct __kernel_timespec* ts, int ms) {
+  struct io_uring_sqe* sqe = uring_ring_get_sqe(&e->ring);
+  if(!sqe) return;
+  ts->tv_sec = ms / 1000;
+  ts->tv_nsec = (ms % 1000) * 1000000L;
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->addr = (uint64_t)(uintptr_t)ts;
+  sqe->len = 1;
+  sqe->user_data = uring_user_data(NULL, URING_OP_TIMEOUT);
+}
+
+//==============================================================================
+// Connection lifecycle
+//==============================================================================
+// Free a connection once the kernel holds no more references to it
+static void uring_engine_maybe_free(UringEngine* e, UringConn* uc) {
+  if(uc->closing && !uc->recv_armed && !uc->send_armed) {
+    worker_close_connection(e->worker, uc->conn);
+    uring_conn_free(uc);
+  }
+}
+
+// Start closing a connection. Shutting the socket down makes any outstanding
+// recv or send complete, after which the connection is freed.
+static void uring_engine_start_close(UringEngine* e, UringConn* uc) {
+  if(uc->closing) return;
+  uc->closing = true;
+  worker_cancel_deadline(e->worker, uc->conn);
+  shutdown(uc->conn->socket.fd, SHUT_RDWR);
+}
+
+// Same, and free it right away if nothing is outstanding. Also called when
+// an operation on a closing connection fails, since it may be the last one.
+static void uring_engine_close(UringEngine* e, UringConn* uc) {
+  uring_engine_start_close(e, uc);
+  uring_engine_maybe_free(e, uc);
+}
+
+// Start a send if there's queued output, keep receiving only while the input
+// buffer has room, and push the deadline back to account for the IO.
+// - Requests held back by the pipelining limit can fill in_buf. Like epoll,
+//   which stops reading at that point, we stop the recv until there's room.
+static void uring_engine_after_io(UringEngine* e, UringConn* uc) {
+  if(uc->closing) return;
+  Connection* conn = uc->conn;
+  const bool input_full = (conn->in_len >= e->worker->config->max_request_size);
+
+  if(!uc->send_armed && connection_has_output(conn)) {
+    uring_engine_arm_send(e, uc);
+    if(uc->closing) return;
+  }
+  if(uc->recv_armed && input_full && !uc->recv_paused) {
+    uring_engine_pause_recv(e, uc);
+  }
+  else if(!uc->recv_armed && !input_full && !uc->read_closed) {
+    uring_engine_arm_recv(e, uc);
+  }
+
+  // A stream that yielded with nothing to send has no completion to wake it.
+  // It goes on after the rest of this batch.
+  if(conn->yielded && !uc->send_armed) worker_defer(e->worker, conn);
+  worker_update_deadline(e->worker, conn);
+}
+
+// A deferred connection's turn has come round again: have the webserver carry
+// on with its stream
+static void uring_engine_on_ready(Connection* conn, void* arg) {
+  UringEngine* e = arg;
+  UringConn* uc = conn->engine_data;
+  if(uc->closing) return;
+  if(!connection_has_output(conn) && !webserver_on_output(conn, e->worker->config)) {
+    uring_engine_close(e, uc);
+    return;
+  }
+  uring_engine_after_io(e, uc);
+  uring_engine_maybe_free(e, uc);
+}
+
+// A connection ran out of time: start closing it
+static void uring_engine_on_expired(Connection* conn, void* arg) {
+  uring_engine_close(arg, conn->engine_data);
+}
+
+//==============================================================================
+// Completion handlers
+//==============================================================================
+static void uring_engine_on_accept(UringEngine* e, const struct io_uring_cqe* cqe) {
+  if(!(cqe->flags & IORING_CQE_F_MORE)) e->accept_armed = false;
+
+  if(cqe->res < 0) {
+    if(cqe->res != -ECANCELED && cqe->res != -EAGAIN && cqe->res != -ECONNABORTED) {
+      log_err("Error accepting incoming connection (errno: %i)", -cqe->res);
+    }
+  }
+  else {
+    ClientSocket client;
+    client_socket_attach(&client, cqe->res);
+
+    UringConn* uc = uring_conn_new(worker_add_connection(e->worker, &client));
+    uring_engine_arm_recv(e, uc);
+  }
+
+  // The kernel ends a multishot accept on errors; start another
+  if(!e->accept_armed && worker_keep_running(e->worker)) {
+    uring_engine_arm_accept(e);
+  }
+}
+
+static void uring_engine_on_recv(UringEngine* e, UringConn* uc,
+                                 const struct io_uring_cqe* cqe)
+{
+  Connection* conn = uc->conn;
+  WebServerConfig* config = e->worker->config;
+  const bool was_paused = uc->recv_paused;
+  if(!(cqe->flags & IORING_CQE_F_MORE)) {
+    uc->recv_armed = false;
+    uc->recv_paused = false;
+  }
+
+  bool keep_open = true;
+  if(cqe->res > 0) {
+    // Copy the data out and hand the buffer straight back to the kernel.
+    // Data may still arrive past max_request_size while the recv is being
+    // paused; it's kept, since it may hold pipelined requests.
+    const uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    if(!uc->closing) {
+      const char* data = e->bufs.base + (size_t)bid * URING_BUFFER_SIZE;
+      connection_append_input(conn, data, cqe->res);
+    }
+    uring_buffers_add(&e->bufs, bid);
+    if(!uc->closing) keep_open = webserver_on_input(conn, config, false);
+  }
+  else if(cqe->res == 0) {
+    uc->read_closed = true;
+    if(!uc->closing) keep_open = webserver_on_input(conn, config, true);
+  }
+  else if(cqe->res != -ENOBUFS && !(cqe->res == -ECANCELED && was_paused)) {
+    // Out of buffers just means the recv must be re-armed, and so does our own
+    // pause. Anything else (including other cancellation) ends the connection.
+    keep_open = false;
+  }
+
+  // Closing may free the connection, so it must be the last thing we do
+  if(!keep_open) {
+    uring_engine_close(e, uc);
+    return;
+  }
+  uring_engine_after_io(e, uc);
+  uring_engine_maybe_free(e, uc);
+}
+
+static void uring_engine_on_send(UringEngine* e, UringConn* uc,
+                                 const struct io_uring_cqe* cqe)
+{
+  uc->send_armed = false;
+  if(cqe->res < 0) {
+    uring_engine_close(e, uc);
+    return;
+  }
+  if(uc->pipe_len > 0) uc->pipe_len -= cqe->res;
+
+  // Once everything queued is out, the webserver closes the connection or
+  // moves on to requests it held back
+  connection_output_sent(uc->conn, cqe->res);
+  if(!uc->closing && !connection_has_output(uc->conn) &&
+     !webserver_on_output(uc->conn, e->worker->config))
+  {
+    uring_engine_close(e, uc);
+    return;
+  }
+  uring_engine_after_io(e, uc);
+  uring_engine_maybe_free(e, uc);
+}
+
+// File bytes are in the pipe: send them
+static void uring_engine_on_fill(UringEngine* e, UringConn* uc,
+                                 const struct io_uring_cqe* cqe)
+{
+  uc->send_armed = false;
+  if(cqe->res <= 0) {
+    // Zero bytes means the file was truncated since it was opened
+    uring_engine_close(e, uc);
+    return;
+  }
+  uc->pipe_len = cqe->res;
+  uring_engine_after_io(e, uc);
+  uring_engine_maybe_free(e, uc);
+}
+
+// Dispatch one completion. Returns the operation that completed.
+static enum EUringOp uring_engine_on_cqe(UringEngine* e, const struct io_uring_cqe* cqe) {
+  const enum EUringOp op = cqe->user_data & URING_OP_MASK;
+  UringConn* uc = (UringConn*)(uintptr_t)(cqe->user_data & ~URING_OP_MASK);
+  if(!(cqe->flags & IORING_CQE_F_MORE)) e->ring.inflight -= 1;
+
+  switch(op) {
+    case URING_OP_ACCEPT: uring_engine_on_accept(e, cqe);   break;
+    case URING_OP_RECV:   uring_engine_on_recv(e, uc, cqe); break;
+    case URING_OP_SEND:   uring_engine_on_send(e, uc, cqe); break;
+    case URING_OP_FILL:   uring_engine_on_fill(e, uc, cqe); break;
+    default:              break;  // Nothing to do for the others
+  }
+  return op;
+}
+
+// Handle every completion that's ready.
+// - Returns true if one of them was a URING_OP_TIMEOUT.
+static bool uring_engine_reap(UringEngine* e) {
+  UringRing* ring = &e->ring;
+  unsigned head = *ring->cq_head;
+  const unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  bool timed_out = false;
+  while(head != tail) {
+    // Copy the CQE so the slot can be released before handlers submit more
+    const struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+    head += 1;
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    if(uring_engine_on_cqe(e, &cqe) == URING_OP_TIMEOUT) timed_out = true;
+  }
+  return timed_out;
+}
+
+//==============================================================================
+// Engine
+//==============================================================================
+Status uring_engine_run(Worker* worker) {
+  UringEngine e;
+  memset(&e, 0, sizeof(e));
+  e.worker = worker;
+  worker_start_timers(worker);
+
+  Status status = uring_ring_init(&e.ring, URING_QUEUE_DEPTH);
+  if(!status.ok) return status;
+  status = uring_buffers_init(&e.bufs, &e.ring);
+  if(!status.ok) {
+    uring_ring_close(&e.ring);
+    return status;
+  }
+
+  uring_engine_arm_accept(&e);
+  uring_engine_arm_shutdown(&e);
+
+  // Submit everything queued while handling the last batch of completions, and
+  // wait for at least one more (or the next connection deadline), in a single
+  // syscall. Don't wait if there are deferred connections to get back to.
+  while(worker_keep_running(worker)) {
+    status = uring_ring_submit(&e.ring, (worker->ready ? 0 : 1), worker_next_timeout(worker));
+    if(!status.ok && status.errnum != EINTR && status.errnum != EAGAIN &&
+       status.errnum != EBUSY && status.errnum != ETIME)
+    {
+      log_err("Worker %i: error submitting to io_uring (errno: %i)", worker->id, status.errnum);
+      break;
+    }
+    uring_engine_reap(&e);
+    worker_run_ready(worker, uring_engine_on_ready, &e);
+    worker_expire_timers(worker, uring_engine_on_expired, &e);
+  }
+
+  // Cancel what's outstanding, shut down every connection, and wait (up to a
+  // second) for the kernel to let go of them before freeing anything
+  struct __kernel_timespec drain_timeout;
+  uring_engine_cancel_all(&e);
+  uring_engine_arm_timeout(&e, &drain_timeout, 1000);
+  for(Connection* conn = worker->open_connections; conn; conn = conn->next) {
+    UringConn* uc = conn->engine_data;
+    if(!uc->closing) {
+      uc->closing = true;
+      shutdown(conn->socket.fd, SHUT_RDWR);
+    }
+  }
+  while(e.ring.inflight > 1) {
+    status = uring_ring_submit(&e.ring, 1, -1);
+    if(!status.ok && status.errnum != EINTR) break;
+    if(uring_engine_reap(&e)) break;
+  }
+
+  // Anything still open couldn't be reclaimed from the kernel; close it anyway
+  while(worker->open_connections) {
+    UringConn* uc = worker->open_connections->engine_data;
+    worker_close_connection(worker, worker->open_connections);
+    uring_conn_free(uc);
+  }
+  uring_ring_close(&e.ring);
+  uring_buffers_free(&e.bufs);
+  return make_status(true, 0);
+}
@@ -0,0 +1,24 @@
+//==============================================================================
+// io_uring IO engine. Instead of one syscall per accept/recv/send, the worker
+// queues operations on a submission ring and submits them in one batch per
+// loop iteration, then handles whatever has completed.
+//
+// - Accepts use a single multishot accept on the listening socket.
+// - Receives use multishot recv with a provided buffer ring, so the kernel
+//   picks a buffer only once data arrives and idle connections pin no memory.
+// - Sends use sendmsg on the connection's queued output.
+//
+// Requires Linux 6.0 or later. The engine talks to the kernel directly with
+// io_uring_setup(2), io_uring_enter(2) and io_uring_register(2).
+//==============================================================================
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include "status.h"
+#include "worker.h"
+
+// Run the worker until the server shuts down.
+// - Fails without running if io_uring can't be set up.
+Status uring_engine_run(Worker* worker);
+
+#endif // URING_ENGINE_H
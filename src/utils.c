@@ -2,7 +2,6 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 const char* safe_cstr(const char* s) {
   return (s ? s : "");
@@ -28,10 +27,14 @@ char* trim(char* str) {
   return str;
 }
 
-const char* timestamp(timebuf_t buffer) {
-  time_t rawtime;
-  time(&rawtime);
-  struct tm* timeinfo = gmtime(&rawtime);
-  strftime(buffer, 22, "%Y%m%d-%H:%M:%S UTC", timeinfo);
-  return buffer;
+size_t format_uint(char* buf, uint64_t value) {
+  // Write the digits backwards, then move them into place
+  char digits[20];
+  size_t len = 0;
+  do {
+    digits[sizeof(digits) - ++len] = '0' + value % 10;
+    value /= 10;
+  } while(value);
+  memcpy(buf, digits + sizeof(digits) - len, len);
+  return len;
 }
@@ -6,7 +6,8 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-typedef char timebuf_t[22];
+#include <stddef.h>
+#include <stdint.h>
 
 // Return the input string, or "" if input is null
 const char* safe_cstr(const char* s);
@@ -17,9 +18,9 @@ const char* safe_cstr(const char* s);
 // - Returns NULL if input is NULL.
 char* trim(char* str);
 
-// Construct and return a timestamp string.
-// - Fills the 'buffer' param with the string.
-// - Returns a pointer to the first character in the input buffer.
-const char* timestamp(timebuf_t buffer);
+// Write the decimal digits of 'value' to 'buf', without a null terminator.
+// - 'buf' must have room for 20 characters.
+// - Returns the number of characters written.
+size_t format_uint(char* buf, uint64_t value);
 
 #endif // UTILS_H
\ No newline at end of file
@@ -1,26 +1,44 @@
 #include "webserver.h"
+#include "access_log.h"
+#include "clock.h"
+#include "connection.h"
+#include "file_cache.h"
+#include "gzip_stream.h"
+#include "http_parser.h"
 #include "http_request.h"
-#include "http_response.h"
+#include "http_request_view.h"
+#include "http_response_builder.h"
 #include "sockets.h"
+#include "static_file.h"
 #include "logging.h"
-#include "utils.h"
+#include "response_cache.h"
+#include "response_stream.h"
+#include "worker.h"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <signal.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 //==============================================================================
 // Constants and utilities
 //==============================================================================
 // Max number of incoming connections that may be queued by the server's socket
-static const int MAX_PENDING_CONNS = 100;
+static const int MAX_PENDING_CONNS = 1024;
 
-// Path to the files to serve   //TODO - make this configurable!
-//static const char* FILE_STORAGE_ROOT = "/Users/evan/dev/webserver/sites";
+// Max number of arena chunks each worker keeps for reuse
+static const size_t MAX_SPARE_ARENA_CHUNKS = 256;
+
+// What every response says in its Server header
+static const char SERVER_NAME[] = "webserver";
 
 // Check status. On error, print mesage and return from calling function.
 #define return_on_error(status, errmsg) \
@@ -29,153 +47,723 @@ if(!status.ok) { \
   return; \
 }
 
+// Responses that are the same every time, shared by all workers
+static ResponseCache response_cache = RESPONSE_CACHE_INITIALIZER(SERVER_NAME);
+
+// Open files under the document root, shared by all workers. Set up by
+// webserver_start(); until then, files are opened for every request.
+static FileCache file_cache;
+static bool file_cache_ready = false;
+
 //==============================================================================
 // Signal handling
 //==============================================================================
-// Objects for the signal handler to manipulate
-static bool keep_running = true;
-static ClientSocket* curr_client_socket = NULL;
-static ServerSocket* curr_server_socket = NULL;
+// Every worker checks this flag whenever its IO engine wakes up
+static volatile sig_atomic_t keep_running = true;
 
-// Upon receipt of a signal, close sockets and have the webserver stop running
-void handle_signal(int sig) {
+// Signal that stopped the server, for logging once the workers have exited
+static volatile sig_atomic_t received_signal = 0;
+
+// eventfd registered with every worker's event loop. Writing to it wakes all
+// the workers, whichever thread the signal was delivered to.
+static int shutdown_fd = -1;
+
+// Tell all workers to stop. Async-signal-safe.
+static void stop_workers() {
   keep_running = false;
-  log_all("Received signal %i. Shutting down.", sig);
-  if(curr_client_socket) {
-    client_socket_close(curr_client_socket);
-  }
-  if(curr_server_socket) {
-    server_socket_close(curr_server_socket);
+  if(shutdown_fd != -1) {
+    const uint64_t one = 1;
+    ssize_t ignored = write(shutdown_fd, &one, sizeof(one));
+    (void)ignored;
   }
 }
 
+// Upon receipt of a signal, have the webserver stop running. Only
+// async-signal-safe calls are allowed here, so logging happens after shutdown.
+void handle_signal(int sig) {
+  received_signal = sig;
+  stop_workers();
+}
+
 //==============================================================================
 // Webserver request-handling and response functions
 //==============================================================================
 // This function routes the request to the proper function below
-void webserver_process_request(HttpRequest* request, ClientSocket* client,
+void webserver_process_request(const HttpRequestView* request, Connection* conn,
                                WebServerConfig* config);
 
 // Handle different HTTP methods, or a bad request
-void webserver_process_get    (HttpRequest* request, ClientSocket* client);
-void webserver_process_head   (HttpRequest* request, ClientSocket* client);
-void webserver_process_post   (HttpRequest* request, ClientSocket* client);
-void webserver_process_put    (HttpRequest* request, ClientSocket* client);
-void webserver_process_delete (HttpRequest* request, ClientSocket* client);
-void webserver_process_error  (HttpRequest* request, ClientSocket* client);
+void webserver_process_get    (const HttpRequestView* request, Connection* conn,
+                               WebServerConfig* config);
+void webserver_process_head   (const HttpRequestView* request, Connection* conn,
+                               WebServerConfig* config);
+void webserver_process_post   (const HttpRequestView* request, Connection* conn);
+void webserver_process_put    (const HttpRequestView* request, Connection* conn);
+void webserver_process_delete (const HttpRequestView* request, Connection* conn);
+void webserver_process_error  (const HttpRequestView* request, Connection* conn);
+
+// Respond with the file the request's URI maps to under the document root,
+// or an error if there isn't one. 'head_only' leaves out the body, for HEAD.
+void webserver_serve_file     (const HttpRequestView* request, Connection* conn,
+                               WebServerConfig* config, bool head_only);
 
 // Echo the request data back to the client. Useful for development/debugging.
-void webserver_echo_request   (HttpRequest* request, ClientSocket* client);
+void webserver_echo_request   (const HttpRequestView* request, Connection* conn);
 
-// Send an HTTP response
+// Queue an HTTP response on the connection
 // - Use NULL to indicate no body
 // - If content_type is NULL, use "text/plain"
-void webserver_send_response(ClientSocket* client, enum EHttpStatus status,
+// - The body must be static, e.g. a string literal. The response is cached and
+//   the body's address is part of its key.
+void webserver_send_response(Connection* conn, enum EHttpStatus status,
                              const char* body, const char* content_type);
 
+// Queue a cached response's head, followed by the headers that vary per
+// request. What's left of the response goes after them.
+static void webserver_write_cached_head(Connection* conn, const char* head, size_t head_len) {
+  static const char KEEP_ALIVE[] = "\r\nConnection: keep-alive\r\n";
+  static const char CLOSE[] = "\r\nConnection: close\r\n";
+  connection_write(conn, head, head_len);
+  connection_write(conn, "Date: ", 6);
+  connection_write(conn, clock_http_date(), CLOCK_HTTP_DATE_LEN);
+  if(conn->keep_alive) connection_write(conn, KEEP_ALIVE, sizeof(KEEP_ALIVE) - 1);
+  else                 connection_write(conn, CLOSE, sizeof(CLOSE) - 1);
+}
+
+// Build a response and queue it on the connection. The head goes in the
+// connection's arena; the body is copied only if 'copy_body' is set.
+static void webserver_queue_response(Connection* conn, enum EHttpStatus status,
+                                     const char* body, size_t body_len,
+                                     const char* content_type, bool copy_body)
+{
+  conn->response_status = status;
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &conn->arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, status);
+  http_response_builder_add_header(&res, "Server", SERVER_NAME);
+  http_response_builder_add_header(&res, "Date", clock_http_date());
+  http_response_builder_add_header(&res, "Connection", conn->keep_alive ? "keep-alive" : "close");
+  if(body) {
+    http_response_builder_add_header(&res, "Content-Type", content_type ? content_type : "text/plain");
+    http_response_builder_set_body(&res, body, body_len);
+  }
+  else {
+    http_response_builder_add_header_uint(&res, "Content-Length", 0);
+  }
+
+  // Queue the head, then the body. The event loop sends them together.
+  struct iovec iov[2];
+  const int count = http_response_builder_iov(&res, iov);
+  connection_write(conn, iov[0].iov_base, iov[0].iov_len);
+  if(count > 1) {
+    if(copy_body) connection_write(conn, iov[1].iov_base, iov[1].iov_len);
+    else          connection_write_ref(conn, iov[1].iov_base, iov[1].iov_len);
+  }
+}
+
+// Does the client already have the representation with this ETag, last
+// modified at 'mtime'? If-None-Match decides if it's there; otherwise
+// If-Modified-Since does, unless it's not a valid date or in the future.
+// (RFC 9110, section 13.2.2)
+static bool webserver_not_modified(const HttpRequestView* request, const char* etag,
+                                   time_t mtime)
+{
+  HttpSpan value;
+  if(http_request_view_find_header(request, HTTP_HEADER_IF_NONE_MATCH, &value)) {
+    return http_etag_list_match(http_request_view_ptr(request, value), value.len, etag);
+  }
+  time_t since;
+  return http_request_view_find_header(request, HTTP_HEADER_IF_MODIFIED_SINCE, &value) &&
+         clock_parse_http_date(http_request_view_ptr(request, value), value.len, &since) &&
+         mtime <= since && since <= clock_now();
+}
+
+// Should a Range header be honoured? Only if there's no If-Range, or it names
+// the representation the client has: by its ETag, which must match exactly,
+// or by its Last-Modified date. (RFC 9110, section 13.1.5)
+static bool webserver_if_range(const HttpRequestView* request, const char* etag, time_t mtime) {
+  HttpSpan value;
+  if(!http_request_view_find_header(request, HTTP_HEADER_IF_RANGE, &value)) return true;
+  const char* str = http_request_view_ptr(request, value);
+  if(value.len > 0 && str[0] == '"') {
+    return value.len == strlen(etag) && !memcmp(str, etag, value.len);
+  }
+  time_t date;
+  return clock_parse_http_date(str, value.len, &date) && date == mtime;
+}
+
+// Format a string into the connection's arena. Sets 'len' to its length.
+static char* webserver_format(Connection* conn, size_t* len, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  const int n = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  char* str = arena_alloc(&conn->arena, n + 1);
+  va_start(args, format);
+  vsnprintf(str, n + 1, format, args);
+  va_end(args);
+  *len = n;
+  return str;
+}
+
+// Queue 'len' bytes of a file's body, starting at 'offset': from memory if
+// 'data' holds it, or else from 'fd' with sendfile(). The bytes take their own
+// reference to the entry, which is released once they've been sent.
+static void webserver_write_part(Connection* conn, FileCacheEntry* entry, const char* data,
+                                 int fd, uint64_t offset, uint64_t len)
+{
+  file_cache_retain(entry);
+  if(data) connection_write_ref_release(conn, data + offset, len, file_cache_release, entry);
+  else     connection_write_file_ref(conn, fd, offset, len, file_cache_release, entry);
+}
+
+// Fill in a binary access log record for a request whose response has just
+// been queued, 'response_len' bytes of it
+static void webserver_access_record(const HttpRequestView* request, Connection* conn,
+                                    size_t response_len, AccessLogRecord* record)
+{
+  record->time = clock_now();
+  record->ip = conn->socket.addr.sin_addr.s_addr;
+  record->port = client_socket_get_port(&conn->socket);
+  record->method = request->method;
+  record->version = request->version;
+  record->status = conn->response_status;
+  record->latency_us = clock_monotonic_us() - conn->request_start_us;
+  record->bytes = response_len;
+  record->body_in = conn->response_body_in;
+  record->body_out = conn->response_body_out;
+  record->compress_us = conn->response_compress_us;
+  record->encoding = conn->response_encoding;
+  memset(record->reserved, 0, sizeof(record->reserved));
+}
+
+// Write a binary access log record
+static void webserver_write_access_record(AccessLogRecord* record, const char* uri,
+                                          size_t uri_len)
+{
+  char buf[sizeof(AccessLogRecord) + ACCESS_LOG_MAX_URI];
+  const size_t len = access_log_encode(buf, record, uri, uri_len);
+  log_access(buf, len);
+}
+
+// Write a binary access log record for a request whose response has just been
+// queued
+static void webserver_log_access(const HttpRequestView* request, Connection* conn,
+                                 size_t response_len)
+{
+  AccessLogRecord record;
+  webserver_access_record(request, conn, response_len, &record);
+  webserver_write_access_record(&record, http_request_view_ptr(request, request->uri),
+                                request->uri.len);
+}
+
+// A file being gzipped into a streamed response, a block at a time. Its
+// access log record is written once all of it has been queued, with the
+// sizes and CPU time of the compression.
+typedef struct GzipFileStream {
+  FileCacheEntry* entry;   // Holds the file open
+  uint64_t        offset;  // How much of the file has been compressed
+  ResponseStream* out;     // Where the compressed bytes go
+  GzipStream      gzip;
+  uint64_t        compress_us;  // CPU time spent compressing so far
+  uint64_t        start_us;     // When work on the request began
+  bool            log;          // Write a binary access log record at the end?
+  AccessLogRecord record;       // The record, as far as it's known up front
+  size_t          uri_len;
+  char            uri[ACCESS_LOG_MAX_URI];
+} GzipFileStream;
+
+// GzipSink that writes to the response
+static void webserver_gzip_sink(void* arg, const void* data, size_t len) {
+  GzipFileStream* gz = arg;
+  response_stream_write(gz->out, data, len);
+}
+
+// ResponseStreamProducer that compresses the next block of the file
+static enum EResponseStreamResult webserver_gzip_produce(ResponseStream* stream, void* arg) {
+  GzipFileStream* gz = arg;
+  gz->out = stream;
+  const uint64_t size = gz->entry->file.size;
+  if(gz->offset == size) {
+    const uint64_t start = clock_thread_cpu_us();
+    const Status status = gzip_stream_finish(&gz->gzip);
+    gz->compress_us += clock_thread_cpu_us() - start;
+    return (status.ok ? RESPONSE_STREAM_DONE : RESPONSE_STREAM_ERROR);
+  }
+
+  // Zero bytes means the file was truncated since it was opened
+  char block[GZIP_STREAM_CHUNK_SIZE];
+  const size_t want = (size - gz->offset < sizeof(block) ? size - gz->offset : sizeof(block));
+  const ssize_t n = pread(gz->entry->file.fd, block, want, gz->offset);
+  if(n < 0 && errno == EINTR) return RESPONSE_STREAM_MORE;
+  if(n <= 0) return RESPONSE_STREAM_ERROR;
+  gz->offset += n;
+  const uint64_t start = clock_thread_cpu_us();
+  const Status status = gzip_stream_write(&gz->gzip, block, n);
+  gz->compress_us += clock_thread_cpu_us() - start;
+  return (status.ok ? RESPONSE_STREAM_MORE : RESPONSE_STREAM_ERROR);
+}
+
+// Write the access log record of a GzipFileStream, if it wants one. Free it,
+// and release its entry.
+static void webserver_gzip_release(void* arg) {
+  GzipFileStream* gz = arg;
+  if(gz->log) {
+    gz->record.time = clock_now();
+    gz->record.latency_us = clock_monotonic_us() - gz->start_us;
+    gz->record.bytes = gz->out->queued;
+    gz->record.body_in = gz->gzip.bytes_in;
+    gz->record.body_out = gz->gzip.bytes_out;
+    gz->record.compress_us = gz->compress_us;
+    webserver_write_access_record(&gz->record, gz->uri, gz->uri_len);
+  }
+  gzip_stream_free(&gz->gzip);
+  file_cache_release(gz->entry);
+  free(gz);
+}
+
+// Respond with a file gzipped as it's sent. Its length isn't known up front,
+// so it goes in chunks, or to an HTTP/1.0 client, until the connection closes.
+// Takes over the reference to the entry. A binary access log record for the
+// body is written once it's all been queued, rather than by the caller.
+static void webserver_stream_gzip(const HttpRequestView* request, Connection* conn,
+                                  WebServerConfig* config, FileCacheEntry* entry,
+                                  const char* etag, time_t mtime, bool head_only)
+{
+  GzipFileStream* gz = NULL;
+  if(!head_only) {
+    gz = malloc(sizeof(GzipFileStream));
+    gz->entry = entry;
+    gz->offset = 0;
+    gz->out = NULL;
+    gz->compress_us = 0;
+    if(!gzip_stream_init(&gz->gzip, Z_DEFAULT_COMPRESSION, webserver_gzip_sink, gz).ok) {
+      free(gz);
+      file_cache_release(entry);
+      webserver_send_response(conn, HTTP_STATUS_INTERNAL_SERVER_ERROR, 0, 0);
+      return;
+    }
+  }
+
+  const bool chunked = (request->version == HTTP_VERSION_1_1);
+  if(!chunked) conn->keep_alive = false;
+  char last_modified[CLOCK_HTTP_DATE_LEN + 1];
+  clock_format_http_date(mtime, last_modified);
+  conn->response_status = HTTP_STATUS_OK;
+  if(gz) {
+    gz->log = (config->access_log == ACCESS_LOG_BINARY);
+    if(gz->log) {
+      webserver_access_record(request, conn, 0, &gz->record);
+      gz->start_us = conn->request_start_us;
+      gz->uri_len = (request->uri.len < ACCESS_LOG_MAX_URI ? request->uri.len : ACCESS_LOG_MAX_URI);
+      memcpy(gz->uri, http_request_view_ptr(request, request->uri), gz->uri_len);
+      conn->response_logged = true;
+    }
+  }
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &conn->arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  http_response_builder_add_header(&res, "Server", SERVER_NAME);
+  http_response_builder_add_header(&res, "Date", clock_http_date());
+  http_response_builder_add_header(&res, "Connection", conn->keep_alive ? "keep-alive" : "close");
+  http_response_builder_add_header(&res, "Content-Type", entry->file.content_type);
+  http_response_builder_add_header(&res, "Content-Encoding", "gzip");
+  http_response_builder_add_header(&res, "ETag", etag);
+  http_response_builder_add_header(&res, "Last-Modified", last_modified);
+  http_response_builder_add_header(&res, "Vary", "Accept-Encoding");
+  if(head_only) response_stream_start(conn, &res, chunked, NULL, entry, file_cache_release);
+  else response_stream_start(conn, &res, chunked, webserver_gzip_produce, gz, webserver_gzip_release);
+}
+
+// Queue a 416 / Range Not Satisfiable, saying how big the representation is
+// (RFC 9110, section 15.5.17)
+static void webserver_queue_unsatisfiable(Connection* conn, uint64_t size, bool varies) {
+  char content_range[32];
+  snprintf(content_range, sizeof(content_range), "bytes */%" PRIu64, size);
+  conn->response_status = HTTP_STATUS_RANGE_NOT_SATISFIABLE;
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &conn->arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, HTTP_STATUS_RANGE_NOT_SATISFIABLE);
+  http_response_builder_add_header(&res, "Server", SERVER_NAME);
+  http_response_builder_add_header(&res, "Date", clock_http_date());
+  http_response_builder_add_header(&res, "Connection", conn->keep_alive ? "keep-alive" : "close");
+  http_response_builder_add_header(&res, "Content-Range", content_range);
+  if(varies) http_response_builder_add_header(&res, "Vary", "Accept-Encoding");
+  http_response_builder_add_header_uint(&res, "Content-Length", 0);
+  struct iovec iov[2];
+  http_response_builder_iov(&res, iov);
+  connection_write(conn, iov[0].iov_base, iov[0].iov_len);
+}
+
 //==============================================================================
-// Webserver
+// Connection handling
 //==============================================================================
-void webserver_start(WebServerConfig* config) {
-  const int port = config->port;
-  log_all("Initializing server on port %i", port);
+// Should the connection stay open after responding to this request?
+static bool webserver_keep_alive(const HttpRequestView* request, const Connection* conn,
+                                 const WebServerConfig* config)
+{
+  return config->keepalive_timeout_ms > 0 &&
+         conn->requests < (unsigned)config->max_keepalive_requests &&
+         http_request_view_keep_alive(request);
+}
 
-  // Set up signal handler
-  signal(SIGINT,  handle_signal);
-  signal(SIGKILL, handle_signal);
-  signal(SIGTERM, handle_signal);
+// Reject the request being received with 'status', and close the connection
+// once it's sent. If it's the body that's bad, the request has had its
+// response already: the connection just closes.
+static void webserver_reject_request(Connection* conn, enum EHttpStatus status,
+                                     const char* error, bool in_body)
+{
+  log_err("%s:%i | %s", client_socket_get_ip(&conn->socket),
+          client_socket_get_port(&conn->socket), error);
+  conn->keep_alive = false;
+  if(!in_body) webserver_send_response(conn, status, error, 0);
+  conn->state = CONNECTION_STATE_WRITING;
+}
 
-  // Make sure we can open the log files
-  echo_log_to_console(true);
-  if(!open_log_files().ok) return;
+// The request at the start of the connection's input buffer is done: drop it
+// from the buffer
+static void webserver_end_request(Connection* conn) {
+  HttpParser* parser = &conn->parser;
+  connection_consume(conn, parser->pos);
+  http_parser_reset(parser);
+}
 
-  // Create and initialize the socket
-  Status status;
-  ServerSocket server;
+// Process the request at the start of the connection's input buffer, once its
+// headers have been parsed. If a body follows, the headers are dropped from the
+// buffer, and the body goes to conn->body_handler as it arrives.
+static void webserver_handle_request(Connection* conn, WebServerConfig* config) {
+  HttpParser* parser = &conn->parser;
+  const size_t request_len = parser->pos;
+  const bool has_body = http_parser_in_body(parser);
 
-  // Set the current server socket so the signal handler can close the socket
-  curr_server_socket = &server;
+  // Only look at this request, not any that the client sent after it
+  const char next_char = conn->in_buf[request_len];
+  conn->in_buf[request_len] = 0;
 
-  // Initialize the server socket and start listening for incoming connections
-  status = server_socket_init(&server);
-  return_on_error(status, "Error initializing server socket");
+  // Print the entire request if verbose mode enabled
+  if(config->verbose) {
+    printf("------------ received ------------\n");
+    printf("%s\n", conn->in_buf);
+    printf("----------------------------------\n");
+  }
 
-  status = server_socket_bind(&server, port);
-  return_on_error(status, "Error binding socket to port");
+  // Look at the request where it sits in the input buffer
+  HttpRequestView request;
+  http_request_view_init(&request, parser, conn->in_buf);
+  conn->requests += 1;
+  conn->keep_alive = webserver_keep_alive(&request, conn, config);
 
-  status = server_socket_listen(&server, MAX_PENDING_CONNS);
-  return_on_error(status, "Error having socket listen for incoming connections");
+  // A client that asked first waits to be told to send the body. Whatever the
+  // response, the body is read, so that the connection can carry on after it.
+  if(has_body && request.version == HTTP_VERSION_1_1 &&
+     http_request_view_header_has_token(&request, HTTP_HEADER_EXPECT, "100-continue"))
+  {
+    static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    connection_write(conn, CONTINUE, sizeof(CONTINUE) - 1);
+  }
 
-  log_std("Server now listening for incoming connections on port %i", port);
+  // Log a message and process the response. A binary log record also has the
+  // response's status and size, so it's written afterwards.
+  if(config->access_log == ACCESS_LOG_TEXT) {
+    const char* ip = client_socket_get_ip(&conn->socket);
+    const int port = client_socket_get_port(&conn->socket);
+    const char* method = http_method_to_string(request.method);
+    const char* version = http_version_to_string(request.version);
+    log_std("%s:%i | %s %.*s %s", ip, port, method, (int)request.uri.len,
+            http_request_view_ptr(&request, request.uri), version);
+  }
+  const size_t queued = connection_output_len(conn);
+  conn->response_encoding = HTTP_ENCODING_IDENTITY;
+  conn->response_body_in = 0;
+  conn->response_body_out = 0;
+  conn->response_compress_us = 0;
+  conn->response_logged = false;
+  conn->body_handler = NULL;
+  webserver_process_request(&request, conn, config);
+  if(config->access_log == ACCESS_LOG_BINARY && !conn->response_logged) {
+    webserver_log_access(&request, conn, connection_output_len(conn) - queued);
+  }
+  conn->in_buf[request_len] = next_char;
+  arena_reset(&conn->arena);
 
-  // Accept incoming connections and service their requests
-  while(keep_running) {
-    // Create the client socket save it so the signal handler can close it
-    ClientSocket client;
-    client_socket_init(&client);
-    curr_client_socket = &client;
+  if(has_body) {
+    connection_consume(conn, request_len);
+    http_parser_consume(parser, request_len);
+  }
+  else {
+    webserver_end_request(conn);
+  }
+}
 
-    // Accept the next connection. On failure, try again.
-    // - If we're shutting down, skip printing the error
-    status = server_socket_accept(&server, &client);
-    if(!status.ok) {
-      if(keep_running) log_err("Error accepting incoming connection (errno: %i)", status.errnum);
-      continue;
-    }
+// Hand the piece of body the parser just found to the request's body handler,
+// and drop everything parsed so far from the input buffer. Once the body is
+// complete, so is the request.
+static void webserver_take_body(Connection* conn, bool complete) {
+  HttpParser* parser = &conn->parser;
+  if(conn->body_handler && parser->body.len > 0) {
+    conn->body_handler(conn, conn->in_buf + parser->body.off, parser->body.len);
+  }
+  if(!complete) {
+    const size_t parsed = parser->pos;
+    connection_consume(conn, parsed);
+    http_parser_consume(parser, parsed);
+    return;
+  }
+  if(conn->body_handler) conn->body_handler(conn, NULL, 0);
+  conn->body_handler = NULL;
+  webserver_end_request(conn);
+}
+
+// Set the phase that determines the connection's deadline
+static void webserver_update_phase(Connection* conn) {
+  if(connection_has_output(conn)) {
+    conn->phase = CONNECTION_PHASE_WRITE;
+  }
+  else if(http_parser_in_body(&conn->parser)) {
+    conn->phase = CONNECTION_PHASE_BODY;
+  }
+  else if(conn->in_len > 0 || conn->requests == 0) {
+    conn->phase = CONNECTION_PHASE_HEADERS;
+  }
+  else {
+    conn->phase = CONNECTION_PHASE_IDLE;
+  }
+}
 
-    // Where is the connection coming from?
-    const char* ip = client_socket_get_ip(&client);
-    const int port = client_socket_get_port(&client);
+bool webserver_on_input(Connection* conn, WebServerConfig* config, bool peer_closed) {
+  if(peer_closed) conn->read_closed = true;
 
-    // Read the incoming data
-    status = client_socket_recv(&client);
-    if(!status.ok) {
-      log_err("%s:%i | Error reading data from client (errno: %i)", ip, port, status.errnum);
-      client_socket_close(&client);
-      continue;
+  // Answer every complete request in the buffer, in order. Past the pipelining
+  // limit, or while a response is still being streamed, the rest wait until
+  // the queued responses have been sent. A request body is taken as it
+  // arrives, except while plenty of output is queued: its handler may be
+  // sending something back for each piece.
+  bool pipeline_full = false;
+  while(conn->state == CONNECTION_STATE_READING) {
+    const bool in_body = http_parser_in_body(&conn->parser);
+    if(in_body ? connection_output_len(conn) >= RESPONSE_STREAM_HIGH_WATER
+               : (conn->stream || conn->pipelined >= (unsigned)config->max_pipelined_requests))
+    {
+      pipeline_full = true;
+      break;
     }
 
-    // Check if data received. If not, log an error.
-    if(!client.data) {
-      log_err("%s:%i | Got no data from client", ip, port);
-      client_socket_close(&client);
-      continue;
+    // Carry on parsing from wherever the last call stopped. The binary access
+    // log times each request from when parsing it began.
+    if(config->access_log == ACCESS_LOG_BINARY && conn->parser.pos == 0 && !in_body) {
+      conn->request_start_us = clock_monotonic_us();
+    }
+    const enum EHttpParseResult result =
+      http_parser_execute(&conn->parser, conn->in_buf, conn->in_len);
+    if(result == HTTP_PARSE_HEADERS_COMPLETE) {
+      webserver_handle_request(conn, config);
+    }
+    else if(result == HTTP_PARSE_BODY) {
+      webserver_take_body(conn, false);
+    }
+    else if(result == HTTP_PARSE_COMPLETE) {
+      if(in_body) webserver_take_body(conn, true);
+      else        webserver_handle_request(conn, config);
+      conn->pipelined += 1;
+      if(!conn->keep_alive) conn->state = CONNECTION_STATE_WRITING;
     }
+    else if(result == HTTP_PARSE_ERROR) {
+      // A request that's well-formed, but framed in a way we can't decode, gets
+      // a 501 / Not Implemented (RFC 9112 section 6.1)
+      const enum EHttpStatus status = (conn->parser.not_implemented ? HTTP_STATUS_NOT_IMPLEMENTED
+                                                                    : HTTP_STATUS_BAD_REQUEST);
+      webserver_reject_request(conn, status, conn->parser.error, in_body);
+    }
+    else if(result == HTTP_PARSE_INCOMPLETE) {
+      if(in_body) {
+        webserver_take_body(conn, false);
+      }
+      else if(conn->in_len >= config->max_request_size) {
+        webserver_reject_request(conn, HTTP_STATUS_BAD_REQUEST, "Request too large", false);
+      }
+      break;
+    }
+  }
 
-    // Print the entire request if verbose mode enabled
-    if(config->verbose) {
-      printf("------------ received ------------\n");
-      printf("%s\n", client.data);
-      printf("----------------------------------\n");
+  // Client hung up without another complete request. Send what's queued, then
+  // close. Between requests on a persistent connection, that's just how it ends.
+  if(conn->state == CONNECTION_STATE_READING && conn->read_closed && !pipeline_full) {
+    if(!connection_has_output(conn)) {
+      if(conn->in_len == 0 && conn->requests == 0) {
+        log_err("%s:%i | Got no data from client", client_socket_get_ip(&conn->socket),
+                client_socket_get_port(&conn->socket));
+      }
+      return false;
     }
+    conn->state = CONNECTION_STATE_WRITING;
+  }
+
+  webserver_update_phase(conn);
+  return true;
+}
+
+bool webserver_on_output(Connection* conn, WebServerConfig* config) {
+  if(connection_has_output(conn)) return true;
+
+  // A response being streamed gets the next of its body
+  if(conn->stream) {
+    response_stream_pump(conn);
+    if(connection_has_output(conn) || conn->yielded) return true;
+  }
+
+  // Everything queued has been sent. Close, or carry on with requests that
+  // arrived in the meantime.
+  if(conn->state == CONNECTION_STATE_WRITING) return false;
+  return webserver_on_input(conn, config, conn->read_closed);
+}
+
+//==============================================================================
+// Workers
+//==============================================================================
+// Worker thread: run the configured IO engine until the server shuts down. If
+// io_uring can't be set up, fall back to epoll.
+static void* webserver_run_worker(void* arg) {
+  Worker* worker = arg;
+  enum EIoEngine engine = worker->config->io_engine;
 
-    // Parse the request
-    HttpRequest request;
-    http_request_init(&request);
-    bool status = http_request_parse(&request, client.data);
-
-    // If parsing succeeded, log a message and process the response
-    if(status) {
-      const char* method = http_method_to_string(request.method);
-      const char* version = http_version_to_string(request.version);
-      log_std("%s:%i | %s %s %s", ip, port, method, request.uri, version);
-      webserver_process_request(&request, &client, config);
+  Status status = io_engine_run(engine, worker);
+  if(!status.ok && engine == IO_ENGINE_IO_URING) {
+    log_err("Worker %i: io_uring unavailable (errno: %i). Falling back to epoll.",
+            worker->id, status.errnum);
+    engine = IO_ENGINE_EPOLL;
+    status = io_engine_run(engine, worker);
+  }
+  if(!status.ok) {
+    log_err("Worker %i: error running %s engine (errno: %i)", worker->id,
+            io_engine_to_string(engine), status.errnum);
+  }
+  return NULL;
+}
+
+// Create a non-blocking listening socket on the given port.
+// - If 'reuseport' is set, enable SO_REUSEPORT so other workers can bind the
+//   same port. Fails if the platform doesn't support it.
+static Status webserver_open_listener(ServerSocket* server, int port, bool reuseport) {
+  Status status = server_socket_init(server);
+  if(!status.ok) return status;
+
+  if(reuseport) status = server_socket_set_reuseport(server, true);
+  if(status.ok) status = server_socket_bind(server, port);
+  if(status.ok) status = server_socket_listen(server, MAX_PENDING_CONNS);
+  if(status.ok) status = server_socket_set_blocking(server, false);
+  if(!status.ok) server_socket_close(server);
+  return status;
+}
+
+//==============================================================================
+// Webserver
+//==============================================================================
+void webserver_start(WebServerConfig* config) {
+  const int port = config->port;
+  const int num_workers = (config->workers > 0 ? config->workers : 1);
+  log_all("Initializing server on port %i with %i %s worker(s)", port, num_workers,
+          io_engine_to_string(config->io_engine));
+
+  // Set up signal handler
+  signal(SIGINT,  handle_signal);
+  signal(SIGKILL, handle_signal);
+  signal(SIGTERM, handle_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  // Make sure we can open the log files
+  echo_log_to_console(true);
+  use_binary_access_log(config->access_log == ACCESS_LOG_BINARY);
+  if(!open_log_files().ok) return;
+
+  // Create the eventfd used to wake the workers on shutdown
+  shutdown_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(shutdown_fd == -1) {
+    log_err("Error creating shutdown eventfd (errno: %i)", errno);
+    return;
+  }
+
+  // From here on, workers log through the background writer
+  start_log_writer(config->log_overflow);
+
+  // Without inotify the cache still works, but opens every file afresh
+  Status status = file_cache_init(&file_cache, config->doc_root, SERVER_NAME,
+                                  config->file_cache_entries, config->file_cache_memory);
+  if(!status.ok) {
+    log_err("Error setting up the file cache. Caching is off. (errno: %i)", status.errnum);
+  }
+  file_cache_ready = true;
+
+  Worker* workers = calloc(num_workers, sizeof(Worker));
+  ServerSocket* servers = calloc(num_workers, sizeof(ServerSocket));
+  int num_servers = 0;
+  int num_started = 0;
+
+  // Open one SO_REUSEPORT listener per worker. If the first one fails, fall
+  // back to a single listener shared by all workers.
+  const bool reuseport = (num_workers > 1);
+  bool shared_listener = false;
+  status = webserver_open_listener(&servers[0], port, reuseport);
+  if(!status.ok && reuseport) {
+    log_err("SO_REUSEPORT unavailable (errno: %i). Sharing one listening socket.", status.errnum);
+    status = webserver_open_listener(&servers[0], port, false);
+    shared_listener = true;
+  }
+  if(status.ok) {
+    num_servers = 1;
+    if(!shared_listener) {
+      while(status.ok && num_servers < num_workers) {
+        status = webserver_open_listener(&servers[num_servers], port, true);
+        if(status.ok) ++num_servers;
+      }
     }
-    // If parsing failed, log the error and respond with a 400 / Bad Request
-    else {
-      log_err("%s:%i | %s", ip, port, request.error);
-      webserver_send_response(&client, HTTP_STATUS_BAD_REQUEST, request.error, 0);
+  }
+
+  // Start the workers
+  if(status.ok) {
+    log_std("Server now listening for incoming connections on port %i", port);
+    for(int i=0; i<num_workers; ++i) {
+      workers[i].id = i;
+      workers[i].server = &servers[num_servers > 1 ? i : 0];
+      workers[i].shared_listener = shared_listener;
+      workers[i].shutdown_fd = shutdown_fd;
+      workers[i].keep_running = &keep_running;
+      workers[i].open_connections = NULL;
+      workers[i].ready = NULL;
+      workers[i].config = config;
+      arena_pool_init(&workers[i].arenas, MAX_SPARE_ARENA_CHUNKS);
+      if(pthread_create(&workers[i].thread, NULL, webserver_run_worker, &workers[i])) {
+        log_err("Error starting worker %i", i);
+        stop_workers();
+        break;
+      }
+      ++num_started;
     }
+  }
+  else {
+    log_err("Error setting up listening socket on port %i (errno: %i)", port, status.errnum);
+  }
 
-    // Clean up: request-handling resources
-    curr_client_socket = NULL;
-    http_request_free(&request);
-    client_socket_close(&client);
+  // Wait for the workers to exit
+  for(int i=0; i<num_started; ++i) {
+    pthread_join(workers[i].thread, NULL);
+    arena_pool_free(&workers[i].arenas);
+  }
+  if(received_signal) {
+    log_all("Received signal %i. Shutting down.", received_signal);
   }
 
   // Clean up: webserver resources
-  curr_server_socket = NULL;
-  server_socket_close(&server);
+  for(int i=0; i<num_servers; ++i) {
+    server_socket_close(&servers[i]);
+  }
+  free(servers);
+  free(workers);
+  response_cache_free(&response_cache);
+  file_cache_ready = false;
+  file_cache_free(&file_cache);
+  close(shutdown_fd);
+  shutdown_fd = -1;
+  stop_log_writer();
   close_log_files();
 }
 
@@ -184,98 +772,328 @@ void webserver_start(WebServerConfig* config) {
 //   TODO - reuse shared memory location for writing responses
 //   TODO - move to a different file?
 //==============================================================================
-void webserver_process_request(HttpRequest*     request,
-                               ClientSocket*    client,
-                               WebServerConfig* config)
+void webserver_process_request(const HttpRequestView* request,
+                               Connection*            conn,
+                               WebServerConfig*       config)
 {
   // If in echo mode, echo the request info back to the user
   if(config->echo) {
-    webserver_echo_request(request, client);
+    webserver_echo_request(request, conn);
   }
   // Otherwise, respond normally
   else {
     switch(request->method) {
-      case HTTP_METHOD_GET:  webserver_process_get  (request, client); break;
-      case HTTP_METHOD_HEAD: webserver_process_head (request, client); break;
-      case HTTP_METHOD_POST: webserver_process_post (request, client); break;
-      case HTTP_METHOD_PUT:  webserver_process_put  (request, client); break;
-      default:               webserver_process_error(request, client); break;
+      case HTTP_METHOD_GET:  webserver_process_get  (request, conn, config); break;
+      case HTTP_METHOD_HEAD: webserver_process_head (request, conn, config); break;
+      case HTTP_METHOD_POST: webserver_process_post (request, conn); break;
+      case HTTP_METHOD_PUT:  webserver_process_put  (request, conn); break;
+      default:               webserver_process_error(request, conn); break;
     }
   }
 }
 
-void webserver_process_get(HttpRequest* request, ClientSocket* client) {
-  // Look up resource and return it
-  // - If found, return 200 / OK
-  // - If not, return 404 / Not Found
+void webserver_process_get(const HttpRequestView* request, Connection* conn,
+                           WebServerConfig* config)
+{
+  webserver_serve_file(request, conn, config, false);
+}
 
-  // Append request URI to FILE_STORAGE_ROOT
-  // If file exists, return it with 200 / OK
-  // Else file is missing, so return 404 / Not Found
+void webserver_process_head(const HttpRequestView* request, Connection* conn,
+                            WebServerConfig* config)
+{
+  // Same headers as GET, without the body
+  webserver_serve_file(request, conn, config, true);
+}
 
-  const char* body =
-    "<html>"
-    "<head></head>"
-    "<body><p>Hello World!</p></body>"
-    "</html>\n";
+void webserver_process_post(const HttpRequestView* request, Connection* conn) {
+  // Without a Content-Length or chunks, we can't tell where the body ends.
+  // Respond with 411 / Length Required, and close.
+  const HttpParser* parser = &conn->parser;
+  if(!parser->has_content_length && !parser->chunked) {
+    conn->keep_alive = false;
+    webserver_send_response(conn, HTTP_STATUS_LENGTH_REQUIRED, 0, 0);
+    return;
+  }
 
-  webserver_send_response(client, HTTP_STATUS_OK, body, "text/html");
+  // Respond with 501 / Not Implemented. The body is read and dropped. A body
+  // that doesn't match its framing gets the connection closed instead.
+  webserver_send_response(conn, HTTP_STATUS_NOT_IMPLEMENTED, 0, 0);
 }
 
-void webserver_process_head(HttpRequest* request, ClientSocket* client) {
-  // Look up resource and return meta-info via headers
-  // - Should be identical to meta-info returned from GET; just w/o a body
-  webserver_send_response(client, HTTP_STATUS_OK, 0, 0);
+void webserver_process_put(const HttpRequestView* request, Connection* conn) {
+  // Respond with 501 / Not Implemented
+  webserver_send_response(conn, HTTP_STATUS_NOT_IMPLEMENTED, 0, 0);
 }
 
-void webserver_process_post(HttpRequest* request, ClientSocket* client) {
-  // Respond with 501 / Not Implemented
-  webserver_send_response(client, HTTP_STATUS_NOT_IMPLEMENTED, 0, 0);
-  // NOTES:
-  // Get content length
-  // - If missing, send 411 / Length Required
-  // - If different than message body, send 400 / Bad Request
+void webserver_process_delete(const HttpRequestView* request, Connection* conn) {
+  // Respond with 404 / Not Found
+  webserver_send_response(conn, HTTP_STATUS_NOT_FOUND, 0, 0);
 }
 
-void webserver_process_put(HttpRequest* request, ClientSocket* client) {
+void webserver_process_error(const HttpRequestView* request, Connection* conn) {
   // Respond with 501 / Not Implemented
-  webserver_send_response(client, HTTP_STATUS_NOT_IMPLEMENTED, 0, 0);
+  webserver_send_response(conn, HTTP_STATUS_NOT_IMPLEMENTED, 0, 0);
 }
 
-void webserver_process_delete(HttpRequest* request, ClientSocket* client) {
-  // Respond with 404 / Not Found
-  webserver_send_response(client, HTTP_STATUS_NOT_FOUND, 0, 0);
+void webserver_serve_file(const HttpRequestView* request, Connection* conn,
+                          WebServerConfig* config, bool head_only)
+{
+  // Which precompressed siblings would the client take?
+  HttpAcceptEncoding accept;
+  HttpSpan accept_encoding;
+  if(http_request_view_find_header(request, HTTP_HEADER_ACCEPT_ENCODING, &accept_encoding)) {
+    http_accept_encoding_parse(&accept, http_request_view_ptr(request, accept_encoding),
+                               accept_encoding.len);
+  }
+  else {
+    http_accept_encoding_parse(&accept, NULL, 0);
+  }
+
+  // Get the file from the cache if there is one. Its entry holds the file
+  // open until the response is sent, then is released.
+  const char* uri = http_request_view_ptr(request, request->uri);
+  FileCacheEntry* entry = NULL;
+  const enum EHttpStatus status = (file_cache_ready ?
+    file_cache_open(&file_cache, uri, request->uri.len, &entry) :
+    file_cache_open_file(config->doc_root, uri, request->uri.len, &entry));
+  if(status != HTTP_STATUS_OK) {
+    webserver_send_response(conn, status, 0, 0);
+    return;
+  }
+
+  // Send a precompressed sibling if the client prefers one, or else gzip the
+  // file on the fly, if that's worth it. If the client accepts nothing we
+  // have, send the file as it is anyway, as most servers do, rather than a 406.
+  // A text file too big to gzip in one go is gzipped as it's sent instead.
+  const unsigned GZIP = (1u << HTTP_ENCODING_GZIP);
+  enum EHttpEncoding encoding = http_accept_encoding_choose(&accept, entry->encodings | GZIP);
+  const FileCacheCompressed* gzip = NULL;
+  const bool streamed = (encoding == HTTP_ENCODING_GZIP && !(entry->encodings & GZIP) &&
+                         file_cache_gzip_streams(entry));
+  char gzip_etag[STATIC_FILE_ETAG_SIZE + 3];
+  file_cache_gzip_etag(entry, gzip_etag);
+  bool encoded = false;
+  const StaticFile* file = NULL;
+  const char* etag = NULL;
+  time_t mtime = 0;
+  char last_modified[CLOCK_HTTP_DATE_LEN + 1];
+  for(;;) {
+    const bool on_the_fly = (encoding == HTTP_ENCODING_GZIP && !(entry->encodings & GZIP));
+    encoded = (encoding != HTTP_ENCODING_IDENTITY && encoding != HTTP_ENCODING_UNKNOWN);
+    file = (encoded && !on_the_fly ? &entry->encoded[encoding].file : &entry->file);
+    etag = (on_the_fly ? gzip_etag : encoded ? entry->encoded[encoding].etag : entry->etag);
+    mtime = (file->mtime > entry->file.mtime ? file->mtime : entry->file.mtime);
+
+    // If the client's copy is current, say so, with the headers a 200 would
+    // have had that describe the representation, and no body. A sibling is as
+    // new as the newer of it and the file.
+    if(webserver_not_modified(request, etag, mtime)) {
+      clock_format_http_date(mtime, last_modified);
+      conn->response_status = HTTP_STATUS_NOT_MODIFIED;
+      HttpResponseBuilder res;
+      http_response_builder_init(&res, &conn->arena);
+      http_response_builder_set_status(&res, HTTP_VERSION_1_1, HTTP_STATUS_NOT_MODIFIED);
+      http_response_builder_add_header(&res, "Server", SERVER_NAME);
+      http_response_builder_add_header(&res, "Date", clock_http_date());
+      http_response_builder_add_header(&res, "Connection", conn->keep_alive ? "keep-alive" : "close");
+      http_response_builder_add_header(&res, "ETag", etag);
+      http_response_builder_add_header(&res, "Last-Modified", last_modified);
+      if(file_cache_varies(entry)) http_response_builder_add_header(&res, "Vary", "Accept-Encoding");
+      struct iovec iov[2];
+      http_response_builder_iov(&res, iov);
+      connection_write(conn, iov[0].iov_base, iov[0].iov_len);
+      file_cache_release(entry);
+      return;
+    }
+
+    // Only now that the body (or at least its length) is needed, gzip it. If
+    // it doesn't get smaller, go with what else the client takes, which its
+    // copy may be of.
+    if(!on_the_fly || streamed) break;
+    uint64_t cpu_us = 0;
+    gzip = file_cache_gzip(file_cache_ready ? &file_cache : NULL, entry, &cpu_us);
+    conn->response_compress_us = cpu_us;
+    if(gzip) break;
+    encoding = http_accept_encoding_choose(&accept, entry->encodings);
+  }
+  const size_t size = (gzip ? gzip->len : file->size);
+
+  // A streamed body's size isn't known until it's been sent
+  if(encoded) conn->response_encoding = encoding;
+  if(streamed) {
+    webserver_stream_gzip(request, conn, config, entry, etag, mtime, head_only);
+    return;
+  }
+  if(encoded) {
+    conn->response_body_in = entry->file.size;
+    conn->response_body_out = size;
+  }
+
+  // A GET for parts of the file gets just those, unless If-Range says the
+  // client's copy is out of date, in which case it gets all of it. Several
+  // parts of an encoded file would each need their own Content-Encoding,
+  // which multipart/byteranges can't say, so they get all of it too.
+  HttpRange ranges[HTTP_RANGES_MAX];
+  int range_count = -1;
+  HttpSpan range;
+  if(!head_only && http_request_view_find_header(request, HTTP_HEADER_RANGE, &range) &&
+     webserver_if_range(request, etag, mtime)) {
+    range_count = http_range_parse(http_request_view_ptr(request, range), range.len, size,
+                                   ranges, HTTP_RANGES_MAX);
+    if(range_count > 1 && encoded) range_count = -1;
+  }
+  if(range_count == 0) {
+    webserver_queue_unsatisfiable(conn, size, file_cache_varies(entry));
+    file_cache_release(entry);
+    return;
+  }
+
+  // A small file may be in memory as a ready-made response. The tail is sent
+  // by reference, holding the entry until it's gone out. HEAD gets just the
+  // headers in it.
+  conn->response_status = (range_count > 0 ? HTTP_STATUS_PARTIAL_CONTENT : HTTP_STATUS_OK);
+  if(!encoded && entry->head && range_count < 0) {
+    webserver_write_cached_head(conn, entry->head, entry->head_len);
+    if(head_only) {
+      connection_write(conn, entry->tail, entry->tail_len - file->size);
+      file_cache_release(entry);
+    }
+    else {
+      connection_write_ref_release(conn, entry->tail, entry->tail_len, file_cache_release, entry);
+    }
+    return;
+  }
+
+  // The body comes from memory if it's there: the gzipped file, or a small
+  // file at the end of its ready-made response. Otherwise it's sent from the
+  // file, straight from the page cache with sendfile().
+  const char* data = (gzip ? gzip->data :
+                      !encoded && entry->head ? entry->tail + entry->tail_len - size : NULL);
+
+  // Several parts go in a multipart/byteranges body, each with a head of its
+  // own, and a closing delimiter after them (RFC 9110, section 14.6). Their
+  // heads are formatted first, to get the body's length.
+  char* part_heads[HTTP_RANGES_MAX];
+  size_t part_lens[HTTP_RANGES_MAX];
+  char boundary[32];
+  char content_type[80];
+  uint64_t body_len = size;
+  if(range_count > 1) {
+    snprintf(boundary, sizeof(boundary), "%016" PRIx64,
+             (uint64_t)(clock_monotonic_us() * 0x9e3779b97f4a7c15ull ^ (uintptr_t)conn));
+    snprintf(content_type, sizeof(content_type), "multipart/byteranges; boundary=%s", boundary);
+    body_len = 2 + 2 + strlen(boundary) + 4;  // CRLF "--" boundary "--" CRLF
+    for(int i=0; i<range_count; ++i) {
+      part_heads[i] = webserver_format(conn, &part_lens[i],
+        "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64
+        "\r\n\r\n", boundary, file->content_type, ranges[i].first, ranges[i].last, (uint64_t)size);
+      body_len += part_lens[i] + (ranges[i].last - ranges[i].first + 1);
+    }
+  }
+  else if(range_count == 1) {
+    body_len = ranges[0].last - ranges[0].first + 1;
+  }
+
+  // Queue the head, then the body. The response depends on Accept-Encoding
+  // whenever the file has another encoding, even if it's not the one sent.
+  clock_format_http_date(mtime, last_modified);
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &conn->arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, conn->response_status);
+  http_response_builder_add_header(&res, "Server", SERVER_NAME);
+  http_response_builder_add_header(&res, "Date", clock_http_date());
+  http_response_builder_add_header(&res, "Connection", conn->keep_alive ? "keep-alive" : "close");
+  http_response_builder_add_header(&res, "Content-Type",
+                                   range_count > 1 ? content_type : file->content_type);
+  if(encoded) {
+    http_response_builder_add_header(&res, "Content-Encoding", http_encoding_to_string(encoding));
+  }
+  http_response_builder_add_header_uint(&res, "Content-Length", body_len);
+  if(range_count == 1) {
+    char content_range[80];
+    snprintf(content_range, sizeof(content_range), "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64,
+             ranges[0].first, ranges[0].last, (uint64_t)size);
+    http_response_builder_add_header(&res, "Content-Range", content_range);
+  }
+  http_response_builder_add_header(&res, "ETag", etag);
+  http_response_builder_add_header(&res, "Last-Modified", last_modified);
+  if(file_cache_varies(entry)) http_response_builder_add_header(&res, "Vary", "Accept-Encoding");
+  http_response_builder_add_header(&res, "Accept-Ranges", "bytes");
+  struct iovec iov[2];
+  http_response_builder_iov(&res, iov);
+  connection_write(conn, iov[0].iov_base, iov[0].iov_len);
+
+  // Each part of the body holds its own reference to the entry
+  if(head_only) {
+    // Nothing more to send
+  }
+  else if(range_count < 0) {
+    webserver_write_part(conn, entry, data, file->fd, 0, size);
+  }
+  else if(range_count == 1) {
+    webserver_write_part(conn, entry, data, file->fd, ranges[0].first,
+                         ranges[0].last - ranges[0].first + 1);
+  }
+  else {
+    for(int i=0; i<range_count; ++i) {
+      connection_write(conn, part_heads[i], part_lens[i]);
+      webserver_write_part(conn, entry, data, file->fd, ranges[i].first,
+                           ranges[i].last - ranges[i].first + 1);
+    }
+    connection_write(conn, "\r\n--", 4);
+    connection_write(conn, boundary, strlen(boundary));
+    connection_write(conn, "--\r\n", 4);
+  }
+  file_cache_release(entry);
 }
 
-void webserver_process_error(HttpRequest* request, ClientSocket* client) {
-  // Respond with 501 / Not Implemented
-  webserver_send_response(client, HTTP_STATUS_NOT_IMPLEMENTED, 0, 0);
+// Echo each piece of a request body as it arrives
+static void webserver_echo_body(Connection* conn, const char* data, size_t len) {
+  if(data) response_stream_write(conn->stream, data, len);
+  else     response_stream_end(conn);
 }
 
-void webserver_echo_request(HttpRequest* request, ClientSocket* client) {
-  // Just send back the full HTTP request from the client
-  webserver_send_response(client, HTTP_STATUS_OK, client->data, 0);
+void webserver_echo_request(const HttpRequestView* request, Connection* conn) {
+  // Just send back the full HTTP request from the client. It's about to be
+  // consumed from the input buffer, so it's copied rather than referenced.
+  if(!http_parser_in_body(&conn->parser)) {
+    webserver_queue_response(conn, HTTP_STATUS_OK, conn->in_buf, strlen(conn->in_buf), 0, true);
+    return;
+  }
+
+  // The body follows the headers as it arrives, so the response's length isn't
+  // known up front: it goes in chunks, or until the connection closes
+  const bool chunked = (request->version == HTTP_VERSION_1_1);
+  if(!chunked) conn->keep_alive = false;
+  conn->response_status = HTTP_STATUS_OK;
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &conn->arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  http_response_builder_add_header(&res, "Server", SERVER_NAME);
+  http_response_builder_add_header(&res, "Date", clock_http_date());
+  http_response_builder_add_header(&res, "Connection", conn->keep_alive ? "keep-alive" : "close");
+  http_response_builder_add_header(&res, "Content-Type", "text/plain");
+  ResponseStream* stream = response_stream_open(conn, &res, chunked);
+  response_stream_write(stream, conn->in_buf, conn->parser.header_len);
+  conn->body_handler = webserver_echo_body;
 }
 
-void webserver_send_response(ClientSocket*    client,
+void webserver_send_response(Connection*      conn,
                              enum EHttpStatus status,
                              const char*      body,
                              const char*      content_type)
 {
-  // Build the Content-Length string
-  char content_length[20] = {0};
-  snprintf(content_length, 20, "%zu", (body ? strlen(body) : 0));
+  const size_t body_len = (body ? strlen(body) : 0);
   if(!content_type) content_type = "text/plain";
 
-  // Build the response object
-  HttpResponse* res = http_response_new();
-  http_response_set_status(res, HTTP_VERSION_1_0, status);
-  http_response_add_header(res, "Server", "webserver");
-  http_response_add_header(res, "Content-Length", content_length);
-  if(body) http_response_add_header(res, "Content-Type", content_type);
-  if(body) http_response_set_body(res, body);
-
-  // Send the response and clean up
-  client_socket_send(client, http_response_string(res), http_response_length(res));
-  http_response_free(res);
+  // Send the cached bytes, with the headers that vary in the middle
+  const CachedResponse* res =
+    response_cache_get(&response_cache, status, body, body_len, content_type);
+  if(!res) {
+    webserver_queue_response(conn, status, body, body_len, content_type, false);
+    return;
+  }
+  conn->response_status = status;
+  webserver_write_cached_head(conn, res->head, res->head_len);
+  connection_write_ref(conn, res->tail, res->tail_len);
 }
@@ -6,9 +6,29 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
+#include <stdbool.h>
+#include "connection.h"
 #include "webserver_config.h"
 
 // Start the webserver listening on a given port
 void webserver_start(WebServerConfig* config);
 
+//==============================================================================
+// Hooks called by the IO engines
+//==============================================================================
+// New bytes were appended to the connection's input buffer, or the peer shut
+// down its side ('peer_closed'). Processes any request whose headers are
+// complete, and queues the response on the connection. A request body is taken
+// from the input buffer as it arrives, which makes room for more of it.
+// - Returns false if the connection should be closed right away.
+bool webserver_on_input(Connection* conn, WebServerConfig* config, bool peer_closed);
+
+// All queued output has been sent. Queues more of a response that's being
+// streamed, if there is one: if that sets conn->yielded, call again once the
+// worker's other connections have had a turn. Otherwise, on a persistent
+// connection, processes any requests that were held back (in which case
+// there's new output to send).
+// - Returns false if the connection should be closed.
+bool webserver_on_output(Connection* conn, WebServerConfig* config);
+
 #endif // WEBSERVER_H
\ No newline at end of file
@@ -4,6 +4,21 @@ void webserver_config_init(WebServerConfig* conf) {
   conf->port = 80;
   conf->verbose = false;
   conf->echo = false;
+  conf->workers = 1;
+  conf->io_engine = IO_ENGINE_EPOLL;
+  conf->max_request_size = 64 * 1024;
+  conf->header_timeout_ms = 10 * 1000;
+  conf->body_timeout_ms = 30 * 1000;
+  conf->keepalive_timeout_ms = 5 * 1000;
+  conf->max_keepalive_requests = 100;
+  conf->max_pipelined_requests = 32;
+  conf->write_timeout_ms = 30 * 1000;
+  conf->min_throughput = 64;
+  conf->log_overflow = LOG_OVERFLOW_DROP;
+  conf->access_log = ACCESS_LOG_TEXT;
+  conf->doc_root = "/etc/webserver/sites";
+  conf->file_cache_entries = 1024;
+  conf->file_cache_memory = 64 * 1024 * 1024;
 }
 
 // TODO - we need a 3-step process to get configuration data:
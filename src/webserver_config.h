@@ -7,11 +7,31 @@
 #define WEBSERVER_CONFIG_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "access_log.h"
+#include "io_engine.h"
+#include "logging.h"
 
 typedef struct WebServerConfig {
   int  port;        // Port to listen on
   bool verbose;     // Enable verbose output
   bool echo;        // Echo the response back, for debugging
+  int  workers;     // Number of worker threads, each with its own event loop
+  enum EIoEngine io_engine;  // IO engine each worker runs
+  size_t max_request_size;   // Larger requests get a 400 / Bad Request
+  int header_timeout_ms;     // Time allowed to receive a request's headers
+  int body_timeout_ms;       // Max time without progress receiving a body
+  int keepalive_timeout_ms;  // Time an idle connection is kept open (0 = no keep-alive)
+  int max_keepalive_requests;  // Requests served per connection before closing it
+  int max_pipelined_requests;  // Responses queued per connection before we stop
+                               //   reading requests until they're sent
+  int write_timeout_ms;      // Max time without progress sending a response
+  int min_throughput;        // Slower clients are dropped (bytes/sec, 0 = off)
+  enum ELogOverflow log_overflow;  // What to do when the log buffer fills up
+  enum EAccessLogFormat access_log;  // How each request is logged
+  const char* doc_root;      // Directory of files to serve
+  int file_cache_entries;    // Max open files kept in the file cache (0 = off)
+  size_t file_cache_memory;  // Bytes of small files it keeps in memory (0 = none)
 } WebServerConfig;
 
 // Initialize the config object by setting defaults
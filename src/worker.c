@@ -0,0 +1,198 @@
+#include "worker.h"
+#include "clock.h"
+#include "logging.h"
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Resolution of the timer wheel
+static const unsigned WORKER_TIMER_TICK_MS = 100;
+
+// Minimum-throughput rule: how long a phase runs before it's checked, and how
+// often it's checked after that
+static const uint64_t MIN_THROUGHPUT_GRACE_MS = 5000;
+static const uint64_t MIN_THROUGHPUT_INTERVAL_MS = 1000;
+
+//==============================================================================
+// Deadlines
+//==============================================================================
+// Arguments passed through timer_wheel_advance() to worker_on_timer()
+typedef struct WorkerExpireArgs {
+  Worker*              worker;
+  uint64_t             now_ms;
+  WorkerExpireCallback expire;
+  void*                arg;
+} WorkerExpireArgs;
+
+// When the current phase runs out of time.
+// - Headers and idle time are limited overall, which is what stops a client
+//   from holding a connection open by sending a byte now and then.
+// - Bodies and responses may be large, so they're only limited between bytes.
+static uint64_t worker_phase_deadline(const Worker* worker, const Connection* conn) {
+  const WebServerConfig* config = worker->config;
+  switch(conn->phase) {
+    case CONNECTION_PHASE_HEADERS: return conn->phase_start_ms + config->header_timeout_ms;
+    case CONNECTION_PHASE_BODY:    return conn->progress_ms + config->body_timeout_ms;
+    case CONNECTION_PHASE_IDLE:    return conn->phase_start_ms + config->keepalive_timeout_ms;
+    case CONNECTION_PHASE_WRITE:   return conn->progress_ms + config->write_timeout_ms;
+  }
+  return conn->phase_start_ms;
+}
+
+// Does the minimum-throughput rule apply to this connection?
+static bool worker_checks_throughput(const Worker* worker, const Connection* conn) {
+  return worker->config->min_throughput > 0 && conn->phase != CONNECTION_PHASE_IDLE;
+}
+
+// When the timer should next fire: at the deadline, or at the next throughput
+// check if that's sooner. Checks are on a fixed schedule from the start of the
+// phase, so a trickle of bytes can't keep postponing them.
+static uint64_t worker_next_check(const Worker* worker, const Connection* conn,
+                                  uint64_t now_ms)
+{
+  uint64_t when = worker_phase_deadline(worker, conn);
+  if(worker_checks_throughput(worker, conn)) {
+    uint64_t check = conn->phase_start_ms + MIN_THROUGHPUT_GRACE_MS;
+    if(check <= now_ms) {
+      const uint64_t late = (now_ms - check) % MIN_THROUGHPUT_INTERVAL_MS;
+      check = now_ms + MIN_THROUGHPUT_INTERVAL_MS - late;
+    }
+    if(check < when) when = check;
+  }
+  return when;
+}
+
+// Log why a connection is being dropped
+static void worker_log_expired(Connection* conn, const char* reason) {
+  log_err("%s:%i | %s while %s", client_socket_get_ip(&conn->socket),
+          client_socket_get_port(&conn->socket), reason,
+          connection_phase_to_string(conn->phase));
+}
+
+// A connection's timer went off: drop it if it's out of time or too slow,
+// otherwise re-arm the timer
+static void worker_on_timer(Timer* timer, void* arg) {
+  WorkerExpireArgs* args = arg;
+  Worker* worker = args->worker;
+  Connection* conn = timer->data;
+  const uint64_t now = args->now_ms;
+
+  if(now >= worker_phase_deadline(worker, conn)) {
+    if(conn->phase != CONNECTION_PHASE_IDLE) worker_log_expired(conn, "Timed out");
+    args->expire(conn, args->arg);
+    return;
+  }
+
+  if(worker_checks_throughput(worker, conn)) {
+    const uint64_t elapsed = now - conn->phase_start_ms;
+    const uint64_t bytes = connection_phase_bytes(conn) - conn->phase_start_bytes;
+    if(elapsed >= MIN_THROUGHPUT_GRACE_MS &&
+       bytes * 1000 < (uint64_t)worker->config->min_throughput * elapsed)
+    {
+      worker_log_expired(conn, "Too slow");
+      args->expire(conn, args->arg);
+      return;
+    }
+  }
+
+  timer_wheel_add(&worker->timers, timer, worker_next_check(worker, conn, now));
+}
+
+//==============================================================================
+// Worker
+//==============================================================================
+bool worker_keep_running(const Worker* worker) {
+  return *worker->keep_running;
+}
+
+Connection* worker_add_connection(Worker* worker, const ClientSocket* socket) {
+  Connection* conn = connection_new(socket, &worker->arenas);
+  conn->prev = NULL;
+  conn->next = worker->open_connections;
+  if(worker->open_connections) worker->open_connections->prev = conn;
+  worker->open_connections = conn;
+
+  // Start the clock on the request headers
+  conn->phase_start_ms = conn->progress_ms = clock_monotonic_ms();
+  worker_update_deadline(worker, conn);
+  return conn;
+}
+
+// Take a connection off the ready list, if it's there
+static void worker_unready(Worker* worker, Connection* conn) {
+  if(conn->ready_prev) conn->ready_prev->ready_next = conn->ready_next;
+  if(conn->ready_next) conn->ready_next->ready_prev = conn->ready_prev;
+  if(worker->ready == conn) worker->ready = conn->ready_next;
+  conn->ready_prev = conn->ready_next = NULL;
+}
+
+void worker_close_connection(Worker* worker, Connection* conn) {
+  timer_wheel_remove(&worker->timers, &conn->timer);
+  worker_unready(worker, conn);
+  if(conn->prev) conn->prev->next = conn->next;
+  if(conn->next) conn->next->prev = conn->prev;
+  if(worker->open_connections == conn) worker->open_connections = conn->next;
+  connection_free(conn);
+}
+
+void worker_defer(Worker* worker, Connection* conn) {
+  if(conn->ready_prev || worker->ready == conn) return;
+  conn->ready_prev = NULL;
+  conn->ready_next = worker->ready;
+  if(worker->ready) worker->ready->ready_prev = conn;
+  worker->ready = conn;
+}
+
+void worker_run_ready(Worker* worker, WorkerReadyCallback service, void* arg) {
+  // Oldest first, from the back of the list to what's at the front now.
+  // Connections deferred meanwhile go on the front, ahead of that.
+  Connection* first = worker->ready;
+  Connection* conn = first;
+  while(conn && conn->ready_next) conn = conn->ready_next;
+  while(conn) {
+    Connection* prev = (conn == first ? NULL : conn->ready_prev);
+    worker_unready(worker, conn);
+    service(conn, arg);
+    conn = prev;
+  }
+}
+
+void worker_close_all_connections(Worker* worker) {
+  while(worker->open_connections) {
+    worker_close_connection(worker, worker->open_connections);
+  }
+}
+
+void worker_start_timers(Worker* worker) {
+  timer_wheel_init(&worker->timers, clock_monotonic_ms(), WORKER_TIMER_TICK_MS);
+}
+
+void worker_update_deadline(Worker* worker, Connection* conn) {
+  const uint64_t now = clock_monotonic_ms();
+  const uint64_t bytes = connection_phase_bytes(conn);
+
+  // A new phase starts its clocks over. Otherwise just note any progress.
+  if(conn->phase != conn->timer_phase) {
+    conn->timer_phase = conn->phase;
+    conn->phase_start_ms = conn->progress_ms = now;
+    conn->phase_start_bytes = conn->progress_bytes = bytes;
+  }
+  else if(bytes != conn->progress_bytes) {
+    conn->progress_ms = now;
+    conn->progress_bytes = bytes;
+  }
+  timer_wheel_add(&worker->timers, &conn->timer, worker_next_check(worker, conn, now));
+}
+
+void worker_cancel_deadline(Worker* worker, Connection* conn) {
+  timer_wheel_remove(&worker->timers, &conn->timer);
+}
+
+int worker_next_timeout(Worker* worker) {
+  return timer_wheel_next_timeout(&worker->timers, clock_monotonic_ms());
+}
+
+void worker_expire_timers(Worker* worker, WorkerExpireCallback expire, void* arg) {
+  WorkerExpireArgs args = { worker, clock_monotonic_ms(), expire, arg };
+  timer_wheel_advance(&worker->timers, args.now_ms, worker_on_timer, &args);
+}
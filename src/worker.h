@@ -0,0 +1,90 @@
+//==============================================================================
+// A Worker is one thread's share of the webserver: a listening socket (its own,
+// or one shared with the other workers) plus the connections it has accepted.
+// The IO engine that drives a worker (epoll or io_uring) moves bytes in and out
+// of each Connection and hands the buffered input to the webserver via the
+// hooks in webserver.h.
+//
+// An engine may also defer a connection that has more to do but has had a fair
+// turn, putting it on the worker's ready list to be serviced again once the
+// other connections with events have been.
+//
+// Each worker also keeps a timer wheel with a deadline for every connection.
+// Engines call worker_update_deadline() after moving a connection's bytes,
+// wait no longer than worker_next_timeout(), and then call
+// worker_expire_timers() to drop connections that have run out of time.
+//==============================================================================
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include "arena.h"
+#include "connection.h"
+#include "sockets.h"
+#include "timer_wheel.h"
+#include "webserver_config.h"
+
+typedef struct Worker {
+  int                    id;                // Worker number, from 0
+  pthread_t              thread;            // Thread running the worker
+  ServerSocket*          server;            // Listening socket (non-blocking)
+  bool                   shared_listener;   // Is 'server' shared with other workers?
+  int                    shutdown_fd;       // eventfd that becomes readable on shutdown
+  volatile sig_atomic_t* keep_running;      // Cleared when the server shuts down
+  Connection*            open_connections;  // Connections owned by this worker
+  Connection*            ready;             // Connections to service again before
+                                            //   waiting for events (see worker_defer)
+  WebServerConfig*       config;            // Server configuration
+  TimerWheel             timers;            // Connection deadlines
+  ArenaPool              arenas;            // Chunks for connections' arenas
+} Worker;
+
+// Called for each connection whose deadline has passed. The engine must close
+// it (possibly asynchronously) and must not touch its timer.
+typedef void (*WorkerExpireCallback)(Connection* conn, void* arg);
+
+// Called for each connection on the ready list
+typedef void (*WorkerReadyCallback)(Connection* conn, void* arg);
+
+// Should the worker keep running?
+bool worker_keep_running(const Worker* worker);
+
+// Create a Connection for a socket that was just accepted, and track it.
+// - Takes ownership of the socket's file descriptor.
+Connection* worker_add_connection(Worker* worker, const ClientSocket* socket);
+
+// Stop tracking a connection, close it and free it
+void worker_close_connection(Worker* worker, Connection* conn);
+
+// Put a connection on the ready list, if it isn't there already, for the
+// engine to service again once it's been through the events it has in hand.
+// It's taken off if it's closed first.
+void worker_defer(Worker* worker, Connection* conn);
+
+// Hand each connection on the ready list to 'service', taking it off the list
+// first. Connections deferred again meanwhile wait for the next call.
+void worker_run_ready(Worker* worker, WorkerReadyCallback service, void* arg);
+
+// Close and free every connection the worker owns
+void worker_close_all_connections(Worker* worker);
+
+// Reset the timer wheel. Call before running an engine.
+void worker_start_timers(Worker* worker);
+
+// Re-arm a connection's timer after IO or a change of phase
+void worker_update_deadline(Worker* worker, Connection* conn);
+
+// Stop a connection's timer, e.g. when the engine starts closing it
+void worker_cancel_deadline(Worker* worker, Connection* conn);
+
+// Milliseconds until worker_expire_timers() has work to do, or -1 for never
+int worker_next_timeout(Worker* worker);
+
+// Check every timer that's due. Connections that are past their deadline, or
+// moving bytes slower than the configured minimum throughput, are handed to
+// 'expire' for closing.
+void worker_expire_timers(Worker* worker, WorkerExpireCallback expire, void* arg);
+
+#endif // WORKER_H
@@ -4,12 +4,30 @@
 // Evan Kuhn 2012-09-09
 //==============================================================================
 #include "nu_unit.h"
+#include "test_access_log.h"
+#include "test_arena.h"
+#include "test_clock.h"
+#include "test_connection.h"
+#include "test_event_loop.h"
+#include "test_file_cache.h"
+#include "test_gzip_stream.h"
 #include "test_http_enums.h"
+#include "test_http_parser.h"
 #include "test_http_request.h"
+#include "test_http_request_view.h"
 #include "test_http_response.h"
+#include "test_http_response_builder.h"
+#include "test_http_scan.h"
+#include "test_io_engine.h"
+#include "test_log_ring.h"
+#include "test_mime_types.h"
 #include "test_program_options.h"
+#include "test_response_cache.h"
+#include "test_response_stream.h"
 #include "test_sockets.h"
+#include "test_static_file.h"
 #include "test_string.h"
+#include "test_timer_wheel.h"
 #include "test_utils.h"
 
 nu_init();
@@ -18,15 +36,33 @@ int main(int argc, char **argv) {
   nu_parse_cmdline(argc, argv);
 
   // Run all test suites
-  nu_run_suite(test_suite__http_enums,      "HttpEnums");
-  nu_run_suite(test_suite__http_header,     "HttpHeader");
-  nu_run_suite(test_suite__http_request,    "HttpRequest");
-  nu_run_suite(test_suite__http_response,   "HttpResponse");
-  nu_run_suite(test_suite__program_options, "ProgramOptions");
-  nu_run_suite(test_suite__client_socket,   "ClientSocket");
-  nu_run_suite(test_suite__server_socket,   "ServerSocket");
-  nu_run_suite(test_suite__string,          "String");
-  nu_run_suite(test_suite__utils,           "Utils");
+  nu_run_suite(test_suite__access_log,            "AccessLog");
+  nu_run_suite(test_suite__arena,                 "Arena");
+  nu_run_suite(test_suite__clock,                 "Clock");
+  nu_run_suite(test_suite__connection,            "Connection");
+  nu_run_suite(test_suite__event_loop,            "EventLoop");
+  nu_run_suite(test_suite__file_cache,            "FileCache");
+  nu_run_suite(test_suite__gzip_stream,           "GzipStream");
+  nu_run_suite(test_suite__http_enums,            "HttpEnums");
+  nu_run_suite(test_suite__http_parser,           "HttpParser");
+  nu_run_suite(test_suite__http_header,           "HttpHeader");
+  nu_run_suite(test_suite__http_request,          "HttpRequest");
+  nu_run_suite(test_suite__http_request_view,     "HttpRequestView");
+  nu_run_suite(test_suite__http_response,         "HttpResponse");
+  nu_run_suite(test_suite__http_response_builder, "HttpResponseBuilder");
+  nu_run_suite(test_suite__http_scan,             "HttpScan");
+  nu_run_suite(test_suite__io_engine,             "IoEngine");
+  nu_run_suite(test_suite__log_ring,              "LogRing");
+  nu_run_suite(test_suite__mime_types,            "MimeTypes");
+  nu_run_suite(test_suite__program_options,       "ProgramOptions");
+  nu_run_suite(test_suite__response_cache,        "ResponseCache");
+  nu_run_suite(test_suite__response_stream,       "ResponseStream");
+  nu_run_suite(test_suite__client_socket,         "ClientSocket");
+  nu_run_suite(test_suite__server_socket,         "ServerSocket");
+  nu_run_suite(test_suite__static_file,           "StaticFile");
+  nu_run_suite(test_suite__string,                "String");
+  nu_run_suite(test_suite__timer_wheel,           "TimerWheel");
+  nu_run_suite(test_suite__utils,                 "Utils");
 
   // Print results and return
   nu_print_summary();
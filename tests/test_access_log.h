@@ -0,0 +1,136 @@
+//==============================================================================
+// Binary access log tests
+//==============================================================================
+#ifndef TEST_ACCESS_LOG_H
+#define TEST_ACCESS_LOG_H
+
+#include "nu_unit.h"
+#include "access_log.h"
+#include "http_enums.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+// Helper: a record for "GET /index.html" from 10.0.0.1:5123
+AccessLogRecord access_log_test_record() {
+  AccessLogRecord record;
+  memset(&record, 0, sizeof(record));
+  record.time = 784111777;
+  record.ip = inet_addr("10.0.0.1");
+  record.port = 5123;
+  record.method = HTTP_METHOD_GET;
+  record.version = HTTP_VERSION_1_1;
+  record.status = 200;
+  record.latency_us = 120;
+  record.bytes = 59;
+  record.encoding = HTTP_ENCODING_IDENTITY;
+  return record;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__access_log_format_from_string() {
+  nu_check("text",    access_log_format_from_string("text") == ACCESS_LOG_TEXT);
+  nu_check("binary",  access_log_format_from_string("binary") == ACCESS_LOG_BINARY);
+  nu_check("unknown", access_log_format_from_string("json") == ACCESS_LOG_UNKNOWN);
+  nu_check("to string", !strcmp(access_log_format_to_string(ACCESS_LOG_BINARY), "binary"));
+}
+
+void test__access_log_encode() {
+  char buf[sizeof(AccessLogRecord) + ACCESS_LOG_MAX_URI];
+  AccessLogRecord record = access_log_test_record();
+  const size_t len = access_log_encode(buf, &record, "/index.html", 11);
+  nu_check("should write the record and URI", len == sizeof(AccessLogRecord) + 11);
+  nu_check("should set the URI length", record.uri_len == 11);
+  nu_check("should follow the record with the URI",
+           !memcmp(buf + sizeof(AccessLogRecord), "/index.html", 11));
+
+  char uri[ACCESS_LOG_MAX_URI + 10];
+  memset(uri, 'a', sizeof(uri));
+  nu_check("should truncate long URIs",
+           access_log_encode(buf, &record, uri, sizeof(uri)) == sizeof(buf) &&
+           record.uri_len == ACCESS_LOG_MAX_URI);
+}
+
+void test__access_log_read() {
+  // Write a header and two records to a file, then read them back
+  FILE* file = tmpfile();
+  nu_assert("should create a temp file", file);
+  AccessLogHeader header;
+  access_log_header(&header);
+  fwrite(&header, sizeof(header), 1, file);
+  char buf[sizeof(AccessLogRecord) + ACCESS_LOG_MAX_URI];
+  AccessLogRecord record = access_log_test_record();
+  fwrite(buf, 1, access_log_encode(buf, &record, "/index.html", 11), file);
+  record.status = 404;
+  record.body_in = 1000;
+  record.body_out = 250;
+  record.compress_us = 35;
+  record.encoding = HTTP_ENCODING_GZIP;
+  fwrite(buf, 1, access_log_encode(buf, &record, "/a\"b", 4), file);
+  rewind(file);
+
+  AccessLogRecord read;
+  char uri[ACCESS_LOG_MAX_URI + 1];
+  nu_check("should accept the header", access_log_read_header(file));
+  nu_check("should read the first record", access_log_read(file, &read, uri) == 1);
+  nu_check("should read its fields", read.port == 5123 && read.status == 200 &&
+           read.bytes == 59 && read.latency_us == 120);
+  nu_check("should read its URI", !strcmp(uri, "/index.html"));
+  nu_check("should read no compression", read.body_in == 0 && read.encoding == HTTP_ENCODING_IDENTITY);
+
+  // Check the text format with a second stream
+  FILE* out = tmpfile();
+  access_log_print_text(out, &read, uri);
+  nu_check("should read the second record", access_log_read(file, &read, uri) == 1);
+  nu_check("should read its compression", read.body_in == 1000 && read.body_out == 250 &&
+           read.compress_us == 35 && read.encoding == HTTP_ENCODING_GZIP);
+  access_log_print_text(out, &read, uri);
+  access_log_print_csv(out, &read, uri);
+  nu_check("should stop at the end of the file", access_log_read(file, &read, uri) == 0);
+
+  char line[256];
+  rewind(out);
+  nu_check("should print a text line", fgets(line, sizeof(line), out) &&
+           !strcmp(line, "19941106-08:49:37 UTC | 10.0.0.1:5123 | GET /index.html HTTP/1.1"
+                         " | 200 59 120us\n"));
+  nu_check("should print the compression", fgets(line, sizeof(line), out) &&
+           !strcmp(line, "19941106-08:49:37 UTC | 10.0.0.1:5123 | GET /a\"b HTTP/1.1"
+                         " | 404 59 120us | gzip 1000->250 25.0% 35us\n"));
+  nu_check("should print a CSV row with the URI quoted", fgets(line, sizeof(line), out) &&
+           !strcmp(line, "784111777,10.0.0.1,5123,GET,\"/a\"\"b\",HTTP/1.1,404,59,120,"
+                         "gzip,1000,250,35\n"));
+  fclose(out);
+  fclose(file);
+}
+
+void test__access_log_read__bad_input() {
+  FILE* file = tmpfile();
+  fwrite("NOPE1234", 1, 8, file);
+  rewind(file);
+  nu_check("should reject a bad header", !access_log_read_header(file));
+  fclose(file);
+
+  // A record cut off partway through
+  file = tmpfile();
+  AccessLogRecord record = access_log_test_record();
+  fwrite(&record, 1, sizeof(record) / 2, file);
+  rewind(file);
+  AccessLogRecord read;
+  char uri[ACCESS_LOG_MAX_URI + 1];
+  nu_check("should report a truncated record", access_log_read(file, &read, uri) == -1);
+  fclose(file);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__access_log() {
+  nu_run_test(test__access_log_format_from_string, "access_log_format_from_string()");
+  nu_run_test(test__access_log_encode,             "access_log_encode()");
+  nu_run_test(test__access_log_read,               "access_log_read() and printing");
+  nu_run_test(test__access_log_read__bad_input,    "access_log_read() w/ bad input");
+}
+
+#endif // TEST_ACCESS_LOG_H
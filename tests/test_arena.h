@@ -0,0 +1,135 @@
+//==============================================================================
+// Arena tests
+//==============================================================================
+#ifndef TEST_ARENA_H
+#define TEST_ARENA_H
+
+#include "nu_unit.h"
+#include "arena.h"
+#include "http_request.h"
+#include "http_response.h"
+#include <stdint.h>
+#include <string.h>
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__arena_alloc() {
+  Arena arena;
+  arena_init(&arena, NULL);
+  nu_check("should start without memory", !arena.chunks);
+
+  char* a = arena_alloc(&arena, 3);
+  char* b = arena_alloc(&arena, 40);
+  nu_check("should align allocations",
+           (uintptr_t)a % ARENA_ALIGNMENT == 0 && (uintptr_t)b % ARENA_ALIGNMENT == 0);
+  nu_check("should bump the pointer", b == a + ARENA_ALIGNMENT);
+
+  // An oversized allocation gets its own chunk, and the current one carries on
+  char* big = arena_alloc(&arena, ARENA_CHUNK_SIZE * 2);
+  memset(big, 'x', ARENA_CHUNK_SIZE * 2);
+  char* c = arena_alloc(&arena, 1);
+  nu_check("should keep using the current chunk", c == b + 48);
+
+  // Filling the chunk starts another
+  size_t allocs = 0;
+  while(arena.chunks->next->size != ARENA_CHUNK_SIZE) {
+    arena_alloc(&arena, 1000);
+    ++allocs;
+  }
+  nu_check("should fill a chunk before moving on",
+           allocs > 0 && allocs <= ARENA_CHUNK_SIZE / 1000 + 1);
+
+  char* s = arena_strndup(&arena, "hello world", 5);
+  nu_check("should copy a string", !strcmp(s, "hello"));
+  arena_free(&arena);
+  nu_check("should give back its memory", !arena.chunks);
+}
+
+void test__arena_realloc() {
+  Arena arena;
+  arena_init(&arena, NULL);
+  char* a = arena_realloc(&arena, NULL, 0, 10);
+  strcpy(a, "grow me");
+  char* grown = arena_realloc(&arena, a, 10, 100);
+  nu_check("should grow the latest allocation in place", grown == a);
+
+  arena_alloc(&arena, 1);
+  char* moved = arena_realloc(&arena, grown, 100, 200);
+  nu_check("should move an earlier allocation", moved != grown);
+  nu_check("should keep its contents", !strcmp(moved, "grow me"));
+  arena_free(&arena);
+}
+
+void test__arena_reset() {
+  ArenaPool pool;
+  arena_pool_init(&pool, 4);
+  Arena arena;
+  arena_init(&arena, &pool);
+
+  // Three pooled chunks and an oversized one
+  arena_alloc(&arena, 64);
+  for(int i=0; i<20; ++i) arena_alloc(&arena, 1000);
+  arena_alloc(&arena, ARENA_CHUNK_SIZE * 2);
+  ArenaChunk* current = arena.chunks;
+  arena_reset(&arena);
+  nu_check("should keep the current chunk", arena.chunks == current && !current->next);
+  nu_check("should pool the other chunks", pool.num_spare == 2);
+
+  // The next request starts at the top of the chunk it kept
+  char* top = arena.ptr;
+  nu_check("should reuse the kept chunk", arena_alloc(&arena, 64) == top);
+  nu_check("should be at the top", (size_t)(arena.end - top) > ARENA_CHUNK_SIZE - 64);
+  arena_free(&arena);
+  nu_check("should pool every chunk", pool.num_spare == 3);
+
+  // Another arena gets the pooled chunks instead of new ones
+  Arena other;
+  arena_init(&other, &pool);
+  arena_alloc(&other, 1);
+  nu_check("should take a spare chunk", pool.num_spare == 2);
+  arena_free(&other);
+
+  // Past the limit, chunks are freed
+  for(int i=0; i<6 * ARENA_CHUNK_SIZE / 1000; ++i) arena_alloc(&arena, 1000);
+  arena_free(&arena);
+  nu_check("should pool no more than the limit", pool.num_spare == 4);
+  arena_pool_free(&pool);
+  nu_check("should free the pool", pool.num_spare == 0 && !pool.spare);
+}
+
+void test__arena_requests() {
+  Arena arena;
+  arena_init(&arena, NULL);
+
+  // A request parsed into the arena owns nothing itself
+  HttpRequest request;
+  http_request_init_arena(&request, &arena);
+  nu_check("should parse into the arena",
+           http_request_parse(&request, "GET /a HTTP/1.1\r\nHost: x\r\nAccept: */*\r\n\r\n"));
+  nu_check("should find the uri", !strcmp(request.uri, "/a"));
+  nu_check("should find a header", !strcmp(http_request_get_header(&request, "Accept"), "*/*"));
+  http_request_free(&request);
+  nu_check("should keep the arena", request.arena == &arena && !request.uri);
+
+  HttpResponse* res = http_response_new_arena(&arena);
+  http_response_set_status(res, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  http_response_add_header(res, "Content-Length", "2");
+  http_response_set_body(res, "ok");
+  nu_check("should build a response in the arena",
+           !strcmp(http_response_string(res), "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"));
+  http_response_free(res);
+  arena_free(&arena);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__arena() {
+  nu_run_test(test__arena_alloc,    "arena_alloc()");
+  nu_run_test(test__arena_realloc,  "arena_realloc()");
+  nu_run_test(test__arena_reset,    "arena_reset()");
+  nu_run_test(test__arena_requests, "requests and responses in an arena");
+}
+
+#endif // TEST_ARENA_H
@@ -0,0 +1,151 @@
+//==============================================================================
+// Clock tests
+//==============================================================================
+#ifndef TEST_CLOCK_H
+#define TEST_CLOCK_H
+
+#include "nu_unit.h"
+#include "clock.h"
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__clock_monotonic_ms() {
+  const uint64_t a = clock_monotonic_ms();
+  usleep(20 * 1000);
+  const uint64_t b = clock_monotonic_ms();
+  nu_check("should never go backwards", b >= a);
+  nu_check("should advance while sleeping", b - a >= 10);
+}
+
+void test__clock_monotonic_us() {
+  const uint64_t a = clock_monotonic_us();
+  usleep(2 * 1000);
+  const uint64_t b = clock_monotonic_us();
+  nu_check("should advance while sleeping", b - a >= 1000);
+  nu_check("should agree with the millisecond clock",
+           clock_monotonic_us() / 1000 <= clock_monotonic_ms());
+}
+
+void test__clock_thread_cpu_us() {
+  const uint64_t a = clock_thread_cpu_us();
+  usleep(20 * 1000);
+  const uint64_t b = clock_thread_cpu_us();
+  nu_check("should not count time spent sleeping", b - a < 10 * 1000);
+  const uint64_t start = clock_monotonic_us();
+  volatile uint64_t sum = 0;
+  while(clock_monotonic_us() - start < 10 * 1000) sum += 1;
+  nu_check("should count time spent working", clock_thread_cpu_us() - b >= 1000);
+}
+
+void test__clock_format_http_date() {
+  char buf[CLOCK_HTTP_DATE_LEN + 1];
+  clock_format_http_date(784111777, buf);
+  nu_check("should format the RFC example", !strcmp(buf, "Sun, 06 Nov 1994 08:49:37 GMT"));
+  clock_format_http_date(0, buf);
+  nu_check("should format the epoch", !strcmp(buf, "Thu, 01 Jan 1970 00:00:00 GMT"));
+  clock_format_http_date(951782400, buf);
+  nu_check("should format a leap day", !strcmp(buf, "Tue, 29 Feb 2000 00:00:00 GMT"));
+  clock_format_http_date(951868800, buf);
+  nu_check("should roll over a leap day", !strcmp(buf, "Wed, 01 Mar 2000 00:00:00 GMT"));
+  clock_format_http_date(4102444800, buf);
+  nu_check("should format dates past 2038", !strcmp(buf, "Fri, 01 Jan 2100 00:00:00 GMT"));
+}
+
+// Helper: parse a null-terminated HTTP date. Returns -1 if it's not valid.
+time_t clock_test_parse(const char* str) {
+  time_t t = 0;
+  return (clock_parse_http_date(str, strlen(str), &t) ? t : -1);
+}
+
+void test__clock_parse_http_date() {
+  nu_check("should parse the RFC example", clock_test_parse("Sun, 06 Nov 1994 08:49:37 GMT") == 784111777);
+  nu_check("should parse the epoch", clock_test_parse("Thu, 01 Jan 1970 00:00:00 GMT") == 0);
+  nu_check("should parse a leap day", clock_test_parse("Tue, 29 Feb 2000 00:00:00 GMT") == 951782400);
+  nu_check("should parse dates past 2038", clock_test_parse("Fri, 01 Jan 2100 00:00:00 GMT") == 4102444800);
+  nu_check("should parse the RFC 850 format",
+           clock_test_parse("Sunday, 06-Nov-94 08:49:37 GMT") == 784111777);
+  nu_check("should parse the longest RFC 850 day",
+           clock_test_parse("Wednesday, 09-Nov-94 08:49:37 GMT") == 784111777 + 3 * 86400);
+  nu_check("should parse the asctime format", clock_test_parse("Sun Nov  6 08:49:37 1994") == 784111777);
+  nu_check("should parse asctime with two-digit days",
+           clock_test_parse("Wed Nov 16 08:49:37 1994") == 784111777 + 10 * 86400);
+  nu_check("should count a leap second as the second before",
+           clock_test_parse("Sat, 31 Dec 2016 23:59:60 GMT") == 1483228799);
+
+  // Round trip
+  char buf[CLOCK_HTTP_DATE_LEN + 1];
+  const time_t now = clock_now();
+  clock_format_http_date(now, buf);
+  nu_check("should parse what it formats", clock_test_parse(buf) == now);
+
+  nu_check("should reject an empty string", clock_test_parse("") == -1);
+  nu_check("should reject another zone", clock_test_parse("Sun, 06 Nov 1994 08:49:37 PST") == -1);
+  nu_check("should reject a bad month", clock_test_parse("Sun, 06 Nox 1994 08:49:37 GMT") == -1);
+  nu_check("should reject lowercase names", clock_test_parse("sun, 06 nov 1994 08:49:37 GMT") == -1);
+  nu_check("should reject a bad day name", clock_test_parse("Sux, 06 Nov 1994 08:49:37 GMT") == -1);
+  nu_check("should reject day 0", clock_test_parse("Sun, 00 Nov 1994 08:49:37 GMT") == -1);
+  nu_check("should reject day 31 of a short month",
+           clock_test_parse("Sun, 31 Nov 1994 08:49:37 GMT") == -1);
+  nu_check("should reject a leap day in a common year",
+           clock_test_parse("Sun, 29 Feb 1900 08:49:37 GMT") == -1);
+  nu_check("should reject hour 24", clock_test_parse("Sun, 06 Nov 1994 24:00:00 GMT") == -1);
+  nu_check("should reject non-digits", clock_test_parse("Sun, 06 Nov 19x4 08:49:37 GMT") == -1);
+  nu_check("should reject a missing comma", clock_test_parse("Sun  06 Nov 1994 08:49:37 GMT") == -1);
+  nu_check("should reject a bad RFC 850 day", clock_test_parse("Sunxay, 06-Nov-94 08:49:37 GMT") == -1);
+  nu_check("should reject trailing bytes", clock_test_parse("Sun, 06 Nov 1994 08:49:37 GMTX") == -1);
+}
+
+void test__clock_format_log_timestamp() {
+  char buf[CLOCK_LOG_TIMESTAMP_LEN + 1];
+  clock_format_log_timestamp(784111777, buf);
+  nu_check("should format a timestamp", !strcmp(buf, "19941106-08:49:37 UTC"));
+  clock_format_log_timestamp(1709251199, buf);
+  nu_check("should format a leap day", !strcmp(buf, "20240229-23:59:59 UTC"));
+}
+
+void test__clock_http_date() {
+  const char* date = clock_http_date();
+  nu_check("should have the right length", strlen(date) == CLOCK_HTTP_DATE_LEN);
+  nu_check("should end in GMT", !strcmp(date + CLOCK_HTTP_DATE_LEN - 4, " GMT"));
+
+  // Within a second the same string comes back, reformatted only on change
+  char expected[CLOCK_HTTP_DATE_LEN + 1];
+  const time_t now = clock_now();
+  clock_format_http_date(now, expected);
+  const char* again = clock_http_date();
+  nu_check("should reuse the thread's buffer", again == date);
+  nu_check("should match the current second",
+           !strcmp(again, expected) || clock_now() != now);
+}
+
+void test__clock_log_timestamp() {
+  // Expected format: "20121008-15:32:46 UTC"
+  const char* str = clock_log_timestamp();
+  nu_check("timestamp should have length 21", strlen(str) == CLOCK_LOG_TIMESTAMP_LEN);
+  bool digits_ok = true;
+  const int digit_indexes[14] = {0,1,2,3,4,5,6,7,9,10,12,13,15,16};
+  for(int i=0; i<14 && digits_ok; ++i) {
+    digits_ok = isdigit(str[digit_indexes[i]]);
+  }
+  nu_check("should have digits in expected locations", digits_ok);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__clock() {
+  nu_run_test(test__clock_monotonic_ms,         "clock_monotonic_ms()");
+  nu_run_test(test__clock_monotonic_us,         "clock_monotonic_us()");
+  nu_run_test(test__clock_thread_cpu_us,        "clock_thread_cpu_us()");
+  nu_run_test(test__clock_format_http_date,     "clock_format_http_date()");
+  nu_run_test(test__clock_parse_http_date,      "clock_parse_http_date()");
+  nu_run_test(test__clock_format_log_timestamp, "clock_format_log_timestamp()");
+  nu_run_test(test__clock_http_date,            "clock_http_date()");
+  nu_run_test(test__clock_log_timestamp,        "clock_log_timestamp()");
+}
+
+#endif // TEST_CLOCK_H
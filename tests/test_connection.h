@@ -0,0 +1,352 @@
+//==============================================================================
+// Connection tests
+//==============================================================================
+#ifndef TEST_CONNECTION_H
+#define TEST_CONNECTION_H
+
+#include "nu_unit.h"
+#include "connection.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Helper: create a connected pair of sockets. The first one is wrapped in a
+// non-blocking Connection, the second is returned as a plain fd for the test
+// to talk to.
+Connection* make_test_connection(int* peer_fd) {
+  int fds[2];
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) return NULL;
+  ClientSocket client;
+  client_socket_init(&client);
+  client.fd = fds[0];
+  client_socket_set_blocking(&client, false);
+  *peer_fd = fds[1];
+  return connection_new(&client, NULL);
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__connection_new() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to create connection", conn);
+  nu_check("should start in the reading state", conn->state == CONNECTION_STATE_READING);
+  nu_check("should start with no input", conn->in_len == 0);
+  nu_check("should start with no output", !connection_has_output(conn));
+  connection_free(conn);
+  close(peer);
+}
+
+void test__connection_fill() {
+  int peer = -1;
+  bool peer_closed = true;
+  Connection* conn = make_test_connection(&peer);
+
+  Status status = connection_fill(conn, 1024, &peer_closed);
+  nu_check("should succeed when no data is pending", status.ok);
+  nu_check("should not report peer closed", !peer_closed);
+  nu_check("should not read anything", conn->in_len == 0);
+
+  // Send more than the initial buffer size, to force growth
+  const size_t len = 3000;
+  char* msg = malloc(len);
+  memset(msg, 'x', len);
+  nu_assert("failed to write test data", write(peer, msg, len) == len);
+  status = connection_fill(conn, 64 * 1024, &peer_closed);
+  nu_check("should succeed reading pending data", status.ok);
+  nu_check("should read all pending data", conn->in_len == len);
+  nu_check("should read the right data", !memcmp(conn->in_buf, msg, len));
+  nu_check("should null-terminate the input", conn->in_buf[len] == 0);
+
+  // Closing the peer is reported
+  close(peer);
+  status = connection_fill(conn, 64 * 1024, &peer_closed);
+  nu_check("should succeed when peer closes", status.ok);
+  nu_check("should report peer closed", peer_closed);
+
+  free(msg);
+  connection_free(conn);
+}
+
+void test__connection_fill__max_bytes() {
+  int peer = -1;
+  bool peer_closed = false;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to write test data", write(peer, "0123456789", 10) == 10);
+  connection_fill(conn, 4, &peer_closed);
+  nu_check("should stop reading at max_bytes", conn->in_len == 4);
+  nu_check("should read the first bytes", !strcmp(conn->in_buf, "0123"));
+  connection_free(conn);
+  close(peer);
+}
+
+void test__connection_consume() {
+  int peer = -1;
+  bool peer_closed = false;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to write test data", write(peer, "abcdef", 6) == 6);
+  connection_fill(conn, 1024, &peer_closed);
+  connection_consume(conn, 2);
+  nu_check("should remove consumed bytes", !strcmp(conn->in_buf, "cdef"));
+  nu_check("should update the length", conn->in_len == 4);
+  connection_consume(conn, 100);
+  nu_check("should empty the buffer", conn->in_len == 0 && conn->in_buf[0] == 0);
+  connection_free(conn);
+  close(peer);
+}
+
+void test__connection_write_and_flush() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  connection_write(conn, "hello ", 6);
+  connection_write(conn, "world", 5);
+  nu_check("should have pending output", connection_has_output(conn));
+
+  Status status = connection_flush(conn);
+  nu_check("flush should succeed", status.ok);
+  nu_check("should have no pending output", !connection_has_output(conn));
+
+  char buf[32] = {0};
+  nu_check("peer should receive the data", read(peer, buf, sizeof(buf)) == 11);
+  nu_check("peer should receive the right data", !strcmp(buf, "hello world"));
+  connection_free(conn);
+  close(peer);
+}
+
+void test__connection_output_iov() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+
+  // Small writes share a segment; big ones get their own
+  char big[6000];
+  memset(big, 'b', sizeof(big));
+  connection_write(conn, "ab", 2);
+  connection_write(conn, "cd", 2);
+  connection_write(conn, big, sizeof(big));
+  connection_write(conn, "ef", 2);
+
+  struct iovec iov[8];
+  int count = connection_output_iov(conn, iov, 8);
+  nu_check("should describe three segments", count == 3);
+  nu_check("first segment should hold the small writes", iov[0].iov_len == 4 &&
+           !memcmp(iov[0].iov_base, "abcd", 4));
+  nu_check("second segment should hold the big write", iov[1].iov_len == sizeof(big));
+  nu_check("third segment should hold the last write", iov[2].iov_len == 2);
+  nu_check("should count all the output", connection_output_len(conn) == sizeof(big) + 6);
+  nu_check("should respect the iovec limit", connection_output_iov(conn, iov, 1) == 1);
+
+  // Sending part of the output moves the first iovec along
+  connection_output_sent(conn, 6);
+  count = connection_output_iov(conn, iov, 8);
+  nu_check("should drop a finished segment", count == 2);
+  nu_check("should start after the sent bytes", iov[0].iov_len == sizeof(big) - 2 &&
+           ((char*)iov[0].iov_base)[0] == 'b');
+
+  // Sending everything empties the queue, and it can be used again
+  connection_output_sent(conn, sizeof(big));
+  nu_check("should have no pending output", !connection_has_output(conn));
+  connection_write(conn, "gh", 2);
+  count = connection_output_iov(conn, iov, 8);
+  nu_check("should reuse the queue", count == 1 && iov[0].iov_len == 2 &&
+           !memcmp(iov[0].iov_base, "gh", 2));
+  connection_free(conn);
+  close(peer);
+}
+
+void test__connection_write_ref() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+
+  // Big enough to be referenced rather than copied
+  static char body[1000];
+  memset(body, 'r', sizeof(body));
+  connection_write(conn, "head", 4);
+  connection_write_ref(conn, body, sizeof(body));
+  connection_write(conn, "next", 4);
+  connection_write_ref(conn, "tiny", 4);
+
+  struct iovec iov[8];
+  const int count = connection_output_iov(conn, iov, 8);
+  nu_check("should describe three segments", count == 3);
+  nu_check("should point at the referenced bytes", iov[1].iov_base == body &&
+           iov[1].iov_len == sizeof(body));
+  nu_check("should copy a small write", iov[2].iov_len == 8 &&
+           !memcmp(iov[2].iov_base, "nexttiny", 8));
+
+  nu_check("flush should succeed", connection_flush(conn).ok);
+  char buf[1100] = {0};
+  nu_check("peer should receive everything", read(peer, buf, sizeof(buf)) == 1012);
+  nu_check("peer should receive it in order", !memcmp(buf, "head", 4) && buf[4] == 'r' &&
+           !memcmp(buf + 1004, "nexttiny", 8));
+  connection_free(conn);
+  close(peer);
+}
+
+// Helper: count calls to release a segment
+void connection_test_release(void* arg) {
+  *(int*)arg += 1;
+}
+
+void test__connection_write_ref_release() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+
+  static char body[1000];
+  memset(body, 'r', sizeof(body));
+  int released = 0;
+  connection_write_ref_release(conn, "tiny", 4, connection_test_release, &released);
+  nu_check("should release a small write at once", released == 1);
+  connection_write_ref_release(conn, body, sizeof(body), connection_test_release, &released);
+  struct iovec iov[8];
+  nu_check("should point at the referenced bytes", connection_output_iov(conn, iov, 8) == 2 &&
+           iov[1].iov_base == body);
+  nu_check("should not release unsent bytes", released == 1);
+  nu_check("flush should succeed", connection_flush(conn).ok);
+  nu_check("should release the bytes once they're sent", released == 2);
+  char buf[1100] = {0};
+  nu_check("peer should receive everything", read(peer, buf, sizeof(buf)) == 1004);
+
+  // Unsent bytes are released when the connection is freed
+  connection_write_ref_release(conn, body, sizeof(body), connection_test_release, &released);
+  connection_free(conn);
+  nu_check("should release unsent bytes", released == 3);
+  close(peer);
+}
+
+void test__connection_write_file() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+
+  // A file to send part of
+  char path[] = "/tmp/webserver-test-XXXXXX";
+  const int fd = mkstemp(path);
+  nu_assert("failed to create test file", fd != -1);
+  unlink(path);
+  nu_check("failed to write test file", write(fd, "0123456789", 10) == 10);
+
+  connection_write(conn, "head", 4);
+  connection_write_file(conn, fd, 2, 5);
+  connection_write(conn, "tail", 4);
+  nu_check("should count the file's bytes", connection_output_len(conn) == 13);
+
+  // The file can't be described as an iovec, so the iovecs stop before it
+  struct iovec iov[8];
+  int file_fd;
+  off_t offset;
+  size_t len;
+  nu_check("should describe the segment before the file",
+           connection_output_iov(conn, iov, 8) == 1 && iov[0].iov_len == 4);
+  nu_check("should not start with the file",
+           !connection_output_file(conn, &file_fd, &offset, &len));
+  nu_check("should say the file follows", connection_output_file_follows(conn, 1));
+  nu_check("should say the file doesn't follow at once", !connection_output_file_follows(conn, 0));
+
+  // Once the head is sent, the file is next, and its range moves along as
+  // it's sent
+  connection_output_sent(conn, 4);
+  nu_check("should describe no iovecs at the file", connection_output_iov(conn, iov, 8) == 0);
+  nu_check("should describe the file", connection_output_file(conn, &file_fd, &offset, &len) &&
+           file_fd == fd && offset == 2 && len == 5);
+  connection_output_sent(conn, 1);
+  nu_check("should describe the rest of the file",
+           connection_output_file(conn, &file_fd, &offset, &len) && offset == 3 && len == 4);
+
+  // The rest goes out with sendfile(), and the file is closed once it's sent
+  nu_check("flush should succeed", connection_flush(conn).ok);
+  nu_check("should have no pending output", !connection_has_output(conn));
+  nu_check("should close the file once it's sent", fcntl(fd, F_GETFD) == -1);
+  char buf[32] = {0};
+  nu_check("peer should receive the rest", read(peer, buf, sizeof(buf)) == 8);
+  nu_check("peer should receive it in order", !strcmp(buf, "3456tail"));
+  connection_free(conn);
+  close(peer);
+}
+
+void test__connection_write_file__unsent() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  char path[] = "/tmp/webserver-test-XXXXXX";
+  const int fd = mkstemp(path);
+  nu_assert("failed to create test file", fd != -1);
+  unlink(path);
+  nu_check("failed to write test file", write(fd, "0123456789", 10) == 10);
+
+  connection_write_file(conn, fd, 0, 10);
+  connection_free(conn);
+  nu_check("should close an unsent file", fcntl(fd, F_GETFD) == -1);
+  close(peer);
+}
+
+
+void test__connection_write_file_ref() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  char path[] = "/tmp/webserver-test-XXXXXX";
+  const int fd = mkstemp(path);
+  nu_assert("failed to create test file", fd != -1);
+  unlink(path);
+  nu_check("failed to write test file", write(fd, "0123456789", 10) == 10);
+
+  // Sent files are released, not closed
+  int released = 0;
+  connection_write_file_ref(conn, fd, 0, 10, connection_test_release, &released);
+  connection_write_file_ref(conn, fd, 5, 0, connection_test_release, &released);
+  nu_check("should release an empty range at once", released == 1);
+  nu_check("flush should succeed", connection_flush(conn).ok);
+  nu_check("should release the file once it's sent", released == 2);
+  nu_check("should leave the file open", fcntl(fd, F_GETFD) != -1);
+  char buf[32] = {0};
+  nu_check("peer should receive the file", read(peer, buf, sizeof(buf)) == 10);
+
+  // So are unsent ones, when the connection is freed
+  connection_write_file_ref(conn, fd, 0, 10, connection_test_release, &released);
+  connection_free(conn);
+  nu_check("should release an unsent file", released == 3);
+  close(fd);
+  close(peer);
+}
+
+void test__connection_flush__would_block() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+
+  // Queue far more than the socket buffer holds while nobody reads
+  const size_t len = 8 * 1024 * 1024;
+  char* msg = malloc(len);
+  memset(msg, 'y', len);
+  connection_write(conn, msg, len);
+
+  Status status = connection_flush(conn);
+  nu_check("flush should succeed even when the socket is full", status.ok);
+  nu_check("should still have pending output", connection_has_output(conn));
+  nu_check("should have sent part of the output", conn->bytes_out > 0);
+  nu_check("should count what's left", connection_output_len(conn) == len - conn->bytes_out);
+
+  free(msg);
+  connection_free(conn);
+  close(peer);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__connection() {
+  nu_run_test(test__connection_new,                "connection_new()");
+  nu_run_test(test__connection_fill,               "connection_fill()");
+  nu_run_test(test__connection_fill__max_bytes,    "connection_fill() w/ max_bytes");
+  nu_run_test(test__connection_consume,            "connection_consume()");
+  nu_run_test(test__connection_write_and_flush,    "connection_write() and connection_flush()");
+  nu_run_test(test__connection_output_iov,         "connection_output_iov()");
+  nu_run_test(test__connection_write_ref,          "connection_write_ref()");
+  nu_run_test(test__connection_write_ref_release,  "connection_write_ref_release()");
+  nu_run_test(test__connection_write_file,         "connection_write_file()");
+  nu_run_test(test__connection_write_file__unsent, "connection_write_file() w/ unsent file");
+  nu_run_test(test__connection_write_file_ref,     "connection_write_file_ref()");
+  nu_run_test(test__connection_flush__would_block, "connection_flush() w/ full socket");
+}
+
+#endif // TEST_CONNECTION_H
@@ -0,0 +1,69 @@
+//==============================================================================
+// EventLoop tests
+//==============================================================================
+#ifndef TEST_EVENT_LOOP_H
+#define TEST_EVENT_LOOP_H
+
+#include "nu_unit.h"
+#include "event_loop.h"
+#include <unistd.h>
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__event_loop_init() {
+  EventLoop loop;
+  Status status = event_loop_init(&loop, 16);
+  nu_assert("failed to create event loop", status.ok);
+  nu_check("failed to set file descriptor", loop.fd != -1);
+  nu_check("failed to allocate events", loop.events && loop.max_events == 16);
+  event_loop_close(&loop);
+  nu_check("failed to reset file descriptor", loop.fd == -1);
+}
+
+void test__event_loop_wait() {
+  EventLoop loop;
+  event_loop_init(&loop, 16);
+  int fds[2];
+  nu_assert("failed to create pipe", pipe(fds) == 0);
+
+  int marker = 42;
+  Status status = event_loop_add(&loop, fds[0], EPOLLIN | EPOLLET, &marker);
+  nu_assert("failed to add fd", status.ok);
+
+  int num_events = -1;
+  status = event_loop_wait(&loop, 0, &num_events);
+  nu_check("wait should succeed", status.ok);
+  nu_check("should have no events before data is written", num_events == 0);
+
+  nu_assert("failed to write to pipe", write(fds[1], "x", 1) == 1);
+  status = event_loop_wait(&loop, 1000, &num_events);
+  nu_check("wait should succeed", status.ok);
+  nu_assert("should have one event", num_events == 1);
+  nu_check("should return the data pointer", loop.events[0].data.ptr == &marker);
+  nu_check("should report readable", loop.events[0].events & EPOLLIN);
+
+  // Edge-triggered: no new event until more data arrives
+  status = event_loop_wait(&loop, 0, &num_events);
+  nu_check("should not repeat an edge-triggered event", num_events == 0);
+
+  status = event_loop_remove(&loop, fds[0]);
+  nu_check("failed to remove fd", status.ok);
+  nu_assert("failed to write to pipe", write(fds[1], "x", 1) == 1);
+  status = event_loop_wait(&loop, 0, &num_events);
+  nu_check("should have no events after removal", num_events == 0);
+
+  close(fds[0]);
+  close(fds[1]);
+  event_loop_close(&loop);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__event_loop() {
+  nu_run_test(test__event_loop_init, "event_loop_init()");
+  nu_run_test(test__event_loop_wait, "event_loop_wait()");
+}
+
+#endif // TEST_EVENT_LOOP_H
@@ -0,0 +1,417 @@
+//==============================================================================
+// File cache tests
+//==============================================================================
+#ifndef TEST_FILE_CACHE_H
+#define TEST_FILE_CACHE_H
+
+#include "nu_unit.h"
+#include "clock.h"
+#include "file_cache.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Helper: create or overwrite a file under 'dir'
+void file_cache_test_write(const char* dir, const char* name, const char* data) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  nu_check("failed to write test file", fd != -1 && write(fd, data, strlen(data)) >= 0);
+  close(fd);
+}
+
+void file_cache_test_remove(const char* dir, const char* name) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  unlink(path);
+}
+
+// Helper: wait up to a second for the watcher to drop more than 'count'
+// entries in all
+bool file_cache_test_wait(FileCache* cache, uint64_t count) {
+  for(int i=0; i<1000; ++i) {
+    if(file_cache_stats(cache).invalidations > count) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+// Helper: open 'uri' and release it straight away
+enum EHttpStatus file_cache_test_open(FileCache* cache, const char* uri) {
+  FileCacheEntry* entry = NULL;
+  const enum EHttpStatus status = file_cache_open(cache, uri, strlen(uri), &entry);
+  if(status == HTTP_STATUS_OK) file_cache_release(entry);
+  return status;
+}
+
+// Helper: open 'uri' until it's cached. A change can take a few events to
+// arrive, and the cache won't keep a file while they're still coming.
+bool file_cache_test_cache(FileCache* cache, const char* uri) {
+  for(int i=0; i<1000; ++i) {
+    const uint64_t hits = file_cache_stats(cache).hits;
+    file_cache_test_open(cache, uri);
+    file_cache_test_open(cache, uri);
+    if(file_cache_stats(cache).hits > hits) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__file_cache_open() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  file_cache_test_write(root, "a.txt", "hello");
+  file_cache_test_write(root, "index.html", "<p>home</p>");
+
+  FileCache cache;
+  nu_assert("failed to init cache", file_cache_init(&cache, root, "test", 64, 0).ok);
+
+  FileCacheEntry* first = NULL;
+  FileCacheEntry* second = NULL;
+  nu_check("should open a file", file_cache_open(&cache, "/a.txt", 6, &first) == HTTP_STATUS_OK);
+  nu_check("should get the size", first->file.size == 5);
+  nu_check("should get the type", !strcmp(first->file.content_type, "text/plain"));
+  nu_check("should get the ETag", first->etag[0] == '"');
+  nu_check("should open it again", file_cache_open(&cache, "/a.txt", 6, &second) == HTTP_STATUS_OK);
+  nu_check("should return the cached entry", first == second);
+  file_cache_release(first);
+  file_cache_release(second);
+
+  nu_check("should open a directory's index", file_cache_test_open(&cache, "/") == HTTP_STATUS_OK);
+  nu_check("should give 404 for a missing file",
+           file_cache_test_open(&cache, "/missing.txt") == HTTP_STATUS_NOT_FOUND);
+  nu_check("should give 400 for a malformed URI",
+           file_cache_test_open(&cache, "/%zz") == HTTP_STATUS_BAD_REQUEST);
+
+  const FileCacheStats stats = file_cache_stats(&cache);
+  nu_check("should count entries", stats.entries == 2);
+  nu_check("should count hits", stats.hits == 1);
+  nu_check("should count misses", stats.misses == 3);
+
+  file_cache_free(&cache);
+  file_cache_test_remove(root, "a.txt");
+  file_cache_test_remove(root, "index.html");
+  rmdir(root);
+}
+
+void test__file_cache_evicts() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  char name[16], uri[16];
+  for(int i=0; i<64; ++i) {
+    snprintf(name, sizeof(name), "%i.txt", i);
+    file_cache_test_write(root, name, "x");
+  }
+
+  // One entry per shard
+  FileCache cache;
+  nu_assert("failed to init cache", file_cache_init(&cache, root, "test", FILE_CACHE_SHARDS, 0).ok);
+  for(int i=0; i<64; ++i) {
+    snprintf(uri, sizeof(uri), "/%i.txt", i);
+    nu_check("should open every file", file_cache_test_open(&cache, uri) == HTTP_STATUS_OK);
+  }
+  FileCacheStats stats = file_cache_stats(&cache);
+  nu_check("should stay within capacity", stats.entries <= FILE_CACHE_SHARDS);
+  nu_check("should evict the rest", stats.entries + stats.evictions == 64);
+
+  // The most recently used file is still there
+  nu_check("should open the last file", file_cache_test_open(&cache, uri) == HTTP_STATUS_OK);
+  nu_check("should keep the last file", file_cache_stats(&cache).hits == 1);
+
+  file_cache_free(&cache);
+  for(int i=0; i<64; ++i) {
+    snprintf(name, sizeof(name), "%i.txt", i);
+    file_cache_test_remove(root, name);
+  }
+  rmdir(root);
+}
+
+void test__file_cache_content() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  char big[FILE_CACHE_MAX_CONTENT_SIZE + 2];
+  memset(big, 'b', sizeof(big) - 1);
+  big[sizeof(big) - 1] = 0;
+  char medium[200];
+  memset(medium, 'm', sizeof(medium) - 1);
+  medium[sizeof(medium) - 1] = 0;
+  file_cache_test_write(root, "a.txt", "hello");
+  file_cache_test_write(root, "big.txt", big);
+  char name[16], uri[16];
+  for(int i=0; i<64; ++i) {
+    snprintf(name, sizeof(name), "%i.txt", i);
+    file_cache_test_write(root, name, medium);
+  }
+
+  // Room for one medium file's response per shard
+  FileCache cache;
+  nu_assert("failed to init cache",
+            file_cache_init(&cache, root, "test", 1024, FILE_CACHE_SHARDS * 450).ok);
+
+  FileCacheEntry* entry = NULL;
+  nu_assert("should open a small file", file_cache_open(&cache, "/a.txt", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should keep a small file in memory", entry->head != NULL);
+  nu_check("should format the head", entry->head_len == 31 &&
+           !memcmp(entry->head, "HTTP/1.1 200 OK\r\nServer: test", 29));
+  const char* tail_end = entry->tail + entry->tail_len;
+  nu_check("should put the headers in the tail",
+           !memcmp(entry->tail, "Content-Type: text/plain\r\nContent-Length: 5\r\nETag: ", 51));
+  nu_check("should end the tail with the file",
+           !memcmp(tail_end - 29, "Accept-Ranges: bytes\r\n\r\nhello", 29));
+  nu_check("should say when the file changed",
+           !memcmp(tail_end - 29 - CLOCK_HTTP_DATE_LEN - 17, "Last-Modified: ", 15));
+  nu_check("should count the bytes", file_cache_stats(&cache).bytes ==
+           entry->head_len + entry->tail_len);
+  file_cache_release(entry);
+
+  nu_assert("should open a big file", file_cache_open(&cache, "/big.txt", 8, &entry) == HTTP_STATUS_OK);
+  nu_check("should not keep a big file in memory", entry->head == NULL);
+  file_cache_release(entry);
+
+  // Past the budget, the least recently used responses are evicted
+  for(int i=0; i<64; ++i) {
+    snprintf(uri, sizeof(uri), "/%i.txt", i);
+    nu_check("should open every file", file_cache_test_open(&cache, uri) == HTTP_STATUS_OK);
+  }
+  const FileCacheStats stats = file_cache_stats(&cache);
+  nu_check("should stay within the budget", stats.bytes <= FILE_CACHE_SHARDS * 450);
+  nu_check("should evict to make room", stats.evictions >= 64 - FILE_CACHE_SHARDS);
+  nu_assert("should open the last file", file_cache_open(&cache, uri, strlen(uri), &entry) == HTTP_STATUS_OK);
+  nu_check("should keep the last file in memory", entry->head != NULL);
+  file_cache_release(entry);
+
+  file_cache_free(&cache);
+  file_cache_test_remove(root, "a.txt");
+  file_cache_test_remove(root, "big.txt");
+  for(int i=0; i<64; ++i) {
+    snprintf(name, sizeof(name), "%i.txt", i);
+    file_cache_test_remove(root, name);
+  }
+  rmdir(root);
+}
+
+void test__file_cache_encoded() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  file_cache_test_write(root, "a.css", "p { color: red }");
+  file_cache_test_write(root, "a.css.gz", "gzipped");
+  file_cache_test_write(root, "a.css.br", "brotli");
+
+  const unsigned GZ = 1u << HTTP_ENCODING_GZIP;
+  const unsigned BR = 1u << HTTP_ENCODING_BR;
+  FileCache cache;
+  nu_assert("failed to init cache", file_cache_init(&cache, root, "test", 64, 0).ok);
+
+  // An entry has every sibling there is
+  FileCacheEntry* entry = NULL;
+  nu_assert("should open a file", file_cache_open(&cache, "/a.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should find the siblings", entry->encodings == (GZ | BR));
+  const FileCacheVariant* gz = &entry->encoded[HTTP_ENCODING_GZIP];
+  nu_check("should open the gzip sibling", gz->file.fd != -1 && gz->file.size == 7);
+  nu_check("should give the sibling the file's type", !strcmp(gz->file.content_type, "text/css"));
+  nu_check("should give the sibling its own ETag", strcmp(gz->etag, entry->etag) != 0);
+  nu_check("should open the br sibling", entry->encoded[HTTP_ENCODING_BR].file.size == 6);
+  file_cache_release(entry);
+
+  // Removing a sibling drops the file's entry
+  nu_check("should cache the file", file_cache_test_cache(&cache, "/a.css"));
+  const uint64_t count = file_cache_stats(&cache).invalidations;
+  file_cache_test_remove(root, "a.css.br");
+  nu_check("should drop the file when a sibling goes", file_cache_test_wait(&cache, count));
+  nu_assert("should reopen the file", file_cache_open(&cache, "/a.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should lose the removed sibling", entry->encodings == GZ);
+  file_cache_release(entry);
+  file_cache_free(&cache);
+
+  // Without a cache too
+  nu_assert("should open a file without a cache",
+            file_cache_open_file(root, "/a.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should find the siblings without a cache", entry->encodings == GZ &&
+           entry->encoded[HTTP_ENCODING_BR].file.fd == -1);
+  file_cache_release(entry);
+
+  file_cache_test_remove(root, "a.css");
+  file_cache_test_remove(root, "a.css.gz");
+  rmdir(root);
+}
+
+void test__file_cache_gzip() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  char text[4096];
+  for(size_t i=0; i<sizeof(text) - 1; ++i) text[i] = "p { margin: 0 } "[i % 16];
+  text[sizeof(text) - 1] = 0;
+  file_cache_test_write(root, "a.css", text);
+  file_cache_test_write(root, "b.css", text);
+  file_cache_test_write(root, "b.css.gz", "gzipped");
+  file_cache_test_write(root, "c.png", text);
+  file_cache_test_write(root, "d.css", "p {}");
+
+  FileCache cache;
+  nu_assert("failed to init cache", file_cache_init(&cache, root, "test", 64, 1024 * 1024).ok);
+  FileCacheEntry* entry = NULL;
+  uint64_t cpu_us = 0;
+
+  // Text is gzipped once, then kept
+  nu_check("should cache a file", file_cache_test_cache(&cache, "/a.css"));
+  nu_assert("should open it", file_cache_open(&cache, "/a.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should say it varies", file_cache_varies(entry));
+  const size_t bytes = file_cache_stats(&cache).bytes;
+  const FileCacheCompressed* gzip = file_cache_gzip(&cache, entry, &cpu_us);
+  nu_assert("should gzip text", gzip);
+  nu_check("should make it smaller", gzip->len < sizeof(text) / 10 &&
+           (unsigned char)gzip->data[0] == 0x1f && (unsigned char)gzip->data[1] == 0x8b);
+  nu_check("should mark the ETag", strlen(gzip->etag) == strlen(entry->etag) + 3 &&
+           !strncmp(gzip->etag, entry->etag, strlen(entry->etag) - 1) &&
+           !strcmp(gzip->etag + strlen(gzip->etag) - 4, "-gz\""));
+  nu_check("should charge the shard", file_cache_stats(&cache).bytes >= bytes + gzip->len);
+  file_cache_release(entry);
+  nu_assert("should open it again", file_cache_open(&cache, "/a.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should keep the result", file_cache_gzip(&cache, entry, &cpu_us) == gzip);
+  nu_check("should take no time the second time", cpu_us == 0);
+  nu_check("should not leave it to be streamed", !file_cache_gzip_streams(entry));
+  file_cache_release(entry);
+
+  // Text too big to gzip in one go is left to be gzipped as it's sent
+  char* huge = malloc(FILE_CACHE_MAX_COMPRESS_SIZE + 2);
+  memset(huge, 'x', FILE_CACHE_MAX_COMPRESS_SIZE + 1);
+  huge[FILE_CACHE_MAX_COMPRESS_SIZE + 1] = 0;
+  file_cache_test_write(root, "e.css", huge);
+  free(huge);
+  nu_assert("should open a huge file", file_cache_open(&cache, "/e.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should not gzip it at once", !file_cache_gzip(&cache, entry, &cpu_us));
+  nu_check("should leave it to be streamed", file_cache_gzip_streams(entry));
+  nu_check("should say it varies too", file_cache_varies(entry));
+  char etag[STATIC_FILE_ETAG_SIZE + 3];
+  file_cache_gzip_etag(entry, etag);
+  nu_check("should mark its ETag", !strcmp(etag + strlen(etag) - 4, "-gz\""));
+  file_cache_release(entry);
+
+  // Other files aren't
+  nu_assert("should open a file with a sibling",
+            file_cache_open(&cache, "/b.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should leave a file with a sibling", !file_cache_gzip(&cache, entry, &cpu_us));
+  file_cache_release(entry);
+  nu_assert("should open an image", file_cache_open(&cache, "/c.png", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should leave an image", !file_cache_gzip(&cache, entry, &cpu_us));
+  nu_check("should say an image doesn't vary", !file_cache_varies(entry));
+  file_cache_release(entry);
+  nu_assert("should open a tiny file", file_cache_open(&cache, "/d.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should leave a tiny file", !file_cache_gzip(&cache, entry, &cpu_us));
+  file_cache_release(entry);
+  file_cache_free(&cache);
+
+  // Without a cache, the result goes with the entry
+  nu_assert("should open a file without a cache",
+            file_cache_open_file(root, "/a.css", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should gzip without a cache", file_cache_gzip(NULL, entry, &cpu_us) != NULL);
+  file_cache_release(entry);
+
+  file_cache_test_remove(root, "a.css");
+  file_cache_test_remove(root, "b.css");
+  file_cache_test_remove(root, "b.css.gz");
+  file_cache_test_remove(root, "c.png");
+  file_cache_test_remove(root, "d.css");
+  file_cache_test_remove(root, "e.css");
+  rmdir(root);
+}
+
+void test__file_cache_invalidates() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  char dir[64];
+  snprintf(dir, sizeof(dir), "%s/docs", root);
+  mkdir(dir, 0755);
+  file_cache_test_write(root, "a.txt", "hello");
+  file_cache_test_write(dir, "index.html", "<p>docs</p>");
+
+  FileCache cache;
+  nu_assert("failed to init cache", file_cache_init(&cache, root, "test", 64, 1024 * 1024).ok);
+
+  // Change a file while a response still holds its entry, twice over
+  FileCacheEntry* entry = NULL;
+  nu_assert("should open a file", file_cache_open(&cache, "/a.txt", 6, &entry) == HTTP_STATUS_OK);
+  file_cache_retain(entry);
+  file_cache_test_write(root, "a.txt", "hello, world");
+  nu_check("should drop a changed file", file_cache_test_wait(&cache, 0));
+  char buf[8] = {0};
+  nu_check("should keep a dropped file open while it's used",
+           pread(entry->file.fd, buf, sizeof(buf) - 1, 0) > 0);
+  file_cache_release(entry);
+  nu_check("should keep it open for the other reference",
+           pread(entry->file.fd, buf, sizeof(buf) - 1, 0) > 0);
+  file_cache_release(entry);
+  nu_assert("should reopen a changed file", file_cache_open(&cache, "/a.txt", 6, &entry) == HTTP_STATUS_OK);
+  nu_check("should see the new size", entry->file.size == 12);
+  file_cache_release(entry);
+
+  // Change a directory's index
+  nu_check("should cache a directory", file_cache_test_cache(&cache, "/docs"));
+  uint64_t count = file_cache_stats(&cache).invalidations;
+  file_cache_test_write(dir, "index.html", "<p>new docs</p>");
+  nu_check("should drop a directory whose index changed", file_cache_test_wait(&cache, count));
+  nu_check("should reopen the directory", file_cache_open(&cache, "/docs", 5, &entry) == HTTP_STATUS_OK);
+  nu_check("should see the new index", entry->file.size == 15);
+  file_cache_release(entry);
+
+  // Delete a file
+  nu_check("should cache the file", file_cache_test_cache(&cache, "/a.txt"));
+  count = file_cache_stats(&cache).invalidations;
+  file_cache_test_remove(root, "a.txt");
+  nu_check("should drop a deleted file", file_cache_test_wait(&cache, count));
+  nu_check("should give 404 for a deleted file",
+           file_cache_test_open(&cache, "/a.txt") == HTTP_STATUS_NOT_FOUND);
+
+  // Move a directory
+  nu_check("should cache the directory", file_cache_test_cache(&cache, "/docs"));
+  count = file_cache_stats(&cache).invalidations;
+  char moved[64];
+  snprintf(moved, sizeof(moved), "%s/moved", root);
+  rename(dir, moved);
+  nu_check("should drop everything when a directory moves", file_cache_test_wait(&cache, count));
+  nu_check("should give 404 for a moved directory",
+           file_cache_test_open(&cache, "/docs") == HTTP_STATUS_NOT_FOUND);
+
+  file_cache_free(&cache);
+  file_cache_test_remove(moved, "index.html");
+  rmdir(moved);
+  rmdir(root);
+}
+
+void test__file_cache_disabled() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  file_cache_test_write(root, "a.txt", "hello");
+
+  FileCache cache;
+  nu_assert("failed to init cache", file_cache_init(&cache, root, "test", 0, 1024 * 1024).ok);
+  nu_check("should open a file", file_cache_test_open(&cache, "/a.txt") == HTTP_STATUS_OK);
+  nu_check("should open it again", file_cache_test_open(&cache, "/a.txt") == HTTP_STATUS_OK);
+  const FileCacheStats stats = file_cache_stats(&cache);
+  nu_check("should cache nothing", stats.entries == 0 && stats.hits == 0);
+
+  file_cache_free(&cache);
+  file_cache_test_remove(root, "a.txt");
+  rmdir(root);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__file_cache() {
+  nu_run_test(test__file_cache_open,        "file_cache_open()");
+  nu_run_test(test__file_cache_evicts,      "file_cache evicts least recently used files");
+  nu_run_test(test__file_cache_content,     "file_cache keeps small files in memory");
+  nu_run_test(test__file_cache_encoded,     "file_cache opens precompressed siblings");
+  nu_run_test(test__file_cache_gzip,        "file_cache_gzip()");
+  nu_run_test(test__file_cache_invalidates, "file_cache drops changed files");
+  nu_run_test(test__file_cache_disabled,    "file_cache with caching off");
+}
+
+#endif // TEST_FILE_CACHE_H
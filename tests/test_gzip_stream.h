@@ -0,0 +1,108 @@
+//==============================================================================
+// GzipStream tests
+//==============================================================================
+#ifndef TEST_GZIP_STREAM_H
+#define TEST_GZIP_STREAM_H
+
+#include "nu_unit.h"
+#include "gzip_stream.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Helper: a GzipSink that collects output, counting the chunks
+typedef struct GzipTestSink {
+  char*  data;
+  size_t len;
+  size_t chunks;
+} GzipTestSink;
+
+void gzip_test_sink(void* arg, const void* data, size_t len) {
+  GzipTestSink* sink = arg;
+  sink->data = realloc(sink->data, sink->len + len);
+  memcpy(sink->data + sink->len, data, len);
+  sink->len += len;
+  sink->chunks += 1;
+}
+
+// Helper: gunzip 'len' bytes into 'out'. Returns the size of the result, or
+// -1 on error.
+long gzip_test_inflate(const char* data, size_t len, char* out, size_t out_len) {
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if(inflateInit2(&z, 15 + 16) != Z_OK) return -1;
+  z.next_in = (Bytef*)data;
+  z.avail_in = len;
+  z.next_out = (Bytef*)out;
+  z.avail_out = out_len;
+  const int err = inflate(&z, Z_FINISH);
+  const long total = z.total_out;
+  inflateEnd(&z);
+  return (err == Z_STREAM_END ? total : -1);
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__gzip_stream() {
+  // Text, fed in pieces of various sizes
+  const size_t size = 200 * 1000;
+  char* text = malloc(size);
+  for(size_t i=0; i<size; ++i) text[i] = "lorem ipsum dolor sit amet "[i % 27] + (i / 4096) % 3;
+
+  GzipStream* stream = malloc(sizeof(GzipStream));
+  GzipTestSink sink = { NULL, 0, 0 };
+  nu_assert("should init", gzip_stream_init(stream, Z_DEFAULT_COMPRESSION, gzip_test_sink, &sink).ok);
+  size_t done = 0;
+  for(size_t piece=1; done < size; piece *= 3) {
+    const size_t n = (size - done < piece ? size - done : piece);
+    nu_check("should compress a piece", gzip_stream_write(stream, text + done, n).ok);
+    done += n;
+  }
+  nu_check("should hold output back until a chunk fills", sink.len < GZIP_STREAM_CHUNK_SIZE);
+  nu_check("should finish", gzip_stream_finish(stream).ok);
+  nu_check("should count the input", stream->bytes_in == size);
+  nu_check("should count the output", stream->bytes_out == sink.len);
+  nu_check("should compress text", sink.len < size / 10);
+  nu_check("should start with the gzip magic",
+           sink.len > 2 && (unsigned char)sink.data[0] == 0x1f && (unsigned char)sink.data[1] == 0x8b);
+
+  char* out = malloc(size + 1);
+  nu_check("should round-trip", gzip_test_inflate(sink.data, sink.len, out, size + 1) == (long)size &&
+           !memcmp(out, text, size));
+  gzip_stream_free(stream);
+  free(sink.data);
+
+  // Incompressible input comes out in several chunks
+  for(size_t i=0; i<size; ++i) text[i] = rand();
+  memset(&sink, 0, sizeof(sink));
+  nu_assert("should init again", gzip_stream_init(stream, 1, gzip_test_sink, &sink).ok);
+  nu_check("should compress it all at once", gzip_stream_write(stream, text, size).ok);
+  nu_check("should finish again", gzip_stream_finish(stream).ok);
+  nu_check("should hand over full chunks", sink.chunks > size / GZIP_STREAM_CHUNK_SIZE);
+  nu_check("should round-trip random bytes",
+           gzip_test_inflate(sink.data, sink.len, out, size + 1) == (long)size &&
+           !memcmp(out, text, size));
+  gzip_stream_free(stream);
+  free(sink.data);
+
+  // Nothing at all still makes a valid stream
+  memset(&sink, 0, sizeof(sink));
+  nu_assert("should init for nothing", gzip_stream_init(stream, 9, gzip_test_sink, &sink).ok);
+  nu_check("should finish with nothing", gzip_stream_finish(stream).ok);
+  nu_check("should make an empty stream", gzip_test_inflate(sink.data, sink.len, out, size) == 0);
+  gzip_stream_free(stream);
+  free(sink.data);
+
+  free(out);
+  free(text);
+  free(stream);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__gzip_stream() {
+  nu_run_test(test__gzip_stream, "gzip_stream");
+}
+
+#endif // TEST_GZIP_STREAM_H
@@ -50,8 +50,25 @@ void test__http_method_from_string() {
   nu_check("failed to recognize PUT", val == HTTP_METHOD_PUT);
   val = http_method_from_string("DELETE");
   nu_check("failed to recognize DELETE", val == HTTP_METHOD_DELETE);
+  val = http_method_from_string("OPTIONS");
+  nu_check("failed to recognize OPTIONS", val == HTTP_METHOD_OPTIONS);
+  val = http_method_from_string("CONNECT");
+  nu_check("failed to recognize CONNECT", val == HTTP_METHOD_CONNECT);
   val = http_method_from_string("SHOUT");
   nu_check("failed to return UNKNOWN for invalid method", val == HTTP_METHOD_UNKNOWN);
+  val = http_method_from_string("get");
+  nu_check("failed to return UNKNOWN for lowercase method", val == HTTP_METHOD_UNKNOWN);
+}
+
+void test__http_method_lookup() {
+  nu_check("failed to look up a method", http_method_lookup("PATCH /x", 5) == HTTP_METHOD_PATCH);
+  nu_check("failed to respect the length", http_method_lookup("GETTER", 3) == HTTP_METHOD_GET);
+  nu_check("failed to reject a prefix", http_method_lookup("GE", 2) == HTTP_METHOD_UNKNOWN);
+  nu_check("failed to reject an empty method", http_method_lookup("", 0) == HTTP_METHOD_UNKNOWN);
+  for(int m=HTTP_METHOD_UNKNOWN+1; strcmp(http_method_to_string(m), "?"); ++m) {
+    const char* str = http_method_to_string(m);
+    nu_check("failed to round-trip a method", http_method_lookup(str, strlen(str)) == m);
+  }
 }
 
 void test__http_method_to_string() {
@@ -72,9 +89,68 @@ void test__http_method_to_string() {
   nu_check("failed to convert invalid enum to string", strcmp(str, "?")==0);
 }
 
+//==============================================================================
+// HTTP Headers
+//==============================================================================
+void test__http_header_to_string() {
+  nu_check("failed to convert HTTP_HEADER_HOST to string",
+           !strcmp(http_header_to_string(HTTP_HEADER_HOST), "Host"));
+  nu_check("failed to convert HTTP_HEADER_IF_MODIFIED_SINCE to string",
+           !strcmp(http_header_to_string(HTTP_HEADER_IF_MODIFIED_SINCE), "If-Modified-Since"));
+  nu_check("failed to convert HTTP_HEADER_UNKNOWN to string",
+           !strcmp(http_header_to_string(HTTP_HEADER_UNKNOWN), "?"));
+  nu_check("failed to convert invalid enum to string",
+           !strcmp(http_header_to_string(HTTP_HEADER_COUNT), "?"));
+}
+
+void test__http_header_lookup() {
+  nu_check("failed to recognize Content-Length",
+           http_header_from_string("Content-Length") == HTTP_HEADER_CONTENT_LENGTH);
+  nu_check("failed to ignore case",
+           http_header_from_string("cOnTeNt-lEnGtH") == HTTP_HEADER_CONTENT_LENGTH);
+  nu_check("failed to respect the length",
+           http_header_lookup("Accept-Encoding", 6) == HTTP_HEADER_ACCEPT);
+  nu_check("failed to return UNKNOWN for an unknown header",
+           http_header_from_string("X-Custom") == HTTP_HEADER_UNKNOWN);
+  nu_check("failed to return UNKNOWN for a near miss",
+           http_header_from_string("Content-Lenght") == HTTP_HEADER_UNKNOWN);
+
+  // Every well-known header should map back to itself
+  for(int h=HTTP_HEADER_UNKNOWN+1; h<HTTP_HEADER_COUNT; ++h) {
+    const char* str = http_header_to_string(h);
+    nu_check("failed to round-trip a header", http_header_lookup(str, strlen(str)) == h);
+  }
+}
+
+//==============================================================================
+// Content codings
+//==============================================================================
+void test__http_encoding_to_string() {
+  nu_check("failed to convert HTTP_ENCODING_IDENTITY to string",
+           !strcmp(http_encoding_to_string(HTTP_ENCODING_IDENTITY), "identity"));
+  nu_check("failed to convert HTTP_ENCODING_GZIP to string",
+           !strcmp(http_encoding_to_string(HTTP_ENCODING_GZIP), "gzip"));
+  nu_check("failed to convert HTTP_ENCODING_BR to string",
+           !strcmp(http_encoding_to_string(HTTP_ENCODING_BR), "br"));
+  nu_check("failed to convert HTTP_ENCODING_UNKNOWN to string",
+           !strcmp(http_encoding_to_string(HTTP_ENCODING_UNKNOWN), "?"));
+}
+
+void test__http_encoding_from_string() {
+  nu_check("failed to recognize identity", http_encoding_from_string("identity") == HTTP_ENCODING_IDENTITY);
+  nu_check("failed to recognize gzip", http_encoding_from_string("gzip") == HTTP_ENCODING_GZIP);
+  nu_check("failed to recognize x-gzip", http_encoding_from_string("x-gzip") == HTTP_ENCODING_GZIP);
+  nu_check("failed to recognize br", http_encoding_from_string("br") == HTTP_ENCODING_BR);
+  nu_check("failed to ignore case", http_encoding_from_string("GZip") == HTTP_ENCODING_GZIP);
+  nu_check("failed to return UNKNOWN for deflate",
+           http_encoding_from_string("deflate") == HTTP_ENCODING_UNKNOWN);
+  nu_check("failed to compare the length", http_encoding_lookup("gzip", 3) == HTTP_ENCODING_UNKNOWN);
+}
+
 //==============================================================================
 // HTTP Status Codes
 //==============================================================================
+
 void test__http_status_to_string() {
   const char* str = NULL;
   str = http_status_to_string(HTTP_STATUS_OK);
@@ -85,10 +161,19 @@ void test__http_status_to_string() {
   nu_check("failed to convert HTTP_STATUS_NOT_FOUND to string", !strcmp(str, "Not Found"));
   str = http_status_to_string(HTTP_STATUS_NOT_IMPLEMENTED);
   nu_check("failed to convert HTTP_STATUS_NOT_IMPLEMENTED to string", !strcmp(str, "Not Implemented"));
+  str = http_status_to_string(HTTP_STATUS_NOT_MODIFIED);
+  nu_check("failed to convert HTTP_STATUS_NOT_MODIFIED to string", !strcmp(str, "Not Modified"));
+  str = http_status_to_string(HTTP_STATUS_NETWORK_AUTHENTICATION_REQUIRED);
+  nu_check("failed to convert the last status to string",
+           !strcmp(str, "Network Authentication Required"));
   str = http_status_to_string(HTTP_STATUS_UNKNOWN);
   nu_check("failed to convert HTTP_STATUS_UNKNOWN to string", !strcmp(str, "?"));
   str = http_status_to_string(HTTP_STATUS_UNKNOWN + 3);
   nu_check("failed to convert invalid enum to string", !strcmp(str, "?"));
+  str = http_status_to_string((enum EHttpStatus)306);
+  nu_check("failed to convert an unused code to string", !strcmp(str, "?"));
+  str = http_status_to_string((enum EHttpStatus)HTTP_STATUS_MAX);
+  nu_check("failed to convert an out-of-range code to string", !strcmp(str, "?"));
 }
 
 void test__http_status_from_string() {
@@ -101,6 +186,8 @@ void test__http_status_from_string() {
   nu_check("failed to recognize Not Found", val == HTTP_STATUS_NOT_FOUND);
   val = http_status_from_string("Not Implemented");
   nu_check("failed to recognize Not Implemented", val == HTTP_STATUS_NOT_IMPLEMENTED);
+  val = http_status_from_string("Range Not Satisfiable");
+  nu_check("failed to recognize Range Not Satisfiable", val == HTTP_STATUS_RANGE_NOT_SATISFIABLE);
   val = http_status_from_string("AMAZING");
   nu_check("failed to return UNKNOWN for invalid status", val == HTTP_STATUS_UNKNOWN);
 }
@@ -113,8 +200,13 @@ void test_suite__http_enums() {
   nu_run_test(test__http_version_from_string, "http_version_from_string()");
   nu_run_test(test__http_method_to_string,    "http_method_to_string()");
   nu_run_test(test__http_method_from_string,  "http_method_from_string()");
-  nu_run_test(test__http_status_to_string,    "http_status_to_string()");
-  nu_run_test(test__http_status_from_string,  "http_status_from_string()");
+  nu_run_test(test__http_method_lookup,       "http_method_lookup()");
+  nu_run_test(test__http_header_to_string,    "http_header_to_string()");
+  nu_run_test(test__http_header_lookup,       "http_header_lookup()");
+  nu_run_test(test__http_encoding_to_string,   "http_encoding_to_string()");
+  nu_run_test(test__http_encoding_from_string, "http_encoding_from_string()");
+  nu_run_test(test__http_status_to_string,     "http_status_to_string()");
+  nu_run_test(test__http_status_from_string,   "http_status_from_string()");
 }
 
 #endif // TEST_HTTP_ENUMS_H
\ No newline at end of file
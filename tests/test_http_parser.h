@@ -0,0 +1,355 @@
+//==============================================================================
+// HttpParser tests
+//==============================================================================
+#ifndef TEST_HTTP_PARSER_H
+#define TEST_HTTP_PARSER_H
+
+#include "nu_unit.h"
+#include "http_parser.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sample request with a body, and extra whitespace around header values
+const char* HTTP_PARSER_REQUEST =
+  "POST /form HTTP/1.1\r\n"
+  "User-Agent:    curl/7.24.0\r\n"
+  "Host: localhost:4445  \r\n"
+  "Content-Length: 11\r\n"
+  "\r\n"
+  "hello world";
+
+// Helper: does the span hold exactly 'str'?
+bool http_parser_test_span(const char* buf, HttpSpan span, const char* str) {
+  return span.len == strlen(str) && !memcmp(buf + span.off, str, span.len);
+}
+
+// Helper: parse the request one byte at a time, checking the parser never
+// goes backwards, and gather the pieces of its body into 'body'. Returns the
+// last result.
+enum EHttpParseResult http_parser_test_bytewise(HttpParser* parser, const char* text,
+                                               bool* monotonic, int* headers_complete,
+                                               char* body)
+{
+  enum EHttpParseResult result = HTTP_PARSE_INCOMPLETE;
+  *monotonic = true;
+  *headers_complete = 0;
+  body[0] = 0;
+  for(size_t len=1; len<=strlen(text); ++len) {
+    const size_t before = parser->pos;
+    result = http_parser_execute(parser, text, len);
+    if(parser->pos < before || parser->pos > len) *monotonic = false;
+    if(result == HTTP_PARSE_HEADERS_COMPLETE) {
+      *headers_complete += 1;
+      result = http_parser_execute(parser, text, len);
+    }
+    strncat(body, text + parser->body.off, parser->body.len);
+    if(result == HTTP_PARSE_COMPLETE || result == HTTP_PARSE_ERROR) break;
+  }
+  return result;
+}
+
+// Helper: parse a whole request in one go, skipping over the headers-complete
+// notification and all but the last piece of the body
+enum EHttpParseResult http_parser_test_parse(HttpParser* parser, const char* text) {
+  http_parser_reset(parser);
+  enum EHttpParseResult result = HTTP_PARSE_HEADERS_COMPLETE;
+  while(result == HTTP_PARSE_HEADERS_COMPLETE || result == HTTP_PARSE_BODY) {
+    result = http_parser_execute(parser, text, strlen(text));
+  }
+  return result;
+}
+
+// Helper: write a chunked request into 'buf' whose one chunk has an extension
+// of 'len' bytes, counting the semicolon
+void http_parser_test_chunk_ext(char* buf, size_t len) {
+  strcpy(buf, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;");
+  const size_t start = strlen(buf);
+  memset(buf + start, 'x', len - 1);
+  strcpy(buf + start + len - 1, "\r\nhello\r\n0\r\n\r\n");
+}
+
+// Helper: parse a request that arrives 'step' bytes at a time into a buffer
+// that only ever holds what hasn't been parsed yet, as a server reading a body
+// would. Gathers the body into 'body', which has room for 'size' bytes.
+// Returns the last result, and the length of the body in 'body_len'.
+enum EHttpParseResult http_parser_test_stream(HttpParser* parser, const char* text, size_t step,
+                                             char* body, size_t size, size_t* body_len)
+{
+  char buf[256];
+  size_t buf_len = 0;
+  size_t sent = 0;
+  const size_t text_len = strlen(text);
+  enum EHttpParseResult result = HTTP_PARSE_INCOMPLETE;
+  http_parser_reset(parser);
+  *body_len = 0;
+  while(result != HTTP_PARSE_COMPLETE && result != HTTP_PARSE_ERROR) {
+    if(result == HTTP_PARSE_INCOMPLETE) {
+      if(sent == text_len) break;
+      const size_t n = (text_len - sent < step ? text_len - sent : step);
+      memcpy(buf + buf_len, text + sent, n);
+      buf_len += n;
+      sent += n;
+    }
+    result = http_parser_execute(parser, buf, buf_len);
+    if(parser->body.len && *body_len + parser->body.len <= size) {
+      memcpy(body + *body_len, buf + parser->body.off, parser->body.len);
+      *body_len += parser->body.len;
+    }
+
+    // Drop whatever's been parsed from the buffer
+    if(http_parser_in_body(parser)) {
+      const size_t done = parser->pos;
+      memmove(buf, buf + done, buf_len - done);
+      buf_len -= done;
+      http_parser_consume(parser, done);
+    }
+  }
+  return result;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__http_parser_execute() {
+  HttpParser parser;
+  http_parser_init(&parser);
+  const char* text = HTTP_PARSER_REQUEST;
+
+  nu_check("should report the headers first",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_HEADERS_COMPLETE);
+  nu_check("should stop after the headers", parser.pos == parser.header_len);
+  nu_check("should then finish the body",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_COMPLETE);
+  nu_check("should consume the whole request", parser.pos == strlen(text));
+
+  nu_check("should find the method", parser.method == HTTP_METHOD_POST);
+  nu_check("should find the version", parser.version == HTTP_VERSION_1_1);
+  nu_check("should find the uri", http_parser_test_span(text, parser.uri, "/form"));
+  nu_check("should find 3 headers", parser.num_headers == 3);
+  nu_check("should find the header name",
+           http_parser_test_span(text, parser.headers[0].name, "User-Agent"));
+  nu_check("should trim the header value",
+           http_parser_test_span(text, parser.headers[0].value, "curl/7.24.0"));
+  nu_check("should trim trailing whitespace",
+           http_parser_test_span(text, parser.headers[1].value, "localhost:4445"));
+  nu_check("should find the content length", parser.content_length == 11);
+  nu_check("should find the body", http_parser_test_span(text, parser.body, "hello world"));
+
+  const HttpParserHeader* host = http_parser_find_header(&parser, text, "host");
+  nu_check("should find a header by name", host == &parser.headers[1]);
+  nu_check("should not find a missing header", !http_parser_find_header(&parser, text, "Accept"));
+  nu_check("should identify a well-known header", parser.headers[1].id == HTTP_HEADER_HOST);
+  nu_check("should index a well-known header",
+           http_parser_known_header(&parser, HTTP_HEADER_HOST) == host);
+  nu_check("should not index a missing header",
+           !http_parser_known_header(&parser, HTTP_HEADER_ACCEPT));
+  http_parser_free(&parser);
+}
+
+void test__http_parser_execute__fragments() {
+  HttpParser parser;
+  http_parser_init(&parser);
+  bool monotonic = false;
+  int headers_complete = 0;
+  char body[64];
+
+  enum EHttpParseResult result = http_parser_test_bytewise(&parser, HTTP_PARSER_REQUEST,
+                                                           &monotonic, &headers_complete, body);
+  nu_check("should complete when fed a byte at a time", result == HTTP_PARSE_COMPLETE);
+  nu_check("should never go backwards", monotonic);
+  nu_check("should report the headers once", headers_complete == 1);
+  nu_check("should consume the whole request", parser.pos == strlen(HTTP_PARSER_REQUEST));
+  nu_check("should find the uri", http_parser_test_span(HTTP_PARSER_REQUEST, parser.uri, "/form"));
+  nu_check("should hand over the body a piece at a time", !strcmp(body, "hello world"));
+  nu_check("should count the body", parser.body_received == 11);
+
+  // Without a body, the headers are the end of the request
+  const char* text = "GET / HTTP/1.0\r\nHost: x\r\n\r\n";
+  http_parser_reset(&parser);
+  result = http_parser_test_bytewise(&parser, text, &monotonic, &headers_complete, body);
+  nu_check("should complete a request without a body", result == HTTP_PARSE_COMPLETE);
+  nu_check("should not report headers separately", headers_complete == 0);
+  nu_check("should find the version", parser.version == HTTP_VERSION_1_0);
+  http_parser_free(&parser);
+}
+
+void test__http_parser_execute__pipelined() {
+  HttpParser parser;
+  http_parser_init(&parser);
+  const char* text =
+    "GET /a HTTP/1.1\r\n\r\n"
+    "POST /b HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+    "GET /c HTTP/1.1\r\n";
+  const size_t len = strlen(text);
+
+  nu_check("should parse the first request",
+           http_parser_test_parse(&parser, text) == HTTP_PARSE_COMPLETE);
+  nu_check("should stop at the end of the first request", parser.pos == 19);
+
+  // The parser works on the request at the start of the buffer
+  size_t off = parser.pos;
+  nu_check("should parse the second request",
+           http_parser_test_parse(&parser, text + off) == HTTP_PARSE_COMPLETE);
+  nu_check("should take only its body", http_parser_test_span(text + off, parser.body, "abc"));
+
+  off += parser.pos;
+  http_parser_reset(&parser);
+  nu_check("should wait for the rest of the third",
+           http_parser_execute(&parser, text + off, len - off) == HTTP_PARSE_INCOMPLETE);
+  nu_check("should have consumed what it was given", parser.pos == len - off);
+  http_parser_free(&parser);
+}
+
+void test__http_parser_execute__leniency() {
+  HttpParser parser;
+  http_parser_init(&parser);
+
+  const char* text = "\r\n\nGET  /  HTTP/1.1 \nAccept:*/*\nX-Empty:\n\n";
+  nu_check("should accept blank lines, extra spaces and bare LFs",
+           http_parser_test_parse(&parser, text) == HTTP_PARSE_COMPLETE);
+  nu_check("should find the uri", http_parser_test_span(text, parser.uri, "/"));
+  nu_check("should find 2 headers", parser.num_headers == 2);
+  nu_check("should find the value", http_parser_test_span(text, parser.headers[0].value, "*/*"));
+  nu_check("should allow an empty value", parser.headers[1].value.len == 0);
+  http_parser_free(&parser);
+}
+
+void test__http_parser_execute__chunked() {
+  HttpParser parser;
+  http_parser_init(&parser);
+  const char* text =
+    "POST /upload HTTP/1.1\r\n"
+    "Transfer-Encoding: Chunked\r\n"
+    "\r\n"
+    "5\r\nhello\r\n"
+    "1;name=value\r\n \r\n"
+    "A\nworld, 123\n"
+    "0\r\n"
+    "Checksum: none\r\n"
+    "\r\n"
+    "GET / HTTP/1.1\r\n";
+
+  nu_check("should report the headers first",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_HEADERS_COMPLETE);
+  nu_check("should see that the body is chunked", parser.chunked && !parser.other_coding);
+  nu_check("should hand over the first chunk",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_BODY &&
+           http_parser_test_span(text, parser.body, "hello"));
+  nu_check("should skip the extension",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_BODY &&
+           http_parser_test_span(text, parser.body, " "));
+  nu_check("should accept bare LFs",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_BODY &&
+           http_parser_test_span(text, parser.body, "world, 123"));
+  nu_check("should skip the trailers",
+           http_parser_execute(&parser, text, strlen(text)) == HTTP_PARSE_COMPLETE &&
+           parser.body.len == 0);
+  nu_check("should stop at the end of the request", !strcmp(text + parser.pos, "GET / HTTP/1.1\r\n"));
+  nu_check("should count the body", parser.body_received == 16);
+
+  // However it's split up, and with the buffer emptied as it goes
+  bool monotonic = false;
+  int headers_complete = 0;
+  char body[64];
+  http_parser_reset(&parser);
+  nu_check("should complete when fed a byte at a time",
+           http_parser_test_bytewise(&parser, text, &monotonic, &headers_complete, body) ==
+           HTTP_PARSE_COMPLETE && !strcmp(body, "hello world, 123"));
+  bool intact = true;
+  for(size_t step=1; step<=24; ++step) {
+    size_t body_len = 0;
+    intact = intact &&
+      http_parser_test_stream(&parser, text, step, body, sizeof(body), &body_len) == HTTP_PARSE_COMPLETE &&
+      body_len == 16 && !memcmp(body, "hello world, 123", 16);
+  }
+  nu_check("should decode the body through a small buffer", intact);
+
+  // A Content-Length body goes through the same way
+  size_t body_len = 0;
+  nu_check("should take a framed body through a small buffer",
+           http_parser_test_stream(&parser, HTTP_PARSER_REQUEST, 7, body, sizeof(body), &body_len) ==
+           HTTP_PARSE_COMPLETE && body_len == 11 && !memcmp(body, "hello world", 11));
+
+  // Codings can be listed across headers, with empty elements and parameters
+  text = "POST / HTTP/1.1\r\nTransfer-Encoding: ,\r\nTransfer-Encoding: , Chunked ;\r\n\r\n0\r\n\r\n";
+  nu_check("should find chunked at the end of a list",
+           http_parser_test_parse(&parser, text) == HTTP_PARSE_COMPLETE && parser.chunked);
+
+  // Other codings before chunked can be framed, but not decoded
+  text = "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n5\r\nhello\r\n";
+  nu_check("should reject a coding it doesn't support",
+           http_parser_test_parse(&parser, text) == HTTP_PARSE_ERROR && parser.not_implemented);
+  http_parser_free(&parser);
+}
+
+void test__http_parser_execute__errors() {
+  const char* bad[] = {
+    "FOO / HTTP/1.1\r\n\r\n",                              // Unknown method
+    "G@T / HTTP/1.1\r\n\r\n",                              // Bad method character
+    "GET /\r\n\r\n",                                       // No version
+    "GET / HTTP/2.0\r\n\r\n",                              // Unknown version
+    "GET / HTTP/1.1\rX\n\r\n",                             // CR without LF
+    "GET / HTTP/1.1\r\nHost : x\r\n\r\n",                  // Space before colon
+    "GET / HTTP/1.1\r\nHost: x\r\n  folded\r\n\r\n",       // Obsolete line folding
+    "GET / HTTP/1.1\r\nHost: a\x01z\r\n\r\n",              // Control character
+    "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",       // Bad length
+    "POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nx\r\n",          // Bad chunk size
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloX",    // No CRLF after data
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\rX",          // CR without LF
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n11111111111111111\r\n",
+    "GET / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",                // Chunked not last
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding:\r\n\r\n",                    // No codings
+  };
+  HttpParser parser;
+  http_parser_init(&parser);
+  for(size_t i=0; i<sizeof(bad)/sizeof(bad[0]); ++i) {
+    const bool failed = http_parser_test_parse(&parser, bad[i]) == HTTP_PARSE_ERROR;
+    nu_check("should reject a malformed request", failed && parser.error && !parser.not_implemented);
+    nu_check("should stay failed",
+             http_parser_execute(&parser, bad[i], strlen(bad[i])) == HTTP_PARSE_ERROR);
+  }
+
+  // Too many headers
+  char text[4096] = "GET / HTTP/1.1\r\n";
+  for(int i=0; i<=HTTP_PARSER_MAX_HEADERS; ++i) strcat(text, "A: b\r\n");
+  strcat(text, "\r\n");
+  nu_check("should reject too many headers",
+           http_parser_test_parse(&parser, text) == HTTP_PARSE_ERROR);
+
+  // Chunk extensions and trailers that go on too long, even when each
+  // trailer line is short
+  char chunked[2 * HTTP_PARSER_MAX_TRAILERS];
+  http_parser_test_chunk_ext(chunked, HTTP_PARSER_MAX_CHUNK_EXT);
+  nu_check("should accept a chunk extension up to the limit",
+           http_parser_test_parse(&parser, chunked) == HTTP_PARSE_COMPLETE);
+  http_parser_test_chunk_ext(chunked, HTTP_PARSER_MAX_CHUNK_EXT + 1);
+  nu_check("should reject a longer chunk extension",
+           http_parser_test_parse(&parser, chunked) == HTTP_PARSE_ERROR &&
+           !strcmp(parser.error, "Chunk extension too long"));
+  strcpy(chunked, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n");
+  for(int i=0; i<=HTTP_PARSER_MAX_TRAILERS/4; ++i) strcat(chunked, "A: b\r\n");
+  strcat(chunked, "\r\n");
+  nu_check("should reject too many trailers",
+           http_parser_test_parse(&parser, chunked) == HTTP_PARSE_ERROR &&
+           !strcmp(parser.error, "Trailers too large"));
+  http_parser_free(&parser);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__http_parser() {
+  nu_run_test(test__http_parser_execute,            "http_parser_execute()");
+  nu_run_test(test__http_parser_execute__fragments, "http_parser_execute() w/ fragments");
+  nu_run_test(test__http_parser_execute__pipelined, "http_parser_execute() w/ pipelining");
+  nu_run_test(test__http_parser_execute__leniency,  "http_parser_execute() w/ leniency");
+  nu_run_test(test__http_parser_execute__chunked,   "http_parser_execute() w/ chunks");
+  nu_run_test(test__http_parser_execute__errors,    "http_parser_execute() w/ errors");
+}
+
+#endif // TEST_HTTP_PARSER_H
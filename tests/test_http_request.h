@@ -8,6 +8,7 @@
 
 #include "nu_unit.h"
 #include "http_request.h"
+#include "utils.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -101,6 +102,148 @@ void test__http_request_parse() {
   http_request_free(&request);
 }
 
+void test__http_request_get_header() {
+  HttpRequest request;
+  http_request_init(&request);
+  http_request_parse(&request, HTTP_REQUEST_STRING);
+  nu_check("should find a header", !strcmp(safe_cstr(http_request_get_header(&request, "Host")), "localhost:4445"));
+  nu_check("should ignore key case", !strcmp(safe_cstr(http_request_get_header(&request, "content-length")), "4"));
+  nu_check("should return NULL for a missing header", !http_request_get_header(&request, "Connection"));
+  http_request_free(&request);
+}
+
+void test__http_request_header_has_token() {
+  HttpRequest request;
+  http_request_init(&request);
+  http_request_parse(&request, "GET / HTTP/1.1\r\nConnection: Keep-Alive , Upgrade\r\n\r\n");
+  nu_check("should find the first token", http_request_header_has_token(&request, "Connection", "keep-alive"));
+  nu_check("should find a later token", http_request_header_has_token(&request, "connection", "upgrade"));
+  nu_check("shouldn't match part of a token", !http_request_header_has_token(&request, "Connection", "keep"));
+  nu_check("shouldn't find a missing header", !http_request_header_has_token(&request, "Upgrade", "h2c"));
+  http_request_free(&request);
+}
+
+// Helper: which coding is chosen for an Accept-Encoding value, out of
+// identity and the codings in 'available'? Pass NULL for no header.
+enum EHttpEncoding test_accept_encoding(const char* value, unsigned available) {
+  HttpAcceptEncoding accept;
+  http_accept_encoding_parse(&accept, value, value ? strlen(value) : 0);
+  return http_accept_encoding_choose(&accept, available);
+}
+
+void test__http_accept_encoding() {
+  const unsigned GZ = 1u << HTTP_ENCODING_GZIP;
+  const unsigned BR = 1u << HTTP_ENCODING_BR;
+  const char* value = "gzip;q=0.5, br ; Q=1.0,identity;q=0";
+  HttpAcceptEncoding accept;
+  http_accept_encoding_parse(&accept, value, strlen(value));
+  nu_check("should parse a q-value", accept.q[HTTP_ENCODING_GZIP] == 500);
+  nu_check("should parse a q-value after spaces", accept.q[HTTP_ENCODING_BR] == 1000);
+  nu_check("should parse a zero q-value", accept.q[HTTP_ENCODING_IDENTITY] == 0);
+
+  nu_check("should send identity without a header", test_accept_encoding(NULL, GZ | BR) == HTTP_ENCODING_IDENTITY);
+  nu_check("should send identity for an empty header", test_accept_encoding("", GZ | BR) == HTTP_ENCODING_IDENTITY);
+  nu_check("should prefer br to gzip", test_accept_encoding("gzip, deflate, br", GZ | BR) == HTTP_ENCODING_BR);
+  nu_check("should use what's available", test_accept_encoding("gzip, br", GZ) == HTTP_ENCODING_GZIP);
+  nu_check("should fall back to identity", test_accept_encoding("br", GZ) == HTTP_ENCODING_IDENTITY);
+  nu_check("should follow q-values", test_accept_encoding("br;q=0.2, gzip;q=0.8", GZ | BR) == HTTP_ENCODING_GZIP);
+  nu_check("should skip excluded codings", test_accept_encoding("br;q=0, gzip", GZ | BR) == HTTP_ENCODING_GZIP);
+  nu_check("should accept x-gzip", test_accept_encoding("x-gzip", GZ | BR) == HTTP_ENCODING_GZIP);
+  nu_check("should ignore case", test_accept_encoding("GZIP", GZ) == HTTP_ENCODING_GZIP);
+  nu_check("should apply '*' to unlisted codings", test_accept_encoding("*", BR) == HTTP_ENCODING_BR);
+  nu_check("should let listed codings override '*'",
+           test_accept_encoding("*;q=0.5, br;q=0.1", GZ | BR) == HTTP_ENCODING_GZIP);
+  nu_check("should prefer identity if asked to",
+           test_accept_encoding("identity, gzip;q=0.5", GZ) == HTTP_ENCODING_IDENTITY);
+  nu_check("should ignore a malformed q-value",
+           test_accept_encoding("br;q=2, gzip", GZ | BR) == HTTP_ENCODING_GZIP);
+  nu_check("should give nothing if identity is excluded",
+           test_accept_encoding("br, identity;q=0", GZ) == HTTP_ENCODING_UNKNOWN);
+  nu_check("should give nothing if '*' is excluded",
+           test_accept_encoding("*;q=0", 0) == HTTP_ENCODING_UNKNOWN);
+}
+
+// Helper: does a null-terminated If-None-Match value match 'etag'?
+bool test_etag_match(const char* value, const char* etag) {
+  return http_etag_list_match(value, strlen(value), etag);
+}
+
+void test__http_etag_list_match() {
+  const char* etag = "\"1a-2b-3c-4d\"";
+  nu_check("should match the tag", test_etag_match("\"1a-2b-3c-4d\"", etag));
+  nu_check("should match in a list", test_etag_match("\"x\", \"y\" ,\"1a-2b-3c-4d\"", etag));
+  nu_check("should match a weak tag", test_etag_match("W/\"1a-2b-3c-4d\"", etag));
+  nu_check("should match a weak ETag", test_etag_match("\"x\"", "W/\"x\""));
+  nu_check("should match anything with *", test_etag_match("*", etag));
+  nu_check("should not match another tag", !test_etag_match("\"1a-2b-3c-4e\"", etag));
+  nu_check("should not match a prefix", !test_etag_match("\"1a-2b-3c\"", etag));
+  nu_check("should not match without quotes", !test_etag_match("1a-2b-3c-4d", etag));
+  nu_check("should not match an empty value", !test_etag_match("", etag));
+  nu_check("should allow commas in tags", test_etag_match("\"a,b\", \"1a-2b-3c-4d\"", etag));
+  nu_check("should stop at an unterminated tag", !test_etag_match("\"x, \"1a-2b-3c-4d", etag));
+  nu_check("should only look at 'len' bytes",
+           !http_etag_list_match("\"1a-2b-3c-4d\"", 12, etag));
+}
+
+// Helper: parse a null-terminated Range value against a 1000-byte file, and
+// check the result is 'expected', with ranges as in 'want' (first, last, ...)
+bool test_range(const char* value, int expected, const uint64_t* want) {
+  HttpRange ranges[4];
+  const int count = http_range_parse(value, strlen(value), 1000, ranges, 4);
+  if(count != expected) return false;
+  for(int i=0; i<count; ++i) {
+    if(ranges[i].first != want[2*i] || ranges[i].last != want[2*i + 1]) return false;
+  }
+  return true;
+}
+
+void test__http_range_parse() {
+  nu_check("should parse a range", test_range("bytes=0-499", 1, (uint64_t[]){ 0, 499 }));
+  nu_check("should parse an open range", test_range("bytes=500-", 1, (uint64_t[]){ 500, 999 }));
+  nu_check("should parse a suffix", test_range("bytes=-100", 1, (uint64_t[]){ 900, 999 }));
+  nu_check("should clip a long suffix", test_range("bytes=-5000", 1, (uint64_t[]){ 0, 999 }));
+  nu_check("should clip the end", test_range("bytes=990-5000", 1, (uint64_t[]){ 990, 999 }));
+  nu_check("should cap huge numbers",
+           test_range("bytes=1-99999999999999999999999", 1, (uint64_t[]){ 1, 999 }));
+  nu_check("should take the unit in any case", test_range("Bytes=1-1", 1, (uint64_t[]){ 1, 1 }));
+  nu_check("should parse several ranges", test_range("bytes=0-0, -1 ,500-599", 3,
+           (uint64_t[]){ 0, 0, 500, 599, 999, 999 }));
+  nu_check("should sort and merge ranges", test_range("bytes=500-600,0-9,10-19,550-700", 2,
+           (uint64_t[]){ 0, 19, 500, 700 }));
+  nu_check("should skip empty elements", test_range("bytes=,1-2,,", 1, (uint64_t[]){ 1, 2 }));
+  nu_check("should drop a range past the end", test_range("bytes=1000-,5-5", 1, (uint64_t[]){ 5, 5 }));
+  nu_check("should find nothing past the end", test_range("bytes=1000-1001", 0, NULL));
+  nu_check("should find nothing in an empty suffix", test_range("bytes=-0", 0, NULL));
+  nu_check("should ignore another unit", test_range("items=0-1", -1, NULL));
+  nu_check("should ignore a backwards range", test_range("bytes=5-4", -1, NULL));
+  nu_check("should ignore a missing dash", test_range("bytes=5", -1, NULL));
+  nu_check("should ignore a lone dash", test_range("bytes=-", -1, NULL));
+  nu_check("should ignore junk", test_range("bytes=1-2x", -1, NULL));
+  nu_check("should ignore no ranges", test_range("bytes=", -1, NULL));
+  nu_check("should ignore too many ranges", test_range("bytes=1-1,3-3,5-5,7-7,9-9", -1, NULL));
+  HttpRange range;
+  nu_check("should find nothing in an empty file",
+           http_range_parse("bytes=0-", 8, 0, &range, 1) == 0);
+}
+
+void test__http_request_keep_alive() {
+  struct { const char* text; bool keep_alive; } cases[] = {
+    { "GET / HTTP/1.1\r\n\r\n",                          true  },
+    { "GET / HTTP/1.1\r\nConnection: close\r\n\r\n",       false },
+    { "GET / HTTP/1.1\r\nConnection: keep-alive\r\n\r\n",  true  },
+    { "GET / HTTP/1.0\r\n\r\n",                          false },
+    { "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n",  true  },
+    { "GET / HTTP/1.0\r\nConnection: close\r\n\r\n",       false },
+  };
+  for(size_t i=0; i<sizeof(cases)/sizeof(cases[0]); ++i) {
+    HttpRequest request;
+    http_request_init(&request);
+    http_request_parse(&request, cases[i].text);
+    nu_check("wrong keep-alive decision", http_request_keep_alive(&request) == cases[i].keep_alive);
+    http_request_free(&request);
+  }
+}
+
 void test__http_request_add_header() {
   HttpHeader* header = NULL;
   HttpRequest request;
@@ -116,12 +259,11 @@ void test__http_request_add_header() {
 }
 
 void test__http_request_pop_header() {
-  HttpHeader* header = NULL;
   HttpRequest request;
   http_request_init(&request);
   // Add two headers
-  header = http_request_add_header(&request);
-  header = http_request_add_header(&request);
+  http_request_add_header(&request);
+  http_request_add_header(&request);
   // Start popping
   nu_assert("expected num_headers to be 2", request.num_headers == 2);
   http_request_pop_header(&request);
@@ -168,6 +310,12 @@ void test_suite__http_header() {
 void test_suite__http_request() {
   nu_run_test(test__http_request_init,       "http_request_init()");
   nu_run_test(test__http_request_parse,      "http_request_parse()");
+  nu_run_test(test__http_request_get_header, "http_request_get_header()");
+  nu_run_test(test__http_request_header_has_token, "http_request_header_has_token()");
+  nu_run_test(test__http_accept_encoding,    "http_accept_encoding_parse() and _choose()");
+  nu_run_test(test__http_etag_list_match,    "http_etag_list_match()");
+  nu_run_test(test__http_range_parse,        "http_range_parse()");
+  nu_run_test(test__http_request_keep_alive, "http_request_keep_alive()");
   nu_run_test(test__http_request_add_header, "http_request_add_header()");
   nu_run_test(test__http_request_pop_header, "http_request_pop_header()");
   nu_run_test(test__http_request_free,       "http_request_free()");
@@ -0,0 +1,130 @@
+//==============================================================================
+// HttpRequestView tests
+//==============================================================================
+#ifndef TEST_HTTP_REQUEST_VIEW_H
+#define TEST_HTTP_REQUEST_VIEW_H
+
+#include "nu_unit.h"
+#include "http_parser.h"
+#include "http_request_view.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Helper: parse 'text' and describe it with a view
+void http_request_view_test_parse(HttpParser* parser, HttpRequestView* view,
+                                  const char* text)
+{
+  http_parser_reset(parser);
+  if(http_parser_execute(parser, text, strlen(text)) == HTTP_PARSE_HEADERS_COMPLETE) {
+    http_parser_execute(parser, text, strlen(text));
+  }
+  http_request_view_init(view, parser, text);
+}
+
+// Helper: does the span hold exactly 'str'?
+bool http_request_view_test_span(const HttpRequestView* view, HttpSpan span,
+                                 const char* str)
+{
+  return span.len == strlen(str) &&
+         !memcmp(http_request_view_ptr(view, span), str, span.len);
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__http_request_view_init() {
+  HttpParser parser;
+  HttpRequestView view;
+  http_parser_init(&parser);
+  const char* text =
+    "POST /form?a=1 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Content-Length: 5\r\n"
+    "\r\n"
+    "hello"
+    "GET /next HTTP/1.1\r\n\r\n";
+  http_request_view_test_parse(&parser, &view, text);
+
+  nu_check("should point into the buffer", view.buf == text);
+  nu_check("should have the method", view.method == HTTP_METHOD_POST);
+  nu_check("should have the version", view.version == HTTP_VERSION_1_1);
+  nu_check("should have the uri", http_request_view_test_span(&view, view.uri, "/form?a=1"));
+  nu_check("should share the parser's headers", view.headers == parser.headers);
+  nu_check("should have 2 headers", view.num_headers == 2);
+  nu_check("should have the body", http_request_view_test_span(&view, view.body, "hello"));
+  http_parser_free(&parser);
+}
+
+void test__http_request_view_get_header() {
+  HttpParser parser;
+  HttpRequestView view;
+  http_parser_init(&parser);
+  http_request_view_test_parse(&parser, &view,
+    "GET / HTTP/1.1\r\nHost: a\r\nConnection: keep-alive, Upgrade\r\n\r\n");
+
+  HttpSpan value;
+  nu_check("should find a header", http_request_view_get_header(&view, "connection", &value));
+  nu_check("should find its value",
+           http_request_view_test_span(&view, value, "keep-alive, Upgrade"));
+  nu_check("shouldn't find a missing header", !http_request_view_get_header(&view, "Accept", &value));
+  nu_check("should find a well-known header",
+           http_request_view_find_header(&view, HTTP_HEADER_HOST, &value) &&
+           http_request_view_test_span(&view, value, "a"));
+  nu_check("should find a later token",
+           http_request_view_header_has_token(&view, HTTP_HEADER_CONNECTION, "upgrade"));
+  nu_check("shouldn't match part of a token",
+           !http_request_view_header_has_token(&view, HTTP_HEADER_CONNECTION, "keep"));
+  http_parser_free(&parser);
+}
+
+void test__http_request_view_keep_alive() {
+  struct { const char* text; bool keep_alive; } cases[] = {
+    { "GET / HTTP/1.1\r\n\r\n",                                true  },
+    { "GET / HTTP/1.1\r\nConnection: close\r\n\r\n",           false },
+    { "GET / HTTP/1.0\r\n\r\n",                                false },
+    { "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n",      true  },
+  };
+  HttpParser parser;
+  HttpRequestView view;
+  http_parser_init(&parser);
+  for(size_t i=0; i<sizeof(cases)/sizeof(cases[0]); ++i) {
+    http_request_view_test_parse(&parser, &view, cases[i].text);
+    nu_check("wrong keep-alive decision",
+             http_request_view_keep_alive(&view) == cases[i].keep_alive);
+  }
+  http_parser_free(&parser);
+}
+
+void test__http_request_view_copy() {
+  HttpParser parser;
+  HttpRequestView view;
+  http_parser_init(&parser);
+  http_request_view_test_parse(&parser, &view,
+    "POST /form HTTP/1.1\r\nHost: localhost:4445  \r\nContent-Length: 11\r\n\r\nhello world");
+
+  HttpRequest request;
+  http_request_init(&request);
+  http_request_view_copy(&view, &request);
+  nu_check("should copy the method", request.method == HTTP_METHOD_POST);
+  nu_check("should copy the version", request.version == HTTP_VERSION_1_1);
+  nu_check("should copy the uri", request.uri && !strcmp(request.uri, "/form"));
+  nu_check("should copy the headers", request.num_headers == 2);
+  nu_check("should copy a header value",
+           !strcmp(http_request_get_header(&request, "Host"), "localhost:4445"));
+  nu_check("should copy the body", request.body && !strcmp(request.body, "hello world"));
+  http_request_free(&request);
+  http_parser_free(&parser);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__http_request_view() {
+  nu_run_test(test__http_request_view_init,       "http_request_view_init()");
+  nu_run_test(test__http_request_view_get_header, "http_request_view_get_header()");
+  nu_run_test(test__http_request_view_keep_alive, "http_request_view_keep_alive()");
+  nu_run_test(test__http_request_view_copy,       "http_request_view_copy()");
+}
+
+#endif // TEST_HTTP_REQUEST_VIEW_H
@@ -0,0 +1,88 @@
+//==============================================================================
+// HttpResponseBuilder tests
+//==============================================================================
+#ifndef TEST_HTTP_RESPONSE_BUILDER_H
+#define TEST_HTTP_RESPONSE_BUILDER_H
+
+#include "nu_unit.h"
+#include "arena.h"
+#include "http_response_builder.h"
+#include <string.h>
+
+// Helper: does the iovec hold exactly 'str'?
+bool http_response_builder_test_iov(const struct iovec* iov, const char* str) {
+  return iov->iov_len == strlen(str) && !memcmp(iov->iov_base, str, iov->iov_len);
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__http_response_builder_head() {
+  Arena arena;
+  arena_init(&arena, NULL);
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_0, HTTP_STATUS_NOT_FOUND);
+  http_response_builder_add_header(&res, "Server", "webserver");
+  http_response_builder_add_header_uint(&res, "Content-Length", 0);
+
+  struct iovec iov[2];
+  nu_check("should describe just the head", http_response_builder_iov(&res, iov) == 1);
+  nu_check("should format the head", http_response_builder_test_iov(&iov[0],
+           "HTTP/1.0 404 Not Found\r\nServer: webserver\r\nContent-Length: 0\r\n\r\n"));
+  nu_check("should finish the head once", http_response_builder_iov(&res, iov) == 1 &&
+           iov[0].iov_len == strlen("HTTP/1.0 404 Not Found\r\nServer: webserver\r\n"
+                                    "Content-Length: 0\r\n\r\n"));
+  arena_free(&arena);
+}
+
+void test__http_response_builder_body() {
+  Arena arena;
+  arena_init(&arena, NULL);
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  const char* body = "I like programming!";
+  http_response_builder_set_body(&res, body, strlen(body));
+
+  struct iovec iov[2];
+  nu_check("should describe the head and body", http_response_builder_iov(&res, iov) == 2);
+  nu_check("should add the content length", http_response_builder_test_iov(&iov[0],
+           "HTTP/1.1 200 OK\r\nContent-Length: 19\r\n\r\n"));
+  nu_check("should refer to the body, not copy it", iov[1].iov_base == body);
+  nu_check("should have the body's length", iov[1].iov_len == strlen(body));
+  arena_free(&arena);
+}
+
+void test__http_response_builder_grow() {
+  Arena arena;
+  arena_init(&arena, NULL);
+  HttpResponseBuilder res;
+  http_response_builder_init(&res, &arena);
+  http_response_builder_set_status(&res, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+
+  // Far more header bytes than the initial head holds
+  char value[1000];
+  memset(value, 'v', sizeof(value) - 1);
+  value[sizeof(value) - 1] = 0;
+  for(int i=0; i<10; ++i) http_response_builder_add_header(&res, "X-Filler", value);
+
+  struct iovec iov[2];
+  http_response_builder_iov(&res, iov);
+  const size_t expect = strlen("HTTP/1.1 200 OK\r\n") + 10 * (strlen("X-Filler: ") + 999 + 2) + 2;
+  nu_check("should grow the head", iov[0].iov_len == expect);
+  nu_check("should keep what was written first", !memcmp(iov[0].iov_base, "HTTP/1.1 200 OK\r\n", 17));
+  nu_check("should end the head", !memcmp((char*)iov[0].iov_base + expect - 4, "\r\n\r\n", 4));
+  arena_free(&arena);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__http_response_builder() {
+  nu_run_test(test__http_response_builder_head, "http_response_builder_iov() w/o body");
+  nu_run_test(test__http_response_builder_body, "http_response_builder_set_body()");
+  nu_run_test(test__http_response_builder_grow, "http_response_builder w/ large head");
+}
+
+#endif // TEST_HTTP_RESPONSE_BUILDER_H
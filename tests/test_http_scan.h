@@ -0,0 +1,79 @@
+//==============================================================================
+// HTTP scanning kernel tests
+//==============================================================================
+#ifndef TEST_HTTP_SCAN_H
+#define TEST_HTTP_SCAN_H
+
+#include "nu_unit.h"
+#include "http_scan.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Helper: check one kernel set against the character class table. For every
+// byte value, place it at every offset of a buffer otherwise full of 'fill',
+// and make sure each scan stops exactly where it should.
+bool http_scan_test_impl(enum EHttpScanImpl impl) {
+  char buf[80];
+  for(int c=0; c<256; ++c) {
+    const uint8_t cls = http_char_class[c];
+    for(size_t at=0; at<sizeof(buf); ++at) {
+      memset(buf, 'a', sizeof(buf));
+      buf[at] = (char)c;
+      const size_t token = http_scan_token(buf, sizeof(buf));
+      const size_t visible = http_scan_visible(buf, sizeof(buf));
+      const size_t value = http_scan_value(buf, sizeof(buf));
+      if(token   != ((cls & HTTP_CHAR_TOKEN)   ? sizeof(buf) : at)) return false;
+      if(visible != ((cls & HTTP_CHAR_VISIBLE) ? sizeof(buf) : at)) return false;
+      if(value   != ((cls & HTTP_CHAR_VALUE)   ? sizeof(buf) : at)) return false;
+    }
+  }
+
+  // Scans must stop at 'len', whatever follows
+  memset(buf, 'a', sizeof(buf));
+  for(size_t len=0; len<sizeof(buf); ++len) {
+    if(http_scan_token(buf, len) != len) return false;
+  }
+  return true;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__http_char_class() {
+  nu_check("letters are tokens", http_is_token_char('a') && http_is_token_char('Z'));
+  nu_check("some symbols are tokens", http_is_token_char('-') && http_is_token_char('~'));
+  nu_check("delimiters aren't tokens", !http_is_token_char(':') && !http_is_token_char('"'));
+  nu_check("space isn't visible", !http_is_visible_char(' '));
+  nu_check("DEL isn't visible", !http_is_visible_char(0x7f));
+  nu_check("non-ASCII bytes are visible", http_is_visible_char(0xc3));
+  nu_check("tab is part of a value", http_char_class['\t'] & HTTP_CHAR_VALUE);
+  nu_check("CR isn't part of a value", !(http_char_class['\r'] & HTTP_CHAR_VALUE));
+}
+
+void test__http_scan() {
+  const enum EHttpScanImpl best = http_scan_impl();
+  nu_check("should start with SIMD kernels on x86-64",
+#ifdef __x86_64__
+           best != HTTP_SCAN_SCALAR
+#else
+           true
+#endif
+           );
+
+  const enum EHttpScanImpl impls[] = {HTTP_SCAN_SCALAR, HTTP_SCAN_SSE2, HTTP_SCAN_AVX2};
+  for(size_t i=0; i<sizeof(impls)/sizeof(impls[0]); ++i) {
+    if(!http_scan_use(impls[i])) continue;
+    nu_check("kernels disagree with the character classes", http_scan_test_impl(impls[i]));
+  }
+  nu_check("should switch back", http_scan_use(best) && http_scan_impl() == best);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__http_scan() {
+  nu_run_test(test__http_char_class, "http character classes");
+  nu_run_test(test__http_scan,       "http_scan_*()");
+}
+
+#endif // TEST_HTTP_SCAN_H
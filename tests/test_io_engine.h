@@ -0,0 +1,698 @@
+//==============================================================================
+// IO engine tests
+//==============================================================================
+#ifndef TEST_IO_ENGINE_H
+#define TEST_IO_ENGINE_H
+
+#include "nu_unit.h"
+#include "clock.h"
+#include "io_engine.h"
+#include "static_file.h"
+#include "test_response_stream.h"
+#include "test_sockets.h"
+#include "webserver_config.h"
+#include "worker.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+//==============================================================================
+// Helpers
+//==============================================================================
+// Arguments and result for a worker running on a background thread
+typedef struct EngineTestRun {
+  enum EIoEngine engine;
+  Worker*        worker;
+  Status         status;
+} EngineTestRun;
+
+void* engine_test_thread(void* arg) {
+  EngineTestRun* run = arg;
+  run->status = io_engine_run(run->engine, run->worker);
+  return NULL;
+}
+
+// Read from a blocking socket until the peer closes it
+size_t read_until_closed(int fd, char* buf, size_t bufsize) {
+  size_t total = 0;
+  while(total < bufsize - 1) {
+    const ssize_t bytes = read(fd, buf + total, bufsize - 1 - total);
+    if(bytes <= 0) break;
+    total += bytes;
+  }
+  buf[total] = 0;
+  return total;
+}
+
+// Read one response with a Content-Length from a blocking socket. Returns its
+// total length, or 0 if the peer closed the connection first.
+size_t read_response(int fd, char* buf, size_t bufsize) {
+  size_t total = 0;
+  while(total < bufsize - 1) {
+    const ssize_t bytes = read(fd, buf + total, 1);
+    if(bytes <= 0) return 0;
+    total += bytes;
+    buf[total] = 0;
+    const char* end = strstr(buf, "\r\n\r\n");
+    if(end) {
+      const char* length = strstr(buf, "Content-Length: ");
+      size_t body = (length ? strtoul(length + 16, NULL, 10) : 0);
+      total = end + 4 - buf;
+      while(body > 0 && total < bufsize - 1) {
+        const ssize_t more = read(fd, buf + total, body);
+        if(more <= 0) return 0;
+        total += more;
+        body -= more;
+      }
+      buf[total] = 0;
+      return total;
+    }
+  }
+  return total;
+}
+
+// Bytes for a background thread to send on a blocking socket, so that the
+// test can read the response at the same time
+typedef struct EngineTestUpload {
+  int         fd;
+  const char* data;
+  size_t      len;
+} EngineTestUpload;
+
+void* engine_test_upload_thread(void* arg) {
+  EngineTestUpload* upload = arg;
+  size_t sent = 0;
+  while(sent < upload->len) {
+    const ssize_t n = send(upload->fd, upload->data + sent, upload->len - sent, MSG_NOSIGNAL);
+    if(n <= 0) break;
+    sent += n;
+  }
+  return NULL;
+}
+
+// Size of the large file in the test document root. More than a socket
+// buffer holds, so it takes several sends.
+#define ENGINE_TEST_BIG_FILE_SIZE (300 * 1000)
+
+// Byte 'i' of the large file
+char engine_test_big_file_byte(size_t i) {
+  return (char)(i * 7 + i / 251);
+}
+
+// Write a file into the directory 'dir'
+void engine_test_write_file(const char* dir, const char* name, const char* data, size_t len) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  nu_check("failed to write test file", fd != -1 && write(fd, data, len) == (ssize_t)len);
+  close(fd);
+}
+
+// Remove a file from the directory 'dir'
+void engine_test_remove_file(const char* dir, const char* name) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  unlink(path);
+}
+
+// A worker running on a background thread, with its own listening socket and
+// a temporary document root holding index.html and big.bin
+typedef struct EngineTestServer {
+  char                  doc_root[32];
+  int                   port;
+  ServerSocket          server;
+  WebServerConfig       config;
+  volatile sig_atomic_t keep_running;
+  Worker                worker;
+  EngineTestRun         run;
+  pthread_t             thread;
+} EngineTestServer;
+
+// Set up a listening socket and config for a worker. Adjust the config, then
+// call engine_test_server_start().
+void engine_test_server_init(EngineTestServer* ts, enum EIoEngine engine) {
+  memset(ts, 0, sizeof(*ts));
+  ts->port = get_next_port();
+  server_socket_init(&ts->server);
+  server_socket_bind(&ts->server, ts->port);
+  server_socket_listen(&ts->server, 16);
+  Status result = server_socket_set_blocking(&ts->server, false);
+  nu_check("failed to set up listening socket", result.ok);
+
+  strcpy(ts->doc_root, "/tmp/webserver-test-XXXXXX");
+  nu_check("failed to create document root", mkdtemp(ts->doc_root));
+  const char* index = "<p>index</p>\n";
+  engine_test_write_file(ts->doc_root, "index.html", index, strlen(index));
+  engine_test_write_file(ts->doc_root, "index.html.gz", "not really gzip", 15);
+  char page[2000];
+  for(size_t i=0; i<sizeof(page); ++i) page[i] = "All work and no play. "[i % 22];
+  engine_test_write_file(ts->doc_root, "page.txt", page, sizeof(page));
+  char* big = malloc(ENGINE_TEST_BIG_FILE_SIZE);
+  for(size_t i=0; i<ENGINE_TEST_BIG_FILE_SIZE; ++i) big[i] = engine_test_big_file_byte(i);
+  engine_test_write_file(ts->doc_root, "big.bin", big, ENGINE_TEST_BIG_FILE_SIZE);
+  free(big);
+
+  webserver_config_init(&ts->config);
+  ts->config.io_engine = engine;
+  ts->config.doc_root = ts->doc_root;
+
+  ts->keep_running = true;
+  ts->worker.server = &ts->server;
+  ts->worker.shutdown_fd = eventfd(0, EFD_NONBLOCK);
+  ts->worker.keep_running = &ts->keep_running;
+  ts->worker.config = &ts->config;
+  ts->run.engine = engine;
+  ts->run.worker = &ts->worker;
+  ts->run.status = make_status(false, 0);
+}
+
+void engine_test_server_start(EngineTestServer* ts) {
+  pthread_create(&ts->thread, NULL, engine_test_thread, &ts->run);
+}
+
+// Shut the worker down and check it exited cleanly
+void engine_test_server_stop(EngineTestServer* ts) {
+  ts->keep_running = false;
+  const uint64_t one = 1;
+  nu_check("failed to signal shutdown", write(ts->worker.shutdown_fd, &one, sizeof(one)) == sizeof(one));
+  pthread_join(ts->thread, NULL);
+  nu_check("engine should run and exit cleanly", ts->run.status.ok);
+  nu_check("engine should close its connections", ts->worker.open_connections == NULL);
+  close(ts->worker.shutdown_fd);
+  server_socket_close(&ts->server);
+  engine_test_remove_file(ts->doc_root, "index.html");
+  engine_test_remove_file(ts->doc_root, "index.html.gz");
+  engine_test_remove_file(ts->doc_root, "page.txt");
+  engine_test_remove_file(ts->doc_root, "big.bin");
+  rmdir(ts->doc_root);
+}
+
+// Run one worker with the given engine, send it a couple of requests, and
+// check the responses. Then shut the worker down.
+void io_engine_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  engine_test_server_start(&ts);
+
+  // Send requests on two connections at once, and answer the second first
+  ClientSocket a, b;
+  client_socket_init(&a);
+  client_socket_init(&b);
+  nu_check("failed to connect first client", client_socket_connect(&a, LOCALHOST, ts.port).ok);
+  nu_check("failed to connect second client", client_socket_connect(&b, LOCALHOST, ts.port).ok);
+  const char* request = "GET / HTTP/1.0\r\n\r\n";
+  client_socket_send(&a, request, 5);
+  client_socket_send(&b, request, strlen(request));
+
+  char buf[4096];
+  read_until_closed(b.fd, buf, sizeof(buf));
+  nu_check("second client should get a 200 response", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+
+  client_socket_send(&a, request + 5, strlen(request) - 5);
+  read_until_closed(a.fd, buf, sizeof(buf));
+  nu_check("first client should get a 200 response", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+
+  engine_test_server_stop(&ts);
+  client_socket_close(&a);
+  client_socket_close(&b);
+}
+
+// Send several requests on one persistent connection, one at a time and then
+// pipelined, and check the connection closes when the client asks it to
+void io_engine_keep_alive_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  engine_test_server_start(&ts);
+
+  ClientSocket c;
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+
+  char buf[4096];
+  const char* request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  for(int i=0; i<3; ++i) {
+    client_socket_send(&c, request, strlen(request));
+    nu_check("should answer each request", read_response(c.fd, buf, sizeof(buf)) > 0);
+    nu_check("should keep the connection alive", strstr(buf, "Connection: keep-alive\r\n"));
+  }
+
+  const char* pipelined =
+    "GET / HTTP/1.1\r\n\r\n"
+    "HEAD / HTTP/1.1\r\nConnection: close\r\n\r\n";
+  client_socket_send(&c, pipelined, strlen(pipelined));
+  nu_check("should answer the first pipelined request", read_response(c.fd, buf, sizeof(buf)) > 0);
+  read_until_closed(c.fd, buf, sizeof(buf));
+  nu_check("should answer the last request", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+  nu_check("should say it's closing", strstr(buf, "Connection: close\r\n"));
+  client_socket_close(&c);
+
+  // HTTP/1.0 connections only persist if the client asks
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+  request = "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  nu_check("should answer an HTTP/1.0 request", read_response(c.fd, buf, sizeof(buf)) > 0);
+  request = "GET / HTTP/1.0\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_until_closed(c.fd, buf, sizeof(buf));
+  nu_check("should close after a plain HTTP/1.0 request", strstr(buf, "Connection: close\r\n"));
+  client_socket_close(&c);
+
+  engine_test_server_stop(&ts);
+}
+
+// Send a burst of pipelined requests, more than the worker will queue
+// responses for at once, and check they're all answered in order
+void io_engine_pipelining_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  ts.config.echo = true;
+  ts.config.max_pipelined_requests = 4;
+  engine_test_server_start(&ts);
+
+  ClientSocket c;
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+
+  const int num_requests = 20;
+  char requests[1024] = {0};
+  for(int i=0; i<num_requests; ++i) {
+    char request[64];
+    snprintf(request, sizeof(request), "GET /%i HTTP/1.1\r\n\r\n", i);
+    strcat(requests, request);
+  }
+  client_socket_send(&c, requests, strlen(requests));
+
+  char buf[4096];
+  bool in_order = true;
+  for(int i=0; i<num_requests && in_order; ++i) {
+    char expected[64];
+    snprintf(expected, sizeof(expected), "\r\n\r\nGET /%i HTTP/1.1\r\n", i);
+    in_order = read_response(c.fd, buf, sizeof(buf)) > 0 && strstr(buf, expected);
+  }
+  nu_check("should answer every pipelined request in order", in_order);
+  client_socket_close(&c);
+
+  engine_test_server_stop(&ts);
+}
+
+// Fetch a file too big to send at once, then its headers alone, on one
+// connection, and check every byte arrives
+void io_engine_file_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  engine_test_server_start(&ts);
+
+  ClientSocket c;
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+
+  const size_t bufsize = ENGINE_TEST_BIG_FILE_SIZE + 4096;
+  char* buf = malloc(bufsize);
+  const char* request = "GET /big.bin HTTP/1.1\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  size_t len = read_response(c.fd, buf, bufsize);
+  nu_check("should answer with the file", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+  nu_check("should give the file's type", strstr(buf, "Content-Type: application/octet-stream\r\n"));
+  nu_check("should give the file's size", strstr(buf, "Content-Length: 300000\r\n"));
+  const char* body = strstr(buf, "\r\n\r\n") + 4;
+  bool intact = (len == (size_t)(body - buf) + ENGINE_TEST_BIG_FILE_SIZE);
+  for(size_t i=0; i<ENGINE_TEST_BIG_FILE_SIZE && intact; ++i) {
+    intact = (body[i] == engine_test_big_file_byte(i));
+  }
+  nu_check("should send the whole file intact", intact);
+
+  // Parts of it, from the middle, several at once, or past the end
+  request = "GET /big.bin HTTP/1.1\r\nRange: bytes=100000-100009\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  len = read_response(c.fd, buf, bufsize);
+  nu_check("should send part of the file", !strncmp(buf, "HTTP/1.1 206 Partial Content\r\n", 30));
+  nu_check("should say which part", strstr(buf, "Content-Range: bytes 100000-100009/300000\r\n"));
+  body = strstr(buf, "\r\n\r\n") + 4;
+  intact = (len == (size_t)(body - buf) + 10);
+  for(size_t i=0; i<10 && intact; ++i) intact = (body[i] == engine_test_big_file_byte(100000 + i));
+  nu_check("should send the right bytes", intact);
+  request = "GET /big.bin HTTP/1.1\r\nRange: bytes=-2, 0-1\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  len = read_response(c.fd, buf, bufsize);
+  nu_check("should send several parts", !strncmp(buf, "HTTP/1.1 206 Partial Content\r\n", 30) &&
+           strstr(buf, "Content-Type: multipart/byteranges; boundary="));
+  // The parts' bytes may hold zeros, so search all of the response
+  const char* first = memmem(buf, len, "Content-Range: bytes 0-1/300000\r\n\r\n", 35);
+  const char* last = memmem(buf, len, "Content-Range: bytes 299998-299999/300000\r\n\r\n", 45);
+  nu_check("should send the parts in order", first && last && first < last);
+  nu_check("should send each part's bytes", first && last &&
+           first[35] == engine_test_big_file_byte(0) && first[36] == engine_test_big_file_byte(1) &&
+           last[45] == engine_test_big_file_byte(299998) &&
+           last[46] == engine_test_big_file_byte(299999));
+  nu_check("should close the parts", len > 4 && !strcmp(buf + len - 4, "--\r\n"));
+  request = "GET /big.bin HTTP/1.1\r\nRange: bytes=300000-\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should refuse a range past the end",
+           !strncmp(buf, "HTTP/1.1 416 Range Not Satisfiable\r\n", 36) &&
+           strstr(buf, "Content-Range: bytes */300000\r\n"));
+  request = "GET /big.bin HTTP/1.1\r\nRange: bytes=0-0\r\nIf-Range: \"old\"\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  len = read_response(c.fd, buf, bufsize);
+  nu_check("should send all of a changed file", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) &&
+           strstr(buf, "Content-Length: 300000\r\n"));
+
+  // A precompressed sibling is sent to clients that accept it
+  request = "GET / HTTP/1.1\r\nAccept-Encoding: br;q=1, gzip;q=0.5\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should send the sibling", strstr(buf, "\r\n\r\nnot really gzip"));
+  nu_check("should say how it's encoded", strstr(buf, "Content-Encoding: gzip\r\n"));
+  nu_check("should say the response varies", strstr(buf, "Vary: Accept-Encoding\r\n"));
+  nu_check("should give the index's type", strstr(buf, "Content-Type: text/html\r\n"));
+  request = "GET / HTTP/1.1\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should send the file to other clients", strstr(buf, "\r\n\r\n<p>index</p>"));
+  nu_check("should say it varies for other clients too", strstr(buf, "Vary: Accept-Encoding\r\n"));
+
+  // A client with the current copy gets a 304 and no body, whichever way it
+  // asks. Once the copy is out of date, it gets the file.
+  char etag[STATIC_FILE_ETAG_SIZE] = {0};
+  char date[CLOCK_HTTP_DATE_LEN + 1] = {0};
+  sscanf(strstr(buf, "ETag: ") + 6, "%61s", etag);
+  memcpy(date, strstr(buf, "Last-Modified: ") + 15, CLOCK_HTTP_DATE_LEN);
+  char conditional[256];
+  snprintf(conditional, sizeof(conditional), "GET / HTTP/1.1\r\nIf-None-Match: \"x\", %s\r\n\r\n", etag);
+  client_socket_send(&c, conditional, strlen(conditional));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should say a tag is current", !strncmp(buf, "HTTP/1.1 304 Not Modified\r\n", 27));
+  nu_check("should send the tag with a 304", strstr(buf, etag) != NULL);
+  nu_check("should send no body with a 304", !strcmp(strstr(buf, "\r\n\r\n"), "\r\n\r\n") &&
+           !strstr(buf, "Content-Length"));
+  snprintf(conditional, sizeof(conditional), "GET / HTTP/1.1\r\nIf-Modified-Since: %s\r\n\r\n", date);
+  client_socket_send(&c, conditional, strlen(conditional));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should say a date is current", !strncmp(buf, "HTTP/1.1 304 Not Modified\r\n", 27));
+  request = "GET / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should send a file changed since a date", strstr(buf, "\r\n\r\n<p>index</p>"));
+  snprintf(conditional, sizeof(conditional),
+           "GET / HTTP/1.1\r\nIf-None-Match: \"x\"\r\nIf-Modified-Since: %s\r\n\r\n", date);
+  client_socket_send(&c, conditional, strlen(conditional));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should let If-None-Match decide", strstr(buf, "\r\n\r\n<p>index</p>"));
+
+  // A client with a current copy of text gzipped on the fly gets a 304 too,
+  // before the file has ever been gzipped. Its tag is the file's, marked "-gz".
+  request = "GET /page.txt HTTP/1.1\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_response(c.fd, buf, bufsize);
+  sscanf(strstr(buf, "ETag: ") + 6, "%61s", etag);
+  snprintf(conditional, sizeof(conditional),
+           "GET /page.txt HTTP/1.1\r\nAccept-Encoding: gzip\r\nIf-None-Match: %.*s-gz\"\r\n\r\n",
+           (int)strlen(etag) - 1, etag);
+  client_socket_send(&c, conditional, strlen(conditional));
+  read_response(c.fd, buf, bufsize);
+  nu_check("should say a gzipped copy is current", !strncmp(buf, "HTTP/1.1 304 Not Modified\r\n", 27) &&
+           strstr(buf, "-gz\"\r\n"));
+
+  // Text without a sibling is gzipped on the fly
+  request = "GET /page.txt HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  const size_t page_len = read_response(c.fd, buf, bufsize);
+  nu_check("should gzip text", strstr(buf, "Content-Encoding: gzip\r\n"));
+  nu_check("should say gzipped text varies", strstr(buf, "Vary: Accept-Encoding\r\n"));
+  const char* gzipped = strstr(buf, "\r\n\r\n") + 4;
+  const size_t gzipped_len = page_len - (gzipped - buf);
+  nu_check("should send a gzip stream", gzipped_len > 2 && (unsigned char)gzipped[0] == 0x1f &&
+           (unsigned char)gzipped[1] == 0x8b);
+  nu_check("should make it smaller", gzipped_len < 2000 &&
+           strtoul(strstr(buf, "Content-Length: ") + 16, NULL, 10) == gzipped_len);
+
+  // HEAD gives the same headers and no body, so the connection closes right
+  // after them
+  request = "HEAD /big.bin HTTP/1.1\r\nConnection: close\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_until_closed(c.fd, buf, bufsize);
+  nu_check("should answer HEAD", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+  nu_check("should give the size for HEAD", strstr(buf, "Content-Length: 300000\r\n"));
+  nu_check("should send no body for HEAD", !strcmp(strstr(buf, "\r\n\r\n"), "\r\n\r\n"));
+  client_socket_close(&c);
+
+  // Missing files are 404s
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+  request = "GET /missing.html HTTP/1.0\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_until_closed(c.fd, buf, bufsize);
+  nu_check("should answer 404 for a missing file", !strncmp(buf, "HTTP/1.1 404 Not Found\r\n", 24));
+  client_socket_close(&c);
+
+  free(buf);
+  engine_test_server_stop(&ts);
+}
+
+// Stream a large text file gzipped on the fly to a client that keeps up with
+// it, and check that another client is answered before the stream is done:
+// a stream that compresses well mustn't keep the worker to itself
+void io_engine_stream_fairness_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  const size_t file_len = 32 * 1024 * 1024;
+  char* text = malloc(file_len);
+  for(size_t i=0; i<file_len; ++i) text[i] = "All work and no play. "[i % 22];
+  engine_test_write_file(ts.doc_root, "huge.txt", text, file_len);
+  free(text);
+  engine_test_server_start(&ts);
+
+  ClientSocket a, b;
+  client_socket_init(&a);
+  client_socket_init(&b);
+  nu_check("failed to connect first client", client_socket_connect(&a, LOCALHOST, ts.port).ok);
+  const char* request = "GET /huge.txt HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n";
+  client_socket_send(&a, request, strlen(request));
+  char head[64];
+  nu_check("should start streaming", read(a.fd, head, sizeof(head)) > 0 &&
+           !strncmp(head, "HTTP/1.1 200 OK\r\n", 17));
+
+  nu_check("failed to connect second client", client_socket_connect(&b, LOCALHOST, ts.port).ok);
+  request = "GET / HTTP/1.0\r\n\r\n";
+  client_socket_send(&b, request, strlen(request));
+  char buf[4096];
+  read_until_closed(b.fd, buf, sizeof(buf));
+  nu_check("second client should get a response", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+
+  // Take what the first client has been sent so far, and check it's not all
+  const size_t bufsize = 4 * 1024 * 1024;
+  char* body = malloc(bufsize);
+  size_t len = 0;
+  for(ssize_t n=1; n > 0 && len < bufsize; len += (n > 0 ? n : 0)) {
+    n = recv(a.fd, body + len, bufsize - len, MSG_DONTWAIT);
+  }
+  const bool finished = (len >= 5 && !memcmp(body + len - 5, "0\r\n\r\n", 5));
+  nu_check("should answer the second client while the first is still streaming", !finished);
+  len += read_until_closed(a.fd, body + len, bufsize - len);
+  nu_check("should finish the stream", len >= 5 && !memcmp(body + len - 5, "0\r\n\r\n", 5));
+  free(body);
+
+  client_socket_close(&a);
+  client_socket_close(&b);
+  engine_test_remove_file(ts.doc_root, "huge.txt");
+  engine_test_server_stop(&ts);
+}
+
+// Upload bodies far bigger than the input buffer: one that's dropped on a
+// persistent connection, and a chunked one that's echoed back as it arrives.
+// A body without a length is refused.
+void io_engine_body_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  engine_test_server_start(&ts);
+  const size_t body_len = 1000 * 1000;
+  const size_t bufsize = 2 * body_len;
+  char* upload = malloc(bufsize);
+  char* buf = malloc(bufsize);
+
+  ClientSocket c;
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+  int len = sprintf(upload, "POST /form HTTP/1.1\r\nContent-Length: %zu\r\n\r\n", body_len);
+  memset(upload + len, 'x', body_len);
+  EngineTestUpload sender = { c.fd, upload, len + body_len };
+  pthread_t thread;
+  pthread_create(&thread, NULL, engine_test_upload_thread, &sender);
+  nu_check("should answer a POST", read_response(c.fd, buf, bufsize) > 0 &&
+           !strncmp(buf, "HTTP/1.1 501 Not Implemented\r\n", 30));
+  pthread_join(thread, NULL);
+  const char* request = "GET / HTTP/1.1\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  nu_check("should read past the body to the next request",
+           read_response(c.fd, buf, bufsize) > 0 && !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17));
+
+  request = "POST /form HTTP/1.1\r\n\r\n";
+  client_socket_send(&c, request, strlen(request));
+  read_until_closed(c.fd, buf, bufsize);
+  nu_check("should ask for a length", !strncmp(buf, "HTTP/1.1 411 Length Required\r\n", 30));
+  nu_check("should close after it", strstr(buf, "Connection: close\r\n"));
+  client_socket_close(&c);
+  engine_test_server_stop(&ts);
+
+  // Chunks of all sizes, some with extensions, and binary data
+  engine_test_server_init(&ts, engine);
+  ts.config.echo = true;
+  engine_test_server_start(&ts);
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+  const char* head = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n";
+  len = sprintf(upload, "%s", head);
+  for(size_t off=0, i=0; off<body_len; ++i) {
+    const size_t size = (1 + i * 389 % 9000 < body_len - off ? 1 + i * 389 % 9000 : body_len - off);
+    len += sprintf(upload + len, (i % 3 ? "%zx\r\n" : "%zX;i=%zu\r\n"), size, i);
+    for(size_t j=0; j<size; ++j) upload[len++] = engine_test_big_file_byte(off + j);
+    len += sprintf(upload + len, "\r\n");
+    off += size;
+  }
+  len += sprintf(upload + len, "0\r\n\r\n");
+  sender.fd = c.fd;
+  sender.len = len;
+  pthread_create(&thread, NULL, engine_test_upload_thread, &sender);
+  const size_t received = read_until_closed(c.fd, buf, bufsize);
+  pthread_join(thread, NULL);
+  nu_check("should echo in chunks", !strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) &&
+           strstr(buf, "Transfer-Encoding: chunked\r\n"));
+  char* body = strstr(buf, "\r\n\r\n") + 4;
+  size_t chunks = 0;
+  const long echoed = stream_test_dechunk(body, buf + received - body, &chunks);
+  bool intact = (echoed == (long)(strlen(head) + body_len) && !memcmp(body, head, strlen(head)));
+  for(size_t i=0; i<body_len && intact; ++i) {
+    intact = (body[strlen(head) + i] == engine_test_big_file_byte(i));
+  }
+  nu_check("should echo the decoded body", intact);
+  client_socket_close(&c);
+  engine_test_server_stop(&ts);
+  free(upload);
+  free(buf);
+}
+
+// Connect a client that never finishes its request, and check the worker drops
+// it once the header deadline passes
+void io_engine_timeout_test_helper(enum EIoEngine engine) {
+  EngineTestServer ts;
+  engine_test_server_init(&ts, engine);
+  ts.config.header_timeout_ms = 300;
+  engine_test_server_start(&ts);
+
+  ClientSocket c;
+  client_socket_init(&c);
+  nu_check("failed to connect client", client_socket_connect(&c, LOCALHOST, ts.port).ok);
+  client_socket_send(&c, "GET / HT", 8);
+
+  char buf[64];
+  const uint64_t start = clock_monotonic_ms();
+  const size_t len = read_until_closed(c.fd, buf, sizeof(buf));
+  const uint64_t elapsed = clock_monotonic_ms() - start;
+  nu_check("client should get no response", len == 0);
+  nu_check("client should be dropped at the header deadline",
+           elapsed >= 250 && elapsed < 2000);
+  client_socket_close(&c);
+
+  engine_test_server_stop(&ts);
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__io_engine_to_string() {
+  nu_check("failed to convert IO_ENGINE_EPOLL", !strcmp(io_engine_to_string(IO_ENGINE_EPOLL), "epoll"));
+  nu_check("failed to convert IO_ENGINE_IO_URING", !strcmp(io_engine_to_string(IO_ENGINE_IO_URING), "io_uring"));
+  nu_check("failed to convert IO_ENGINE_UNKNOWN", !strcmp(io_engine_to_string(IO_ENGINE_UNKNOWN), "?"));
+}
+
+void test__io_engine_from_string() {
+  nu_check("failed to convert \"epoll\"", io_engine_from_string("epoll") == IO_ENGINE_EPOLL);
+  nu_check("failed to convert \"io_uring\"", io_engine_from_string("io_uring") == IO_ENGINE_IO_URING);
+  nu_check("failed to convert invalid string", io_engine_from_string("kqueue") == IO_ENGINE_UNKNOWN);
+}
+
+void test__io_engine_run__epoll() {
+  io_engine_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__io_uring() {
+  io_engine_test_helper(IO_ENGINE_IO_URING);
+}
+
+void test__io_engine_run__keep_alive__epoll() {
+  io_engine_keep_alive_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__keep_alive__io_uring() {
+  io_engine_keep_alive_test_helper(IO_ENGINE_IO_URING);
+}
+
+void test__io_engine_run__pipelining__epoll() {
+  io_engine_pipelining_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__pipelining__io_uring() {
+  io_engine_pipelining_test_helper(IO_ENGINE_IO_URING);
+}
+
+void test__io_engine_run__file__epoll() {
+  io_engine_file_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__file__io_uring() {
+  io_engine_file_test_helper(IO_ENGINE_IO_URING);
+}
+
+void test__io_engine_run__stream_fairness__epoll() {
+  io_engine_stream_fairness_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__stream_fairness__io_uring() {
+  io_engine_stream_fairness_test_helper(IO_ENGINE_IO_URING);
+}
+
+void test__io_engine_run__body__epoll() {
+  io_engine_body_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__body__io_uring() {
+  io_engine_body_test_helper(IO_ENGINE_IO_URING);
+}
+
+void test__io_engine_run__timeout__epoll() {
+  io_engine_timeout_test_helper(IO_ENGINE_EPOLL);
+}
+
+void test__io_engine_run__timeout__io_uring() {
+  io_engine_timeout_test_helper(IO_ENGINE_IO_URING);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__io_engine() {
+  nu_run_test(test__io_engine_to_string,      "io_engine_to_string()");
+  nu_run_test(test__io_engine_from_string,    "io_engine_from_string()");
+  nu_run_test(test__io_engine_run__epoll,     "io_engine_run() w/ epoll");
+  nu_run_test(test__io_engine_run__io_uring,  "io_engine_run() w/ io_uring");
+  nu_run_test(test__io_engine_run__keep_alive__epoll,    "io_engine_run() w/ epoll keeps connections alive");
+  nu_run_test(test__io_engine_run__keep_alive__io_uring, "io_engine_run() w/ io_uring keeps connections alive");
+  nu_run_test(test__io_engine_run__pipelining__epoll,    "io_engine_run() w/ epoll answers pipelined requests");
+  nu_run_test(test__io_engine_run__pipelining__io_uring, "io_engine_run() w/ io_uring answers pipelined requests");
+  nu_run_test(test__io_engine_run__file__epoll,       "io_engine_run() w/ epoll sends files");
+  nu_run_test(test__io_engine_run__file__io_uring,    "io_engine_run() w/ io_uring sends files");
+  nu_run_test(test__io_engine_run__stream_fairness__epoll,    "io_engine_run() w/ epoll shares the worker with a stream");
+  nu_run_test(test__io_engine_run__stream_fairness__io_uring, "io_engine_run() w/ io_uring shares the worker with a stream");
+  nu_run_test(test__io_engine_run__body__epoll,       "io_engine_run() w/ epoll takes request bodies");
+  nu_run_test(test__io_engine_run__body__io_uring,    "io_engine_run() w/ io_uring takes request bodies");
+  nu_run_test(test__io_engine_run__timeout__epoll,    "io_engine_run() w/ epoll drops idle clients");
+  nu_run_test(test__io_engine_run__timeout__io_uring, "io_engine_run() w/ io_uring drops idle clients");
+}
+
+#endif // TEST_IO_ENGINE_H
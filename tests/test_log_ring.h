@@ -0,0 +1,115 @@
+//==============================================================================
+// LogRing tests
+//==============================================================================
+#ifndef TEST_LOG_RING_H
+#define TEST_LOG_RING_H
+
+#include "nu_unit.h"
+#include "log_ring.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Number of records the threaded test passes through a ring
+#define LOG_RING_TEST_RECORDS (LOG_RING_RECORDS * 16)
+
+// Helper: allocate a ring, which is too big for the stack
+LogRing* log_ring_test_new() {
+  LogRing* ring = NULL;
+  if(posix_memalign((void**)&ring, 64, sizeof(LogRing))) return NULL;
+  log_ring_init(ring);
+  return ring;
+}
+
+// Helper: producer thread. Pushes numbered records, waiting when full.
+void* log_ring_test_produce(void* arg) {
+  LogRing* ring = arg;
+  for(uint32_t i=0; i<LOG_RING_TEST_RECORDS; ++i) {
+    LogRecord* record;
+    while(!(record = log_ring_reserve(ring))) {
+      sched_yield();
+    }
+    record->targets = i;
+    record->len = 1;
+    record->text[0] = 'a' + i % 26;
+    log_ring_commit(ring);
+  }
+  return NULL;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__log_ring_reserve_and_consume() {
+  LogRing* ring = log_ring_test_new();
+  nu_check("new ring should be empty", log_ring_readable(ring) == 0);
+
+  LogRecord* record = log_ring_reserve(ring);
+  nu_assert("should reserve a record", record);
+  record->targets = 7;
+  nu_check("reserved record should not be readable", log_ring_readable(ring) == 0);
+  log_ring_commit(ring);
+  nu_check("committed record should be readable", log_ring_readable(ring) == 1);
+  nu_check("should peek the record", log_ring_peek(ring, 0)->targets == 7);
+
+  log_ring_consume(ring, 1);
+  nu_check("should be empty after consuming", log_ring_readable(ring) == 0);
+  free(ring);
+}
+
+void test__log_ring_reserve__full() {
+  LogRing* ring = log_ring_test_new();
+  bool ok = true;
+  for(uint32_t i=0; i<LOG_RING_RECORDS; ++i) {
+    LogRecord* record = log_ring_reserve(ring);
+    ok = ok && record;
+    if(record) {
+      record->targets = i;
+      log_ring_commit(ring);
+    }
+  }
+  nu_check("should hold LOG_RING_RECORDS records", ok);
+  nu_check("should refuse a record when full", !log_ring_reserve(ring));
+
+  log_ring_consume(ring, 3);
+  nu_check("should have room after consuming", log_ring_reserve(ring) != NULL);
+  nu_check("should peek from the oldest", log_ring_peek(ring, 0)->targets == 3);
+  free(ring);
+}
+
+void test__log_ring__threads() {
+  LogRing* ring = log_ring_test_new();
+  pthread_t producer;
+  pthread_create(&producer, NULL, log_ring_test_produce, ring);
+
+  // Drain in batches and make sure every record arrives once, in order
+  uint32_t expected = 0;
+  bool in_order = true;
+  while(expected < LOG_RING_TEST_RECORDS) {
+    const size_t count = log_ring_readable(ring);
+    for(size_t i=0; i<count; ++i) {
+      const LogRecord* record = log_ring_peek(ring, i);
+      in_order = in_order && record->targets == expected &&
+                 record->text[0] == (char)('a' + expected % 26);
+      ++expected;
+    }
+    log_ring_consume(ring, count);
+    if(!count) sched_yield();
+  }
+  pthread_join(producer, NULL);
+  nu_check("should get every record in order", in_order);
+  nu_check("should be empty at the end", log_ring_readable(ring) == 0);
+  free(ring);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__log_ring() {
+  nu_run_test(test__log_ring_reserve_and_consume, "log_ring_reserve() and log_ring_consume()");
+  nu_run_test(test__log_ring_reserve__full,       "log_ring_reserve() w/ full ring");
+  nu_run_test(test__log_ring__threads,            "LogRing w/ producer thread");
+}
+
+#endif // TEST_LOG_RING_H
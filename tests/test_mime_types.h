@@ -0,0 +1,58 @@
+//==============================================================================
+// MIME type tests
+//==============================================================================
+#ifndef TEST_MIME_TYPES_H
+#define TEST_MIME_TYPES_H
+
+#include "nu_unit.h"
+#include "mime_types.h"
+#include <string.h>
+
+// Helper: MIME type of a null-terminated path
+const char* mime_types_test_lookup(const char* path) {
+  return mime_type_from_path(path, strlen(path));
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__mime_type_from_path() {
+  nu_check("should know HTML", !strcmp(mime_types_test_lookup("/index.html"), "text/html"));
+  nu_check("should know CSS", !strcmp(mime_types_test_lookup("/css/site.css"), "text/css"));
+  nu_check("should know PNG", !strcmp(mime_types_test_lookup("/a.b/logo.png"), "image/png"));
+  nu_check("should ignore case", !strcmp(mime_types_test_lookup("/PHOTO.JPG"), "image/jpeg"));
+  nu_check("should use the last extension",
+           !strcmp(mime_types_test_lookup("/site.tar.gz"), "application/gzip"));
+  nu_check("should only look at the whole extension",
+           !strcmp(mime_types_test_lookup("/index.h"), MIME_TYPE_DEFAULT));
+  nu_check("should default without an extension",
+           !strcmp(mime_types_test_lookup("/a.b/README"), MIME_TYPE_DEFAULT));
+  nu_check("should default for an unknown extension",
+           !strcmp(mime_types_test_lookup("/data.xyz"), MIME_TYPE_DEFAULT));
+  nu_check("should default for an empty extension",
+           !strcmp(mime_types_test_lookup("/file."), MIME_TYPE_DEFAULT));
+  nu_check("should only look at 'len' bytes",
+           !strcmp(mime_type_from_path("/index.html.bak", 11), "text/html"));
+}
+
+void test__mime_type_compressible() {
+  nu_check("should compress text", mime_type_compressible("text/css"));
+  nu_check("should compress JSON", mime_type_compressible("application/json"));
+  nu_check("should compress SVG", mime_type_compressible("image/svg+xml"));
+  nu_check("should ignore parameters", mime_type_compressible("text/html; charset=utf-8"));
+  nu_check("should ignore case", mime_type_compressible("Text/Plain"));
+  nu_check("should not compress PNG", !mime_type_compressible("image/png"));
+  nu_check("should not compress gzip", !mime_type_compressible("application/gzip"));
+  nu_check("should not compress unknown types", !mime_type_compressible(MIME_TYPE_DEFAULT));
+  nu_check("should match whole types", !mime_type_compressible("application/js"));
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__mime_types() {
+  nu_run_test(test__mime_type_from_path,    "mime_type_from_path()");
+  nu_run_test(test__mime_type_compressible, "mime_type_compressible()");
+}
+
+#endif // TEST_MIME_TYPES_H
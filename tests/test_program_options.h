@@ -7,6 +7,7 @@
 #define TEST_PROGRAM_OPTIONS_H
 
 #include <stdlib.h>
+#include <string.h>
 #include "nu_unit.h"
 #include "program_options.h"
 
@@ -30,6 +31,17 @@ void test__program_options_parse__sets_defaults() {
   nu_check("didn't set default port", options.config.port == 80);
   nu_check("didn't set verbose off", !options.config.verbose);
   nu_check("didn't set help off", !options.help);
+  nu_check("didn't set default workers", options.config.workers == 1);
+  nu_check("didn't set default IO engine", options.config.io_engine == IO_ENGINE_EPOLL);
+  nu_check("didn't set default keep-alive timeout", options.config.keepalive_timeout_ms == 5000);
+  nu_check("didn't set default max requests", options.config.max_keepalive_requests == 100);
+  nu_check("didn't set default log overflow", options.config.log_overflow == LOG_OVERFLOW_DROP);
+  nu_check("didn't set default access log format", options.config.access_log == ACCESS_LOG_TEXT);
+  nu_check("didn't set default document root",
+           !strcmp(options.config.doc_root, "/etc/webserver/sites"));
+  nu_check("didn't set default file cache size", options.config.file_cache_entries == 1024);
+  nu_check("didn't set default file cache memory",
+           options.config.file_cache_memory == 64 * 1024 * 1024);
 }
 
 void test__program_options_parse__parses_port() {
@@ -71,6 +83,162 @@ void test__program_options_parse__parses_echo() {
   nu_check("didn't parse echo flag", options.config.echo);
 }
 
+void test__program_options_parse__parses_workers() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-w"), strdup("8") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should succeed given workers", status);
+  nu_check("didn't parse workers", options.config.workers == 8);
+}
+
+void test__program_options_parse__rejects_bad_workers() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-w"), strdup("0") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given zero workers", status == false);
+}
+
+void test__program_options_parse__parses_io_engine() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-i"), strdup("io_uring") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should succeed given an IO engine", status);
+  nu_check("didn't parse IO engine", options.config.io_engine == IO_ENGINE_IO_URING);
+
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-i");
+  argv[2] = strdup("select");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given an unknown IO engine", status == false);
+}
+
+void test__program_options_parse__parses_keep_alive() {
+  ProgramOptions options;
+  int argc = 5;
+  char* argv[5] = { strdup("webserver"), strdup("-k"), strdup("0"), strdup("-n"), strdup("7") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 5);
+  nu_check("should succeed given keep-alive options", status);
+  nu_check("didn't parse keep-alive timeout", options.config.keepalive_timeout_ms == 0);
+  nu_check("didn't parse max requests", options.config.max_keepalive_requests == 7);
+
+  argc = 3;
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-n");
+  argv[2] = strdup("0");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given zero max requests", status == false);
+
+  // A timeout in milliseconds must fit in an int
+  const char* bad_timeouts[] = { "-1", "2147484", "99999999999", "5s", "" };
+  for(size_t i=0; i<sizeof(bad_timeouts)/sizeof(bad_timeouts[0]); ++i) {
+    argv[0] = strdup("webserver");
+    argv[1] = strdup("-k");
+    argv[2] = strdup(bad_timeouts[i]);
+    status = program_options_parse(&options, argc, argv);
+    free_strings(argv, 3);
+    nu_check("should fail given a bad keep-alive timeout", status == false);
+  }
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-k");
+  argv[2] = strdup("2147483");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should take the longest keep-alive timeout",
+           status && options.config.keepalive_timeout_ms == 2147483000);
+}
+
+void test__program_options_parse__parses_log_overflow() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-l"), strdup("block") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should succeed given a log overflow policy", status);
+  nu_check("didn't parse log overflow policy", options.config.log_overflow == LOG_OVERFLOW_BLOCK);
+
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-l");
+  argv[2] = strdup("spill");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given an unknown log overflow policy", status == false);
+}
+
+void test__program_options_parse__parses_access_log() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-a"), strdup("binary") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should succeed given an access log format", status);
+  nu_check("didn't parse access log format", options.config.access_log == ACCESS_LOG_BINARY);
+
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-a");
+  argv[2] = strdup("json");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given an unknown access log format", status == false);
+}
+
+void test__program_options_parse__parses_doc_root() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-r"), strdup("/srv/www") };
+  bool status = program_options_parse(&options, argc, argv);
+  nu_check("should succeed given a document root", status);
+  nu_check("didn't parse document root", !strcmp(options.config.doc_root, "/srv/www"));
+  free_strings(argv, 3);
+
+  argc = 2;
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-r");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 2);
+  nu_check("should fail without a document root", status == false);
+}
+
+void test__program_options_parse__parses_file_cache() {
+  ProgramOptions options;
+  int argc = 3;
+  char* argv[3] = { strdup("webserver"), strdup("-c"), strdup("0") };
+  bool status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should succeed given a file cache size", status);
+  nu_check("didn't parse file cache size", options.config.file_cache_entries == 0);
+
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-c");
+  argv[2] = strdup("-5");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given a negative file cache size", status == false);
+
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-m");
+  argv[2] = strdup("16");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should succeed given a file cache memory size", status);
+  nu_check("didn't parse file cache memory", options.config.file_cache_memory == 16 * 1024 * 1024);
+
+  argv[0] = strdup("webserver");
+  argv[1] = strdup("-m");
+  argv[2] = strdup("-1");
+  status = program_options_parse(&options, argc, argv);
+  free_strings(argv, 3);
+  nu_check("should fail given a negative file cache memory size", status == false);
+}
+
 void test__program_options_parse__supports_help() {
   ProgramOptions options;
   int argc = 2;
@@ -92,6 +260,14 @@ void test_suite__program_options() {
   nu_run_test(test__program_options_parse__requires_port_arg, "program_options_parse() requires port arg");
   nu_run_test(test__program_options_parse__parses_verbose,    "program_options_parse() parses verbose");
   nu_run_test(test__program_options_parse__parses_echo,       "program_options_parse() parses echo");
+  nu_run_test(test__program_options_parse__parses_workers,    "program_options_parse() parses workers");
+  nu_run_test(test__program_options_parse__rejects_bad_workers, "program_options_parse() rejects bad workers");
+  nu_run_test(test__program_options_parse__parses_io_engine,  "program_options_parse() parses IO engine");
+  nu_run_test(test__program_options_parse__parses_keep_alive, "program_options_parse() parses keep-alive options");
+  nu_run_test(test__program_options_parse__parses_log_overflow, "program_options_parse() parses log overflow");
+  nu_run_test(test__program_options_parse__parses_access_log, "program_options_parse() parses access log format");
+  nu_run_test(test__program_options_parse__parses_doc_root,   "program_options_parse() parses document root");
+  nu_run_test(test__program_options_parse__parses_file_cache, "program_options_parse() parses file cache size");
   nu_run_test(test__program_options_parse__supports_help,     "program_options_parse() supports help");
 }
 
@@ -0,0 +1,83 @@
+//==============================================================================
+// ResponseCache tests
+//==============================================================================
+#ifndef TEST_RESPONSE_CACHE_H
+#define TEST_RESPONSE_CACHE_H
+
+#include "nu_unit.h"
+#include "response_cache.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Helper: do 'len' bytes at 'data' match 'str' exactly?
+bool response_cache_test_bytes(const char* data, size_t len, const char* str) {
+  return len == strlen(str) && !memcmp(data, str, len);
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__response_cache_get() {
+  ResponseCache cache;
+  response_cache_init(&cache, "test");
+  static const char* body = "<p>hi</p>";
+
+  const CachedResponse* res =
+    response_cache_get(&cache, HTTP_STATUS_OK, body, strlen(body), "text/html");
+  nu_assert("should serialize a response", res);
+  nu_check("should format the head", response_cache_test_bytes(res->head, res->head_len,
+           "HTTP/1.1 200 OK\r\nServer: test\r\n"));
+  nu_check("should format the tail", response_cache_test_bytes(res->tail, res->tail_len,
+           "Content-Type: text/html\r\nContent-Length: 9\r\n\r\n<p>hi</p>"));
+
+  const CachedResponse* empty = response_cache_get(&cache, HTTP_STATUS_NOT_FOUND, NULL, 0, NULL);
+  nu_check("should serialize a response without a body",
+           response_cache_test_bytes(empty->tail, empty->tail_len, "Content-Length: 0\r\n\r\n"));
+  nu_check("should have two entries", cache.count == 2);
+
+  // The same key gives back the same bytes
+  nu_check("should reuse a response",
+           response_cache_get(&cache, HTTP_STATUS_OK, body, strlen(body), "text/html") == res);
+  nu_check("should reuse a response without a body",
+           response_cache_get(&cache, HTTP_STATUS_NOT_FOUND, NULL, 0, NULL) == empty);
+  nu_check("should still have two entries", cache.count == 2);
+
+  // Any part of the key that differs makes a new response
+  nu_check("should key on the status",
+           response_cache_get(&cache, HTTP_STATUS_NOT_FOUND, body, strlen(body), "text/html") != res);
+  nu_check("should key on the content type",
+           response_cache_get(&cache, HTTP_STATUS_OK, body, strlen(body), "text/plain") != res);
+  nu_check("should key on the body's address",
+           response_cache_get(&cache, HTTP_STATUS_OK, body + 1, strlen(body) - 1, "text/html") != res);
+  nu_check("should have five entries", cache.count == 5);
+
+  response_cache_free(&cache);
+  nu_check("should be empty once freed", cache.count == 0);
+}
+
+void test__response_cache_get__full() {
+  static char bodies[RESPONSE_CACHE_MAX_ENTRIES + 1];
+  ResponseCache cache;
+  response_cache_init(&cache, "test");
+  bool ok = true;
+  for(size_t i=0; i<RESPONSE_CACHE_MAX_ENTRIES; ++i) {
+    ok = ok && response_cache_get(&cache, HTTP_STATUS_OK, bodies + i, 1, "text/plain");
+  }
+  nu_check("should hold the max number of entries", ok);
+  nu_check("should refuse more",
+           !response_cache_get(&cache, HTTP_STATUS_OK, bodies + RESPONSE_CACHE_MAX_ENTRIES, 1,
+                               "text/plain"));
+  nu_check("should still find existing entries",
+           response_cache_get(&cache, HTTP_STATUS_OK, bodies, 1, "text/plain"));
+  response_cache_free(&cache);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__response_cache() {
+  nu_run_test(test__response_cache_get,       "response_cache_get()");
+  nu_run_test(test__response_cache_get__full, "response_cache_get() w/ full cache");
+}
+
+#endif // TEST_RESPONSE_CACHE_H
@@ -0,0 +1,232 @@
+//==============================================================================
+// ResponseStream tests
+//==============================================================================
+#ifndef TEST_RESPONSE_STREAM_H
+#define TEST_RESPONSE_STREAM_H
+
+#include "nu_unit.h"
+#include "response_stream.h"
+#include "test_connection.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Helper: a producer that writes 'piece' bytes per call until it has written
+// 'total', or fails once it has written 'fail_at' (if not 0)
+typedef struct StreamTestProducer {
+  size_t piece;
+  size_t total;
+  size_t fail_at;
+  size_t written;
+  size_t max_queued;  // Most output seen queued when called
+  bool   released;
+} StreamTestProducer;
+
+enum EResponseStreamResult stream_test_produce(ResponseStream* stream, void* arg) {
+  StreamTestProducer* p = arg;
+  const size_t queued = connection_output_len(stream->conn);
+  if(queued > p->max_queued) p->max_queued = queued;
+  if(p->fail_at && p->written >= p->fail_at) return RESPONSE_STREAM_ERROR;
+  if(p->written == p->total) return RESPONSE_STREAM_DONE;
+  char buf[64 * 1024];
+  const size_t n = (p->total - p->written < p->piece ? p->total - p->written : p->piece);
+  for(size_t i=0; i<n; ++i) buf[i] = 'a' + (p->written + i) % 26;
+  response_stream_write(stream, buf, n);
+  p->written += n;
+  return RESPONSE_STREAM_MORE;
+}
+
+void stream_test_release(void* arg) {
+  ((StreamTestProducer*)arg)->released = true;
+}
+
+// Helper: start a stream with a minimal head
+void stream_test_start(Connection* conn, bool chunked, StreamTestProducer* p) {
+  HttpResponseBuilder head;
+  http_response_builder_init(&head, &conn->arena);
+  http_response_builder_set_status(&head, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  response_stream_start(conn, &head, chunked, stream_test_produce, p, stream_test_release);
+}
+
+// Helper: send everything the stream produces, pumping it whenever the output
+// drains, and collect what the peer receives. Returns its length.
+size_t stream_test_drain(Connection* conn, int peer, char* buf, size_t bufsize) {
+  size_t len = 0;
+  while(len < bufsize) {
+    if(!connection_flush(conn).ok) break;
+    const ssize_t n = recv(peer, buf + len, bufsize - len, MSG_DONTWAIT);
+    if(n > 0) len += n;
+    if(!connection_has_output(conn)) {
+      if(!conn->stream) break;
+      response_stream_pump(conn);
+    }
+  }
+  while(len < bufsize) {
+    const ssize_t n = recv(peer, buf + len, bufsize - len, MSG_DONTWAIT);
+    if(n <= 0) break;
+    len += n;
+  }
+  return len;
+}
+
+// Helper: decode a chunked body, 'len' bytes long, in place. Returns its
+// length, or -1 if it's malformed or has no last chunk. Sets 'chunks'.
+long stream_test_dechunk(char* body, size_t len, size_t* chunks) {
+  const char* in = body;
+  const char* end = body + len;
+  char* out = body;
+  *chunks = 0;
+  while(in < end) {
+    char* line_end = NULL;
+    const size_t size = strtoul(in, &line_end, 16);
+    if(line_end == in || end - line_end < 2 || memcmp(line_end, "\r\n", 2)) return -1;
+    in = line_end + 2;
+    if(size == 0) return (end - in == 2 && !memcmp(in, "\r\n", 2) ? out - body : -1);
+    if((size_t)(end - in) < size + 2 || memcmp(in + size, "\r\n", 2)) return -1;
+    memmove(out, in, size);
+    out += size;
+    in += size + 2;
+    *chunks += 1;
+  }
+  return -1;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__response_stream_chunked() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to create connection", conn);
+  const size_t bufsize = 2 * 1024 * 1024;
+  char* buf = malloc(bufsize);
+
+  // Small writes are gathered into one chunk
+  StreamTestProducer p = { 10, 100, 0, 0, 0, false };
+  stream_test_start(conn, true, &p);
+  nu_check("should finish a short body right away", conn->stream == NULL && p.released);
+  size_t len = stream_test_drain(conn, peer, buf, bufsize);
+  buf[len] = 0;
+  nu_check("should say it's chunked", strstr(buf, "Transfer-Encoding: chunked\r\n\r\n"));
+  char* body = strstr(buf, "\r\n\r\n") + 4;
+  size_t chunks = 0;
+  nu_check("should send one chunk",
+           stream_test_dechunk(body, buf + len - body, &chunks) == 100 && chunks == 1);
+  nu_check("should send the body", !memcmp(body, "abcdefghijklmnopqrstuvwxyzabcd", 30));
+  nu_check("should keep the connection open", conn->state == CONNECTION_STATE_READING);
+
+  // A long body is produced as the output drains, never queueing much more
+  // than the high-water mark
+  StreamTestProducer big = { 5000, 1500 * 1000, 0, 0, 0, false };
+  stream_test_start(conn, true, &big);
+  nu_check("should wait for the output to drain", conn->stream != NULL && !big.released);
+  nu_check("should stop at the high-water mark",
+           connection_output_len(conn) < RESPONSE_STREAM_HIGH_WATER + 2 * RESPONSE_STREAM_CHUNK_SIZE);
+  len = stream_test_drain(conn, peer, buf, bufsize);
+  nu_check("should finish the body", conn->stream == NULL && big.released);
+  nu_check("should never queue much", big.max_queued < RESPONSE_STREAM_HIGH_WATER + 64 * 1024);
+  body = strstr(buf, "\r\n\r\n") + 4;
+  const long body_len = stream_test_dechunk(body, buf + len - body, &chunks);
+  nu_check("should send the whole body", body_len == 1500 * 1000);
+  bool intact = (body_len == 1500 * 1000);
+  for(long i=0; i<body_len && intact; ++i) intact = (body[i] == 'a' + i % 26);
+  nu_check("should send it intact", intact);
+  nu_check("should gather the writes into bigger chunks", chunks < 1500 * 1000 / 5000 / 2);
+
+  free(buf);
+  connection_free(conn);
+  close(peer);
+}
+
+void test__response_stream_unchunked() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to create connection", conn);
+  char buf[4096];
+
+  // Without chunks, the body goes as it is, and the connection closes after it
+  StreamTestProducer p = { 7, 50, 0, 0, 0, false };
+  stream_test_start(conn, false, &p);
+  const size_t len = stream_test_drain(conn, peer, buf, sizeof(buf) - 1);
+  buf[len] = 0;
+  nu_check("should not say it's chunked", !strstr(buf, "Transfer-Encoding"));
+  const char* body = strstr(buf, "\r\n\r\n") + 4;
+  nu_check("should send the body as it is",
+           buf + len - body == 50 && !memcmp(body, "abcdefghijklmnopqrstuvwxyzabcd", 30));
+  nu_check("should close after it", conn->state == CONNECTION_STATE_WRITING && !conn->keep_alive);
+  connection_free(conn);
+  close(peer);
+}
+
+void test__response_stream_error() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to create connection", conn);
+  const size_t bufsize = 512 * 1024;
+  char* buf = malloc(bufsize);
+
+  // A producer that fails leaves the body cut short, and the connection closing
+  StreamTestProducer p = { 8000, 400 * 1000, 200 * 1000, 0, 0, false };
+  conn->keep_alive = true;
+  stream_test_start(conn, true, &p);
+  const size_t len = stream_test_drain(conn, peer, buf, bufsize);
+  nu_check("should free the stream", conn->stream == NULL && p.released);
+  nu_check("should close the connection", conn->state == CONNECTION_STATE_WRITING && !conn->keep_alive);
+  char* body = memmem(buf, len, "\r\n\r\n", 4) + 4;
+  size_t chunks = 0;
+  nu_check("should not send the last chunk", stream_test_dechunk(body, buf + len - body, &chunks) == -1);
+  nu_check("should send what was produced", len > 200 * 1000);
+
+  // A stream that's never finished is freed with its connection
+  StreamTestProducer q = { 8000, 400 * 1000, 0, 0, 0, false };
+  conn->state = CONNECTION_STATE_READING;
+  stream_test_start(conn, true, &q);
+  nu_check("should still be streaming", conn->stream != NULL && !q.released);
+  connection_free(conn);
+  nu_check("should release it with the connection", q.released);
+  free(buf);
+  close(peer);
+}
+
+void test__response_stream_open() {
+  int peer = -1;
+  Connection* conn = make_test_connection(&peer);
+  nu_assert("failed to create connection", conn);
+  char buf[4096];
+
+  // The caller writes the body as it comes, and ends it
+  HttpResponseBuilder head;
+  http_response_builder_init(&head, &conn->arena);
+  http_response_builder_set_status(&head, HTTP_VERSION_1_1, HTTP_STATUS_OK);
+  ResponseStream* stream = response_stream_open(conn, &head, true);
+  nu_check("should hold the stream", conn->stream == stream);
+  response_stream_write(stream, "hello ", 6);
+  response_stream_pump(conn);
+  nu_check("should not call a producer", conn->stream == stream);
+  response_stream_write(stream, "world", 5);
+  response_stream_end(conn);
+  nu_check("should free the stream", conn->stream == NULL);
+  const size_t len = stream_test_drain(conn, peer, buf, sizeof(buf) - 1);
+  buf[len] = 0;
+  char* body = strstr(buf, "\r\n\r\n") + 4;
+  size_t chunks = 0;
+  nu_check("should send the body in chunks",
+           stream_test_dechunk(body, buf + len - body, &chunks) == 11 &&
+           !memcmp(body, "hello world", 11) && chunks == 1);
+  nu_check("should keep the connection open", conn->state == CONNECTION_STATE_READING);
+  connection_free(conn);
+  close(peer);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__response_stream() {
+  nu_run_test(test__response_stream_chunked,   "response_stream with chunks");
+  nu_run_test(test__response_stream_unchunked, "response_stream without chunks");
+  nu_run_test(test__response_stream_error,     "response_stream when the producer fails");
+  nu_run_test(test__response_stream_open,      "response_stream_open()");
+}
+
+#endif // TEST_RESPONSE_STREAM_H
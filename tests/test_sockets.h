@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -40,6 +41,30 @@ void test__client_socket_init() {
   nu_check("failed to initialize the data length", s.data_len == 0);
 }
 
+void test__client_socket_set_blocking() {
+  int fds[2];
+  nu_assert("failed to create socket pair", socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  ClientSocket s;
+  client_socket_init(&s);
+  s.fd = fds[0];
+
+  Status result = client_socket_set_blocking(&s, false);
+  nu_assert("failed to set socket non-blocking", result.ok);
+
+  char buf[8];
+  size_t received = 99;
+  result = client_socket_recv_some(&s, buf, sizeof(buf), &received);
+  nu_check("recv on empty non-blocking socket should fail", !result.ok);
+  nu_check("recv on empty non-blocking socket should give EWOULDBLOCK",
+           result.errnum == EWOULDBLOCK);
+  nu_check("recv should report zero bytes", received == 0);
+
+  result = client_socket_set_blocking(&s, true);
+  nu_check("failed to set socket blocking", result.ok);
+  close(fds[0]);
+  close(fds[1]);
+}
+
 void test__client_socket_connect() {
   // Use a different port in this test, because we're going to spawn a subprocess
   // that'll stick around for a while and use that port.
@@ -152,19 +177,15 @@ void client_socket_recv_test_helper(const char* msg, size_t msg_len) {
       exit(0);
     }
 
-    status = server_socket_set_blocking(&server, false);
-    if(!status.ok) {
-      fprintf(stderr, "CHILD ERROR: server_socket_set_blocking failed, errno = %i\n", status.errnum);
-      exit(0);
-    }
-
     status = server_socket_listen(&server, 5);
     if(!status.ok) {
       fprintf(stderr, "CHILD ERROR: server_socket_listen failed, errno = %i\n", status.errnum);
       exit(0);
     }
 
-    if(server_socket_accept_poll(&server, &client, 250, 5000).ok) {
+    // Don't block forever if the parent never connects
+    alarm(5);
+    if(server_socket_accept(&server, &client).ok) {
       client_socket_send(&client, msg, msg_len);
     }
     client_socket_close(&client);
@@ -190,6 +211,27 @@ void client_socket_recv_test_helper(const char* msg, size_t msg_len) {
   client_socket_close(&s);
 }
 
+void test__client_socket_sendv_some() {
+  int fds[2];
+  nu_assert("failed to create socket pair", socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  ClientSocket s;
+  client_socket_init(&s);
+  s.fd = fds[0];
+
+  struct iovec iov[3] = {
+    { (void*)"hello", 5 }, { (void*)", ", 2 }, { (void*)"world", 5 }
+  };
+  size_t sent = 0;
+  Status result = client_socket_sendv_some(&s, iov, 3, false, &sent);
+  nu_check("should send gathered buffers", result.ok && sent == 12);
+
+  char buf[16] = {0};
+  nu_check("peer should receive all the data", read(fds[1], buf, sizeof(buf)) == 12);
+  nu_check("peer should receive the data in order", !strcmp(buf, "hello, world"));
+  close(fds[0]);
+  close(fds[1]);
+}
+
 void test__client_socket_recv__short() {
   const char* msg = "hello world!";
   const size_t msglen = strlen(msg);
@@ -269,6 +311,26 @@ void test__server_socket_bind() {
   server_socket_close(&s);
 }
 
+void test__server_socket_set_reuseport() {
+  const int port = get_next_port();
+  ServerSocket a, b;
+  server_socket_init(&a);
+  server_socket_init(&b);
+
+  Status result = server_socket_set_reuseport(&a, true);
+  nu_assert("failed to enable SO_REUSEPORT", result.ok);
+  result = server_socket_set_reuseport(&b, true);
+  nu_assert("failed to enable SO_REUSEPORT", result.ok);
+
+  result = server_socket_bind(&a, port);
+  nu_check("first socket should bind", result.ok);
+  result = server_socket_bind(&b, port);
+  nu_check("second socket should bind the same port", result.ok);
+
+  server_socket_close(&a);
+  server_socket_close(&b);
+}
+
 void test__server_socket_listen() {
   const int port = get_next_port();
   ServerSocket s;
@@ -335,56 +397,6 @@ void test__server_socket_accept() {
   server_socket_close(&s);
 }
 
-void test__server_socket_accept_poll() {
-  Status result = make_status(false, 0);
-  const int port = get_next_port();
-  const int interval = 100;
-  const int timeout = 1000;
-
-  ClientSocket c;
-  ServerSocket s;
-  client_socket_init(&c);
-  server_socket_init(&s);
-  server_socket_set_blocking(&s, false);
-
-  result = server_socket_accept_poll(&s, &c, interval, timeout);
-  nu_assert("should fail with unbound socket", !result.ok);
-
-  server_socket_bind(&s, port);
-  result = server_socket_accept_poll(&s, &c, interval, timeout);
-  nu_assert("should fail with non-listening socket", !result.ok);
-
-  server_socket_listen(&s, 1);
-  result = server_socket_accept_poll(&s, &c, interval, timeout);
-  bool ok = (!result.ok && result.errnum == EWOULDBLOCK);
-  nu_assert("should fail with no pending connections", ok);
-  nu_assert("shouldn't set client connection file descriptor", c.fd == -1);
-
-  // Test accepting a connection by forking a new process and initiating a
-  // client connection from that process.
-  pid_t pid = fork();
-  if(pid < 0) {
-    perror("Unable to fork during testing");
-    nu_assert("should fork successfully during testing", false);
-  }
-  else if(pid == 0) {
-    // Child process: wait a bit, then open a connection to the server
-    usleep(100 * 1000);
-    ClientSocket pending;
-    client_socket_init(&pending);
-    client_socket_connect(&pending, LOCALHOST, port);
-    exit(0);
-  }
-  else {
-    // Parent process: poll for child process
-    result = server_socket_accept_poll(&s, &c, interval, timeout);
-    nu_assert("didn't accept a pending connection", result.ok);
-    nu_assert("didn't set the client's file descriptor", c.fd != -1);
-  }
-
-  server_socket_close(&s);
-}
-
 void test__server_socket_close() {
   Status result = make_status(false, 0);
 
@@ -408,8 +420,10 @@ void test__server_socket_close() {
 //==============================================================================
 void test_suite__client_socket() {
   nu_run_test(test__client_socket_init,        "client_socket_init()");
+  nu_run_test(test__client_socket_set_blocking, "client_socket_set_blocking()");
   nu_run_test(test__client_socket_connect,     "client_socket_connect()");
   nu_run_test(test__client_socket_send,        "client_socket_send()");
+  nu_run_test(test__client_socket_sendv_some,  "client_socket_sendv_some()");
   nu_run_test(test__client_socket_recv__short, "client_socket_recv() w/ short message");
   nu_run_test(test__client_socket_recv__long,  "client_socket_recv() w/ long message");
   nu_run_test(test__client_socket_close,       "client_socket_close()");
@@ -418,9 +432,9 @@ void test_suite__client_socket() {
 void test_suite__server_socket() {
   nu_run_test(test__server_socket_init,        "server_socket_init()");
   nu_run_test(test__server_socket_bind,        "server_socket_bind()");
+  nu_run_test(test__server_socket_set_reuseport, "server_socket_set_reuseport()");
   nu_run_test(test__server_socket_listen,      "server_socket_listen()");
   nu_run_test(test__server_socket_accept,      "server_socket_accept()");
-  nu_run_test(test__server_socket_accept_poll, "server_socket_accept_poll()");
   nu_run_test(test__server_socket_close,       "server_socket_close()");
 }
 
@@ -0,0 +1,146 @@
+//==============================================================================
+// Static file tests
+//==============================================================================
+#ifndef TEST_STATIC_FILE_H
+#define TEST_STATIC_FILE_H
+
+#include "nu_unit.h"
+#include "static_file.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Helper: does 'uri' resolve to 'expected'? Pass NULL to expect it to be
+// rejected.
+bool static_file_test_resolve(const char* uri, const char* expected) {
+  char path[64];
+  const size_t len = static_file_resolve(uri, strlen(uri), path, sizeof(path));
+  if(!expected) return len == 0;
+  return len == strlen(expected) && !strcmp(path, expected);
+}
+
+// Helper: create a file under 'dir'
+void static_file_test_write(const char* dir, const char* name, const char* data) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  nu_check("failed to write test file", fd != -1 && write(fd, data, strlen(data)) >= 0);
+  close(fd);
+}
+
+// Helper: open 'uri' under 'root', and close the file if it opened
+enum EHttpStatus static_file_test_open(StaticFile* file, const char* root, const char* uri) {
+  const enum EHttpStatus status = static_file_open(file, root, uri, strlen(uri));
+  if(status == HTTP_STATUS_OK) close(file->fd);
+  return status;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__static_file_resolve() {
+  nu_check("should resolve the root", static_file_test_resolve("/", "/"));
+  nu_check("should resolve a file", static_file_test_resolve("/a/b.html", "/a/b.html"));
+  nu_check("should keep a trailing slash", static_file_test_resolve("/a/b/", "/a/b/"));
+  nu_check("should drop the query", static_file_test_resolve("/a.html?x=/../y", "/a.html"));
+  nu_check("should drop the fragment", static_file_test_resolve("/a/#top", "/a/"));
+  nu_check("should collapse slashes", static_file_test_resolve("//a///b", "/a/b"));
+  nu_check("should drop '.'", static_file_test_resolve("/./a/./b", "/a/b"));
+  nu_check("should resolve '..'", static_file_test_resolve("/a/b/../c", "/a/c"));
+  nu_check("should stop '..' at the root", static_file_test_resolve("/../../etc/passwd", "/etc/passwd"));
+  nu_check("should decode escapes", static_file_test_resolve("/my%20file.txt", "/my file.txt"));
+  nu_check("should resolve escaped '..'", static_file_test_resolve("/a/%2e%2E/b", "/b"));
+  nu_check("should treat an escaped slash as a slash",
+           static_file_test_resolve("/a/..%2f..%2Fetc", "/etc"));
+  nu_check("should keep dots inside names", static_file_test_resolve("/a/..b/.c", "/a/..b/.c"));
+
+  nu_check("should reject an empty URI", static_file_test_resolve("", NULL));
+  nu_check("should reject a relative URI", static_file_test_resolve("a/b", NULL));
+  nu_check("should reject an absolute URL", static_file_test_resolve("http://x/", NULL));
+  nu_check("should reject a truncated escape", static_file_test_resolve("/a%2", NULL));
+  nu_check("should reject a bad escape", static_file_test_resolve("/a%zz", NULL));
+  nu_check("should reject an escaped null", static_file_test_resolve("/a%00b", NULL));
+
+  char path[8];
+  nu_check("should reject a path that doesn't fit",
+           static_file_resolve("/abcdefgh", 9, path, sizeof(path)) == 0);
+  nu_check("should accept a path that just fits",
+           static_file_resolve("/abcdef", 7, path, sizeof(path)) == 7);
+}
+
+void test__static_file_open() {
+  char root[] = "/tmp/webserver-test-XXXXXX";
+  nu_assert("failed to create document root", mkdtemp(root));
+  char dir[64], noread[64];
+  snprintf(dir, sizeof(dir), "%s/docs", root);
+  snprintf(noread, sizeof(noread), "%s/secret.txt", root);
+  mkdir(dir, 0755);
+  static_file_test_write(root, "index.html", "<p>home</p>");
+  static_file_test_write(root, "style.css", "p {}");
+  static_file_test_write(root, "secret.txt", "shh");
+  chmod(noread, 0);
+
+  StaticFile file;
+  nu_check("should open a file", static_file_test_open(&file, root, "/style.css") == HTTP_STATUS_OK);
+  nu_check("should get the size", file.size == 4);
+  nu_check("should get the type", !strcmp(file.content_type, "text/css"));
+  nu_check("should get the modification time", file.mtime > 0);
+
+  nu_check("should open a directory's index", static_file_test_open(&file, root, "/") == HTTP_STATUS_OK);
+  nu_check("should get the index's size", file.size == 11);
+  nu_check("should get the index's type", !strcmp(file.content_type, "text/html"));
+
+  nu_check("should give 404 for a missing file",
+           static_file_test_open(&file, root, "/missing.html") == HTTP_STATUS_NOT_FOUND);
+  nu_check("should give 404 for a directory without an index",
+           static_file_test_open(&file, root, "/docs/") == HTTP_STATUS_NOT_FOUND);
+  nu_check("should give 404 below a file",
+           static_file_test_open(&file, root, "/style.css/x") == HTTP_STATUS_NOT_FOUND);
+  nu_check("should give 400 for a malformed URI",
+           static_file_test_open(&file, root, "/%zz") == HTTP_STATUS_BAD_REQUEST);
+  // Root can read anything, so the permission check only works for others
+  if(geteuid() != 0) {
+    nu_check("should give 403 for an unreadable file",
+             static_file_test_open(&file, root, "/secret.txt") == HTTP_STATUS_FORBIDDEN);
+  }
+
+  unlink(noread);
+  snprintf(noread, sizeof(noread), "%s/index.html", root);
+  unlink(noread);
+  snprintf(noread, sizeof(noread), "%s/style.css", root);
+  unlink(noread);
+  rmdir(dir);
+  rmdir(root);
+}
+
+void test__static_file_etag() {
+  StaticFile file;
+  char etag[STATIC_FILE_ETAG_SIZE];
+  file.inode = 0x1a2b;
+  file.size = 0;
+  file.mtime = 0x5f000000;
+  file.mtime_nsec = 0x1f;
+  static_file_etag(&file, etag);
+  nu_check("should format the fields in hex", !strcmp(etag, "\"1a2b-0-5f000000-1f\""));
+
+  file.inode = UINT64_MAX;
+  file.size = UINT64_MAX;
+  file.mtime = 0x7fffffffffffffffll;
+  file.mtime_nsec = 999999999;
+  static_file_etag(&file, etag);
+  nu_check("should fit the largest values", strlen(etag) == STATIC_FILE_ETAG_SIZE - 1);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__static_file() {
+  nu_run_test(test__static_file_resolve, "static_file_resolve()");
+  nu_run_test(test__static_file_open,    "static_file_open()");
+  nu_run_test(test__static_file_etag,    "static_file_etag()");
+}
+
+#endif // TEST_STATIC_FILE_H
@@ -0,0 +1,158 @@
+//==============================================================================
+// Timer wheel tests
+//==============================================================================
+#ifndef TEST_TIMER_WHEEL_H
+#define TEST_TIMER_WHEEL_H
+
+#include "nu_unit.h"
+#include "timer_wheel.h"
+#include <stdlib.h>
+
+// Helper: count fired timers, remember the last one, and (if 'wheel' is set)
+// check each one fires on exactly the tick it's due
+typedef struct TimerTestLog {
+  int         fired;
+  Timer*      last;
+  TimerWheel* wheel;
+  bool        late;
+} TimerTestLog;
+
+void timer_test_callback(Timer* timer, void* arg) {
+  TimerTestLog* log = arg;
+  log->fired += 1;
+  log->last = timer;
+  if(log->wheel && timer->expires != log->wheel->tick) log->late = true;
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+void test__timer_wheel_add() {
+  TimerWheel wheel;
+  Timer timer;
+  int data = 0;
+  timer_wheel_init(&wheel, 1000, 10);
+  timer_init(&timer, &data);
+  nu_check("timer should start unscheduled", !timer_pending(&timer));
+  nu_check("timer should hold its data", timer.data == &data);
+
+  timer_wheel_add(&wheel, &timer, 1100);
+  nu_check("timer should be scheduled", timer_pending(&timer));
+  nu_check("wheel should count the timer", wheel.count == 1);
+
+  // Adding again moves the timer rather than scheduling it twice
+  timer_wheel_add(&wheel, &timer, 1200);
+  nu_check("rescheduling shouldn't count the timer twice", wheel.count == 1);
+}
+
+void test__timer_wheel_remove() {
+  TimerWheel wheel;
+  Timer timer;
+  TimerTestLog log = {0, NULL, NULL, false};
+  timer_wheel_init(&wheel, 0, 10);
+  timer_init(&timer, NULL);
+
+  timer_wheel_remove(&wheel, &timer);
+  nu_check("removing an unscheduled timer should do nothing", wheel.count == 0);
+
+  timer_wheel_add(&wheel, &timer, 50);
+  timer_wheel_remove(&wheel, &timer);
+  nu_check("timer should be unscheduled", !timer_pending(&timer));
+  nu_check("wheel should be empty", wheel.count == 0);
+
+  timer_wheel_advance(&wheel, 1000, timer_test_callback, &log);
+  nu_check("removed timer shouldn't fire", log.fired == 0);
+}
+
+void test__timer_wheel_advance() {
+  TimerWheel wheel;
+  Timer timer;
+  TimerTestLog log = {0, NULL, NULL, false};
+  timer_wheel_init(&wheel, 0, 10);
+  timer_init(&timer, NULL);
+  timer_wheel_add(&wheel, &timer, 105);
+
+  timer_wheel_advance(&wheel, 100, timer_test_callback, &log);
+  nu_check("timer shouldn't fire early", log.fired == 0);
+  timer_wheel_advance(&wheel, 110, timer_test_callback, &log);
+  nu_check("timer should fire once due", log.fired == 1 && log.last == &timer);
+  nu_check("fired timer should be unscheduled", !timer_pending(&timer));
+  nu_check("wheel should be empty", wheel.count == 0);
+
+  // Timers in the past fire on the next advance
+  timer_wheel_add(&wheel, &timer, 0);
+  timer_wheel_advance(&wheel, 120, timer_test_callback, &log);
+  nu_check("overdue timer should fire", log.fired == 2);
+}
+
+void test__timer_wheel_advance__cascade() {
+  // Timers far enough out to start in each of the higher levels
+  const uint64_t delays[4] = { 50, 5000, 300 * 1000, 20 * 1000 * 1000 };
+  for(int i=0; i<4; ++i) {
+    TimerWheel wheel;
+    Timer timer;
+    TimerTestLog log = {0, NULL, NULL, false};
+    timer_wheel_init(&wheel, 12345, 10);
+    timer_init(&timer, NULL);
+    timer_wheel_add(&wheel, &timer, 12345 + delays[i]);
+
+    timer_wheel_advance(&wheel, 12345 + delays[i] - 10, timer_test_callback, &log);
+    nu_check("timer shouldn't fire before cascading down", log.fired == 0);
+    timer_wheel_advance(&wheel, 12345 + delays[i] + 10, timer_test_callback, &log);
+    nu_check("timer should fire after cascading down", log.fired == 1);
+  }
+}
+
+void test__timer_wheel_advance__many() {
+  // Fire a large number of timers with varied deadlines, in order
+  const int count = 10000;
+  Timer* timers = calloc(count, sizeof(Timer));
+  TimerWheel wheel;
+  TimerTestLog log = {0, NULL, &wheel, false};
+  timer_wheel_init(&wheel, 0, 10);
+  for(int i=0; i<count; ++i) {
+    timer_init(&timers[i], NULL);
+    timer_wheel_add(&wheel, &timers[i], (uint64_t)i * 97 + 1);
+  }
+
+  // Advance in uneven steps, so some calls cover many ticks
+  for(uint64_t now=0; now<=(uint64_t)count * 97 + 10; now+=333) {
+    timer_wheel_advance(&wheel, now, timer_test_callback, &log);
+  }
+  timer_wheel_advance(&wheel, (uint64_t)count * 97 + 10, timer_test_callback, &log);
+  nu_check("every timer should fire", log.fired == count);
+  nu_check("timers should fire on the tick they're due", !log.late);
+  nu_check("wheel should be empty", wheel.count == 0);
+  free(timers);
+}
+
+void test__timer_wheel_next_timeout() {
+  TimerWheel wheel;
+  Timer timer;
+  timer_wheel_init(&wheel, 0, 10);
+  timer_init(&timer, NULL);
+  nu_check("should be -1 with no timers", timer_wheel_next_timeout(&wheel, 0) == -1);
+
+  timer_wheel_add(&wheel, &timer, 100);
+  nu_check("should be the time to a nearby timer", timer_wheel_next_timeout(&wheel, 0) == 100);
+  nu_check("should account for the current time", timer_wheel_next_timeout(&wheel, 30) == 70);
+
+  // Far-off timers need the wheel to turn before they can fire
+  timer_wheel_add(&wheel, &timer, 100 * 1000);
+  const int timeout = timer_wheel_next_timeout(&wheel, 0);
+  nu_check("should wake up for a cascade", timeout > 0 && timeout <= 640);
+}
+
+//==============================================================================
+// Test suite
+//==============================================================================
+void test_suite__timer_wheel() {
+  nu_run_test(test__timer_wheel_add,              "timer_wheel_add()");
+  nu_run_test(test__timer_wheel_remove,           "timer_wheel_remove()");
+  nu_run_test(test__timer_wheel_advance,          "timer_wheel_advance()");
+  nu_run_test(test__timer_wheel_advance__cascade, "timer_wheel_advance() w/ cascading");
+  nu_run_test(test__timer_wheel_advance__many,    "timer_wheel_advance() w/ many timers");
+  nu_run_test(test__timer_wheel_next_timeout,     "timer_wheel_next_timeout()");
+}
+
+#endif // TEST_TIMER_WHEEL_H
@@ -8,8 +8,7 @@
 
 #include "nu_unit.h"
 #include "utils.h"
-#include <ctype.h>
-#include <sys/types.h>
+#include <string.h>
 
 //==============================================================================
 // Tests
@@ -29,27 +28,23 @@ void test__trim() {
   nu_check("didn't trim surrounding spaces", !strcmp(trim(buf), "foo"));
 }
 
-void test__timestamp() {
-  // Expected format: "20121008-15:32:46 UTC"
-  timebuf_t tb;
-  const char* str = timestamp(tb);
-  nu_check("should return pointer to input struct", str == tb);
-  nu_check("timestamp should have length 21", strlen(tb) == 21);
-  bool digits_ok = true;
-  const int digit_indexes[14] = {0,1,2,3,4,5,6,7,9,10,12,13,15,16};
-  for(int i=0; i<14 && digits_ok; ++i) {
-    digits_ok = isdigit(str[digit_indexes[i]]);
-  }
-  nu_check("should have digits in expected locations", digits_ok);
+void test__format_uint() {
+  char buf[21] = {0};
+  nu_check("should format zero", format_uint(buf, 0) == 1 && !strcmp(buf, "0"));
+  memset(buf, 0, sizeof(buf));
+  nu_check("should format a number", format_uint(buf, 4096) == 4 && !strcmp(buf, "4096"));
+  memset(buf, 0, sizeof(buf));
+  nu_check("should format the largest number", format_uint(buf, UINT64_MAX) == 20 &&
+           !strcmp(buf, "18446744073709551615"));
 }
 
 //==============================================================================
 // Test suites
 //==============================================================================
 void test_suite__utils() {
-  nu_run_test(test__safe_cstr, "safe_cstr()");
-  nu_run_test(test__trim,      "trim()");
-  nu_run_test(test__timestamp, "timestamp()");
+  nu_run_test(test__safe_cstr,   "safe_cstr()");
+  nu_run_test(test__trim,        "trim()");
+  nu_run_test(test__format_uint, "format_uint()");
 }
 
 #endif // TEST_UTILS_H
\ No newline at end of file